@@ -1,49 +1,171 @@
 #include "cloudflare_api.h"
-#include "esp_http_client.h"
-#include "esp_crt_bundle.h"
 #include "esp_log.h"
+#include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "hw_http.h"
 #include "main.h"
+#include "spsc_ring.h"
+#include "trace.h"
 #define CLOUDFLARE_API_BASE_URL "https://eee4464.terryh.workers.dev"
 
 static const char *TAG = "cloudflare_api";
 static void (*on_data_sent_cb)(void) = NULL;
 static const int TIMEOUT_MS = 5000; // Increased timeout for HTTP requests
+static const int NOWAIT_TIMEOUT_MS = 1000;
 #define MAX_RETRIES 1  // Maximum number of retries for HTTP requests
 
+// Long-lived clients shared by all verbs. Every connected client holds a TLS
+// context (~35 KB heap), so keep the pool small.
+#define CLOUDFLARE_POOL_SIZE 3
+#define POOL_ACQUIRE_TIMEOUT_MS 6000
+
+// Requests waiting for the engine (a power of two); each one in flight
+// occupies a pooled connection
+#define ENGINE_QUEUE_LENGTH 8
+#define ENGINE_TASK_STACK   10240
+
+// Validators of recent GET responses, keyed by endpoint
+#define ETAG_CACHE_SIZE 4
+
 // Structure to hold data for the HTTP event handler
 typedef struct {
+    const char *endpoint;
     char *buffer;
     int buffer_size;
     int bytes_written;
+    int body_len;                 // bytes received, including any that did not fit
+    cloudflare_data_cb_t on_data; // streams the body instead of copying it to buffer
+    void *on_data_arg;
+    bool cacheable;               // streaming GET: may be conditional, validators are kept
+    bool conditional;             // sent with If-None-Match / If-Modified-Since
+    char etag[64];                // validators of the response, "" if absent or too long
+    char last_modified[32];
     esp_err_t err_code; // To capture errors from event handler if any
 } http_event_user_data_t;
 
+// One pooled connection. The client handle survives across requests, so the
+// socket and TLS session are reused for as long as the server keeps them open.
+typedef struct {
+    hw_http_handle_t client;
+    bool in_use;
+    bool connected;               // maintained by the event handler
+    http_event_user_data_t req;   // per-request state for the event handler
+} cf_conn_t;
+
+static cf_conn_t pool[CLOUDFLARE_POOL_SIZE];
+static int pool_busy = 0;                    // connections in use, for peak_in_flight
+static SemaphoreHandle_t pool_lock = NULL;   // guards in_use flags
+static SemaphoreHandle_t pool_slots = NULL;  // counts free connections
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+static cloudflare_pool_stats_t pool_stats;
+
+// A request owned by the engine. conn is NULL while it waits for a
+// connection or for its retry backoff to expire.
+typedef struct {
+    cloudflare_request_t req;
+    const char *verb;
+    char url[256];
+    cf_conn_t *conn;
+    int attempt;
+    bool reused;              // conn was already connected when the attempt started
+    bool reconnected;         // the attempt was already re-issued on a fresh connection
+    TickType_t started;       // start of the current attempt
+    TickType_t not_before;    // retry backoff
+    trace_span_t span;        // the current attempt, on the slot's trace track
+    uint32_t order;           // submission order, for ordered requests
+    bool active;
+} cf_inflight_t;
+
+static cf_inflight_t inflight[CLOUDFLARE_POOL_SIZE];
+static const char *const inflight_track[CLOUDFLARE_POOL_SIZE] = { "http engine 0", "http engine 1", "http engine 2" };
+// cloudflare_submit() -> engine task
+static spsc_ring_t engine_queue;
+static cloudflare_request_t engine_queue_buf[ENGINE_QUEUE_LENGTH];
+static _Atomic(TaskHandle_t) engine_producer;   // the one task that may submit
+static bool engine_started;
+static uint32_t engine_order;     // engine task only
+static bool engine_progress;      // a request completed during this pass
+
+// A streaming GET for a cached endpoint is sent as a conditional request;
+// on a 304 the consumer's result from the last full response still stands.
+// Validators are only used once the consumer has accepted that response.
+typedef struct {
+    char endpoint[128];
+    char etag[64];
+    char last_modified[32];
+    int body_len;          // size of the last full response, what a 304 saves
+    uint32_t last_used;
+    bool accepted;         // cloudflare_accept_response() was called for it
+} cf_etag_entry_t;
+
+static cf_etag_entry_t etag_cache[ETAG_CACHE_SIZE];
+static uint32_t etag_clock = 0;
+static SemaphoreHandle_t etag_lock = NULL;
+
+static char base_url[96] = CLOUDFLARE_API_BASE_URL;
+static const char *server_cert_pem = NULL;
+static bool reuse_connections = true;
+
+#define STATS_INC(field) do { \
+        portENTER_CRITICAL(&stats_mux); \
+        pool_stats.field++; \
+        portEXIT_CRITICAL(&stats_mux); \
+    } while (0)
+
+#define STATS_ADD(field, n) do { \
+        portENTER_CRITICAL(&stats_mux); \
+        pool_stats.field += (n); \
+        portEXIT_CRITICAL(&stats_mux); \
+    } while (0)
+
+// Copy a response header value, leaving dst empty if it does not fit
+static void copy_header(char *dst, size_t size, const char *value) {
+    size_t len = value ? strlen(value) : 0;
+    if (len >= size) len = 0;
+    memcpy(dst, value, len);
+    dst[len] = '\0';
+}
+
 
-// Custom HTTP event handler for GET requests
-static esp_err_t _http_event_handler_for_get(esp_http_client_event_t *evt) {
-    http_event_user_data_t *user_data = (http_event_user_data_t *)evt->user_data;
+// Custom HTTP event handler shared by all pooled clients
+static void _http_event_handler_for_get(const hw_http_event_t *evt) {
+    cf_conn_t *conn = (cf_conn_t *)evt->user_data;
+    http_event_user_data_t *user_data = conn ? &conn->req : NULL;
 
-    switch(evt->event_id) {
-        case HTTP_EVENT_ERROR:
+    switch(evt->id) {
+        case HW_HTTP_EVENT_ERROR:
             ESP_LOGE(TAG, "HTTP_EVENT_ERROR");
             if (user_data) user_data->err_code = ESP_FAIL;
             break;
-        case HTTP_EVENT_ON_CONNECTED:
+        case HW_HTTP_EVENT_CONNECTED:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_CONNECTED");
+            // A new TCP + TLS handshake just completed
+            if (conn) conn->connected = true;
+            STATS_INC(handshakes);
             break;
-        case HTTP_EVENT_HEADER_SENT:
-            // ESP_LOGI(TAG, "HTTP_EVENT_HEADER_SENT");
-            break;
-        case HTTP_EVENT_ON_HEADER:
+        case HW_HTTP_EVENT_HEADER:
             // ESP_LOGI(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
+            if (user_data && user_data->cacheable) {
+                if (strcasecmp(evt->header_key, "ETag") == 0) {
+                    copy_header(user_data->etag, sizeof(user_data->etag), evt->header_value);
+                } else if (strcasecmp(evt->header_key, "Last-Modified") == 0) {
+                    copy_header(user_data->last_modified, sizeof(user_data->last_modified), evt->header_value);
+                }
+            }
             break;
-        case HTTP_EVENT_ON_DATA:
+        case HW_HTTP_EVENT_DATA:
             // ESP_LOGI(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
-            if (user_data && user_data->buffer) {
+            if (user_data && user_data->on_data) {
+                // The consumer keeps its last result until a new body arrives,
+                // so a 304 leaves it intact
+                if (user_data->body_len == 0) user_data->on_data(NULL, 0, user_data->on_data_arg);
+                if (evt->data_len > 0) user_data->on_data(evt->data, evt->data_len, user_data->on_data_arg);
+            } else if (user_data && user_data->buffer) {
                 // Check if there's space in the buffer (leaving 1 byte for null terminator)
                 int space_available = user_data->buffer_size - user_data->bytes_written - 1;
                 if (space_available < 0) space_available = 0; // No space left
@@ -59,8 +181,9 @@ static esp_err_t _http_event_handler_for_get(esp_http_client_event_t *evt) {
                     ESP_LOGW(TAG, "No space left in buffer for response data. Buffer full or too small. Bytes written: %d, Buffer size: %d", user_data->bytes_written, user_data->buffer_size);
                 }
             }
+            if (user_data && evt->data_len > 0) user_data->body_len += evt->data_len;
             break;
-        case HTTP_EVENT_ON_FINISH:
+        case HW_HTTP_EVENT_FINISH:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_FINISH");
             if (user_data && user_data->buffer) {
                 if (user_data->bytes_written < user_data->buffer_size) {
@@ -71,253 +194,607 @@ static esp_err_t _http_event_handler_for_get(esp_http_client_event_t *evt) {
                 }
             }
             break;
-        case HTTP_EVENT_DISCONNECTED:
+        case HW_HTTP_EVENT_DISCONNECTED:
             ESP_LOGD(TAG, "HTTP_EVENT_DISCONNECTED");
-            // If an error wasn't already set, and we disconnected unexpectedly,
-            // esp_http_client_perform() should return an error.
-            // If not, this might indicate a premature disconnection.
+            // The next request on this client will open a new connection
+            if (conn) conn->connected = false;
             break;
         default:
             break;
     }
-    return ESP_OK;
 }
 
-// Enhanced POST with retry functionality
-esp_err_t cloudflare_post_json(const char *endpoint, const char *json_body) {
-    char url[256];
-    snprintf(url, sizeof(url), "%s%s", CLOUDFLARE_API_BASE_URL, endpoint);
+// Give a connection back to the pool. drop=true (or reuse disabled) tears the
+// client down so the next user starts with a fresh handshake.
+static void pool_release(cf_conn_t *conn, bool drop) {
+    if ((drop || !reuse_connections) && conn->client) {
+        hw_http_cleanup(conn->client);
+        conn->client = NULL;
+        conn->connected = false;
+    }
+    xSemaphoreTake(pool_lock, portMAX_DELAY);
+    conn->in_use = false;
+    pool_busy--;
+    xSemaphoreGive(pool_lock);
+    xSemaphoreGive(pool_slots);
+}
 
-    esp_err_t err = ESP_FAIL;
-    if (is_ap_mode_enabled()) {
-        ESP_LOGW("NETWORK", "In SoftAP mode, skip cloudflare_post_json");
-        return err;
+// Borrow a connection, preferring one that is already connected
+static cf_conn_t *pool_acquire(TickType_t wait) {
+    if (xSemaphoreTake(pool_slots, wait) != pdTRUE) {
+        if (wait > 0) ESP_LOGW(TAG, "No free connection in pool after %d ms", POOL_ACQUIRE_TIMEOUT_MS);
+        return NULL;
     }
-    int retry_count = 0;
-    
-    while (retry_count <= MAX_RETRIES) {
-        if (retry_count > 0) {
-            // Exponential backoff
-            int delay_ms = 500 * (1 << (retry_count - 1)); // 500ms, 1000ms, 2000ms
-            ESP_LOGI(TAG, "Retrying POST [%s] (attempt %d/%d) after %dms delay", 
-                     endpoint, retry_count, MAX_RETRIES, delay_ms);
-            vTaskDelay(pdMS_TO_TICKS(delay_ms));
-        }
-        
-        esp_http_client_config_t config = {
-            .url = url,
-            .method = HTTP_METHOD_POST,
+
+    cf_conn_t *conn = NULL;
+    xSemaphoreTake(pool_lock, portMAX_DELAY);
+    for (int i = 0; i < CLOUDFLARE_POOL_SIZE && conn == NULL; i++) {
+        if (!pool[i].in_use && pool[i].client && pool[i].connected) conn = &pool[i];
+    }
+    for (int i = 0; i < CLOUDFLARE_POOL_SIZE && conn == NULL; i++) {
+        if (!pool[i].in_use) conn = &pool[i];
+    }
+    conn->in_use = true; // pool_slots guarantees a free entry
+    if (++pool_busy > (int)pool_stats.peak_in_flight) {
+        portENTER_CRITICAL(&stats_mux);
+        pool_stats.peak_in_flight = pool_busy;
+        portEXIT_CRITICAL(&stats_mux);
+    }
+    xSemaphoreGive(pool_lock);
+
+    if (conn->client == NULL) {
+        hw_http_config_t config = {
+            .url = base_url,
             .event_handler = _http_event_handler_for_get,
-            .crt_bundle_attach = esp_crt_bundle_attach,
+            .user_data = conn,
             .timeout_ms = TIMEOUT_MS,
-            .buffer_size = 2048, // Increased buffer size
+            .buffer_size = 2048,
             .buffer_size_tx = 1024,
-            .keep_alive_enable = false, // Disable keep-alive for cleaner connections
+            // TCP keep-alive probes let us notice a dead peer on an idle connection
+            .keep_alive = true,
+            // Non-blocking: perform() returns HW_HTTP_ERR_EAGAIN instead of
+            // waiting, so one task can drive several connections. Only
+            // supported over TLS.
+            .is_async = strncmp(base_url, "https://", 8) == 0,
+            .cert_pem = server_cert_pem,
         };
-        
-        esp_http_client_handle_t client = esp_http_client_init(&config);
-        esp_http_client_set_header(client, "Content-Type", "application/json");
-        esp_http_client_set_post_field(client, json_body, strlen(json_body));
-        
-        err = esp_http_client_perform(client);
-        
-        if (err == ESP_OK) {
-            int status_code = esp_http_client_get_status_code(client);
-            if (status_code >= 200 && status_code < 300) {
-                ESP_LOGI(TAG, "POST Success [%s]: %s", endpoint, json_body);
-                if (on_data_sent_cb) on_data_sent_cb();
-                esp_http_client_cleanup(client);
-                return ESP_OK;
-            } else {
-                ESP_LOGW(TAG, "POST received HTTP status %d for [%s]", status_code, endpoint);
-                err = ESP_FAIL; // Force retry on non-success HTTP status
+        conn->client = hw_http_init(&config);
+        if (conn->client == NULL) {
+            ESP_LOGE(TAG, "HTTP client init failed");
+            pool_release(conn, true);
+            return NULL;
+        }
+        conn->connected = false;
+    }
+    return conn;
+}
+
+static cf_etag_entry_t *etag_find(const char *endpoint) {
+    for (int i = 0; i < ETAG_CACHE_SIZE; i++) {
+        if (etag_cache[i].endpoint[0] && strcmp(etag_cache[i].endpoint, endpoint) == 0) return &etag_cache[i];
+    }
+    return NULL;
+}
+
+// Add the accepted validators of endpoint to a streaming GET, or clear them
+// from the reused client. Returns true if the request became conditional.
+static bool etag_apply(hw_http_handle_t client, const char *endpoint, bool cacheable) {
+    char etag[sizeof(etag_cache[0].etag)] = "";
+    char last_modified[sizeof(etag_cache[0].last_modified)] = "";
+    if (cacheable && etag_lock) {
+        xSemaphoreTake(etag_lock, portMAX_DELAY);
+        cf_etag_entry_t *e = etag_find(endpoint);
+        if (e && e->accepted) {
+            strcpy(etag, e->etag);
+            strcpy(last_modified, e->last_modified);
+        }
+        xSemaphoreGive(etag_lock);
+    }
+    if (etag[0]) hw_http_set_header(client, "If-None-Match", etag);
+    else hw_http_delete_header(client, "If-None-Match");
+    if (last_modified[0]) hw_http_set_header(client, "If-Modified-Since", last_modified);
+    else hw_http_delete_header(client, "If-Modified-Since");
+    return etag[0] || last_modified[0];
+}
+
+// Remember the validators of a full GET response (or forget the endpoint if
+// the server sent none), evicting the least recently used entry. They are
+// not used until the consumer accepts the response.
+static void etag_store(const http_event_user_data_t *req) {
+    if (etag_lock == NULL || strlen(req->endpoint) >= sizeof(etag_cache[0].endpoint)) return;
+    xSemaphoreTake(etag_lock, portMAX_DELAY);
+    cf_etag_entry_t *e = etag_find(req->endpoint);
+    if (req->etag[0] == '\0' && req->last_modified[0] == '\0') {
+        if (e) e->endpoint[0] = '\0';
+    } else {
+        for (int i = 0; i < ETAG_CACHE_SIZE && e == NULL; i++) {
+            if (etag_cache[i].endpoint[0] == '\0') e = &etag_cache[i];
+        }
+        if (e == NULL) {
+            e = &etag_cache[0];
+            for (int i = 1; i < ETAG_CACHE_SIZE; i++) {
+                if (etag_cache[i].last_used < e->last_used) e = &etag_cache[i];
             }
-        } else {
-            ESP_LOGE(TAG, "POST Failed [%s]: %s", endpoint, esp_err_to_name(err));
         }
-        
-        esp_http_client_cleanup(client);
-        retry_count++;
+        strcpy(e->endpoint, req->endpoint);
+        strcpy(e->etag, req->etag);
+        strcpy(e->last_modified, req->last_modified);
+        e->body_len = req->body_len;
+        e->last_used = ++etag_clock;
+        e->accepted = false;
     }
-    
-    ESP_LOGE(TAG, "POST Failed after %d retries [%s]", MAX_RETRIES, endpoint);
-    return err;
+    xSemaphoreGive(etag_lock);
 }
 
-// Fire-and-forget POST without waiting for response
-esp_err_t cloudflare_post_json_nowait(const char *endpoint, const char *json_body) {
-    char url[256];
-    snprintf(url, sizeof(url), "%s%s", CLOUDFLARE_API_BASE_URL, endpoint);
+void cloudflare_accept_response(const char *endpoint) {
+    if (etag_lock == NULL || endpoint == NULL) return;
+    xSemaphoreTake(etag_lock, portMAX_DELAY);
+    cf_etag_entry_t *e = etag_find(endpoint);
+    if (e) e->accepted = true;
+    xSemaphoreGive(etag_lock);
+}
 
-    if (is_ap_mode_enabled()) {
-        ESP_LOGW("NETWORK", "In SoftAP mode, skip cloudflare_post_json_nowait");
-        return ESP_FAIL;
+static void etag_forget(const char *endpoint) {
+    xSemaphoreTake(etag_lock, portMAX_DELAY);
+    cf_etag_entry_t *e = etag_find(endpoint);
+    if (e) e->endpoint[0] = '\0';
+    xSemaphoreGive(etag_lock);
+}
+
+// A 304 for endpoint: returns the size of the response it replaced
+static int etag_hit(const char *endpoint) {
+    int saved = 0;
+    xSemaphoreTake(etag_lock, portMAX_DELAY);
+    cf_etag_entry_t *e = etag_find(endpoint);
+    if (e) {
+        saved = e->body_len;
+        e->last_used = ++etag_clock;
     }
+    xSemaphoreGive(etag_lock);
+    return saved;
+}
 
-    esp_http_client_config_t config = {
-        .url = url,
-        .method = HTTP_METHOD_POST,
-        .crt_bundle_attach = esp_crt_bundle_attach,
-        .timeout_ms = 1000,
-        .keep_alive_enable = true,
+// Point a pooled client at the next request
+static void cf_begin(cf_conn_t *conn, hw_http_method_t method, const char *endpoint, const char *url,
+                     const char *json_body, char *buffer, int buffer_size,
+                     cloudflare_data_cb_t on_data, void *on_data_arg, int timeout_ms) {
+    if (buffer && buffer_size > 0) buffer[0] = '\0';
+    conn->req = (http_event_user_data_t) {
+        .endpoint = endpoint,
+        .buffer = buffer,
+        .buffer_size = buffer_size,
+        .bytes_written = 0,
+        .on_data = on_data,
+        .on_data_arg = on_data_arg,
+        .cacheable = method == HW_HTTP_GET && on_data != NULL,
+        .err_code = ESP_OK
     };
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-    esp_http_client_open(client, strlen(json_body));
-    esp_http_client_write(client, json_body, strlen(json_body));
-    esp_http_client_close(client);
-    esp_http_client_cleanup(client);
-    return ESP_OK;
+    hw_http_handle_t client = conn->client;
+    conn->req.conditional = etag_apply(client, endpoint, conn->req.cacheable);
+    hw_http_set_url(client, url);
+    hw_http_set_method(client, method);
+    hw_http_set_timeout_ms(client, timeout_ms);
+    if (json_body) {
+        hw_http_set_header(client, "Content-Type", "application/json");
+        hw_http_set_body(client, json_body, strlen(json_body));
+    } else {
+        hw_http_set_body(client, NULL, 0);
+    }
 }
 
-/* ----------------------------------------------------------------------
- * HTTP PUT with retry logic
- * --------------------------------------------------------------------*/
-esp_err_t cloudflare_put_json(const char *endpoint, const char *json_body)
-{
-    char url[256];
-    snprintf(url, sizeof(url), "%s%s", CLOUDFLARE_API_BASE_URL, endpoint);
+// Drop a keep-alive connection the server closed while idle so the same
+// request can be re-sent on a fresh one
+static void cf_reconnect(cf_conn_t *conn, const char *verb, const char *endpoint, esp_err_t err) {
+    ESP_LOGW(TAG, "%s [%s] failed on reused connection (%s), reconnecting",
+             verb, endpoint, esp_err_to_name(err));
+    hw_http_close(conn->client);
+    conn->connected = false;
+    conn->req.bytes_written = 0;
+    conn->req.body_len = 0;
+    conn->req.etag[0] = '\0';
+    conn->req.last_modified[0] = '\0';
+    conn->req.err_code = ESP_OK;
+    if (conn->req.buffer && conn->req.buffer_size > 0) conn->req.buffer[0] = '\0';
+    STATS_INC(reconnects);
+}
 
-    esp_err_t err = ESP_FAIL;
-    if (is_ap_mode_enabled()) {
-        ESP_LOGW("NETWORK", "In SoftAP mode, skip cloudflare_put_json");
-        return err;
-    }
-    int retry_count = 0;
-    
-    while (retry_count <= MAX_RETRIES) {
-        if (retry_count > 0) {
-            // Exponential backoff
-            int delay_ms = 500 * (1 << (retry_count - 1)); // 500ms, 1000ms, 2000ms
-            ESP_LOGI(TAG, "Retrying PUT [%s] (attempt %d/%d) after %dms delay", 
-                     endpoint, retry_count, MAX_RETRIES, delay_ms);
-            vTaskDelay(pdMS_TO_TICKS(delay_ms));
+// Evaluate a finished attempt and give the connection back to the pool.
+// Returns ESP_OK for a 2xx response, CLOUDFLARE_ERR_NOT_MODIFIED for a 304
+// to a conditional GET; *status is 0 if no response arrived.
+static esp_err_t cf_finish(cf_conn_t *conn, esp_err_t err, const char *verb, const char *endpoint,
+                           const char *json_body, int *status) {
+    *status = 0;
+    if (err == ESP_OK && conn->req.err_code == ESP_OK) {
+        *status = hw_http_status(conn->client);
+        char *buffer = conn->req.buffer;
+        if (conn->req.conditional) STATS_INC(conditional);
+        if (*status == 304 && conn->req.conditional) {
+            pool_release(conn, false);
+            STATS_INC(not_modified);
+            STATS_ADD(bytes_saved, etag_hit(endpoint));
+            ESP_LOGD(TAG, "%s Not modified [%s]", verb, endpoint);
+            return CLOUDFLARE_ERR_NOT_MODIFIED;
         }
-        
-        http_event_user_data_t user_data = {
-            .buffer = NULL,
-            .buffer_size = 0,
-            .bytes_written = 0,
-            .err_code = ESP_OK
-        };
-        
-        esp_http_client_config_t config = {
-            .url = url,
-            .method = HTTP_METHOD_PUT,
-            .event_handler = _http_event_handler_for_get,
-            .user_data = &user_data,
-            .crt_bundle_attach = esp_crt_bundle_attach,
-            .timeout_ms = TIMEOUT_MS,
-            .buffer_size = 2048, 
-            .buffer_size_tx = 1024,
-            .keep_alive_enable = false,
-        };
-        
-        esp_http_client_handle_t client = esp_http_client_init(&config);
-        esp_http_client_set_header(client, "Content-Type", "application/json");
-        esp_http_client_set_post_field(client, json_body, strlen(json_body));
-        
-        err = esp_http_client_perform(client);
-        
-        if (err == ESP_OK && user_data.err_code == ESP_OK) {
-            int status_code = esp_http_client_get_status_code(client);
-            if (status_code >= 200 && status_code < 300) {
-                ESP_LOGI(TAG, "PUT Success [%s]: %s", endpoint, json_body);
+        if (*status >= 200 && *status < 300 && conn->req.cacheable) {
+            etag_store(&conn->req);
+            // An empty body still replaces whatever the consumer parsed last time
+            if (conn->req.on_data && conn->req.body_len == 0) conn->req.on_data(NULL, 0, conn->req.on_data_arg);
+        } else if (conn->req.on_data && conn->req.body_len > 0) {
+            etag_forget(endpoint); // an error body went to the consumer
+        }
+        pool_release(conn, false);
+        if (*status >= 200 && *status < 300) {
+            if (json_body) {
+                ESP_LOGI(TAG, "%s Success [%s]: %s", verb, endpoint, json_body);
                 if (on_data_sent_cb) on_data_sent_cb();
-                esp_http_client_cleanup(client);
-                return ESP_OK;
             } else {
-                ESP_LOGW(TAG, "PUT received HTTP status %d for [%s]", status_code, endpoint);
-                err = ESP_FAIL; // Force retry on non-success HTTP status
+                ESP_LOGI(TAG, "%s Success [%s]", verb, endpoint);
+                if (buffer) ESP_LOGD(TAG, "%s Response [%s]: %s", verb, endpoint, buffer);
             }
-        } else {
-            ESP_LOGE(TAG, "PUT Failed [%s]: %s", endpoint, esp_err_to_name(err));
-            if (err == ESP_OK) err = user_data.err_code;
+            return ESP_OK;
         }
-        
-        esp_http_client_cleanup(client);
-        retry_count++;
+        ESP_LOGW(TAG, "%s received HTTP status %d for [%s]", verb, *status, endpoint);
+        return ESP_FAIL; // Force retry on non-success HTTP status
     }
-    
-    ESP_LOGE(TAG, "PUT Failed after %d retries [%s]", MAX_RETRIES, endpoint);
+    ESP_LOGE(TAG, "%s Failed [%s]: %s", verb, endpoint, esp_err_to_name(err));
+    // A consumer fed part of a body no longer holds the cached response
+    if (conn->req.on_data && conn->req.body_len > 0) etag_forget(endpoint);
+    // If perform() was OK but handler reported a problem, propagate that
+    if (err == ESP_OK) err = conn->req.err_code;
+    // Transport failure: start the next attempt from a clean client
+    STATS_INC(failures);
+    pool_release(conn, true);
     return err;
 }
 
-// Enhanced GET with retry functionality
-esp_err_t cloudflare_get_json(const char *endpoint, char *buffer, int buffer_size) {
-    if (buffer == NULL || buffer_size <= 0) {
-        ESP_LOGE(TAG, "Invalid buffer or size for GET request");
-        return ESP_ERR_INVALID_ARG;
+// Drive a non-blocking client to completion from the calling task
+static esp_err_t cf_perform_blocking(cf_conn_t *conn, int timeout_ms) {
+    TickType_t start = xTaskGetTickCount();
+    trace_span_t span = trace_begin("http", "perform");
+    esp_err_t err;
+    while ((err = hw_http_perform(conn->client)) == HW_HTTP_ERR_EAGAIN) {
+        if (xTaskGetTickCount() - start >= pdMS_TO_TICKS(timeout_ms)) {
+            err = ESP_ERR_TIMEOUT;
+            break;
+        }
+        vTaskDelay(1);
     }
+    trace_end(&span);
+    return err;
+}
+
+// Exponential backoff before retry n (1-based): 500ms, 1000ms, 2000ms
+static int retry_delay_ms(int retry) {
+    return 500 * (1 << (retry - 1));
+}
+
+// Run one request on a pooled connection with retry/backoff, blocking the
+// caller. buffer may be NULL when the response body is not needed, or when
+// on_data consumes it as it arrives.
+static esp_err_t cf_perform(hw_http_method_t method, const char *verb, const char *endpoint,
+                            const char *json_body, char *buffer, int buffer_size,
+                            cloudflare_data_cb_t on_data, void *on_data_arg,
+                            int timeout_ms, int max_retries) {
     char url[256];
-    snprintf(url, sizeof(url), "%s%s", CLOUDFLARE_API_BASE_URL, endpoint);
-    
+    snprintf(url, sizeof(url), "%s%s", base_url, endpoint);
+
     esp_err_t err = ESP_FAIL;
     if (is_ap_mode_enabled()) {
-        ESP_LOGW("NETWORK", "In SoftAP mode, skip cloudflare_get_json");
+        ESP_LOGW("NETWORK", "In SoftAP mode, skip %s [%s]", verb, endpoint);
         return err;
     }
+    if (pool_slots == NULL) {
+        ESP_LOGE(TAG, "cloudflare_api_init() has not been called");
+        return ESP_ERR_INVALID_STATE;
+    }
     int retry_count = 0;
-    
-    while (retry_count <= MAX_RETRIES) {
+
+    while (retry_count <= max_retries) {
         if (retry_count > 0) {
-            // Clear buffer before retry
-            if (buffer && buffer_size > 0) {
-                buffer[0] = '\0';
-            }
-            
-            // Exponential backoff
-            int delay_ms = 500 * (1 << (retry_count - 1)); // 500ms, 1000ms, 2000ms
-            ESP_LOGI(TAG, "Retrying GET [%s] (attempt %d/%d) after %dms delay", 
-                     endpoint, retry_count, MAX_RETRIES, delay_ms);
+            int delay_ms = retry_delay_ms(retry_count);
+            ESP_LOGI(TAG, "Retrying %s [%s] (attempt %d/%d) after %dms delay",
+                     verb, endpoint, retry_count, max_retries, delay_ms);
             vTaskDelay(pdMS_TO_TICKS(delay_ms));
         }
 
-        /* Prepare a structure that the HTTP event handler will populate */
-        http_event_user_data_t user_data = {
-            .buffer = buffer,
-            .buffer_size = buffer_size,
-            .bytes_written = 0,
-            .err_code = ESP_OK
-        };
+        cf_conn_t *conn = pool_acquire(pdMS_TO_TICKS(POOL_ACQUIRE_TIMEOUT_MS));
+        if (conn == NULL) {
+            err = ESP_ERR_TIMEOUT;
+            retry_count++;
+            continue;
+        }
+        bool reused = conn->connected;
+        cf_begin(conn, method, endpoint, url, json_body, buffer, buffer_size, on_data, on_data_arg, timeout_ms);
+
+        err = cf_perform_blocking(conn, timeout_ms);
+        STATS_INC(requests);
+
+        if (err != ESP_OK && reused) {
+            // The server or a NAT box dropped the idle keep-alive connection.
+            // Reconnect once right away instead of burning a backoff retry.
+            cf_reconnect(conn, verb, endpoint, err);
+            err = cf_perform_blocking(conn, timeout_ms);
+            STATS_INC(requests);
+        }
 
-        esp_http_client_config_t config = {
-            .url = url,
-            .method = HTTP_METHOD_GET,
-            .event_handler = _http_event_handler_for_get,
-            .user_data = &user_data,
-            .buffer_size = buffer_size + 512, // Additional buffer for processing
-            .crt_bundle_attach = esp_crt_bundle_attach,
-            .timeout_ms = TIMEOUT_MS,
-            .keep_alive_enable = false,
-        };
+        int status;
+        err = cf_finish(conn, err, verb, endpoint, json_body, &status);
+        if (err == ESP_OK || err == CLOUDFLARE_ERR_NOT_MODIFIED) return err;
+        retry_count++;
+    }
+
+    ESP_LOGE(TAG, "%s Failed after %d retries [%s]", verb, max_retries, endpoint);
+    return err;
+}
 
-        esp_http_client_handle_t client = esp_http_client_init(&config);
-        err = esp_http_client_perform(client);
+/* ----------------------------------------------------------------------
+ * Request engine: one task keeps up to CLOUDFLARE_POOL_SIZE requests in
+ * flight on the pooled non-blocking clients. Nothing in here sleeps on a
+ * single request; retries are scheduled and the connection is handed back
+ * while the backoff runs.
+ * --------------------------------------------------------------------*/
+static const char *method_name(cloudflare_method_t method) {
+    switch (method) {
+        case CLOUDFLARE_GET: return "GET";
+        case CLOUDFLARE_PUT: return "PUT";
+        default:             return "POST";
+    }
+}
 
-        if (err == ESP_OK && user_data.err_code == ESP_OK) {
-            int status_code = esp_http_client_get_status_code(client);
-            if (status_code >= 200 && status_code < 300) {
-                ESP_LOGI(TAG, "GET Success [%s]", endpoint);
-                ESP_LOGD(TAG, "GET Response [%s]: %s", endpoint, buffer);
-                esp_http_client_cleanup(client);
-                return ESP_OK;
-            } else {
-                ESP_LOGW(TAG, "GET received HTTP status %d for [%s]", status_code, endpoint);
-                err = ESP_FAIL; // Force retry on non-success HTTP status
+static hw_http_method_t http_method(cloudflare_method_t method) {
+    switch (method) {
+        case CLOUDFLARE_GET: return HW_HTTP_GET;
+        case CLOUDFLARE_PUT: return HW_HTTP_PUT;
+        default:             return HW_HTTP_POST;
+    }
+}
+
+static void engine_complete(cf_inflight_t *slot, esp_err_t result, int status) {
+    slot->active = false;
+    engine_progress = true;
+    if (slot->req.done_cb) slot->req.done_cb(result, status, slot->req.arg);
+}
+
+// An ordered request waits for every earlier ordered one to the same
+// endpoint, including one that is only waiting out a retry backoff
+static bool engine_held(const cf_inflight_t *slot) {
+    if (!slot->req.ordered) return false;
+    for (int i = 0; i < CLOUDFLARE_POOL_SIZE; i++) {
+        const cf_inflight_t *other = &inflight[i];
+        if (other != slot && other->active && other->req.ordered &&
+            (int32_t)(other->order - slot->order) < 0 && strcmp(other->req.endpoint, slot->req.endpoint) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Advance one request. Returns true while it is waiting on the network.
+static bool engine_step(cf_inflight_t *slot, TickType_t now, TickType_t *wake) {
+    const cloudflare_request_t *req = &slot->req;
+    int timeout_ms = req->timeout_ms > 0 ? req->timeout_ms : TIMEOUT_MS;
+
+    if (slot->conn == NULL) {
+        // Not started yet; re-checked after the earlier one completes
+        if (slot->attempt == 0 && engine_held(slot)) return false;
+        if ((int32_t)(slot->not_before - now) > 0) {
+            TickType_t left = slot->not_before - now;
+            if (left < *wake) *wake = left;
+            return false;
+        }
+        if (is_ap_mode_enabled()) {
+            ESP_LOGW("NETWORK", "In SoftAP mode, skip %s [%s]", slot->verb, req->endpoint);
+            engine_complete(slot, ESP_FAIL, 0);
+            return false;
+        }
+        slot->conn = pool_acquire(0);
+        if (slot->conn == NULL) {
+            *wake = 1; // every connection is lent to a blocking caller
+            return false;
+        }
+        slot->reused = slot->conn->connected;
+        slot->reconnected = false;
+        slot->started = now;
+        slot->span = trace_begin("http", slot->verb);
+        cf_begin(slot->conn, http_method(req->method), req->endpoint, slot->url, req->json_body,
+                 req->response, req->response_size, req->on_data, req->arg, timeout_ms);
+    }
+
+    esp_err_t err = hw_http_perform(slot->conn->client);
+    if (err == HW_HTTP_ERR_EAGAIN) {
+        if (now - slot->started < pdMS_TO_TICKS(timeout_ms)) return true;
+        err = ESP_ERR_TIMEOUT;
+    }
+    STATS_INC(requests);
+    trace_end_on(&slot->span, inflight_track[slot - inflight]);
+
+    if (err != ESP_OK && slot->reused && !slot->reconnected) {
+        cf_reconnect(slot->conn, slot->verb, req->endpoint, err);
+        slot->reconnected = true;
+        slot->started = now;
+        slot->span = trace_begin("http", slot->verb);
+        return true;
+    }
+
+    int status;
+    esp_err_t result = cf_finish(slot->conn, err, slot->verb, req->endpoint, req->json_body, &status);
+    slot->conn = NULL;
+    if (result == ESP_OK || result == CLOUDFLARE_ERR_NOT_MODIFIED || slot->attempt >= req->max_retries) {
+        if (result != ESP_OK && result != CLOUDFLARE_ERR_NOT_MODIFIED) {
+            ESP_LOGE(TAG, "%s Failed after %d retries [%s]", slot->verb, req->max_retries, req->endpoint);
+        }
+        engine_complete(slot, result, status);
+        return false;
+    }
+    slot->attempt++;
+    int delay_ms = retry_delay_ms(slot->attempt);
+    ESP_LOGI(TAG, "Retrying %s [%s] (attempt %d/%d) in %dms",
+             slot->verb, req->endpoint, slot->attempt, req->max_retries, delay_ms);
+    slot->not_before = now + pdMS_TO_TICKS(delay_ms);
+    if (pdMS_TO_TICKS(delay_ms) < *wake) *wake = pdMS_TO_TICKS(delay_ms);
+    return false;
+}
+
+static void cf_engine_task(void *arg) {
+    while (1) {
+        TickType_t now = xTaskGetTickCount();
+        TickType_t wake = portMAX_DELAY;
+        bool busy = false;
+        bool free_slot = false;
+        engine_progress = false;
+
+        for (int i = 0; i < CLOUDFLARE_POOL_SIZE; i++) {
+            cf_inflight_t *slot = &inflight[i];
+            if (!slot->active) {
+                if (spsc_ring_pop(&engine_queue, &slot->req, 1) != 1) {
+                    free_slot = true;
+                    continue;
+                }
+                slot->active = true;
+                slot->verb = method_name(slot->req.method);
+                slot->conn = NULL;
+                slot->attempt = 0;
+                slot->order = ++engine_order;
+                slot->not_before = now + pdMS_TO_TICKS(slot->req.delay_ms);
+                snprintf(slot->url, sizeof(slot->url), "%s%s", base_url, slot->req.endpoint);
             }
+            if (engine_step(slot, now, &wake)) busy = true;
+            if (!slot->active) free_slot = true;
+        }
+
+        if (engine_progress) {
+            continue; // a completion may have released a held request or a queued one
+        } else if (busy) {
+            vTaskDelay(1); // sockets not ready yet, poll again next tick
+        } else if (free_slot) {
+            // Sleep until a new request arrives or a backoff expires
+            spsc_ring_wait(&engine_queue, wake);
         } else {
-            ESP_LOGE(TAG, "GET Failed [%s]: %s", endpoint, esp_err_to_name(err));
-            // If perform() was OK but handler reported a problem, propagate that
-            if (err == ESP_OK) err = user_data.err_code;
+            vTaskDelay(wake);
         }
+    }
+}
 
-        esp_http_client_cleanup(client);
-        retry_count++;
+esp_err_t cloudflare_submit(const cloudflare_request_t *req, uint32_t wait_ms) {
+    if (req == NULL || req->endpoint == NULL) return ESP_ERR_INVALID_ARG;
+    if (!engine_started) {
+        ESP_LOGE(TAG, "cloudflare_api_init() has not been called");
+        return ESP_ERR_INVALID_STATE;
     }
-    
-    ESP_LOGE(TAG, "GET Failed after %d retries [%s]", MAX_RETRIES, endpoint);
-    return err;
+    // The engine queue takes one producer: the first task to submit owns it
+    TaskHandle_t self = xTaskGetCurrentTaskHandle(), producer = NULL;
+    if (!atomic_compare_exchange_strong(&engine_producer, &producer, self) && producer != self) {
+        ESP_LOGE(TAG, "Submit from %s, the engine queue belongs to %s",
+                 pcTaskGetName(self), pcTaskGetName(producer));
+        return ESP_ERR_INVALID_STATE;
+    }
+    // The engine frees a place as soon as a pooled connection does; it
+    // cannot wake the producer, so a full queue is polled once a tick
+    TickType_t start = xTaskGetTickCount();
+    while (spsc_ring_push(&engine_queue, req, 1) != 1) {
+        if (xTaskGetTickCount() - start >= pdMS_TO_TICKS(wait_ms)) return ESP_ERR_TIMEOUT;
+        vTaskDelay(1);
+    }
+    return ESP_OK;
+}
+
+esp_err_t cloudflare_api_init(void) {
+    if (pool_slots) return ESP_OK;
+    pool_lock = xSemaphoreCreateMutex();
+    etag_lock = xSemaphoreCreateMutex();
+    pool_slots = xSemaphoreCreateCounting(CLOUDFLARE_POOL_SIZE, CLOUDFLARE_POOL_SIZE);
+    spsc_ring_init(&engine_queue, engine_queue_buf, sizeof(cloudflare_request_t), ENGINE_QUEUE_LENGTH);
+    if (!pool_lock || !etag_lock || !pool_slots) {
+        ESP_LOGE(TAG, "No mem for connection pool");
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(cf_engine_task, "cf_engine", ENGINE_TASK_STACK, NULL, 7, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "No mem for request engine task");
+        return ESP_ERR_NO_MEM;
+    }
+    engine_started = true;
+    return ESP_OK;
+}
+
+esp_err_t cloudflare_api_configure(const cloudflare_api_config_t *config) {
+    if (config == NULL) return ESP_ERR_INVALID_ARG;
+    if (pool_slots == NULL) return ESP_ERR_INVALID_STATE;
+
+    // Drain the pool so no request is using a client while we tear it down
+    for (int i = 0; i < CLOUDFLARE_POOL_SIZE; i++) {
+        xSemaphoreTake(pool_slots, portMAX_DELAY);
+    }
+    for (int i = 0; i < CLOUDFLARE_POOL_SIZE; i++) {
+        if (pool[i].client) {
+            hw_http_cleanup(pool[i].client);
+            pool[i].client = NULL;
+            pool[i].connected = false;
+        }
+    }
+    snprintf(base_url, sizeof(base_url), "%s",
+             config->base_url ? config->base_url : CLOUDFLARE_API_BASE_URL);
+    server_cert_pem = config->cert_pem;
+    reuse_connections = config->reuse_connections;
+    // Validators from another server mean nothing here
+    xSemaphoreTake(etag_lock, portMAX_DELAY);
+    memset(etag_cache, 0, sizeof(etag_cache));
+    xSemaphoreGive(etag_lock);
+    for (int i = 0; i < CLOUDFLARE_POOL_SIZE; i++) {
+        xSemaphoreGive(pool_slots);
+    }
+    ESP_LOGI(TAG, "Using %s (connection reuse %s)", base_url, reuse_connections ? "on" : "off");
+    return ESP_OK;
+}
+
+void cloudflare_api_get_pool_stats(cloudflare_pool_stats_t *stats) {
+    if (stats == NULL) return;
+    portENTER_CRITICAL(&stats_mux);
+    *stats = pool_stats;
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+void cloudflare_api_reset_pool_stats(void) {
+    portENTER_CRITICAL(&stats_mux);
+    memset(&pool_stats, 0, sizeof(pool_stats));
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+// Enhanced POST with retry functionality
+esp_err_t cloudflare_post_json(const char *endpoint, const char *json_body) {
+    return cf_perform(HW_HTTP_POST, "POST", endpoint, json_body, NULL, 0, NULL, NULL, TIMEOUT_MS, MAX_RETRIES);
+}
+
+// Best-effort POST: one attempt with a short timeout and no retry.
+// The response is still read so the pooled connection stays reusable.
+esp_err_t cloudflare_post_json_nowait(const char *endpoint, const char *json_body) {
+    return cf_perform(HW_HTTP_POST, "POST", endpoint, json_body, NULL, 0, NULL, NULL, NOWAIT_TIMEOUT_MS, 0);
+}
+
+/* ----------------------------------------------------------------------
+ * HTTP PUT with retry logic
+ * --------------------------------------------------------------------*/
+esp_err_t cloudflare_put_json(const char *endpoint, const char *json_body)
+{
+    return cf_perform(HW_HTTP_PUT, "PUT", endpoint, json_body, NULL, 0, NULL, NULL, TIMEOUT_MS, MAX_RETRIES);
+}
+
+// Enhanced GET with retry functionality
+esp_err_t cloudflare_get_json(const char *endpoint, char *buffer, int buffer_size) {
+    if (buffer == NULL || buffer_size <= 0) {
+        ESP_LOGE(TAG, "Invalid buffer or size for GET request");
+        return ESP_ERR_INVALID_ARG;
+    }
+    buffer[0] = '\0';
+    return cf_perform(HW_HTTP_GET, "GET", endpoint, NULL, buffer, buffer_size, NULL, NULL, TIMEOUT_MS, MAX_RETRIES);
+}
+
+// GET without a response buffer: the body is handed to on_data chunk by chunk
+esp_err_t cloudflare_get_stream(const char *endpoint, cloudflare_data_cb_t on_data, void *arg) {
+    if (on_data == NULL) {
+        ESP_LOGE(TAG, "Invalid callback for streaming GET request");
+        return ESP_ERR_INVALID_ARG;
+    }
+    return cf_perform(HW_HTTP_GET, "GET", endpoint, NULL, NULL, 0, on_data, arg, TIMEOUT_MS, MAX_RETRIES);
 }
 
 // register a callback function to be called when data is sent
@@ -1,6 +1,8 @@
 #ifndef CLOUDFLARE_API_H
 #define CLOUDFLARE_API_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "esp_err.h"
 // NOTE: All HTTP requests set .timeout_ms to avoid WDT. Adjust in cloudflare_api.c if needed.
 
@@ -11,6 +13,79 @@
 //esp_err_t cloudflare_post_sensor_data(float value);
 
 
+// Connection pool counters, see cloudflare_api_get_pool_stats()
+typedef struct {
+    uint32_t requests;    // HTTP requests performed, including reconnect attempts
+    uint32_t handshakes;  // new TCP + TLS connections opened
+    uint32_t reconnects;  // dropped keep-alive connections that were re-established
+    uint32_t failures;    // transport failures that discarded a pooled client
+    uint32_t peak_in_flight; // most connections busy at the same time
+    uint32_t conditional; // GETs sent with a cached ETag / Last-Modified
+    uint32_t not_modified; // of those, answered 304 (hit rate = not_modified / conditional)
+    uint32_t bytes_saved; // body bytes a 304 did not have to resend
+} cloudflare_pool_stats_t;
+
+// Returned by streaming GETs when the server answers a conditional request
+// with 304: the response is the same as the last accepted one for this
+// endpoint, nothing was passed to on_data.
+#define CLOUDFLARE_ERR_NOT_MODIFIED 0xCF304
+
+// Optional override used by benchmarks and tests against a local stand-in worker
+typedef struct {
+    const char *base_url;    // NULL restores the Cloudflare worker URL
+    const char *cert_pem;    // server certificate of the stand-in, NULL uses the CA bundle
+    bool reuse_connections;  // false closes the connection after every request
+} cloudflare_api_config_t;
+
+// Create the keep-alive connection pool. Call once before any request.
+esp_err_t cloudflare_api_init(void);
+// Close all pooled connections and apply a new endpoint configuration
+esp_err_t cloudflare_api_configure(const cloudflare_api_config_t *config);
+void cloudflare_api_get_pool_stats(cloudflare_pool_stats_t *stats);
+void cloudflare_api_reset_pool_stats(void);
+
+typedef enum {
+    CLOUDFLARE_POST = 0,
+    CLOUDFLARE_PUT,
+    CLOUDFLARE_GET,
+} cloudflare_method_t;
+
+// Receives a response body chunk by chunk as it is read off the socket.
+// data == NULL (len 0) comes before the first chunk of every new body: drop
+// what was parsed so far.
+typedef void (*cloudflare_data_cb_t)(const char *data, int len, void *arg);
+
+// Called from the request engine task once a submitted request has finished,
+// after any retries. status is the last HTTP status, 0 if none was received.
+// Keep it short: the engine does not advance other requests while it runs.
+typedef void (*cloudflare_done_cb_t)(esp_err_t result, int status, void *arg);
+
+// Request for the non-blocking engine. endpoint, json_body and response are
+// not copied and must stay valid until done_cb has been called.
+typedef struct {
+    cloudflare_method_t method;
+    const char *endpoint;
+    const char *json_body;   // NULL for GET
+    char *response;          // optional, NUL-terminated on completion
+    int response_size;
+    cloudflare_data_cb_t on_data; // optional, streams the body (with arg) instead of response
+    int timeout_ms;          // per attempt, 0 = default
+    int max_retries;
+    uint32_t delay_ms;       // first attempt no sooner than this after the engine takes it
+    bool ordered;            // not started while an earlier ordered request to the same
+                             // endpoint is in flight or backing off, so state-setting
+                             // requests (control PUTs) reach the server in order
+    cloudflare_done_cb_t done_cb;
+    void *arg;
+} cloudflare_request_t;
+
+// Hand a request to the engine, which keeps several in flight over the pooled
+// connections. Waits up to wait_ms for room in the engine queue. The queue
+// has a single producer: the first task to submit (http_request_task) owns
+// it, and a submit from any other task fails with ESP_ERR_INVALID_STATE.
+esp_err_t cloudflare_submit(const cloudflare_request_t *req, uint32_t wait_ms);
+
+// Blocking calls below share the same connection pool.
 // POST generic JSON data to any endpoint (e.g., sensor_data, controls, messages)
 // Example: cloudflare_post_json("/api/controls", "{\"mode\":\"auto\"}")
 esp_err_t cloudflare_post_json(const char *endpoint, const char *json_body);
@@ -18,7 +93,17 @@ esp_err_t cloudflare_post_json_nowait(const char *endpoint, const char *json_bod
 esp_err_t cloudflare_put_json(const char *endpoint, const char *json_body);
 // GET JSON data from any endpoint (e.g., sensor_data, controls, messages)
 // buffer should be large enough to store the full response (e.g., 512-2048 bytes)
+// Always a full GET; the body is in buffer whenever this returns ESP_OK.
 esp_err_t cloudflare_get_json(const char *endpoint, char *buffer, int buffer_size);
+// GET with the body streamed to on_data, for responses of any size. Once the
+// consumer has accepted a response with cloudflare_accept_response(), later
+// GETs of the endpoint are conditional and may return
+// CLOUDFLARE_ERR_NOT_MODIFIED. on_data gets the NULL restart call only when
+// a new body arrives, so a parser fed by it still holds the accepted result then.
+esp_err_t cloudflare_get_stream(const char *endpoint, cloudflare_data_cb_t on_data, void *arg);
+// Call after the body of a streaming GET parsed: its ETag / Last-Modified are
+// used from now on. A response that was not accepted is fetched in full again.
+void cloudflare_accept_response(const char *endpoint);
 // preserve a callback function to be called when data is sent
 void cloudflare_api_on_data_sent(void (*callback)(void));
 
@@ -0,0 +1,118 @@
+#include "control_scan.h"
+#include <stdlib.h>
+#include <string.h>
+
+static bool is_scalar(const json_stream_token_t *tok) {
+    return tok->event == JSON_STREAM_STRING || tok->event == JSON_STREAM_NUMBER;
+}
+
+// Ids come as numbers or as numeric strings depending on the table
+static bool parse_long(const json_stream_token_t *tok, long *out) {
+    if (!is_scalar(tok) || tok->truncated || tok->value[0] == '\0') return false;
+    char *end;
+    long v = strtol(tok->value, &end, 10);
+    if (*end != '\0') return false;
+    *out = v;
+    return true;
+}
+
+// Thresholds are 12-bit ADC readings; anything else is not a threshold
+static bool parse_threshold(const json_stream_token_t *tok, int *out) {
+    if (tok->event != JSON_STREAM_NUMBER || tok->truncated) return false;
+    char *end;
+    double v = strtod(tok->value, &end);
+    if (*end != '\0' || !(v >= 0 && v <= CONTROL_THRESHOLD_MAX)) return false;
+    *out = (int)v;
+    return true;
+}
+
+static void begin_entry(control_scan_t *scan, int depth) {
+    scan->entry_depth = depth;
+    scan->cur_has_control_id = false;
+    scan->cur_has_device_id = false;
+    scan->cur_is_switch = false;
+    scan->cur_has_dry = false;
+    scan->cur_has_wet = false;
+    scan->cur_state[0] = '\0';
+}
+
+static void end_entry(control_scan_t *scan) {
+    scan->entry_depth = 0;
+    scan->entries++;
+
+    if (!scan->pump_found && scan->cur_has_control_id && scan->cur_control_id == scan->pump_control_id) {
+        scan->pump_found = true;
+        scan->pump_is_switch = scan->cur_is_switch;
+        memcpy(scan->pump_state, scan->cur_state, sizeof(scan->pump_state));
+    }
+    if (!scan->device_found && scan->cur_has_device_id && scan->cur_device_id == scan->device_id) {
+        scan->device_found = true;
+        if (scan->cur_has_dry && scan->cur_has_wet) {
+            scan->thresholds_found = true;
+            scan->dry_threshold = scan->cur_dry;
+            scan->wet_threshold = scan->cur_wet;
+        }
+    }
+}
+
+static void entry_field(control_scan_t *scan, const json_stream_token_t *tok) {
+    const char *key = tok->key;
+    if (strcmp(key, "control_id") == 0) {
+        scan->cur_has_control_id = parse_long(tok, &scan->cur_control_id);
+    } else if (strcmp(key, "device_id") == 0) {
+        scan->cur_has_device_id = parse_long(tok, &scan->cur_device_id);
+    } else if (strcmp(key, "control_type") == 0) {
+        scan->cur_is_switch = tok->event == JSON_STREAM_STRING && strcmp(tok->value, "switch") == 0;
+    } else if (strcmp(key, "state") == 0) {
+        if (tok->event == JSON_STREAM_STRING && !tok->truncated && strlen(tok->value) < CONTROL_STATE_MAX) {
+            strcpy(scan->cur_state, tok->value);
+        } else {
+            scan->cur_state[0] = '\0';
+        }
+    } else if (strcmp(key, "dry_threshold") == 0) {
+        scan->cur_has_dry = parse_threshold(tok, &scan->cur_dry);
+    } else if (strcmp(key, "wet_threshold") == 0) {
+        scan->cur_has_wet = parse_threshold(tok, &scan->cur_wet);
+    }
+}
+
+static void on_token(const json_stream_token_t *tok, void *ctx) {
+    control_scan_t *scan = ctx;
+    switch (tok->event) {
+        case JSON_STREAM_OBJECT_START:
+            // An entry is an object that is not a member of another object,
+            // i.e. an array element or the whole response
+            if (scan->entry_depth == 0 && tok->key[0] == '\0') begin_entry(scan, tok->depth);
+            break;
+        case JSON_STREAM_OBJECT_END:
+            if (tok->depth == scan->entry_depth) end_entry(scan);
+            break;
+        case JSON_STREAM_ARRAY_START:
+        case JSON_STREAM_ARRAY_END:
+            break;
+        default:
+            // only direct members of the entry, not fields of nested objects
+            if (scan->entry_depth != 0 && tok->depth == scan->entry_depth) entry_field(scan, tok);
+            break;
+    }
+}
+
+void control_scan_init(control_scan_t *scan, long pump_control_id, long device_id) {
+    memset(scan, 0, sizeof(*scan));
+    scan->pump_control_id = pump_control_id;
+    scan->device_id = device_id;
+    json_stream_init(&scan->js, on_token, scan);
+}
+
+void control_scan_feed(const char *data, int len, void *arg) {
+    control_scan_t *scan = arg;
+    if (data == NULL) {
+        control_scan_init(scan, scan->pump_control_id, scan->device_id);
+        return;
+    }
+    json_stream_feed(&scan->js, data, len > 0 ? (size_t)len : 0);
+}
+
+bool control_scan_finish(control_scan_t *scan) {
+    return json_stream_finish(&scan->js);
+}
@@ -0,0 +1,56 @@
+#ifndef CONTROL_SCAN_H
+#define CONTROL_SCAN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "json_stream.h"
+
+#define CONTROL_STATE_MAX 8
+#define CONTROL_THRESHOLD_MAX 4095   // thresholds are raw 12-bit ADC readings
+
+// Picks the entries this device cares about out of a /api/controls response
+//   [{"control_id":"446400104","device_id":4464001,"control_type":"switch","state":"on",..},..]
+// while it streams in. Only the fields of the entry being read are kept, so
+// memory use is the same for ten entries or ten thousand. Fields are matched
+// per entry object: a value from one entry never completes another.
+typedef struct {
+    long pump_control_id;     // control to report, from any device
+    long device_id;           // first entry of this device carries the thresholds
+
+    // results, valid after control_scan_finish()
+    bool pump_found;
+    bool pump_is_switch;
+    char pump_state[CONTROL_STATE_MAX];
+    bool device_found;
+    bool thresholds_found;    // the device entry had dry/wet thresholds in 0..CONTROL_THRESHOLD_MAX
+    int dry_threshold;
+    int wet_threshold;
+    uint32_t entries;
+
+    // entry being read
+    int entry_depth;          // 0 between entries
+    long cur_control_id;
+    long cur_device_id;
+    bool cur_has_control_id;
+    bool cur_has_device_id;
+    bool cur_is_switch;
+    bool cur_has_dry;
+    bool cur_has_wet;
+    int cur_dry;
+    int cur_wet;
+    char cur_state[CONTROL_STATE_MAX];
+
+    json_stream_t js;
+} control_scan_t;
+
+void control_scan_init(control_scan_t *scan, long pump_control_id, long device_id);
+
+// Feed the next chunk; arg is the control_scan_t. Matches cloudflare_data_cb_t,
+// including data == NULL to start over when a new response body begins.
+// Results of the last complete response stay valid until then.
+void control_scan_feed(const char *data, int len, void *arg);
+
+// True if the whole response parsed as JSON
+bool control_scan_finish(control_scan_t *scan);
+
+#endif // CONTROL_SCAN_H
@@ -0,0 +1,53 @@
+#include "sensor_batch.h"
+#include <string.h>
+
+void sensor_batch_init(sensor_batch_t *batch, char *buf, size_t size) {
+    batch->buf = buf;
+    batch->size = size;
+    sensor_batch_reset(batch);
+}
+
+void sensor_batch_reset(sensor_batch_t *batch) {
+    batch->len = 0;
+    batch->count = 0;
+    batch->opened_ms = 0;
+    if (batch->buf && batch->size > 0) batch->buf[0] = '\0';
+}
+
+bool sensor_batch_add(sensor_batch_t *batch, const char *json_object, uint32_t now_ms) {
+    size_t obj_len = strlen(json_object);
+    if (obj_len == 0) return false;
+
+    // '[' or ',' before the object, then room for the closing ']' and NUL
+    size_t needed = 1 + obj_len + 2;
+    if (batch->len + needed > batch->size) return false;
+
+    batch->buf[batch->len++] = (batch->count == 0) ? '[' : ',';
+    memcpy(batch->buf + batch->len, json_object, obj_len);
+    batch->len += obj_len;
+    batch->buf[batch->len] = '\0';
+
+    if (batch->count == 0) batch->opened_ms = now_ms;
+    batch->count++;
+    return true;
+}
+
+bool sensor_batch_due(const sensor_batch_t *batch, int max_count, uint32_t window_ms, uint32_t now_ms) {
+    if (batch->count == 0) return false;
+    if (batch->count >= max_count) return true;
+    return (uint32_t)(now_ms - batch->opened_ms) >= window_ms;
+}
+
+uint32_t sensor_batch_ms_until_due(const sensor_batch_t *batch, uint32_t window_ms, uint32_t now_ms) {
+    if (batch->count == 0) return UINT32_MAX;
+    uint32_t open_for = now_ms - batch->opened_ms;
+    return (open_for >= window_ms) ? 0 : window_ms - open_for;
+}
+
+const char *sensor_batch_finish(sensor_batch_t *batch) {
+    if (batch->count == 0) return "[]";
+    // sensor_batch_add() always leaves room for these two bytes
+    batch->buf[batch->len] = ']';
+    batch->buf[batch->len + 1] = '\0';
+    return batch->buf;
+}
@@ -0,0 +1,34 @@
+#ifndef SENSOR_BATCH_H
+#define SENSOR_BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Coalesces /api/sensor_data JSON objects into one JSON array body:
+//   [{"sensor_id":..,"data":{..}},{"sensor_id":..,"data":{..}}]
+// The caller owns the buffer; nothing here allocates or blocks.
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;          // bytes used, excluding the closing ']'
+    int count;           // objects in the batch
+    uint32_t opened_ms;  // time the first object was added
+} sensor_batch_t;
+
+void sensor_batch_init(sensor_batch_t *batch, char *buf, size_t size);
+void sensor_batch_reset(sensor_batch_t *batch);
+
+// Append one JSON object. Returns false (batch unchanged) if it does not fit.
+bool sensor_batch_add(sensor_batch_t *batch, const char *json_object, uint32_t now_ms);
+
+// True once the batch holds max_count objects or has been open for window_ms
+bool sensor_batch_due(const sensor_batch_t *batch, int max_count, uint32_t window_ms, uint32_t now_ms);
+
+// Milliseconds until the window closes (0 if already due, UINT32_MAX if empty)
+uint32_t sensor_batch_ms_until_due(const sensor_batch_t *batch, uint32_t window_ms, uint32_t now_ms);
+
+// Close the array and return the request body. Valid until the next reset.
+const char *sensor_batch_finish(sensor_batch_t *batch);
+
+#endif // SENSOR_BATCH_H
@@ -0,0 +1,70 @@
+#include "ac_meter.h"
+#include <string.h>
+
+uint32_t ac_meter_isqrt64(uint64_t x)
+{
+    uint64_t root = 0;
+    uint64_t bit = 1ull << 62;
+    while (bit > x) bit >>= 2;
+    while (bit) {
+        if (x >= root + bit) {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)root;
+}
+
+void ac_meter_init(ac_meter_t *m, uint32_t rate_hz, uint32_t mains_hz, uint32_t cycles, int32_t zero)
+{
+    memset(m, 0, sizeof(*m));
+    m->zero = zero;
+    m->rate_hz = rate_hz;
+    m->window = (rate_hz * cycles + mains_hz / 2) / mains_hz;
+    if (m->window == 0) m->window = 1;
+}
+
+void ac_meter_set_zero(ac_meter_t *m, int32_t zero)
+{
+    m->zero = zero;
+    m->sum = 0;
+    m->sum_sq = 0;
+    m->peak = 0;
+    m->n = 0;
+}
+
+bool ac_meter_push(ac_meter_t *m, int32_t x)
+{
+    int32_t d = x - m->zero;
+    int32_t a = d < 0 ? -d : d;
+    m->sum += d;
+    m->sum_sq += (uint64_t)((int64_t)d * d);
+    if (a > m->peak) m->peak = a;
+    if (++m->n < m->window) return false;
+
+    uint64_t mean_sq = (m->sum_sq + m->n / 2) / m->n;
+    int64_t dc = m->sum >= 0 ? (m->sum + m->n / 2) / m->n : -((-m->sum + m->n / 2) / m->n);
+    uint64_t dc_sq = (uint64_t)(dc * dc);
+    m->result.rms = (int32_t)ac_meter_isqrt64(mean_sq);
+    m->result.ac_rms = (int32_t)ac_meter_isqrt64(mean_sq > dc_sq ? mean_sq - dc_sq : 0);
+    m->result.dc = (int32_t)dc;
+    m->result.peak = m->peak;
+    m->result.seq++;
+    m->rms_samples += (uint64_t)m->result.rms * m->n;
+
+    m->sum = 0;
+    m->sum_sq = 0;
+    m->peak = 0;
+    m->n = 0;
+    return true;
+}
+
+double ac_meter_energy_wh(const ac_meter_t *m, double amps_per_unit, double volts)
+{
+    if (m->rate_hz == 0) return 0;
+    double unit_seconds = (double)m->rms_samples / m->rate_hz;
+    return unit_seconds * amps_per_unit * volts / 3600.0;
+}
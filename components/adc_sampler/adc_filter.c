@@ -0,0 +1,79 @@
+#include "adc_filter.h"
+#include <string.h>
+
+bool adc_filter_init(adc_filter_t *f, uint16_t *buf, size_t size, uint8_t ema_shift)
+{
+    if (buf == NULL || size == 0 || size > 32768 || (size & (size - 1)) != 0) return false;
+    memset(f, 0, sizeof(*f));
+    f->buf = buf;
+    f->mask = (uint16_t)(size - 1);
+    f->ema_shift = ema_shift;
+    return true;
+}
+
+void adc_filter_reset(adc_filter_t *f)
+{
+    f->head = 0;
+    f->count = 0;
+    f->sum = 0;
+    f->ema = 0;
+    f->total = 0;
+}
+
+void adc_filter_push(adc_filter_t *f, uint16_t sample)
+{
+    if (f->count > f->mask) {
+        f->sum -= f->buf[f->head];    // oldest sample falls out of the window
+    } else {
+        f->count++;
+    }
+    f->buf[f->head] = sample;
+    f->head = (f->head + 1) & f->mask;
+    f->sum += sample;
+
+    int32_t x = (int32_t)sample << ADC_FILTER_EMA_FRAC;
+    if (f->total == 0) {
+        f->ema = x;
+    } else {
+        f->ema += (x - (int32_t)f->ema) >> f->ema_shift;
+    }
+    f->total++;
+}
+
+uint16_t adc_filter_mean(const adc_filter_t *f)
+{
+    if (f->count == 0) return 0;
+    return (uint16_t)((f->sum + f->count / 2) / f->count);
+}
+
+uint16_t adc_filter_ema(const adc_filter_t *f)
+{
+    return (uint16_t)((f->ema + (1u << (ADC_FILTER_EMA_FRAC - 1))) >> ADC_FILTER_EMA_FRAC);
+}
+
+size_t adc_filter_copy(const adc_filter_t *f, uint16_t *out, size_t n)
+{
+    if (n > f->count) n = f->count;
+    uint16_t pos = (f->head - n) & f->mask;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = f->buf[pos];
+        pos = (pos + 1) & f->mask;
+    }
+    return n;
+}
+
+uint16_t adc_filter_median(const adc_filter_t *f, size_t n)
+{
+    uint16_t v[ADC_FILTER_MEDIAN_MAX];
+    if (n > ADC_FILTER_MEDIAN_MAX) n = ADC_FILTER_MEDIAN_MAX;
+    n = adc_filter_copy(f, v, n);
+    if (n == 0) return 0;
+    // insertion sort, n is small
+    for (size_t i = 1; i < n; i++) {
+        uint16_t x = v[i];
+        size_t j = i;
+        for (; j > 0 && v[j - 1] > x; j--) v[j] = v[j - 1];
+        v[j] = x;
+    }
+    return v[n / 2];
+}
@@ -0,0 +1,29 @@
+#include "adc_lut.h"
+
+bool adc_lut_build(adc_lut_t *lut, adc_lut_fn_t fn, void *ctx)
+{
+    for (int raw = 0; raw < ADC_LUT_SIZE; raw++) {
+        int mv;
+        if (!fn(raw, &mv, ctx)) return false;
+        lut->mv[raw] = mv < 0 ? 0 : mv > UINT16_MAX ? UINT16_MAX : (uint16_t)mv;
+    }
+    return true;
+}
+
+void adc_lut_build_nominal(adc_lut_t *lut, int full_scale_mv)
+{
+    for (int raw = 0; raw < ADC_LUT_SIZE; raw++) {
+        lut->mv[raw] = (uint16_t)((raw * full_scale_mv + 4095 / 2) / 4095);
+    }
+}
+
+// ESP32 ADC1 line fitting: mV = raw * coeff_a / 65536 + coeff_b, with
+// coeff_a = vref * scale[atten] / 4096 (esp_adc_cal / adc_cali_line_fitting)
+int adc_lut_esp32_line_mv(int raw, int vref_mv, adc_atten_t atten)
+{
+    static const uint32_t scale[] = { 57431, 76236, 105481, 196602 };
+    static const uint32_t offset[] = { 75, 78, 107, 142 };
+    if ((unsigned)atten > 3) return -1;
+    uint32_t coeff_a = (uint32_t)vref_mv * scale[atten] / 4096;
+    return (int)(((uint32_t)raw * coeff_a + 32768) / 65536 + offset[atten]);
+}
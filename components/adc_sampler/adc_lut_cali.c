@@ -0,0 +1,45 @@
+#include "adc_lut.h"
+#include <stddef.h>
+#include "sdkconfig.h"
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+
+static bool cali_mv(int raw, int *mv, void *ctx)
+{
+    return adc_cali_raw_to_voltage(ctx, raw, mv) == ESP_OK;
+}
+
+esp_err_t adc_lut_build_cali(adc_lut_t *lut, adc_unit_t unit, adc_atten_t atten)
+{
+    adc_cali_handle_t cali = NULL;
+    esp_err_t err;
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+    adc_cali_curve_fitting_config_t cfg = {
+        .unit_id = unit,
+        .atten = atten,
+        .bitwidth = ADC_BITWIDTH_12,
+    };
+    err = adc_cali_create_scheme_curve_fitting(&cfg, &cali);
+#elif ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+    adc_cali_line_fitting_config_t cfg = {
+        .unit_id = unit,
+        .atten = atten,
+        .bitwidth = ADC_BITWIDTH_12,
+#if CONFIG_IDF_TARGET_ESP32
+        .default_vref = 1100,   // used when the eFuse has no Vref
+#endif
+    };
+    err = adc_cali_create_scheme_line_fitting(&cfg, &cali);
+#else
+    err = ESP_ERR_NOT_SUPPORTED;
+#endif
+    if (err != ESP_OK) return err;
+
+    err = adc_lut_build(lut, cali_mv, cali) ? ESP_OK : ESP_FAIL;
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+    adc_cali_delete_scheme_curve_fitting(cali);
+#elif ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+    adc_cali_delete_scheme_line_fitting(cali);
+#endif
+    return err;
+}
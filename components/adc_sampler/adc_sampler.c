@@ -0,0 +1,185 @@
+#include "adc_sampler.h"
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "hw_adc.h"
+
+static const char *TAG = "adc_sampler";
+
+#define TASK_STACK       3072
+#define TASK_PRIORITY    9      // above the sensing loops, it only copies samples
+
+typedef struct {
+    adc_channel_t channel;
+    adc_filter_t filter;
+    adc_sampler_sink_t sink;
+    void *sink_ctx;
+} sampler_chan_t;
+
+static TaskHandle_t task_handle;
+static SemaphoreHandle_t lock;
+static sampler_chan_t chans[ADC_SAMPLER_MAX_CHANNELS];
+static int chan_count;
+static uint32_t chan_rate_hz;
+
+static bool IRAM_ATTR on_ready(void *ctx)
+{
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(task_handle, &woken);
+    return woken == pdTRUE;
+}
+
+static sampler_chan_t *find(adc_channel_t channel)
+{
+    for (int i = 0; i < chan_count; i++) {
+        if (chans[i].channel == channel) return &chans[i];
+    }
+    return NULL;
+}
+
+static void sampler_task(void *arg)
+{
+    static hw_adc_sample_t samples[HW_ADC_READ_MAX];
+    uint32_t reported_overflows = 0;
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int n;
+        while ((n = hw_adc_continuous_read(samples, HW_ADC_READ_MAX)) > 0) {
+            xSemaphoreTake(lock, portMAX_DELAY);
+            for (int i = 0; i < n; i++) {
+                sampler_chan_t *c = find(samples[i].channel);
+                if (c == NULL) continue;
+                adc_filter_push(&c->filter, samples[i].raw);
+                if (c->sink) c->sink(samples[i].raw, c->sink_ctx);
+            }
+            xSemaphoreGive(lock);
+        }
+        uint32_t overflows = hw_adc_overflows();
+        if (overflows != reported_overflows) {
+            reported_overflows = overflows;
+            ESP_LOGW(TAG, "DMA pool overflowed %u times, samples lost", (unsigned)reported_overflows);
+        }
+    }
+}
+
+// Undo a start that failed part way, so it can be called again
+static void sampler_release(void)
+{
+    if (task_handle) vTaskDelete(task_handle);
+    task_handle = NULL;
+    for (int i = 0; i < ADC_SAMPLER_MAX_CHANNELS; i++) {
+        free(chans[i].filter.buf);
+        memset(&chans[i], 0, sizeof(chans[i]));
+    }
+    chan_count = 0;
+    chan_rate_hz = 0;
+    vSemaphoreDelete(lock);
+    lock = NULL;
+}
+
+esp_err_t adc_sampler_start(const adc_sampler_channel_t *channels, int count, uint32_t sample_freq_hz)
+{
+    if (lock) return ESP_ERR_INVALID_STATE;
+    if (count <= 0 || count > ADC_SAMPLER_MAX_CHANNELS) return ESP_ERR_INVALID_ARG;
+
+    lock = xSemaphoreCreateMutex();
+    if (lock == NULL) return ESP_ERR_NO_MEM;
+
+    esp_err_t err = ESP_OK;
+    hw_adc_pattern_t pattern[ADC_SAMPLER_MAX_CHANNELS];
+    for (int i = 0; i < count && err == ESP_OK; i++) {
+        uint16_t *buf = calloc(channels[i].ring_size, sizeof(uint16_t));
+        if (buf == NULL) {
+            err = ESP_ERR_NO_MEM;
+        } else if (!adc_filter_init(&chans[i].filter, buf, channels[i].ring_size, channels[i].ema_shift)) {
+            free(buf);
+            err = ESP_ERR_INVALID_ARG;
+        }
+        chans[i].channel = channels[i].channel;
+        pattern[i].channel = channels[i].channel;
+        pattern[i].atten = channels[i].atten;
+    }
+    chan_count = count;
+    chan_rate_hz = sample_freq_hz / count;
+
+    if (err == ESP_OK &&
+        xTaskCreate(sampler_task, "adc_sampler", TASK_STACK, NULL, TASK_PRIORITY, &task_handle) != pdPASS) {
+        task_handle = NULL;
+        err = ESP_ERR_NO_MEM;
+    }
+    if (err == ESP_OK) err = hw_adc_continuous_start(pattern, count, sample_freq_hz, on_ready, NULL);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Start failed: %s", esp_err_to_name(err));
+        sampler_release();
+        return err;
+    }
+    ESP_LOGI(TAG, "Sampling %d channels at %u Hz each", count, (unsigned)chan_rate_hz);
+    return ESP_OK;
+}
+
+bool adc_sampler_read(adc_channel_t channel, adc_sampler_value_t kind, int *raw)
+{
+    sampler_chan_t *c = find(channel);
+    if (c == NULL || lock == NULL) return false;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    bool ok = c->filter.count > 0;
+    if (ok) {
+        switch (kind) {
+        case ADC_SAMPLER_EMA:    *raw = adc_filter_ema(&c->filter); break;
+        case ADC_SAMPLER_MEDIAN: *raw = adc_filter_median(&c->filter, ADC_FILTER_MEDIAN_MAX); break;
+        default:                 *raw = adc_filter_mean(&c->filter); break;
+        }
+    }
+    xSemaphoreGive(lock);
+    return ok;
+}
+
+size_t adc_sampler_copy(adc_channel_t channel, uint16_t *out, size_t n)
+{
+    sampler_chan_t *c = find(channel);
+    if (c == NULL || lock == NULL) return 0;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    n = adc_filter_copy(&c->filter, out, n);
+    xSemaphoreGive(lock);
+    return n;
+}
+
+uint32_t adc_sampler_rate_hz(void)
+{
+    return chan_rate_hz;
+}
+
+uint32_t adc_sampler_count(adc_channel_t channel)
+{
+    sampler_chan_t *c = find(channel);
+    if (c == NULL || lock == NULL) return 0;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    uint32_t total = c->filter.total;
+    xSemaphoreGive(lock);
+    return total;
+}
+
+esp_err_t adc_sampler_set_sink(adc_channel_t channel, adc_sampler_sink_t sink, void *ctx)
+{
+    sampler_chan_t *c = find(channel);
+    if (c == NULL || lock == NULL) return ESP_ERR_NOT_FOUND;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    c->sink = sink;
+    c->sink_ctx = ctx;
+    xSemaphoreGive(lock);
+    return ESP_OK;
+}
+
+void adc_sampler_lock(void)
+{
+    if (lock) xSemaphoreTake(lock, portMAX_DELAY);
+}
+
+void adc_sampler_unlock(void)
+{
+    if (lock) xSemaphoreGive(lock);
+}
@@ -0,0 +1,54 @@
+#ifndef AC_METER_H
+#define AC_METER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // Measurements of one window, in input units (e.g. mV at the sensor)
+    typedef struct {
+        int32_t rms;          // true RMS about zero, AC and DC together
+        int32_t ac_rms;       // RMS with the DC part removed
+        int32_t dc;           // mean - zero
+        int32_t peak;         // largest |x - zero|
+        uint32_t seq;         // windows completed so far
+    } ac_meter_result_t;
+
+    // True RMS over whole mains cycles of a sampled signal. Samples are
+    // accumulated in integers; a result is latched every window and the
+    // RMS of each window is integrated for energy. Not thread safe.
+    typedef struct {
+        int32_t zero;         // input value at 0 A
+        uint32_t window;      // samples per result
+        uint32_t rate_hz;
+
+        int64_t sum;
+        uint64_t sum_sq;
+        int32_t peak;
+        uint32_t n;
+
+        ac_meter_result_t result;
+        uint64_t rms_samples; // sum of rms * window over all windows
+    } ac_meter_t;
+
+    // window = cycles full periods of mains_hz at rate_hz (rounded)
+    void ac_meter_init(ac_meter_t *m, uint32_t rate_hz, uint32_t mains_hz, uint32_t cycles, int32_t zero);
+    void ac_meter_set_zero(ac_meter_t *m, int32_t zero);
+
+    // True when the sample completed a window and m->result was updated
+    bool ac_meter_push(ac_meter_t *m, int32_t x);
+
+    // Energy so far for a signal of amps_per_unit at a fixed line voltage.
+    // Without voltage sensing this is apparent energy (VAh) taken as Wh.
+    double ac_meter_energy_wh(const ac_meter_t *m, double amps_per_unit, double volts);
+
+    uint32_t ac_meter_isqrt64(uint64_t x);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AC_METER_H
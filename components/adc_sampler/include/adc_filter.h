@@ -0,0 +1,51 @@
+#ifndef ADC_FILTER_H
+#define ADC_FILTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    #define ADC_FILTER_MEDIAN_MAX 31
+    #define ADC_FILTER_EMA_FRAC   8     // fractional bits of the EMA state
+
+    // Sample history of one ADC channel: the newest samples in a ring with a
+    // running sum, so the window mean costs the same for any window size, and
+    // an exponential moving average updated with every sample. Integer only.
+    // Not thread safe; the caller provides locking.
+    typedef struct {
+        uint16_t *buf;
+        uint16_t mask;        // ring size - 1, the size is a power of two
+        uint16_t head;        // next write
+        uint16_t count;
+        uint32_t sum;         // of the samples in the ring
+        uint32_t ema;         // value << ADC_FILTER_EMA_FRAC
+        uint8_t ema_shift;    // smoothing factor 1 / 2^ema_shift
+        uint32_t total;       // samples pushed since init
+    } adc_filter_t;
+
+    // size must be a power of two, at most 32768
+    bool adc_filter_init(adc_filter_t *f, uint16_t *buf, size_t size, uint8_t ema_shift);
+    void adc_filter_reset(adc_filter_t *f);
+
+    void adc_filter_push(adc_filter_t *f, uint16_t sample);
+
+    // Results are 0 while the filter is empty
+    uint16_t adc_filter_mean(const adc_filter_t *f);
+    uint16_t adc_filter_ema(const adc_filter_t *f);
+
+    // Median of the newest n samples (n clamped to ADC_FILTER_MEDIAN_MAX), for
+    // inputs with occasional spikes
+    uint16_t adc_filter_median(const adc_filter_t *f, size_t n);
+
+    // Copy the newest n samples, oldest first. Returns the number copied.
+    size_t adc_filter_copy(const adc_filter_t *f, uint16_t *out, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ADC_FILTER_H
@@ -0,0 +1,46 @@
+#ifndef ADC_LUT_H
+#define ADC_LUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "hal/adc_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    #define ADC_LUT_SIZE 4096   // 12-bit raw values
+
+    // Raw reading to calibrated millivolts at the ADC pin, one entry per raw
+    // value, so converting a sample is a single load. 8 KB per unit/atten.
+    typedef struct {
+        uint16_t mv[ADC_LUT_SIZE];
+    } adc_lut_t;
+
+    static inline uint16_t adc_lut_mv(const adc_lut_t *lut, int raw)
+    {
+        return lut->mv[raw & (ADC_LUT_SIZE - 1)];
+    }
+
+    // Fill from a raw -> mV function; false if it fails for any raw value
+    typedef bool (*adc_lut_fn_t)(int raw, int *mv, void *ctx);
+    bool adc_lut_build(adc_lut_t *lut, adc_lut_fn_t fn, void *ctx);
+
+    // raw / 4095 * full_scale_mv, what the code did before calibration
+    void adc_lut_build_nominal(adc_lut_t *lut, int full_scale_mv);
+
+    // From the chip's eFuse calibration (adc_cali curve or line fitting,
+    // whichever the target supports). ESP-IDF builds only.
+    esp_err_t adc_lut_build_cali(adc_lut_t *lut, adc_unit_t unit, adc_atten_t atten);
+
+    // Host reference of the ESP32 line-fitting scheme for ADC1: the same
+    // integer formula adc_cali applies with a reference voltage of vref_mv
+    // (1100 nominal; the eFuse value is per chip).
+    int adc_lut_esp32_line_mv(int raw, int vref_mv, adc_atten_t atten);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ADC_LUT_H
@@ -0,0 +1,61 @@
+#ifndef ADC_SAMPLER_H
+#define ADC_SAMPLER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "hal/adc_types.h"
+#include "adc_filter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    #define ADC_SAMPLER_MAX_CHANNELS 4
+
+    typedef struct {
+        adc_channel_t channel;    // ADC1
+        adc_atten_t atten;
+        uint16_t ring_size;       // samples kept, power of two
+        uint8_t ema_shift;
+    } adc_sampler_channel_t;
+
+    typedef enum {
+        ADC_SAMPLER_MEAN = 0,     // mean of the whole ring
+        ADC_SAMPLER_EMA,
+        ADC_SAMPLER_MEDIAN,       // median of the newest ADC_FILTER_MEDIAN_MAX samples
+    } adc_sampler_value_t;
+
+    // Samples all channels round-robin with the ADC's DMA at sample_freq_hz in
+    // total (each channel gets sample_freq_hz / count) and files them into one
+    // adc_filter_t per channel from a background task. Readers never touch
+    // the ADC and never wait for a conversion. ADC1 must not also be used in
+    // oneshot mode.
+    esp_err_t adc_sampler_start(const adc_sampler_channel_t *channels, int count, uint32_t sample_freq_hz);
+
+    // Filtered raw value of a channel; false if the channel is not sampled
+    // or has no samples yet
+    bool adc_sampler_read(adc_channel_t channel, adc_sampler_value_t kind, int *raw);
+
+    // Newest n raw samples of a channel, oldest first; returns the number copied
+    size_t adc_sampler_copy(adc_channel_t channel, uint16_t *out, size_t n);
+
+    // Per-channel sample rate, and samples pushed so far (0 if not sampled)
+    uint32_t adc_sampler_rate_hz(void);
+    uint32_t adc_sampler_count(adc_channel_t channel);
+
+    // Called from the sampler task with every sample of a channel, with the
+    // sampler lock held. For per-sample processing such as ac_meter.
+    typedef void (*adc_sampler_sink_t)(uint16_t raw, void *ctx);
+    esp_err_t adc_sampler_set_sink(adc_channel_t channel, adc_sampler_sink_t sink, void *ctx);
+
+    // Hold off the sampler task, e.g. to read state a sink updates
+    void adc_sampler_lock(void);
+    void adc_sampler_unlock(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ADC_SAMPLER_H
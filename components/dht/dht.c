@@ -1,65 +1,168 @@
 #include "dht.h"
+#include "dht_decode.h"
+#include <stdbool.h>
+#include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "driver/gpio.h"
+#include "driver/rmt_rx.h"
+#include "esp_timer.h"
 #include "esp_log.h"
-#include <string.h>
 
-#define DHT_DATA_BITS 40
-#define DHT_MAX_TIMINGS 85
+#define RMT_RESOLUTION_HZ 1000000   // 1 tick = 1 us
+#define RMT_SYMBOLS       64        // 43 are used: ack, 40 bits, start and stop
+#define START_LOW_MS      20        // host start signal, at least 18 ms
+#define RX_TIMEOUT_MS     20        // a full transfer takes under 5 ms
+#define TASK_STACK        3072
+#define TASK_PRIORITY     7
 
 static const char *TAG = "DHT";
 
-static int dht_read_raw(gpio_num_t pin, uint8_t data[5]) {
-    int bitidx = 0, byteidx = 0;
-    int timings[DHT_MAX_TIMINGS];
-    memset(data, 0, 5);
+static dht_sensor_type_t sensor_type;
+static gpio_num_t data_pin;
+static dht_callback_t callback;
+static void *callback_ctx;
+static rmt_channel_handle_t rx_chan;
+static QueueHandle_t rx_queue;
+static TaskHandle_t task_handle;
+static volatile bool busy;
+static dht_stats_t stats;
+static rmt_symbol_word_t symbols[RMT_SYMBOLS];
+static dht_pulse_t pulses[RMT_SYMBOLS * 2];
 
-    gpio_set_direction(pin, GPIO_MODE_OUTPUT);
-    gpio_set_level(pin, 0);
-    vTaskDelay(pdMS_TO_TICKS(20));
-    gpio_set_level(pin, 1);
-    esp_rom_delay_us(40);
-    gpio_set_direction(pin, GPIO_MODE_INPUT);
-
-    for (int i = 0; i < DHT_MAX_TIMINGS; i++) {
-        int count = 0;
-        while (gpio_get_level(pin) == (i % 2 == 0 ? 0 : 1)) {
-            count++;
-            esp_rom_delay_us(1);
-            if (count > 255) break;
-        }
-        timings[i] = count;
+static bool IRAM_ATTR on_recv_done(rmt_channel_handle_t chan, const rmt_rx_done_event_data_t *edata, void *ctx)
+{
+    BaseType_t woken = pdFALSE;
+    size_t count = edata->num_symbols;
+    xQueueSendFromISR(rx_queue, &count, &woken);
+    return woken == pdTRUE;
+}
+
+static size_t to_pulses(size_t count)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (symbols[i].duration0 == 0) break;
+        pulses[n++] = (dht_pulse_t){ symbols[i].level0, symbols[i].duration0 };
+        if (symbols[i].duration1 == 0) break;   // idle after the last edge
+        pulses[n++] = (dht_pulse_t){ symbols[i].level1, symbols[i].duration1 };
     }
+    return n;
+}
+
+static void read_once(dht_reading_t *r)
+{
+    const rmt_receive_config_t rx_cfg = {
+        .signal_range_min_ns = 1000,         // glitch filter
+        .signal_range_max_ns = 200 * 1000,   // a high this long ends the frame
+    };
+    int64_t start = esp_timer_get_time();
+    size_t count = 0;
+
+    xQueueReset(rx_queue);
+    gpio_set_level(data_pin, 0);
+    vTaskDelay(pdMS_TO_TICKS(START_LOW_MS) + 1);
+    r->err = rmt_receive(rx_chan, symbols, sizeof(symbols), &rx_cfg);
+    gpio_set_level(data_pin, 1);    // release, the sensor answers after 20-40 us
+    if (r->err != ESP_OK) return;
 
-    for (int i = 4; i < DHT_MAX_TIMINGS - 1; i += 2) {
-        int low = timings[i];
-        int high = timings[i + 1];
-        if (low == 0 || high == 0) continue;
-        data[byteidx] <<= 1;
-        if (high > low) data[byteidx] |= 1;
-        bitidx++;
-        if (bitidx % 8 == 0) byteidx++;
+    if (xQueueReceive(rx_queue, &count, pdMS_TO_TICKS(RX_TIMEOUT_MS)) != pdTRUE) {
+        // no edges at all: abort the pending receive
+        rmt_disable(rx_chan);
+        rmt_enable(rx_chan);
+        r->err = ESP_ERR_TIMEOUT;
+        stats.timeouts++;
+        return;
+    }
+
+    dht_decode_status_t status = dht_decode(pulses, to_pulses(count), r->data);
+    r->capture_us = esp_timer_get_time() - start;
+    switch (status) {
+    case DHT_DECODE_OK:
+        r->err = ESP_OK;
+        stats.ok++;
+        if (sensor_type == DHT_TYPE_DHT22) {
+            dht22_convert(r->data, &r->humidity, &r->temperature);
+        } else {
+            dht11_convert(r->data, &r->humidity, &r->temperature);
+        }
+        break;
+    case DHT_DECODE_CHECKSUM:
+        r->err = ESP_ERR_INVALID_CRC;
+        stats.checksum++;
+        break;
+    case DHT_DECODE_NO_RESPONSE:
+        r->err = ESP_ERR_TIMEOUT;
+        stats.timeouts++;
+        break;
+    default:
+        r->err = ESP_ERR_INVALID_RESPONSE;
+        stats.malformed++;
+        break;
+    }
+    if (status != DHT_DECODE_OK) {
+        ESP_LOGW(TAG, "Read failed: %s (%u symbols)", dht_decode_status_str(status), (unsigned)count);
     }
-    return (bitidx >= 40);
 }
 
-esp_err_t dht_read_float_data(dht_sensor_type_t sensor_type, gpio_num_t pin, float *humidity, float *temperature) {
-    uint8_t data[5];
-    if (!dht_read_raw(pin, data)) {
-        ESP_LOGE(TAG, "Failed to read raw data");
-        return ESP_FAIL;
+static void dht_task(void *arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        dht_reading_t reading = { 0 };
+        read_once(&reading);
+        busy = false;
+        if (callback) callback(&reading, callback_ctx);
     }
-    if (sensor_type == DHT_TYPE_DHT11) {
-        *humidity = data[0];
-        *temperature = data[2];
-        return ESP_OK;
-    } else if (sensor_type == DHT_TYPE_DHT22) {
-        *humidity = ((data[0] << 8) | data[1]) * 0.1f;
-        int16_t temp = ((data[2] & 0x7F) << 8) | data[3];
-        if (data[2] & 0x80) temp = -temp;
-        *temperature = temp * 0.1f;
-        return ESP_OK;
+}
+
+esp_err_t dht_start(dht_sensor_type_t type, gpio_num_t pin, dht_callback_t cb, void *ctx)
+{
+    if (task_handle) return ESP_ERR_INVALID_STATE;
+    sensor_type = type;
+    data_pin = pin;
+    callback = cb;
+    callback_ctx = ctx;
+
+    rx_queue = xQueueCreate(1, sizeof(size_t));
+    if (rx_queue == NULL) return ESP_ERR_NO_MEM;
+
+    const rmt_rx_channel_config_t chan_cfg = {
+        .gpio_num = pin,
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = RMT_RESOLUTION_HZ,
+        .mem_block_symbols = RMT_SYMBOLS,
+    };
+    esp_err_t err = rmt_new_rx_channel(&chan_cfg, &rx_chan);
+    if (err != ESP_OK) return err;
+    const rmt_rx_event_callbacks_t cbs = { .on_recv_done = on_recv_done };
+    err = rmt_rx_register_event_callbacks(rx_chan, &cbs, NULL);
+    if (err == ESP_OK) err = rmt_enable(rx_chan);
+    if (err != ESP_OK) return err;
+
+    // open drain on the same pad: the host drives the start pulse while the
+    // RMT keeps listening through the GPIO matrix
+    gpio_set_level(pin, 1);
+    gpio_set_direction(pin, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_pullup_en(pin);
+
+    if (xTaskCreate(dht_task, "dht", TASK_STACK, NULL, TASK_PRIORITY, &task_handle) != pdPASS) {
+        return ESP_ERR_NO_MEM;
     }
-    return ESP_ERR_INVALID_ARG;
+    ESP_LOGI(TAG, "RMT capture on GPIO %d", pin);
+    return ESP_OK;
 }
 
+esp_err_t dht_request(void)
+{
+    if (task_handle == NULL || busy) return ESP_ERR_INVALID_STATE;
+    busy = true;
+    xTaskNotifyGive(task_handle);
+    return ESP_OK;
+}
+
+void dht_get_stats(dht_stats_t *out)
+{
+    *out = stats;
+}
@@ -0,0 +1,94 @@
+#include "dht_decode.h"
+#include <stdbool.h>
+#include <string.h>
+
+// Datasheet timings with margin for the sensor's RC clock
+#define ACK_MIN_US      60      // acknowledge low and high, 80 us nominal
+#define ACK_MAX_US      110
+#define BIT_LOW_MIN_US  30      // bit start low, 50 us nominal
+#define BIT_LOW_MAX_US  90
+#define BIT_HIGH_MIN_US 10      // 26-28 us for 0, 70 us for 1
+#define BIT_HIGH_MAX_US 100
+
+typedef struct {
+    const dht_pulse_t *p;
+    size_t n;
+    size_t i;
+} reader_t;
+
+// Next pulse with runs of the same level merged; false at the end
+static bool next(reader_t *r, uint8_t *level, uint32_t *us)
+{
+    if (r->i >= r->n) return false;
+    *level = r->p[r->i].level;
+    *us = r->p[r->i].us;
+    for (r->i++; r->i < r->n && r->p[r->i].level == *level; r->i++) {
+        *us += r->p[r->i].us;
+    }
+    return true;
+}
+
+static bool in_range(uint32_t us, uint32_t min, uint32_t max)
+{
+    return us >= min && us <= max;
+}
+
+dht_decode_status_t dht_decode(const dht_pulse_t *pulses, size_t n, uint8_t data[5])
+{
+    memset(data, 0, 5);
+    reader_t r = { pulses, n, 0 };
+    uint8_t level, prev_level = 1;
+    uint32_t us, prev_us = 0;
+
+    // acknowledge: a low then a high of about 80 us each
+    bool ack = false;
+    while (!ack && next(&r, &level, &us)) {
+        ack = level == 1 && prev_level == 0 &&
+              in_range(prev_us, ACK_MIN_US, ACK_MAX_US) && in_range(us, ACK_MIN_US, ACK_MAX_US);
+        prev_level = level;
+        prev_us = us;
+    }
+    if (!ack) return DHT_DECODE_NO_RESPONSE;
+
+    for (int bit = 0; bit < 40; bit++) {
+        uint32_t low, high;
+        if (!next(&r, &level, &low)) return DHT_DECODE_SHORT;
+        if (!next(&r, &level, &high)) return DHT_DECODE_SHORT;
+        if (!in_range(low, BIT_LOW_MIN_US, BIT_LOW_MAX_US) ||
+            !in_range(high, BIT_HIGH_MIN_US, BIT_HIGH_MAX_US)) {
+            return DHT_DECODE_TIMING;
+        }
+        data[bit / 8] = (uint8_t)(data[bit / 8] << 1 | (high > DHT_BIT_THRESHOLD_US));
+    }
+
+    uint8_t sum = (uint8_t)(data[0] + data[1] + data[2] + data[3]);
+    return sum == data[4] ? DHT_DECODE_OK : DHT_DECODE_CHECKSUM;
+}
+
+void dht11_convert(const uint8_t data[5], float *humidity, float *temperature)
+{
+    // integral and decimal bytes; bit 7 of the decimal marks negative on newer parts
+    *humidity = data[0] + data[1] * 0.1f;
+    *temperature = data[2] + (data[3] & 0x7F) * 0.1f;
+    if (data[3] & 0x80) *temperature = -*temperature;
+}
+
+void dht22_convert(const uint8_t data[5], float *humidity, float *temperature)
+{
+    *humidity = ((data[0] << 8) | data[1]) * 0.1f;
+    int16_t temp = ((data[2] & 0x7F) << 8) | data[3];
+    if (data[2] & 0x80) temp = -temp;
+    *temperature = temp * 0.1f;
+}
+
+const char *dht_decode_status_str(dht_decode_status_t status)
+{
+    switch (status) {
+    case DHT_DECODE_OK:          return "ok";
+    case DHT_DECODE_NO_RESPONSE: return "no response";
+    case DHT_DECODE_SHORT:       return "short frame";
+    case DHT_DECODE_TIMING:      return "bad timing";
+    case DHT_DECODE_CHECKSUM:    return "checksum";
+    }
+    return "?";
+}
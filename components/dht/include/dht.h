@@ -1,7 +1,8 @@
 #ifndef DHT_H
 #define DHT_H
 
-#include "driver/gpio.h"
+#include <stdint.h>
+#include "hal/gpio_types.h"
 #include "esp_err.h"
 
 #ifdef __cplusplus
@@ -13,11 +14,39 @@ extern "C" {
         DHT_TYPE_DHT22 = 1
     } dht_sensor_type_t;
 
-    esp_err_t dht_read_float_data(dht_sensor_type_t sensor_type, gpio_num_t pin, float *humidity, float *temperature);
+    typedef struct {
+        esp_err_t err;            // ESP_ERR_TIMEOUT: no answer, ESP_ERR_INVALID_CRC: checksum,
+                                  // ESP_ERR_INVALID_RESPONSE: malformed frame
+        float humidity;
+        float temperature;
+        uint8_t data[5];          // raw bytes as received
+        uint32_t capture_us;      // request to decoded result
+    } dht_reading_t;
+
+    typedef struct {
+        uint32_t ok;
+        uint32_t timeouts;
+        uint32_t checksum;
+        uint32_t malformed;
+    } dht_stats_t;
+
+    // Called from the DHT task with every finished read, OK or not
+    typedef void (*dht_callback_t)(const dht_reading_t *reading, void *ctx);
+
+    // Edges of the data line are captured by an RMT RX channel and decoded
+    // in a small background task, so no caller busy-waits on the sensor or
+    // runs timing loops with interrupts enabled
+    esp_err_t dht_start(dht_sensor_type_t type, gpio_num_t pin, dht_callback_t cb, void *ctx);
+
+    // Start one read and return at once; the result arrives through the
+    // callback about 25 ms later. ESP_ERR_INVALID_STATE if a read is still
+    // running or the driver is not started.
+    esp_err_t dht_request(void);
+
+    void dht_get_stats(dht_stats_t *stats);
 
 #ifdef __cplusplus
 }
 #endif
 
 #endif // DHT_H
-
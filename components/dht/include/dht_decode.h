@@ -0,0 +1,44 @@
+#ifndef DHT_DECODE_H
+#define DHT_DECODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // One level of the data line and how long it lasted, as captured by RMT
+    // or from GPIO edge timestamps
+    typedef struct {
+        uint8_t level;
+        uint16_t us;
+    } dht_pulse_t;
+
+    typedef enum {
+        DHT_DECODE_OK = 0,
+        DHT_DECODE_NO_RESPONSE,   // no 80 us low / 80 us high acknowledge
+        DHT_DECODE_SHORT,         // fewer than 40 bits after the acknowledge
+        DHT_DECODE_TIMING,        // a bit pulse outside the datasheet range
+        DHT_DECODE_CHECKSUM,
+    } dht_decode_status_t;
+
+    // Decode the 5 data bytes from a capture of one transfer. Anything before
+    // the sensor's acknowledge (the tail of the start pulse, glitches) is
+    // skipped and consecutive pulses of the same level are merged. Bit 1 is
+    // a high longer than DHT_BIT_THRESHOLD_US. data is filled even when the
+    // checksum fails.
+    #define DHT_BIT_THRESHOLD_US 48
+    dht_decode_status_t dht_decode(const dht_pulse_t *pulses, size_t n, uint8_t data[5]);
+
+    // Humidity in % and temperature in degrees C from the data bytes
+    void dht11_convert(const uint8_t data[5], float *humidity, float *temperature);
+    void dht22_convert(const uint8_t data[5], float *humidity, float *temperature);
+
+    const char *dht_decode_status_str(dht_decode_status_t status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DHT_DECODE_H
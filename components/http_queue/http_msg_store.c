@@ -0,0 +1,158 @@
+#include "http_msg_store.h"
+#include <string.h>
+
+// Record layout: header, endpoint, NUL, body, NUL, padding to 4 bytes.
+// A PAD record fills the unusable end of the arena before a wrap.
+enum {
+    REC_LIVE = 1,
+    REC_FREE = 2,
+    REC_PAD = 3,
+};
+
+typedef struct {
+    uint16_t size;        // whole record including header and padding
+    uint8_t state;
+    uint8_t endpoint_len;
+} rec_hdr_t;
+
+_Static_assert(sizeof(rec_hdr_t) == HTTP_MSG_HEADER_SIZE, "record header size");
+
+#define ALIGN4(x) (((x) + 3u) & ~3u)
+
+static rec_hdr_t *hdr(const http_msg_store_t *store, uint16_t offset) {
+    return (rec_hdr_t *)(store->arena + offset);
+}
+
+void http_msg_store_init(http_msg_store_t *store, void *arena, size_t size) {
+    if (size > 65532) size = 65532;
+    memset(store, 0, sizeof(*store));
+    store->arena = arena;
+    store->size = (uint16_t)(size & ~3u);
+    store->reserved = HTTP_MSG_INVALID;
+}
+
+// Largest contiguous free run; *wrap is set when it starts at offset 0
+static uint16_t free_run(const http_msg_store_t *store, bool *wrap) {
+    *wrap = false;
+    if (store->stats.used == 0) return store->size; // empty arena restarts at 0
+    if (store->head > store->tail) {
+        uint16_t at_end = store->size - store->head;
+        if (store->tail > at_end) {
+            *wrap = true;
+            return store->tail;
+        }
+        return at_end;
+    }
+    return store->tail - store->head; // zero when head has caught up with tail
+}
+
+size_t http_msg_max_body(const http_msg_store_t *store, const char *endpoint) {
+    bool wrap;
+    size_t run = free_run(store, &wrap);
+    size_t overhead = HTTP_MSG_HEADER_SIZE + strlen(endpoint) + 2;
+    return (run > overhead) ? run - overhead : 0;
+}
+
+char *http_msg_reserve(http_msg_store_t *store, const char *endpoint, size_t max_body,
+                       http_msg_handle_t *handle) {
+    size_t endpoint_len = strlen(endpoint);
+    size_t need = ALIGN4(HTTP_MSG_HEADER_SIZE + endpoint_len + 1 + max_body + 1);
+    *handle = HTTP_MSG_INVALID;
+    if (endpoint_len > 255 || need > store->size || store->reserved != HTTP_MSG_INVALID) {
+        store->stats.alloc_failures++;
+        return NULL;
+    }
+
+    if (store->stats.used == 0) {
+        store->head = store->tail = 0;
+    }
+    bool wrap = false;
+    bool fits;
+    if (store->stats.used > 0 && store->head > store->tail) {
+        fits = need <= (size_t)(store->size - store->head);
+        if (!fits && need <= store->tail) {
+            fits = wrap = true;
+        }
+    } else {
+        fits = need <= free_run(store, &wrap);
+    }
+    if (!fits) {
+        store->stats.alloc_failures++;
+        return NULL;
+    }
+    if (wrap) {
+        // Pad out the end of the arena and continue at offset 0
+        uint16_t pad = store->size - store->head;
+        *hdr(store, store->head) = (rec_hdr_t) { .size = pad, .state = REC_PAD };
+        store->stats.used += pad;
+        store->head = 0;
+    }
+
+    uint16_t offset = store->head;
+    rec_hdr_t *h = hdr(store, offset);
+    *h = (rec_hdr_t) { .size = (uint16_t)need, .state = REC_LIVE, .endpoint_len = (uint8_t)endpoint_len };
+    char *text = (char *)(h + 1);
+    memcpy(text, endpoint, endpoint_len + 1);
+    char *body = text + endpoint_len + 1;
+    body[0] = '\0';
+
+    store->head = offset + need;
+    if (store->head == store->size) store->head = 0;
+    store->stats.used += need;
+    if (store->stats.used > store->stats.peak_used) store->stats.peak_used = store->stats.used;
+    store->stats.allocs++;
+    store->reserved = offset;
+    *handle = offset;
+    return body;
+}
+
+void http_msg_commit(http_msg_store_t *store, http_msg_handle_t handle, size_t body_len) {
+    if (handle == HTTP_MSG_INVALID || handle != store->reserved) return;
+    rec_hdr_t *h = hdr(store, handle);
+    uint16_t actual = ALIGN4(HTTP_MSG_HEADER_SIZE + h->endpoint_len + 1 + body_len + 1);
+    // The reservation is always the newest record, so its tail can be handed back
+    if (actual < h->size) {
+        uint16_t spare = h->size - actual;
+        h->size = actual;
+        store->head = handle + actual;
+        store->stats.used -= spare;
+    }
+    store->reserved = HTTP_MSG_INVALID;
+}
+
+void http_msg_free(http_msg_store_t *store, http_msg_handle_t handle) {
+    if (handle == HTTP_MSG_INVALID || handle >= store->size) return;
+    rec_hdr_t *h = hdr(store, handle);
+    if (h->state != REC_LIVE) return;
+    h->state = REC_FREE;
+    if (store->reserved == handle) store->reserved = HTTP_MSG_INVALID;
+
+    // Reclaim from the tail up to the oldest record still in use
+    while (store->stats.used > 0) {
+        rec_hdr_t *t = hdr(store, store->tail);
+        if (t->state == REC_LIVE) break;
+        store->stats.used -= t->size;
+        store->tail += t->size;
+        if (store->tail >= store->size) store->tail = 0;
+    }
+    if (store->stats.used == 0) {
+        store->head = store->tail = 0;
+    }
+}
+
+const char *http_msg_endpoint(const http_msg_store_t *store, http_msg_handle_t handle) {
+    return (const char *)(hdr(store, handle) + 1);
+}
+
+const char *http_msg_body(const http_msg_store_t *store, http_msg_handle_t handle) {
+    const rec_hdr_t *h = hdr(store, handle);
+    return (const char *)(h + 1) + h->endpoint_len + 1;
+}
+
+size_t http_msg_body_len(const http_msg_store_t *store, http_msg_handle_t handle) {
+    return strlen(http_msg_body(store, handle));
+}
+
+void http_msg_store_get_stats(const http_msg_store_t *store, http_msg_store_stats_t *stats) {
+    *stats = store->stats;
+}
@@ -0,0 +1,177 @@
+#include "http_pqueue.h"
+#include <stdlib.h>
+#include <string.h>
+
+static uint8_t *slot(const http_pqueue_t *q, const http_pq_level_t *lvl, uint16_t index) {
+    return lvl->items + (size_t)index * q->item_size;
+}
+
+// Remove the oldest item of a level, optionally copying it out
+static uint32_t level_take(http_pqueue_t *q, http_pq_level_t *lvl, void *item) {
+    uint32_t stamp = lvl->stamps[lvl->head];
+    if (item) memcpy(item, slot(q, lvl, lvl->head), q->item_size);
+    lvl->head = (lvl->head + 1) % lvl->config.capacity;
+    lvl->count--;
+    q->total_count--;
+    return stamp;
+}
+
+// Drop the oldest item of a level, handing it to the drop callback
+static void level_drop(http_pqueue_t *q, http_pq_level_t *lvl) {
+    if (q->drop_cb) q->drop_cb(slot(q, lvl, lvl->head), q->drop_ctx);
+    level_take(q, lvl, NULL);
+}
+
+// Lowest-priority non-empty level at or below cls, or NULL. A never_evict
+// level does not give up items to its own class.
+static http_pq_level_t *lowest_victim(http_pqueue_t *q, http_class_t cls) {
+    int last = q->levels[cls].config.never_evict ? (int)cls + 1 : (int)cls;
+    for (int c = HTTP_CLASS_COUNT - 1; c >= last; c--) {
+        if (q->levels[c].count > 0) return &q->levels[c];
+    }
+    return NULL;
+}
+
+// Index of the queued item of a level with this key, or -1
+static int level_find(const http_pq_level_t *lvl, uint32_t key) {
+    for (uint16_t i = 0; i < lvl->count; i++) {
+        uint16_t index = (lvl->head + i) % lvl->config.capacity;
+        if (lvl->keys[index] == key) return index;
+    }
+    return -1;
+}
+
+bool http_pqueue_init(http_pqueue_t *q, size_t item_size,
+                      const http_class_config_t config[HTTP_CLASS_COUNT], uint16_t total_capacity) {
+    memset(q, 0, sizeof(*q));
+    q->item_size = item_size;
+    q->total_capacity = total_capacity;
+    for (int c = 0; c < HTTP_CLASS_COUNT; c++) {
+        http_pq_level_t *lvl = &q->levels[c];
+        lvl->config = config[c];
+        if (lvl->config.capacity == 0) continue;
+        lvl->items = malloc((size_t)lvl->config.capacity * item_size);
+        lvl->stamps = malloc((size_t)lvl->config.capacity * sizeof(uint32_t));
+        lvl->keys = malloc((size_t)lvl->config.capacity * sizeof(uint32_t));
+        if (!lvl->items || !lvl->stamps || !lvl->keys) {
+            http_pqueue_deinit(q);
+            return false;
+        }
+    }
+    return true;
+}
+
+void http_pqueue_deinit(http_pqueue_t *q) {
+    for (int c = 0; c < HTTP_CLASS_COUNT; c++) {
+        free(q->levels[c].items);
+        free(q->levels[c].stamps);
+        free(q->levels[c].keys);
+        q->levels[c].items = NULL;
+        q->levels[c].stamps = NULL;
+        q->levels[c].keys = NULL;
+        q->levels[c].count = 0;
+    }
+    q->total_count = 0;
+}
+
+void http_pqueue_set_drop_cb(http_pqueue_t *q, http_pqueue_drop_cb_t cb, void *ctx) {
+    q->drop_cb = cb;
+    q->drop_ctx = ctx;
+}
+
+http_pq_result_t http_pqueue_push(http_pqueue_t *q, http_class_t cls, const void *item, uint32_t now_ms) {
+    return http_pqueue_push_keyed(q, cls, item, 0, now_ms);
+}
+
+http_pq_result_t http_pqueue_push_keyed(http_pqueue_t *q, http_class_t cls, const void *item, uint32_t key,
+                                        uint32_t now_ms) {
+    http_pq_level_t *lvl = &q->levels[cls];
+    http_pq_result_t result = HTTP_PQ_ADDED;
+
+    if (lvl->config.capacity == 0) {
+        lvl->stats.rejected++;
+        return HTTP_PQ_REJECTED;
+    }
+
+    int same = key ? level_find(lvl, key) : -1;
+    if (same >= 0) {
+        // Newer state of the same thing: take the old one's place in line
+        if (q->drop_cb) q->drop_cb(slot(q, lvl, same), q->drop_ctx);
+        memcpy(slot(q, lvl, same), item, q->item_size);
+        lvl->stats.coalesced++;
+        lvl->stats.enqueued++;
+        return HTTP_PQ_COALESCED;
+    }
+
+    if (lvl->count == lvl->config.capacity && lvl->config.never_evict) {
+        lvl->stats.rejected++;
+        return HTTP_PQ_REJECTED;
+    } else if (lvl->count == lvl->config.capacity) {
+        // Class full: the newest item of a class supersedes its oldest
+        level_drop(q, lvl);
+        lvl->stats.evicted++;
+        result = HTTP_PQ_REPLACED;
+    } else if (q->total_count >= q->total_capacity) {
+        // Queue full: make room at the expense of the lowest-priority class
+        http_pq_level_t *victim = lowest_victim(q, cls);
+        if (victim == NULL) {
+            lvl->stats.rejected++;
+            return HTTP_PQ_REJECTED;
+        }
+        level_drop(q, victim);
+        victim->stats.evicted++;
+        result = HTTP_PQ_REPLACED;
+    }
+
+    uint16_t tail = (lvl->head + lvl->count) % lvl->config.capacity;
+    memcpy(slot(q, lvl, tail), item, q->item_size);
+    lvl->stamps[tail] = now_ms;
+    lvl->keys[tail] = key;
+    lvl->count++;
+    q->total_count++;
+    lvl->stats.enqueued++;
+    return result;
+}
+
+int http_pqueue_pop(http_pqueue_t *q, void *item, uint32_t now_ms) {
+    for (int c = 0; c < HTTP_CLASS_COUNT; c++) {
+        http_pq_level_t *lvl = &q->levels[c];
+        while (lvl->count > 0) {
+            uint32_t age = now_ms - lvl->stamps[lvl->head];
+            if (lvl->config.max_age_ms && age > lvl->config.max_age_ms) {
+                level_drop(q, lvl);
+                lvl->stats.expired++;
+                continue;
+            }
+            level_take(q, lvl, item);
+            lvl->stats.dispatched++;
+            return c;
+        }
+    }
+    return -1;
+}
+
+int http_pqueue_evict(http_pqueue_t *q, http_class_t cls) {
+    http_pq_level_t *victim = lowest_victim(q, cls);
+    if (victim == NULL) return -1;
+    level_drop(q, victim);
+    victim->stats.evicted++;
+    return (int)(victim - q->levels);
+}
+
+uint16_t http_pqueue_count(const http_pqueue_t *q, http_class_t cls) {
+    return q->levels[cls].count;
+}
+
+uint16_t http_pqueue_total(const http_pqueue_t *q) {
+    return q->total_count;
+}
+
+void http_pqueue_get_stats(const http_pqueue_t *q, http_class_t cls, http_class_stats_t *stats) {
+    *stats = q->levels[cls].stats;
+}
+
+uint32_t http_pqueue_dropped(const http_pqueue_t *q, http_class_t cls) {
+    const http_class_stats_t *s = &q->levels[cls].stats;
+    return s->evicted + s->rejected + s->expired;
+}
@@ -0,0 +1,66 @@
+#ifndef HTTP_MSG_STORE_H
+#define HTTP_MSG_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // Byte offset of a record in the arena. Small enough to pass through a queue by value.
+    typedef uint16_t http_msg_handle_t;
+    #define HTTP_MSG_INVALID 0xFFFF
+
+    // Per-record overhead: 4-byte header, payload rounded up to 4 bytes
+    #define HTTP_MSG_HEADER_SIZE 4
+
+    typedef struct {
+        uint32_t allocs;
+        uint32_t alloc_failures;   // arena too full for the requested size
+        uint16_t used;             // bytes held by live records and padding
+        uint16_t peak_used;
+    } http_msg_store_stats_t;
+
+    // Ring allocator for variable-length request records. Records are
+    // allocated at the head and reclaimed from the tail; a record freed out
+    // of order is reclaimed once everything older is freed too.
+    // Not thread safe; the caller provides locking.
+    typedef struct {
+        uint8_t *arena;
+        uint16_t size;
+        uint16_t head;       // next allocation
+        uint16_t tail;       // oldest record not yet reclaimed
+        uint16_t reserved;   // record between reserve and commit, or HTTP_MSG_INVALID
+        http_msg_store_stats_t stats;
+    } http_msg_store_t;
+
+    // arena must be 4-byte aligned; size is rounded down to a multiple of 4 (max 65532)
+    void http_msg_store_init(http_msg_store_t *store, void *arena, size_t size);
+
+    // Reserve room for endpoint plus a body of up to max_body bytes (excluding NUL).
+    // Returns a pointer where the body should be written, or NULL if the arena is full.
+    char *http_msg_reserve(http_msg_store_t *store, const char *endpoint, size_t max_body,
+                           http_msg_handle_t *handle);
+
+    // Finish a reservation once body_len bytes (plus NUL) have been written.
+    // Unused reserved space is returned to the arena.
+    void http_msg_commit(http_msg_store_t *store, http_msg_handle_t handle, size_t body_len);
+
+    void http_msg_free(http_msg_store_t *store, http_msg_handle_t handle);
+
+    const char *http_msg_endpoint(const http_msg_store_t *store, http_msg_handle_t handle);
+    const char *http_msg_body(const http_msg_store_t *store, http_msg_handle_t handle);
+    size_t http_msg_body_len(const http_msg_store_t *store, http_msg_handle_t handle);
+
+    // Largest body that could be reserved right now for the given endpoint
+    size_t http_msg_max_body(const http_msg_store_t *store, const char *endpoint);
+
+    void http_msg_store_get_stats(const http_msg_store_t *store, http_msg_store_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HTTP_MSG_STORE_H
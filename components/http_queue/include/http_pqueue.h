@@ -0,0 +1,109 @@
+#ifndef HTTP_PQUEUE_H
+#define HTTP_PQUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // Request classes in dispatch order: lower value is sent first
+    typedef enum {
+        HTTP_CLASS_CONTROL = 0,   // pump/relay state PUTs
+        HTTP_CLASS_MESSAGE,       // /api/messages event log
+        HTTP_CLASS_TELEMETRY,     // /api/sensor_data readings
+        HTTP_CLASS_COUNT
+    } http_class_t;
+
+    typedef enum {
+        HTTP_PQ_ADDED = 0,     // stored, queue grew by one
+        HTTP_PQ_REPLACED,      // stored after evicting an older or lower-priority item
+        HTTP_PQ_COALESCED,     // took the place of a queued item with the same key
+        HTTP_PQ_REJECTED       // not stored, no room it was allowed to take
+    } http_pq_result_t;
+
+    typedef struct {
+        uint16_t capacity;    // max items of this class
+        uint32_t max_age_ms;  // items older than this are dropped at dispatch, 0 = never
+        bool never_evict;     // queued items stay until popped; a newcomer without room is rejected
+    } http_class_config_t;
+
+    typedef struct {
+        uint32_t enqueued;
+        uint32_t dispatched;
+        uint32_t evicted;     // pushed out by a newer item of this or a higher class
+        uint32_t rejected;    // refused on arrival
+        uint32_t expired;     // dropped at dispatch for exceeding max_age_ms
+        uint32_t coalesced;   // superseded by a newer item with the same key, not a drop
+    } http_class_stats_t;
+
+    typedef struct {
+        uint8_t *items;       // capacity * item_size bytes, ring buffer
+        uint32_t *stamps;     // enqueue time of each slot (ms)
+        uint32_t *keys;       // coalescing key of each slot, 0 = none
+        uint16_t head;        // oldest item
+        uint16_t count;
+        http_class_config_t config;
+        http_class_stats_t stats;
+    } http_pq_level_t;
+
+    // Called for every item that leaves the queue without being popped
+    // (evicted or expired), e.g. to release storage the item refers to.
+    typedef void (*http_pqueue_drop_cb_t)(const void *item, void *ctx);
+
+    // Multi-level FIFO: one ring per class, plus a shared total bound.
+    // Not thread safe; the caller provides locking.
+    typedef struct {
+        http_pq_level_t levels[HTTP_CLASS_COUNT];
+        size_t item_size;
+        uint16_t total_capacity;
+        uint16_t total_count;
+        http_pqueue_drop_cb_t drop_cb;
+        void *drop_ctx;
+    } http_pqueue_t;
+
+    // total_capacity may be smaller than the sum of class capacities so that
+    // classes can borrow space from each other.
+    bool http_pqueue_init(http_pqueue_t *q, size_t item_size,
+                          const http_class_config_t config[HTTP_CLASS_COUNT], uint16_t total_capacity);
+    void http_pqueue_deinit(http_pqueue_t *q);
+
+    void http_pqueue_set_drop_cb(http_pqueue_t *q, http_pqueue_drop_cb_t cb, void *ctx);
+
+    // Enqueue a copy of item. When the class is full its oldest item is evicted;
+    // when the whole queue is full the oldest item of the lowest non-empty class
+    // below cls is evicted instead. A never_evict class is not evicted from to
+    // make room: the newcomer is rejected.
+    http_pq_result_t http_pqueue_push(http_pqueue_t *q, http_class_t cls, const void *item, uint32_t now_ms);
+
+    // As http_pqueue_push(), but a queued item of the same class with the same
+    // non-zero key is replaced in place: it keeps its position and enqueue time,
+    // the old copy goes to the drop callback and counts as coalesced.
+    http_pq_result_t http_pqueue_push_keyed(http_pqueue_t *q, http_class_t cls, const void *item, uint32_t key,
+                                            uint32_t now_ms);
+
+    // Dequeue the oldest item of the highest-priority non-empty class, skipping
+    // expired items. Returns the class, or -1 when nothing is queued.
+    int http_pqueue_pop(http_pqueue_t *q, void *item, uint32_t now_ms);
+
+    // Evict the oldest item of the lowest-priority non-empty class that is not
+    // more important than cls, never from cls itself if it is never_evict.
+    // Used to free space held by queued items.
+    // Returns the evicted class, or -1 if only higher-priority items are queued.
+    int http_pqueue_evict(http_pqueue_t *q, http_class_t cls);
+
+    uint16_t http_pqueue_count(const http_pqueue_t *q, http_class_t cls);
+    uint16_t http_pqueue_total(const http_pqueue_t *q);
+    void http_pqueue_get_stats(const http_pqueue_t *q, http_class_t cls, http_class_stats_t *stats);
+
+    // Total drops (evicted + rejected + expired) for one class; coalesced
+    // items are not drops, their newer state is still queued
+    uint32_t http_pqueue_dropped(const http_pqueue_t *q, http_class_t cls);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HTTP_PQUEUE_H
@@ -0,0 +1,104 @@
+#include "hw_adc.h"
+#include <stddef.h>
+#include "sdkconfig.h"
+#include "esp_attr.h"
+#include "esp_adc/adc_continuous.h"
+
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+#define OUTPUT_FORMAT    ADC_DIGI_OUTPUT_FORMAT_TYPE1
+#define RESULT_CHANNEL(p) ((p)->type1.channel)
+#define RESULT_DATA(p)    ((p)->type1.data)
+#else
+#define OUTPUT_FORMAT    ADC_DIGI_OUTPUT_FORMAT_TYPE2
+#define RESULT_CHANNEL(p) ((p)->type2.channel)
+#define RESULT_DATA(p)    ((p)->type2.data)
+#endif
+
+#define FRAME_BYTES      (HW_ADC_READ_MAX * SOC_ADC_DIGI_RESULT_BYTES)
+#define POOL_BYTES       2048
+
+static adc_continuous_handle_t adc_handle;
+static hw_adc_ready_t ready_cb;
+static void *ready_ctx;
+static uint32_t overflows;
+
+static bool IRAM_ATTR on_conv_done(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata, void *arg)
+{
+    return ready_cb(ready_ctx);
+}
+
+static bool IRAM_ATTR on_pool_ovf(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata, void *arg)
+{
+    overflows++;
+    return false;
+}
+
+esp_err_t hw_adc_continuous_start(const hw_adc_pattern_t *pattern, int count, uint32_t sample_freq_hz,
+                                  hw_adc_ready_t ready, void *ctx)
+{
+    if (adc_handle) return ESP_ERR_INVALID_STATE;
+    if (count <= 0 || count > SOC_ADC_PATT_LEN_MAX || sample_freq_hz < SOC_ADC_SAMPLE_FREQ_THRES_LOW) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    adc_digi_pattern_config_t patt[SOC_ADC_PATT_LEN_MAX] = {0};
+    for (int i = 0; i < count; i++) {
+        patt[i].atten = pattern[i].atten;
+        patt[i].channel = pattern[i].channel;
+        patt[i].unit = ADC_UNIT_1;
+        patt[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+    }
+    ready_cb = ready;
+    ready_ctx = ctx;
+
+    adc_continuous_handle_cfg_t handle_cfg = {
+        .max_store_buf_size = POOL_BYTES,
+        .conv_frame_size = FRAME_BYTES,
+    };
+    esp_err_t err = adc_continuous_new_handle(&handle_cfg, &adc_handle);
+    if (err != ESP_OK) {
+        adc_handle = NULL;
+        return err;
+    }
+
+    adc_continuous_config_t cfg = {
+        .pattern_num = count,
+        .adc_pattern = patt,
+        .sample_freq_hz = sample_freq_hz,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = OUTPUT_FORMAT,
+    };
+    adc_continuous_evt_cbs_t cbs = {
+        .on_conv_done = on_conv_done,
+        .on_pool_ovf = on_pool_ovf,
+    };
+    err = adc_continuous_config(adc_handle, &cfg);
+    if (err == ESP_OK) err = adc_continuous_register_event_callbacks(adc_handle, &cbs, NULL);
+    if (err == ESP_OK) err = adc_continuous_start(adc_handle);
+    if (err != ESP_OK) {
+        // release the handle so a later start can try again
+        adc_continuous_deinit(adc_handle);
+        adc_handle = NULL;
+    }
+    return err;
+}
+
+int hw_adc_continuous_read(hw_adc_sample_t *out, int max)
+{
+    static uint8_t frame[FRAME_BYTES];
+    uint32_t len = 0;
+    if (max > HW_ADC_READ_MAX) max = HW_ADC_READ_MAX;
+    if (adc_continuous_read(adc_handle, frame, max * SOC_ADC_DIGI_RESULT_BYTES, &len, 0) != ESP_OK) return 0;
+    int n = 0;
+    for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= len; i += SOC_ADC_DIGI_RESULT_BYTES) {
+        const adc_digi_output_data_t *p = (const adc_digi_output_data_t *)&frame[i];
+        out[n].channel = RESULT_CHANNEL(p);
+        out[n].raw = RESULT_DATA(p);
+        n++;
+    }
+    return n;
+}
+
+uint32_t hw_adc_overflows(void)
+{
+    return overflows;
+}
@@ -0,0 +1,55 @@
+#include "hw_gpio.h"
+#include "esp_attr.h"
+#include "driver/gpio.h"
+
+static bool isr_service;
+
+esp_err_t hw_gpio_output(gpio_num_t pin, bool strong)
+{
+    gpio_reset_pin(pin);
+    esp_err_t err = gpio_set_direction(pin, GPIO_MODE_OUTPUT);
+    if (err == ESP_OK && strong) err = gpio_set_drive_capability(pin, GPIO_DRIVE_CAP_3);
+    if (err == ESP_OK) err = gpio_set_level(pin, 0);
+    return err;
+}
+
+esp_err_t hw_gpio_input(gpio_num_t pin, hw_gpio_pull_t pull)
+{
+    gpio_config_t conf = {
+        .pin_bit_mask = 1ULL << pin,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = pull == HW_GPIO_PULL_UP ? GPIO_PULLUP_ENABLE : GPIO_PULLUP_DISABLE,
+        .pull_down_en = pull == HW_GPIO_PULL_DOWN ? GPIO_PULLDOWN_ENABLE : GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    gpio_reset_pin(pin);
+    return gpio_config(&conf);
+}
+
+void hw_gpio_set(gpio_num_t pin, int level)
+{
+    gpio_set_level(pin, level);
+}
+
+int IRAM_ATTR hw_gpio_get(gpio_num_t pin)
+{
+    return gpio_get_level(pin);
+}
+
+esp_err_t hw_gpio_isr_add(gpio_num_t pin, hw_gpio_edge_t edge, hw_gpio_isr_t isr, void *arg)
+{
+    static const gpio_int_type_t types[] = {
+        [HW_GPIO_EDGE_RISING] = GPIO_INTR_POSEDGE,
+        [HW_GPIO_EDGE_FALLING] = GPIO_INTR_NEGEDGE,
+        [HW_GPIO_EDGE_ANY] = GPIO_INTR_ANYEDGE,
+    };
+    if (!isr_service) {
+        esp_err_t err = gpio_install_isr_service(0);
+        if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) return err;   // already installed is fine
+        isr_service = true;
+    }
+    esp_err_t err = gpio_set_intr_type(pin, types[edge]);
+    if (err == ESP_OK) err = gpio_isr_handler_add(pin, isr, arg);
+    if (err == ESP_OK) err = gpio_intr_enable(pin);
+    return err;
+}
@@ -0,0 +1,129 @@
+#include "hw_http.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_http_client.h"
+#include "esp_crt_bundle.h"
+
+_Static_assert(HW_HTTP_ERR_EAGAIN == ESP_ERR_HTTP_EAGAIN, "EAGAIN code");
+
+struct hw_http_client {
+    esp_http_client_handle_t client;
+    hw_http_event_cb_t handler;
+    void *user_data;
+};
+
+static esp_err_t event_handler(esp_http_client_event_t *evt)
+{
+    struct hw_http_client *c = evt->user_data;
+    hw_http_event_t e = { .user_data = c->user_data };
+    switch (evt->event_id) {
+    case HTTP_EVENT_ERROR:        e.id = HW_HTTP_EVENT_ERROR; break;
+    case HTTP_EVENT_ON_CONNECTED: e.id = HW_HTTP_EVENT_CONNECTED; break;
+    case HTTP_EVENT_ON_HEADER:
+        e.id = HW_HTTP_EVENT_HEADER;
+        e.header_key = evt->header_key;
+        e.header_value = evt->header_value;
+        break;
+    case HTTP_EVENT_ON_DATA:
+        e.id = HW_HTTP_EVENT_DATA;
+        e.data = evt->data;
+        e.data_len = evt->data_len;
+        break;
+    case HTTP_EVENT_ON_FINISH:    e.id = HW_HTTP_EVENT_FINISH; break;
+    case HTTP_EVENT_DISCONNECTED: e.id = HW_HTTP_EVENT_DISCONNECTED; break;
+    default:
+        return ESP_OK;
+    }
+    c->handler(&e);
+    return ESP_OK;
+}
+
+hw_http_handle_t hw_http_init(const hw_http_config_t *config)
+{
+    struct hw_http_client *c = calloc(1, sizeof(*c));
+    if (c == NULL) return NULL;
+    c->handler = config->event_handler;
+    c->user_data = config->user_data;
+    esp_http_client_config_t cfg = {
+        .url = config->url,
+        .event_handler = event_handler,
+        .user_data = c,
+        .timeout_ms = config->timeout_ms,
+        .buffer_size = config->buffer_size,
+        .buffer_size_tx = config->buffer_size_tx,
+        .keep_alive_enable = config->keep_alive,
+        .keep_alive_idle = 5,
+        .keep_alive_interval = 5,
+        .keep_alive_count = 3,
+        .is_async = config->is_async,
+    };
+    if (config->cert_pem) {
+        cfg.cert_pem = config->cert_pem;
+    } else {
+        cfg.crt_bundle_attach = esp_crt_bundle_attach;
+    }
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    // Resume the TLS session after a reconnect instead of a full handshake
+    cfg.save_client_session = true;
+#endif
+    c->client = esp_http_client_init(&cfg);
+    if (c->client == NULL) {
+        free(c);
+        return NULL;
+    }
+    return c;
+}
+
+void hw_http_cleanup(hw_http_handle_t client)
+{
+    esp_http_client_cleanup(client->client);
+    free(client);
+}
+
+void hw_http_close(hw_http_handle_t client)
+{
+    esp_http_client_close(client->client);
+}
+
+void hw_http_set_url(hw_http_handle_t client, const char *url)
+{
+    esp_http_client_set_url(client->client, url);
+}
+
+void hw_http_set_method(hw_http_handle_t client, hw_http_method_t method)
+{
+    static const esp_http_client_method_t methods[] = {
+        [HW_HTTP_GET] = HTTP_METHOD_GET, [HW_HTTP_POST] = HTTP_METHOD_POST, [HW_HTTP_PUT] = HTTP_METHOD_PUT,
+    };
+    esp_http_client_set_method(client->client, methods[method]);
+}
+
+void hw_http_set_timeout_ms(hw_http_handle_t client, int timeout_ms)
+{
+    esp_http_client_set_timeout_ms(client->client, timeout_ms);
+}
+
+void hw_http_set_header(hw_http_handle_t client, const char *key, const char *value)
+{
+    esp_http_client_set_header(client->client, key, value);
+}
+
+void hw_http_delete_header(hw_http_handle_t client, const char *key)
+{
+    esp_http_client_delete_header(client->client, key);
+}
+
+void hw_http_set_body(hw_http_handle_t client, const char *data, int len)
+{
+    esp_http_client_set_post_field(client->client, data, len);
+}
+
+esp_err_t hw_http_perform(hw_http_handle_t client)
+{
+    return esp_http_client_perform(client->client);
+}
+
+int hw_http_status(hw_http_handle_t client)
+{
+    return esp_http_client_get_status_code(client->client);
+}
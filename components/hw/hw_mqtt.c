@@ -0,0 +1,72 @@
+#include "hw_mqtt.h"
+#include <stdlib.h>
+#include "mqtt_client.h"
+
+struct hw_mqtt_client {
+    esp_mqtt_client_handle_t client;
+    hw_mqtt_event_cb_t cb;
+    void *ctx;
+};
+
+static void event_handler(void *arg, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    struct hw_mqtt_client *c = arg;
+    esp_mqtt_event_handle_t event = event_data;
+    hw_mqtt_event_t e = { .client = c, .msg_id = event->msg_id };
+    switch (event_id) {
+    case MQTT_EVENT_CONNECTED:    e.id = HW_MQTT_CONNECTED; break;
+    case MQTT_EVENT_DISCONNECTED: e.id = HW_MQTT_DISCONNECTED; break;
+    case MQTT_EVENT_SUBSCRIBED:   e.id = HW_MQTT_SUBSCRIBED; break;
+    case MQTT_EVENT_PUBLISHED:    e.id = HW_MQTT_PUBLISHED; break;
+    case MQTT_EVENT_DELETED:      e.id = HW_MQTT_DELETED; break;
+    case MQTT_EVENT_DATA:
+        e.id = HW_MQTT_DATA;
+        e.topic = event->topic;
+        e.topic_len = event->topic_len;
+        e.data = event->data;
+        e.data_len = event->data_len;
+        e.current_data_offset = event->current_data_offset;
+        e.total_data_len = event->total_data_len;
+        break;
+    default:
+        return;
+    }
+    c->cb(&e, c->ctx);
+}
+
+hw_mqtt_handle_t hw_mqtt_start(const hw_mqtt_config_t *config, hw_mqtt_event_cb_t cb, void *ctx)
+{
+    struct hw_mqtt_client *c = calloc(1, sizeof(*c));
+    if (c == NULL) return NULL;
+    c->cb = cb;
+    c->ctx = ctx;
+    const esp_mqtt_client_config_t cfg = {
+        .broker.address.uri = config->uri,
+        .broker.verification.certificate = config->cert_pem,
+        .credentials.username = config->username,
+        .credentials.authentication.password = config->password,
+    };
+    c->client = esp_mqtt_client_init(&cfg);
+    if (c->client == NULL) {
+        free(c);
+        return NULL;
+    }
+    esp_mqtt_client_register_event(c->client, ESP_EVENT_ANY_ID, event_handler, c);
+    esp_mqtt_client_start(c->client);
+    return c;
+}
+
+int hw_mqtt_publish(hw_mqtt_handle_t client, const char *topic, const char *data, int len, int qos, bool retain)
+{
+    return esp_mqtt_client_publish(client->client, topic, data, len, qos, retain);
+}
+
+int hw_mqtt_enqueue(hw_mqtt_handle_t client, const char *topic, const char *data, int len, int qos, bool retain)
+{
+    return esp_mqtt_client_enqueue(client->client, topic, data, len, qos, retain, true);
+}
+
+int hw_mqtt_subscribe(hw_mqtt_handle_t client, const char *topic, int qos)
+{
+    return esp_mqtt_client_subscribe(client->client, topic, qos);
+}
@@ -0,0 +1,25 @@
+#include "hw_time.h"
+#include <time.h>
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_sntp.h"
+
+int64_t IRAM_ATTR hw_time_us(void)
+{
+    return esp_timer_get_time();
+}
+
+void hw_time_sync_start(const char *server)
+{
+    esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
+    esp_sntp_setservername(0, server);
+    esp_sntp_init();
+}
+
+bool hw_time_synced(void)
+{
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    return tm.tm_year >= 2020 - 1900;
+}
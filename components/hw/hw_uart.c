@@ -0,0 +1,64 @@
+#include "hw_uart.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "driver/uart.h"
+
+#define EVENT_QUEUE_LEN 20
+
+static QueueHandle_t event_queues[UART_NUM_MAX];
+
+esp_err_t hw_uart_open(uart_port_t port, uint32_t baud, gpio_num_t tx_pin, gpio_num_t rx_pin, size_t rx_buf_size)
+{
+    const uart_config_t config = {
+        .baud_rate = baud,
+        .data_bits = UART_DATA_8_BITS,
+        .parity    = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE
+    };
+    esp_err_t err = uart_driver_install(port, rx_buf_size, 0, EVENT_QUEUE_LEN, &event_queues[port], 0);
+    if (err == ESP_OK) err = uart_param_config(port, &config);
+    if (err == ESP_OK) err = uart_set_pin(port, tx_pin, rx_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    return err;
+}
+
+int hw_uart_wait(uart_port_t port, uint32_t timeout_ms)
+{
+    uart_event_t event;
+    TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(timeout_ms);
+    while (1) {
+        TickType_t left = deadline - xTaskGetTickCount();
+        if ((int32_t)left < 0) left = 0;
+        if (xQueueReceive(event_queues[port], &event, left) != pdTRUE) return 0;
+        switch (event.type) {
+        case UART_DATA:
+            return event.size;
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+            uart_flush_input(port);
+            xQueueReset(event_queues[port]);
+            return -1;
+        default:
+            break;          // line errors and breaks: wait for data
+        }
+    }
+}
+
+int hw_uart_read(uart_port_t port, void *buf, size_t len)
+{
+    return uart_read_bytes(port, buf, len, 0);
+}
+
+int hw_uart_write(uart_port_t port, const void *buf, size_t len)
+{
+    return uart_write_bytes(port, buf, len);
+}
+
+esp_err_t hw_uart_set_baud(uart_port_t port, uint32_t baud)
+{
+    uart_wait_tx_done(port, pdMS_TO_TICKS(100));
+    esp_err_t err = uart_set_baudrate(port, baud);
+    uart_flush_input(port);
+    return err;
+}
@@ -0,0 +1,44 @@
+#ifndef HW_ADC_H
+#define HW_ADC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "hal/adc_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    #define HW_ADC_READ_MAX 128     // samples per hw_adc_continuous_read(), one DMA frame
+
+    typedef struct {
+        adc_channel_t channel;      // ADC1
+        adc_atten_t atten;
+    } hw_adc_pattern_t;
+
+    typedef struct {
+        uint16_t channel;
+        uint16_t raw;               // 12 bit
+    } hw_adc_sample_t;
+
+    // Called in interrupt context when a frame of conversions is ready;
+    // returns true if it woke a higher priority task
+    typedef bool (*hw_adc_ready_t)(void *ctx);
+
+    // Convert the channels round-robin at sample_freq_hz in total, by DMA
+    esp_err_t hw_adc_continuous_start(const hw_adc_pattern_t *pattern, int count, uint32_t sample_freq_hz,
+                                      hw_adc_ready_t ready, void *ctx);
+
+    // Conversions not read yet, oldest first, without waiting; returns the
+    // number copied (at most max, max <= HW_ADC_READ_MAX)
+    int hw_adc_continuous_read(hw_adc_sample_t *out, int max);
+
+    // Frames lost because nobody read them in time
+    uint32_t hw_adc_overflows(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HW_ADC_H
@@ -0,0 +1,42 @@
+#ifndef HW_GPIO_H
+#define HW_GPIO_H
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "hal/gpio_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    typedef enum {
+        HW_GPIO_PULL_NONE = 0,
+        HW_GPIO_PULL_UP,
+        HW_GPIO_PULL_DOWN,
+    } hw_gpio_pull_t;
+
+    typedef enum {
+        HW_GPIO_EDGE_RISING = 1,
+        HW_GPIO_EDGE_FALLING,
+        HW_GPIO_EDGE_ANY,
+    } hw_gpio_edge_t;
+
+    // Called in interrupt context (the scripted input thread on the host)
+    typedef void (*hw_gpio_isr_t)(void *arg);
+
+    // Reset the pin and make it a push-pull output at level 0. strong
+    // selects the highest drive strength, for relay drivers.
+    esp_err_t hw_gpio_output(gpio_num_t pin, bool strong);
+    esp_err_t hw_gpio_input(gpio_num_t pin, hw_gpio_pull_t pull);
+
+    void hw_gpio_set(gpio_num_t pin, int level);
+    int hw_gpio_get(gpio_num_t pin);
+
+    // Interrupt on an input's edges; installs the ISR service on first use
+    esp_err_t hw_gpio_isr_add(gpio_num_t pin, hw_gpio_edge_t edge, hw_gpio_isr_t isr, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HW_GPIO_H
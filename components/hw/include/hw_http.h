@@ -0,0 +1,76 @@
+#ifndef HW_HTTP_H
+#define HW_HTTP_H
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // The subset of esp_http_client that cloudflare_api uses. On the host it
+    // is plain HTTP/1.1 over a socket; https URLs fail with ESP_ERR_NOT_SUPPORTED.
+
+    #define HW_HTTP_ERR_EAGAIN 0x7007   // ESP_ERR_HTTP_EAGAIN: async request not finished yet
+
+    typedef struct hw_http_client *hw_http_handle_t;
+
+    typedef enum {
+        HW_HTTP_GET = 0,
+        HW_HTTP_POST,
+        HW_HTTP_PUT,
+    } hw_http_method_t;
+
+    typedef enum {
+        HW_HTTP_EVENT_ERROR = 0,
+        HW_HTTP_EVENT_CONNECTED,    // a new connection (TCP + TLS) is up
+        HW_HTTP_EVENT_HEADER,       // one response header
+        HW_HTTP_EVENT_DATA,         // a chunk of the response body
+        HW_HTTP_EVENT_FINISH,
+        HW_HTTP_EVENT_DISCONNECTED,
+    } hw_http_event_id_t;
+
+    typedef struct {
+        hw_http_event_id_t id;
+        const char *header_key;
+        const char *header_value;
+        const char *data;
+        int data_len;
+        void *user_data;
+    } hw_http_event_t;
+
+    typedef void (*hw_http_event_cb_t)(const hw_http_event_t *evt);
+
+    typedef struct {
+        const char *url;
+        hw_http_event_cb_t event_handler;
+        void *user_data;
+        int timeout_ms;
+        int buffer_size;            // receive buffer
+        int buffer_size_tx;
+        bool keep_alive;            // TCP keep-alive probes on idle connections
+        bool is_async;              // perform() returns HW_HTTP_ERR_EAGAIN instead of blocking
+        const char *cert_pem;       // server certificate, NULL trusts the CA bundle
+    } hw_http_config_t;
+
+    hw_http_handle_t hw_http_init(const hw_http_config_t *config);
+    void hw_http_cleanup(hw_http_handle_t client);
+    // Drop the connection; the next perform() opens a new one
+    void hw_http_close(hw_http_handle_t client);
+
+    void hw_http_set_url(hw_http_handle_t client, const char *url);
+    void hw_http_set_method(hw_http_handle_t client, hw_http_method_t method);
+    void hw_http_set_timeout_ms(hw_http_handle_t client, int timeout_ms);
+    void hw_http_set_header(hw_http_handle_t client, const char *key, const char *value);
+    void hw_http_delete_header(hw_http_handle_t client, const char *key);
+    // Request body, not copied; NULL for none
+    void hw_http_set_body(hw_http_handle_t client, const char *data, int len);
+
+    esp_err_t hw_http_perform(hw_http_handle_t client);
+    int hw_http_status(hw_http_handle_t client);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HW_HTTP_H
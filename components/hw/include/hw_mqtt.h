@@ -0,0 +1,60 @@
+#ifndef HW_MQTT_H
+#define HW_MQTT_H
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // An MQTT client that connects and reconnects on its own (esp-mqtt on
+    // the device). On the host it speaks MQTT 3.1.1 over plain TCP to mqtt://
+    // brokers only.
+
+    typedef struct hw_mqtt_client *hw_mqtt_handle_t;
+
+    typedef enum {
+        HW_MQTT_CONNECTED = 0,
+        HW_MQTT_DISCONNECTED,
+        HW_MQTT_SUBSCRIBED,
+        HW_MQTT_DATA,               // a message, or a fragment of a large one
+        HW_MQTT_PUBLISHED,          // QoS 1 publish acknowledged
+        HW_MQTT_DELETED,            // QoS 1 publish given up
+    } hw_mqtt_event_id_t;
+
+    typedef struct {
+        hw_mqtt_event_id_t id;
+        hw_mqtt_handle_t client;
+        int msg_id;
+        const char *topic;          // first fragment only
+        int topic_len;
+        const char *data;
+        int data_len;
+        int current_data_offset;    // of this fragment in the message
+        int total_data_len;
+    } hw_mqtt_event_t;
+
+    // Called from the client's task
+    typedef void (*hw_mqtt_event_cb_t)(const hw_mqtt_event_t *event, void *ctx);
+
+    typedef struct {
+        const char *uri;
+        const char *cert_pem;       // broker CA for mqtts://
+        const char *username;
+        const char *password;
+    } hw_mqtt_config_t;
+
+    hw_mqtt_handle_t hw_mqtt_start(const hw_mqtt_config_t *config, hw_mqtt_event_cb_t cb, void *ctx);
+
+    // len 0 takes strlen(data). Returns the message id (0 for QoS 0), -1 on error.
+    int hw_mqtt_publish(hw_mqtt_handle_t client, const char *topic, const char *data, int len, int qos, bool retain);
+    // Like publish, but only queues the message and never waits on the network
+    int hw_mqtt_enqueue(hw_mqtt_handle_t client, const char *topic, const char *data, int len, int qos, bool retain);
+    int hw_mqtt_subscribe(hw_mqtt_handle_t client, const char *topic, int qos);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HW_MQTT_H
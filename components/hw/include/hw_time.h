@@ -0,0 +1,24 @@
+#ifndef HW_TIME_H
+#define HW_TIME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // Monotonic microseconds since boot (esp_timer on the device)
+    int64_t hw_time_us(void);
+
+    // Start keeping the wall clock (time()) in sync with an NTP server
+    void hw_time_sync_start(const char *server);
+
+    // The wall clock has been set: time() is past 2020
+    bool hw_time_synced(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HW_TIME_H
@@ -0,0 +1,32 @@
+#ifndef HW_UART_H
+#define HW_UART_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "hal/gpio_types.h"
+#include "hal/uart_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // 8N1, no flow control, event driven receive into a rx_buf_size ring
+    esp_err_t hw_uart_open(uart_port_t port, uint32_t baud, gpio_num_t tx_pin, gpio_num_t rx_pin, size_t rx_buf_size);
+
+    // Wait up to timeout_ms for received bytes. Returns how many can be read,
+    // 0 on timeout, -1 if the receive buffer overflowed (input was flushed).
+    int hw_uart_wait(uart_port_t port, uint32_t timeout_ms);
+
+    // Take up to len received bytes without waiting
+    int hw_uart_read(uart_port_t port, void *buf, size_t len);
+    int hw_uart_write(uart_port_t port, const void *buf, size_t len);
+
+    // Finish sending at the old rate, switch and drop anything received
+    esp_err_t hw_uart_set_baud(uart_port_t port, uint32_t baud);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HW_UART_H
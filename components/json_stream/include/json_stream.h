@@ -0,0 +1,80 @@
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // Longest key and scalar kept per token, including the NUL. Longer ones are
+    // cut short and flagged; parsing carries on with the rest of the input.
+    #define JSON_STREAM_KEY_MAX   32
+    #define JSON_STREAM_VALUE_MAX 64
+    // Deepest nesting accepted (one bit of state per level)
+    #define JSON_STREAM_MAX_DEPTH 32
+
+    typedef enum {
+        JSON_STREAM_OBJECT_START = 0,
+        JSON_STREAM_OBJECT_END,
+        JSON_STREAM_ARRAY_START,
+        JSON_STREAM_ARRAY_END,
+        JSON_STREAM_STRING,
+        JSON_STREAM_NUMBER,
+        JSON_STREAM_TRUE,
+        JSON_STREAM_FALSE,
+        JSON_STREAM_NULL,
+    } json_stream_event_t;
+
+    typedef struct {
+        json_stream_event_t event;
+        int depth;           // containers open around the token; a container counts itself
+        const char *key;     // member name in the enclosing object, "" inside arrays,
+                             // at top level and for *_END events
+        const char *value;   // scalar text, strings unescaped; "" for container events
+        bool truncated;      // key or value did not fit
+    } json_stream_token_t;
+
+    typedef void (*json_stream_cb_t)(const json_stream_token_t *tok, void *ctx);
+
+    // Incremental SAX-style JSON tokenizer. Input can be split anywhere,
+    // including inside strings and escapes; memory use does not depend on
+    // the document size.
+    typedef struct {
+        json_stream_cb_t cb;
+        void *ctx;
+        uint32_t arrays;       // bit n set: container at depth n+1 is an array
+        uint8_t depth;
+        uint8_t state;
+        uint8_t after_string;  // state to enter once the current string closes
+        uint8_t esc;           // escape progress: 0 none, 1 after '\', 2..5 \u digits
+        uint16_t code;         // \u code unit being read
+        uint8_t key_len;
+        uint8_t value_len;
+        bool key_truncated;
+        bool value_truncated;
+        bool error;
+        size_t offset;         // bytes consumed, for error reports
+        char key[JSON_STREAM_KEY_MAX];
+        char value[JSON_STREAM_VALUE_MAX];
+    } json_stream_t;
+
+    void json_stream_init(json_stream_t *js, json_stream_cb_t cb, void *ctx);
+
+    // Feed the next chunk. Returns false once the input is known to be invalid;
+    // json_stream_error_offset() then tells where.
+    bool json_stream_feed(json_stream_t *js, const char *data, size_t len);
+
+    // End of input. Flushes a trailing top-level number and returns true if
+    // exactly one complete value was read.
+    bool json_stream_finish(json_stream_t *js);
+
+    size_t json_stream_error_offset(const json_stream_t *js);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JSON_STREAM_H
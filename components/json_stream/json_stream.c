@@ -0,0 +1,322 @@
+#include "json_stream.h"
+#include <string.h>
+
+enum {
+    ST_VALUE = 0,       // a value must follow
+    ST_VALUE_OR_END,    // just after '['
+    ST_KEY_OR_END,      // just after '{'
+    ST_KEY,             // after ',' in an object
+    ST_COLON,
+    ST_AFTER,           // after a value: ',' or a closing bracket
+    ST_STRING,
+    ST_NUMBER,
+    ST_LITERAL,
+    ST_DONE,
+    ST_ERROR,
+};
+
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool top_is_array(const json_stream_t *js)
+{
+    return js->depth > 0 && (js->arrays & (1u << (js->depth - 1)));
+}
+
+static bool fail(json_stream_t *js)
+{
+    js->error = true;
+    js->state = ST_ERROR;
+    return true;
+}
+
+static void emit(json_stream_t *js, json_stream_event_t event, int depth)
+{
+    bool scalar = event >= JSON_STREAM_STRING;
+    js->key[js->key_len] = '\0';
+    js->value[scalar ? js->value_len : 0] = '\0';
+    json_stream_token_t tok = {
+        .event = event,
+        .depth = depth,
+        .key = js->key,
+        .value = js->value,
+        .truncated = js->key_truncated || (scalar && js->value_truncated),
+    };
+    if (js->cb) js->cb(&tok, js->ctx);
+}
+
+static void clear_key(json_stream_t *js)
+{
+    js->key_len = 0;
+    js->key_truncated = false;
+}
+
+static void value_done(json_stream_t *js)
+{
+    js->state = js->depth == 0 ? ST_DONE : ST_AFTER;
+}
+
+static void put_value(json_stream_t *js, char c)
+{
+    if (js->value_len < JSON_STREAM_VALUE_MAX - 1) js->value[js->value_len++] = c;
+    else js->value_truncated = true;
+}
+
+// String characters go to the key while a member name is being read
+static void put_char(json_stream_t *js, char c)
+{
+    if (js->after_string != ST_COLON) {
+        put_value(js, c);
+    } else if (js->key_len < JSON_STREAM_KEY_MAX - 1) {
+        js->key[js->key_len++] = c;
+    } else {
+        js->key_truncated = true;
+    }
+}
+
+static void put_code_unit(json_stream_t *js, uint16_t cu)
+{
+    // Surrogate halves are encoded one by one; nothing here compares non-ASCII text
+    if (cu < 0x80) {
+        put_char(js, (char)cu);
+    } else if (cu < 0x800) {
+        put_char(js, (char)(0xC0 | (cu >> 6)));
+        put_char(js, (char)(0x80 | (cu & 0x3F)));
+    } else {
+        put_char(js, (char)(0xE0 | (cu >> 12)));
+        put_char(js, (char)(0x80 | ((cu >> 6) & 0x3F)));
+        put_char(js, (char)(0x80 | (cu & 0x3F)));
+    }
+}
+
+static void begin_scalar(json_stream_t *js, uint8_t state)
+{
+    js->state = state;
+    js->value_len = 0;
+    js->value_truncated = false;
+}
+
+static void begin_string(json_stream_t *js, uint8_t after)
+{
+    begin_scalar(js, ST_STRING);
+    js->after_string = after;
+    js->esc = 0;
+    if (after == ST_COLON) clear_key(js);
+}
+
+// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+static bool valid_number(const char *s, size_t n)
+{
+    size_t i = 0;
+    if (i < n && s[i] == '-') i++;
+    if (i >= n) return false;
+    if (s[i] == '0') {
+        i++;
+    } else if (s[i] >= '1' && s[i] <= '9') {
+        while (i < n && s[i] >= '0' && s[i] <= '9') i++;
+    } else {
+        return false;
+    }
+    if (i < n && s[i] == '.') {
+        size_t start = ++i;
+        while (i < n && s[i] >= '0' && s[i] <= '9') i++;
+        if (i == start) return false;
+    }
+    if (i < n && (s[i] == 'e' || s[i] == 'E')) {
+        i++;
+        if (i < n && (s[i] == '+' || s[i] == '-')) i++;
+        size_t start = i;
+        while (i < n && s[i] >= '0' && s[i] <= '9') i++;
+        if (i == start) return false;
+    }
+    return i == n;
+}
+
+static bool open_container(json_stream_t *js, bool array)
+{
+    if (js->depth >= JSON_STREAM_MAX_DEPTH) return fail(js);
+    if (array) js->arrays |= 1u << js->depth;
+    else js->arrays &= ~(1u << js->depth);
+    js->depth++;
+    emit(js, array ? JSON_STREAM_ARRAY_START : JSON_STREAM_OBJECT_START, js->depth);
+    clear_key(js);
+    js->state = array ? ST_VALUE_OR_END : ST_KEY_OR_END;
+    return true;
+}
+
+static bool close_container(json_stream_t *js, bool array)
+{
+    if (js->depth == 0 || top_is_array(js) != array) return fail(js);
+    clear_key(js);
+    emit(js, array ? JSON_STREAM_ARRAY_END : JSON_STREAM_OBJECT_END, js->depth);
+    js->depth--;
+    value_done(js);
+    return true;
+}
+
+static bool start_value(json_stream_t *js, char c)
+{
+    if (c == '{') return open_container(js, false);
+    if (c == '[') return open_container(js, true);
+    if (c == '"') {
+        begin_string(js, ST_AFTER);
+        return true;
+    }
+    if (c == '-' || (c >= '0' && c <= '9')) {
+        begin_scalar(js, ST_NUMBER);
+        js->value[js->value_len++] = c;
+        return true;
+    }
+    if (c == 't' || c == 'f' || c == 'n') {
+        begin_scalar(js, ST_LITERAL);
+        js->value[js->value_len++] = c;
+        return true;
+    }
+    return fail(js);
+}
+
+static bool string_char(json_stream_t *js, char c)
+{
+    if (js->esc == 1) {
+        js->esc = 0;
+        switch (c) {
+            case '"': case '\\': case '/': put_char(js, c); break;
+            case 'b': put_char(js, '\b'); break;
+            case 'f': put_char(js, '\f'); break;
+            case 'n': put_char(js, '\n'); break;
+            case 'r': put_char(js, '\r'); break;
+            case 't': put_char(js, '\t'); break;
+            case 'u': js->esc = 2; js->code = 0; break;
+            default: return fail(js);
+        }
+        return true;
+    }
+    if (js->esc >= 2) {
+        int digit;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+        else return fail(js);
+        js->code = (uint16_t)((js->code << 4) | digit);
+        if (++js->esc == 6) {
+            js->esc = 0;
+            put_code_unit(js, js->code);
+        }
+        return true;
+    }
+    if (c == '\\') {
+        js->esc = 1;
+    } else if (c == '"') {
+        if (js->after_string == ST_COLON) {
+            js->state = ST_COLON;
+        } else {
+            emit(js, JSON_STREAM_STRING, js->depth);
+            value_done(js);
+        }
+    } else if ((unsigned char)c < 0x20) {
+        return fail(js);
+    } else {
+        put_char(js, c);
+    }
+    return true;
+}
+
+// Returns false when c ended a number or literal and has to be looked at again
+static bool step(json_stream_t *js, char c)
+{
+    switch (js->state) {
+        case ST_STRING:
+            return string_char(js, c);
+
+        case ST_NUMBER:
+            if ((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-') {
+                put_value(js, c);
+                return true;
+            }
+            if (js->value_truncated || !valid_number(js->value, js->value_len)) return fail(js);
+            emit(js, JSON_STREAM_NUMBER, js->depth);
+            value_done(js);
+            return false;
+
+        case ST_LITERAL:
+            if (c >= 'a' && c <= 'z') {
+                if (js->value_len >= 5) return fail(js);
+                js->value[js->value_len++] = c;
+                return true;
+            }
+            js->value[js->value_len] = '\0';
+            if (strcmp(js->value, "true") == 0) emit(js, JSON_STREAM_TRUE, js->depth);
+            else if (strcmp(js->value, "false") == 0) emit(js, JSON_STREAM_FALSE, js->depth);
+            else if (strcmp(js->value, "null") == 0) emit(js, JSON_STREAM_NULL, js->depth);
+            else return fail(js);
+            value_done(js);
+            return false;
+
+        default:
+            break;
+    }
+
+    if (is_space(c)) return true;
+
+    switch (js->state) {
+        case ST_VALUE_OR_END:
+            if (c == ']') return close_container(js, true);
+            return start_value(js, c);
+        case ST_VALUE:
+            return start_value(js, c);
+        case ST_KEY_OR_END:
+            if (c == '}') return close_container(js, false);
+            // fall through
+        case ST_KEY:
+            if (c != '"') return fail(js);
+            begin_string(js, ST_COLON);
+            return true;
+        case ST_COLON:
+            if (c != ':') return fail(js);
+            js->state = ST_VALUE;
+            return true;
+        case ST_AFTER:
+            if (c == ',') {
+                js->state = top_is_array(js) ? ST_VALUE : ST_KEY;
+                return true;
+            }
+            if (c == ']') return close_container(js, true);
+            if (c == '}') return close_container(js, false);
+            return fail(js);
+        default: // ST_DONE: only whitespace may follow
+            return fail(js);
+    }
+}
+
+void json_stream_init(json_stream_t *js, json_stream_cb_t cb, void *ctx)
+{
+    memset(js, 0, sizeof(*js));
+    js->cb = cb;
+    js->ctx = ctx;
+    js->state = ST_VALUE;
+}
+
+bool json_stream_feed(json_stream_t *js, const char *data, size_t len)
+{
+    for (size_t i = 0; i < len && !js->error; i++) {
+        while (!step(js, data[i])) {
+        }
+        if (!js->error) js->offset++;
+    }
+    return !js->error;
+}
+
+bool json_stream_finish(json_stream_t *js)
+{
+    if (js->state == ST_NUMBER || js->state == ST_LITERAL) {
+        json_stream_feed(js, " ", 1);
+    }
+    return !js->error && js->state == ST_DONE;
+}
+
+size_t json_stream_error_offset(const json_stream_t *js)
+{
+    return js->offset;
+}
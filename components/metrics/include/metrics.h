@@ -0,0 +1,98 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // main.c registers about 125 series: 11 fixed, 2 per task (up to 24),
+    // 4 per sensor driver, 10 for the HTTP queue, 4 heap and 6 Uno link/MQTT
+    #ifndef METRICS_MAX
+    #define METRICS_MAX          160
+    #endif
+    #define METRICS_HIST_BUCKETS 8     // finite upper bounds; +Inf is implied
+    #define METRICS_LABEL_LEN    16    // configMAX_TASK_NAME_LEN
+
+    typedef enum {
+        METRIC_COUNTER,
+        METRIC_GAUGE,
+        METRIC_HISTOGRAM,
+    } metric_type_t;
+
+    // One time series: a name with at most one label, e.g.
+    // task_stack_free_bytes{task="mqtt"}. Updates are lock free and may come
+    // from any task; a snapshot reads each value once.
+    typedef struct {
+        const char *name;
+        const char *help;
+        const char *label_name;                 // NULL for an unlabelled metric
+        char label_value[METRICS_LABEL_LEN];
+        metric_type_t type;
+        const uint32_t *bounds;                 // histogram bucket upper bounds, ascending
+        int bucket_count;
+        atomic_uint value;                      // counter, or the float bits of a gauge
+        atomic_uint buckets[METRICS_HIST_BUCKETS + 1];
+        atomic_uint count;                      // histogram observations
+        atomic_uint sum;
+    } metric_t;
+
+    // Fixed table, so it can be a static with no allocation. Registration
+    // appends and must not race with itself; updates and snapshots may run
+    // alongside it.
+    typedef struct {
+        metric_t entries[METRICS_MAX];
+        atomic_int count;
+        atomic_uint refused;        // lookups that returned NULL
+    } metrics_t;
+
+    typedef enum {
+        METRICS_TEXT,       // Prometheus text exposition format 0.0.4
+        METRICS_JSON,       // {"name":value, "name":{"label value":value}, ...}
+    } metrics_format_t;
+
+    void metrics_init(metrics_t *m);
+
+    // Find the metric with this name and label value, or add it. label_name
+    // and label_value are NULL for an unlabelled metric; the value is copied,
+    // the other strings must outlive the registry. Returns NULL if the table
+    // is full or the name is registered with another type. Every update
+    // function ignores a NULL metric.
+    metric_t *metrics_counter(metrics_t *m, const char *name, const char *help,
+                              const char *label_name, const char *label_value);
+    metric_t *metrics_gauge(metrics_t *m, const char *name, const char *help,
+                            const char *label_name, const char *label_value);
+    // bounds: up to METRICS_HIST_BUCKETS ascending upper bounds, kept by reference
+    metric_t *metrics_histogram(metrics_t *m, const char *name, const char *help,
+                                const char *label_name, const char *label_value,
+                                const uint32_t *bounds, int bucket_count);
+
+    void metrics_add(metric_t *counter, uint32_t n);
+    void metrics_set(metric_t *metric, float value);
+    // Counters whose total is kept elsewhere (e.g. queue stats), exact to 2^32
+    void metrics_set_total(metric_t *counter, uint32_t total);
+    void metrics_observe(metric_t *histogram, uint32_t value);
+
+    float metrics_value(const metric_t *metric);
+
+    // Registrations refused so far, for a full table or a name reused with
+    // another type or label; nonzero means series are missing from exports
+    uint32_t metrics_refused(const metrics_t *m);
+
+    // Write a snapshot like snprintf: returns the full length, output is
+    // truncated (and NUL-terminated) if it does not fit in len
+    int metrics_format(const metrics_t *m, metrics_format_t format, char *buf, size_t len);
+
+    // A complete snapshot in a malloc'd buffer the caller frees, its length
+    // in *len. Values and series that change while it is written only make
+    // the buffer grow and the snapshot be taken again. NULL if out of memory.
+    char *metrics_format_alloc(const metrics_t *m, metrics_format_t format, int *len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // METRICS_H
@@ -0,0 +1,279 @@
+#include "metrics.h"
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void metrics_init(metrics_t *m)
+{
+    memset(m, 0, sizeof(*m));
+    atomic_init(&m->count, 0);
+    atomic_init(&m->refused, 0);
+}
+
+static bool same_label(const metric_t *e, const char *label_value)
+{
+    if (label_value == NULL) return e->label_value[0] == '\0';
+    return strncmp(e->label_value, label_value, METRICS_LABEL_LEN - 1) == 0;
+}
+
+static metric_t *find_or_add(metrics_t *m, metric_type_t type, const char *name, const char *help,
+                             const char *label_name, const char *label_value)
+{
+    int count = atomic_load_explicit(&m->count, memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        metric_t *e = &m->entries[i];
+        if (strcmp(e->name, name) != 0) continue;
+        // one type and one label (or none) per name, or the exports would not parse
+        if (e->type != type || (e->label_name == NULL) != (label_name == NULL)) {
+            atomic_fetch_add_explicit(&m->refused, 1, memory_order_relaxed);
+            return NULL;
+        }
+        if (same_label(e, label_value)) return e;
+    }
+    if (count == METRICS_MAX) {
+        atomic_fetch_add_explicit(&m->refused, 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    metric_t *e = &m->entries[count];
+    memset(e, 0, sizeof(*e));
+    e->name = name;
+    e->help = help;
+    e->label_name = label_name;
+    if (label_name && label_value) snprintf(e->label_value, sizeof(e->label_value), "%s", label_value);
+    e->type = type;
+    atomic_store_explicit(&m->count, count + 1, memory_order_release);   // publish the filled entry
+    return e;
+}
+
+uint32_t metrics_refused(const metrics_t *m)
+{
+    return atomic_load_explicit(&m->refused, memory_order_relaxed);
+}
+
+metric_t *metrics_counter(metrics_t *m, const char *name, const char *help,
+                          const char *label_name, const char *label_value)
+{
+    return find_or_add(m, METRIC_COUNTER, name, help, label_name, label_value);
+}
+
+metric_t *metrics_gauge(metrics_t *m, const char *name, const char *help,
+                        const char *label_name, const char *label_value)
+{
+    return find_or_add(m, METRIC_GAUGE, name, help, label_name, label_value);
+}
+
+metric_t *metrics_histogram(metrics_t *m, const char *name, const char *help,
+                            const char *label_name, const char *label_value,
+                            const uint32_t *bounds, int bucket_count)
+{
+    if (bucket_count < 1 || bucket_count > METRICS_HIST_BUCKETS) return NULL;
+    metric_t *e = find_or_add(m, METRIC_HISTOGRAM, name, help, label_name, label_value);
+    if (e && e->bounds == NULL) {
+        e->bounds = bounds;
+        e->bucket_count = bucket_count;
+    }
+    return e;
+}
+
+void metrics_add(metric_t *counter, uint32_t n)
+{
+    if (counter) atomic_fetch_add_explicit(&counter->value, n, memory_order_relaxed);
+}
+
+static uint32_t float_bits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float bits_float(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void metrics_set(metric_t *metric, float value)
+{
+    if (metric == NULL) return;
+    uint32_t v = metric->type == METRIC_GAUGE ? float_bits(value) : value > 0 ? (uint32_t)value : 0;
+    atomic_store_explicit(&metric->value, v, memory_order_relaxed);
+}
+
+void metrics_set_total(metric_t *counter, uint32_t total)
+{
+    if (counter == NULL || counter->type != METRIC_COUNTER) return;
+    atomic_store_explicit(&counter->value, total, memory_order_relaxed);
+}
+
+void metrics_observe(metric_t *histogram, uint32_t value)
+{
+    if (histogram == NULL || histogram->type != METRIC_HISTOGRAM) return;
+    int b = 0;
+    while (b < histogram->bucket_count && value > histogram->bounds[b]) b++;
+    atomic_fetch_add_explicit(&histogram->buckets[b], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->sum, value, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->count, 1, memory_order_relaxed);
+}
+
+float metrics_value(const metric_t *metric)
+{
+    uint32_t v = atomic_load_explicit(&((metric_t *)metric)->value, memory_order_relaxed);
+    return metric->type == METRIC_GAUGE ? bits_float(v) : (float)v;
+}
+
+/* ---------------------------------------------------------------- export */
+
+typedef struct {
+    char *buf;
+    size_t len;
+    int total;      // what would have been written
+} out_t;
+
+static void out(out_t *o, const char *fmt, ...)
+{
+    size_t used = (size_t)o->total < o->len ? (size_t)o->total : o->len;
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(o->buf ? o->buf + used : NULL, o->buf ? o->len - used : 0, fmt, args);
+    va_end(args);
+    if (n > 0) o->total += n;
+}
+
+static const char *type_name(metric_type_t type)
+{
+    return type == METRIC_COUNTER ? "counter" : type == METRIC_GAUGE ? "gauge" : "histogram";
+}
+
+static uint32_t load(const atomic_uint *a)
+{
+    return atomic_load_explicit((atomic_uint *)a, memory_order_relaxed);
+}
+
+static void out_value(out_t *o, const metric_t *e)
+{
+    if (e->type == METRIC_COUNTER) {
+        out(o, "%u", (unsigned)load(&e->value));
+        return;
+    }
+    float v = metrics_value(e);
+    if (isfinite(v)) out(o, "%.6g", v);
+    else out(o, "0");
+}
+
+// name{label="value"} with an optional extra le="bound" label
+static void text_series(out_t *o, const metric_t *e, const char *suffix, const char *le)
+{
+    out(o, "%s%s", e->name, suffix);
+    if (e->label_name && le) out(o, "{%s=\"%s\",le=\"%s\"}", e->label_name, e->label_value, le);
+    else if (e->label_name) out(o, "{%s=\"%s\"}", e->label_name, e->label_value);
+    else if (le) out(o, "{le=\"%s\"}", le);
+    out(o, " ");
+}
+
+static void text_entry(out_t *o, const metric_t *e)
+{
+    if (e->type != METRIC_HISTOGRAM) {
+        text_series(o, e, "", NULL);
+        out_value(o, e);
+        out(o, "\n");
+        return;
+    }
+    uint32_t cumulative = 0;
+    char le[12];
+    for (int b = 0; b <= e->bucket_count; b++) {
+        cumulative += load(&e->buckets[b]);
+        if (b < e->bucket_count) snprintf(le, sizeof(le), "%u", (unsigned)e->bounds[b]);
+        else snprintf(le, sizeof(le), "+Inf");
+        text_series(o, e, "_bucket", le);
+        out(o, "%u\n", (unsigned)cumulative);
+    }
+    text_series(o, e, "_sum", NULL);
+    out(o, "%u\n", (unsigned)load(&e->sum));
+    text_series(o, e, "_count", NULL);
+    out(o, "%u\n", (unsigned)cumulative);     // consistent with the buckets just written
+}
+
+static void json_entry(out_t *o, const metric_t *e)
+{
+    if (e->type != METRIC_HISTOGRAM) {
+        out_value(o, e);
+        return;
+    }
+    uint32_t total = 0;
+    out(o, "{\"le\":[");
+    for (int b = 0; b < e->bucket_count; b++) out(o, "%s%u", b ? "," : "", (unsigned)e->bounds[b]);
+    out(o, "],\"buckets\":[");
+    for (int b = 0; b <= e->bucket_count; b++) {
+        uint32_t n = load(&e->buckets[b]);
+        total += n;
+        out(o, "%s%u", b ? "," : "", (unsigned)n);
+    }
+    out(o, "],\"count\":%u,\"sum\":%u}", (unsigned)total, (unsigned)load(&e->sum));
+}
+
+int metrics_format(const metrics_t *m, metrics_format_t format, char *buf, size_t len)
+{
+    out_t o = { .buf = len ? buf : NULL, .len = len, .total = 0 };
+    if (o.buf) o.buf[0] = '\0';
+    int count = atomic_load_explicit((atomic_int *)&m->count, memory_order_acquire);
+    if (format == METRICS_JSON) out(&o, "{");
+    bool first_family = true;
+
+    // Series of one name are written together, in registration order
+    for (int i = 0; i < count; i++) {
+        const metric_t *e = &m->entries[i];
+        int j = 0;
+        while (j < i && strcmp(m->entries[j].name, e->name) != 0) j++;
+        if (j < i) continue;    // written with its first series
+
+        if (format == METRICS_TEXT) {
+            if (e->help) out(&o, "# HELP %s %s\n", e->name, e->help);
+            out(&o, "# TYPE %s %s\n", e->name, type_name(e->type));
+        } else {
+            out(&o, "%s\"%s\":", first_family ? "" : ",", e->name);
+            if (e->label_name) out(&o, "{");
+        }
+        first_family = false;
+
+        bool first_series = true;
+        for (int k = i; k < count; k++) {
+            const metric_t *s = &m->entries[k];
+            if (strcmp(s->name, e->name) != 0) continue;
+            if (format == METRICS_TEXT) {
+                text_entry(&o, s);
+                continue;
+            }
+            if (s->label_name) out(&o, "%s\"%s\":", first_series ? "" : ",", s->label_value);
+            json_entry(&o, s);
+            first_series = false;
+        }
+        if (format == METRICS_JSON && e->label_name) out(&o, "}");
+    }
+    if (format == METRICS_JSON) out(&o, "}");
+    return o.total;
+}
+
+char *metrics_format_alloc(const metrics_t *m, metrics_format_t format, int *len)
+{
+    char *buf = NULL;
+    int n = metrics_format(m, format, NULL, 0);
+    while (1) {
+        size_t size = n + n / 8 + 64;    // room for counters that grow a digit meanwhile
+        char *grown = realloc(buf, size);
+        if (grown == NULL) {
+            free(buf);
+            return NULL;
+        }
+        buf = grown;
+        n = metrics_format(m, format, buf, size);
+        if ((size_t)n < size) break;
+    }
+    *len = n;
+    return buf;
+}
@@ -0,0 +1,85 @@
+#ifndef MOTION_DETECTOR_H
+#define MOTION_DETECTOR_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // A level change of the sensor output and when it happened
+    typedef struct {
+        int64_t t_us;
+        uint8_t level;
+    } motion_edge_t;
+
+    #define MOTION_EDGE_RING 32     // power of two
+
+    // Single producer (the GPIO ISR), single consumer (the motion task).
+    // Lock free; a full ring drops the new edge and counts it.
+    typedef struct {
+        motion_edge_t buf[MOTION_EDGE_RING];
+        atomic_uint head;           // written by the producer only
+        atomic_uint tail;           // written by the consumer only
+        atomic_uint dropped;
+    } motion_edge_ring_t;
+
+    void motion_edge_ring_init(motion_edge_ring_t *r);
+    bool motion_edge_push(motion_edge_ring_t *r, int64_t t_us, uint8_t level);
+    bool motion_edge_pop(motion_edge_ring_t *r, motion_edge_t *edge);
+
+    typedef struct {
+        uint32_t min_high_ms;       // highs shorter than this are ignored, 0 = none
+        uint32_t hold_ms;           // an episode ends this long after the output falls
+    } motion_config_t;
+
+    typedef enum {
+        MOTION_NONE = 0,
+        MOTION_START,
+        MOTION_END,
+    } motion_change_t;
+
+    typedef struct {
+        motion_change_t change;
+        int64_t t_us;               // time of the edge that caused it
+        int64_t decided_us;         // when the detector could tell
+        uint32_t duration_ms;       // of the episode, on MOTION_END
+    } motion_event_t;
+
+    // Motion episodes from the edges of an RCWL-0516 style output: an episode
+    // starts when the output has stayed high for min_high_ms and ends hold_ms
+    // after it last went low, so retriggers within the hold extend one
+    // episode. Not thread safe.
+    typedef struct {
+        motion_config_t cfg;
+        uint8_t level;
+        int64_t rise_us;
+        int64_t fall_us;
+        bool motion;
+        int64_t start_us;
+        uint32_t episodes;
+        uint32_t glitches;          // highs shorter than min_high_ms
+        uint32_t edges;
+    } motion_detector_t;
+
+    void motion_detector_init(motion_detector_t *d, const motion_config_t *cfg, uint8_t level, int64_t now_us);
+
+    // Apply the passage of time (min_high confirmation, end of hold). Call it
+    // with the edge's time before each edge, and with the current time when
+    // the deadline passes.
+    bool motion_detector_poll(motion_detector_t *d, int64_t now_us, motion_event_t *ev);
+
+    // Feed the next edge; true with *ev filled if the motion state changed
+    bool motion_detector_edge(motion_detector_t *d, const motion_edge_t *edge, motion_event_t *ev);
+
+    // When poll() has something to decide next, or -1 if only an edge can
+    // change the state
+    int64_t motion_detector_deadline(const motion_detector_t *d);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MOTION_DETECTOR_H
@@ -0,0 +1,41 @@
+#ifndef MOTION_RCWL_H
+#define MOTION_RCWL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal/gpio_types.h"
+#include "esp_err.h"
+#include "motion_detector.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    typedef struct {
+        uint32_t edges;
+        uint32_t dropped;           // edges lost to a full ring
+        uint32_t episodes;
+        uint32_t glitches;
+        uint32_t latency_max_us;    // edge to callback
+        uint64_t latency_sum_us;
+        uint32_t events;
+    } motion_rcwl_stats_t;
+
+    // Called from the motion task on every start and end of an episode
+    typedef void (*motion_callback_t)(const motion_event_t *ev, void *ctx);
+
+    // Timestamps both edges of the radar output in a GPIO interrupt and
+    // feeds them through a lock-free ring to a task that runs the episode
+    // detector. The pin must be configured as an input.
+    esp_err_t motion_rcwl_start(gpio_num_t pin, const motion_config_t *cfg, motion_callback_t cb, void *ctx);
+
+    // Current episode state
+    bool motion_rcwl_active(void);
+
+    void motion_rcwl_get_stats(motion_rcwl_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MOTION_RCWL_H
@@ -0,0 +1,90 @@
+#include "motion_detector.h"
+#include <string.h>
+
+void motion_edge_ring_init(motion_edge_ring_t *r)
+{
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->dropped, 0);
+}
+
+bool motion_edge_push(motion_edge_ring_t *r, int64_t t_us, uint8_t level)
+{
+    unsigned head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (head - tail >= MOTION_EDGE_RING) {
+        atomic_fetch_add_explicit(&r->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+    motion_edge_t *e = &r->buf[head & (MOTION_EDGE_RING - 1)];
+    e->t_us = t_us;
+    e->level = level;
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+    return true;
+}
+
+bool motion_edge_pop(motion_edge_ring_t *r, motion_edge_t *edge)
+{
+    unsigned tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&r->head, memory_order_acquire);
+    if (head == tail) return false;
+    *edge = r->buf[tail & (MOTION_EDGE_RING - 1)];
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+void motion_detector_init(motion_detector_t *d, const motion_config_t *cfg, uint8_t level, int64_t now_us)
+{
+    memset(d, 0, sizeof(*d));
+    d->cfg = *cfg;
+    d->level = level ? 1 : 0;
+    d->rise_us = d->fall_us = now_us;
+}
+
+static bool emit(motion_detector_t *d, motion_change_t change, int64_t t_us, int64_t now_us, motion_event_t *ev)
+{
+    ev->change = change;
+    ev->t_us = t_us;
+    ev->decided_us = now_us;
+    ev->duration_ms = 0;
+    if (change == MOTION_START) {
+        d->motion = true;
+        d->start_us = t_us;
+        d->episodes++;
+    } else {
+        d->motion = false;
+        ev->duration_ms = (uint32_t)((t_us - d->start_us) / 1000);
+    }
+    return true;
+}
+
+int64_t motion_detector_deadline(const motion_detector_t *d)
+{
+    if (d->level && !d->motion) return d->rise_us + (int64_t)d->cfg.min_high_ms * 1000;
+    if (!d->level && d->motion) return d->fall_us + (int64_t)d->cfg.hold_ms * 1000;
+    return -1;
+}
+
+bool motion_detector_poll(motion_detector_t *d, int64_t now_us, motion_event_t *ev)
+{
+    int64_t deadline = motion_detector_deadline(d);
+    if (deadline < 0 || now_us < deadline) return false;
+    if (d->level) return emit(d, MOTION_START, d->rise_us, now_us, ev);
+    return emit(d, MOTION_END, deadline, now_us, ev);
+}
+
+bool motion_detector_edge(motion_detector_t *d, const motion_edge_t *edge, motion_event_t *ev)
+{
+    uint8_t level = edge->level ? 1 : 0;
+    d->edges++;
+    if (level == d->level) return false;   // the opposite edge was lost, nothing new
+    d->level = level;
+    if (level) {
+        d->rise_us = edge->t_us;
+        if (!d->motion && d->cfg.min_high_ms == 0) return emit(d, MOTION_START, edge->t_us, edge->t_us, ev);
+    } else {
+        d->fall_us = edge->t_us;
+        if (!d->motion) d->glitches++;
+    }
+    return false;
+}
@@ -0,0 +1,98 @@
+#include "motion_rcwl.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "hw_gpio.h"
+#include "hw_time.h"
+
+#define TASK_STACK    3072
+#define TASK_PRIORITY 9
+
+static const char *TAG = "RCWL";
+
+static gpio_num_t rcwl_pin;
+static motion_edge_ring_t ring;
+static motion_detector_t detector;
+static motion_callback_t callback;
+static void *callback_ctx;
+static TaskHandle_t task_handle;
+static volatile bool active;
+static motion_rcwl_stats_t stats;
+
+static void IRAM_ATTR rcwl_isr(void *arg)
+{
+    motion_edge_push(&ring, hw_time_us(), hw_gpio_get(rcwl_pin));
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(task_handle, &woken);
+    if (woken) portYIELD_FROM_ISR();
+}
+
+static void deliver(const motion_event_t *ev)
+{
+    uint32_t latency = (uint32_t)(hw_time_us() - ev->t_us);
+    if (ev->change == MOTION_START) {
+        // the detector's own delay is min_high_ms; count what comes on top
+        latency -= (uint32_t)(ev->decided_us - ev->t_us);
+    }
+    stats.events++;
+    stats.latency_sum_us += latency;
+    if (latency > stats.latency_max_us) stats.latency_max_us = latency;
+    active = ev->change == MOTION_START;
+    if (callback) callback(ev, callback_ctx);
+}
+
+static void motion_task(void *arg)
+{
+    motion_event_t ev;
+    motion_edge_t edge;
+    while (1) {
+        // sleep until an edge arrives or the detector has a deadline
+        TickType_t wait = portMAX_DELAY;
+        int64_t deadline = motion_detector_deadline(&detector);
+        if (deadline >= 0) {
+            int64_t us = deadline - hw_time_us();
+            wait = us > 0 ? pdMS_TO_TICKS((us + 999) / 1000) + 1 : 0;
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        while (motion_edge_pop(&ring, &edge)) {
+            if (motion_detector_poll(&detector, edge.t_us, &ev)) deliver(&ev);
+            if (motion_detector_edge(&detector, &edge, &ev)) deliver(&ev);
+        }
+        if (motion_detector_poll(&detector, hw_time_us(), &ev)) deliver(&ev);
+    }
+}
+
+esp_err_t motion_rcwl_start(gpio_num_t pin, const motion_config_t *cfg, motion_callback_t cb, void *ctx)
+{
+    if (task_handle) return ESP_ERR_INVALID_STATE;
+    rcwl_pin = pin;
+    callback = cb;
+    callback_ctx = ctx;
+    motion_edge_ring_init(&ring);
+    motion_detector_init(&detector, cfg, hw_gpio_get(pin), hw_time_us());
+
+    if (xTaskCreate(motion_task, "motion", TASK_STACK, NULL, TASK_PRIORITY, &task_handle) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = hw_gpio_isr_add(pin, HW_GPIO_EDGE_ANY, rcwl_isr, NULL);
+    if (err != ESP_OK) return err;
+    ESP_LOGI(TAG, "Edge interrupts on GPIO %d, min high %lu ms, hold %lu ms",
+             pin, (unsigned long)cfg->min_high_ms, (unsigned long)cfg->hold_ms);
+    return ESP_OK;
+}
+
+bool motion_rcwl_active(void)
+{
+    return active;
+}
+
+void motion_rcwl_get_stats(motion_rcwl_stats_t *out)
+{
+    *out = stats;
+    out->edges = detector.edges;
+    out->episodes = detector.episodes;
+    out->glitches = detector.glitches;
+    out->dropped = atomic_load(&ring.dropped);
+}
@@ -0,0 +1,60 @@
+#ifndef PPG_WINDOW_H
+#define PPG_WINDOW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    #define PPG_RATE_HZ 25          // what maxim_heart_rate_and_oxygen_saturation assumes
+    #define PPG_WINDOW  100         // 4 s, its BUFFER_SIZE
+    #define PPG_FINGER_IR 50000     // IR mean below this: nothing on the sensor
+
+    typedef struct {
+        int32_t heart_rate;         // bpm
+        int32_t spo2;               // %
+        bool hr_valid;
+        bool spo2_valid;
+        uint32_t ir_mean;           // low without a finger on the sensor
+    } ppg_result_t;
+
+    // Sliding 4 s window over MAX30102 IR/red samples, evaluated with the
+    // Maxim algorithm every hop samples. Pushing a sample is O(1): the IR
+    // sum and the 4-sample sums behind the moving average are kept up to
+    // date, and each sample is stored twice so the window is always one
+    // contiguous run (no shifting). An evaluation then only runs the peak
+    // search and the ratio over the window. Results are identical to
+    // maxim_heart_rate_and_oxygen_saturation() on the same 100 samples.
+    typedef struct {
+        int32_t ir[2 * PPG_WINDOW];
+        int32_t red[2 * PPG_WINDOW];
+        int32_t sum4[2 * PPG_WINDOW];   // IR of this sample and the 3 before it
+        uint32_t pos;               // next write slot; the window starts here
+        uint32_t count;             // samples since the last reset, saturates
+        uint32_t ir_sum;
+        int32_t last4;              // running sum4
+        uint32_t hop;
+        uint32_t since_eval;
+        int32_t scratch[PPG_WINDOW];
+    } ppg_window_t;
+
+    // hop: samples between evaluations, 1..PPG_WINDOW; PPG_RATE_HZ gives a
+    // result per second
+    void ppg_window_init(ppg_window_t *w, uint32_t hop);
+
+    // Drop all samples, e.g. after packets were lost
+    void ppg_window_reset(ppg_window_t *w);
+
+    // Add a sample; true and *result filled when an evaluation is due
+    bool ppg_window_push(ppg_window_t *w, uint32_t ir, uint32_t red, ppg_result_t *result);
+
+    // Evaluate the current window now; false until it is full
+    bool ppg_window_evaluate(ppg_window_t *w, ppg_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PPG_WINDOW_H
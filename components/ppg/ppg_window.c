@@ -0,0 +1,117 @@
+#include "ppg_window.h"
+#include <string.h>
+#include "spo2_algorithm.h"
+
+_Static_assert(PPG_WINDOW == BUFFER_SIZE, "window must match the Maxim buffer");
+_Static_assert(PPG_RATE_HZ == FreqS, "rate must match the Maxim algorithm");
+
+void ppg_window_init(ppg_window_t *w, uint32_t hop)
+{
+    memset(w, 0, sizeof(*w));
+    w->hop = hop < 1 ? 1 : hop > PPG_WINDOW ? PPG_WINDOW : hop;
+}
+
+void ppg_window_reset(ppg_window_t *w)
+{
+    ppg_window_init(w, w->hop);
+}
+
+bool ppg_window_push(ppg_window_t *w, uint32_t ir, uint32_t red, ppg_result_t *result)
+{
+    uint32_t p = w->pos;
+    // the slot being overwritten holds the sample PPG_WINDOW back, and the
+    // one 4 back is at p + PPG_WINDOW - 4 in the mirrored half
+    w->ir_sum += ir - (uint32_t)w->ir[p];
+    w->last4 += (int32_t)ir - w->ir[p + PPG_WINDOW - 4];
+    w->ir[p] = w->ir[p + PPG_WINDOW] = ir;
+    w->red[p] = w->red[p + PPG_WINDOW] = red;
+    w->sum4[p] = w->sum4[p + PPG_WINDOW] = w->last4;
+    w->pos = p + 1 == PPG_WINDOW ? 0 : p + 1;
+    if (w->count < PPG_WINDOW) w->count++;
+
+    if (++w->since_eval < w->hop) return false;
+    if (w->count < PPG_WINDOW) return false;
+    w->since_eval = 0;
+    return ppg_window_evaluate(w, result);
+}
+
+// Below follows maxim_heart_rate_and_oxygen_saturation() step for step, with
+// the mean and the moving average taken from the running sums. Its quirks
+// (the last 4 samples are not averaged, n_x_ac reads at the red maximum)
+// are kept so results stay identical.
+bool ppg_window_evaluate(ppg_window_t *w, ppg_result_t *result)
+{
+    if (w->count < PPG_WINDOW) return false;
+    const int32_t *ir = &w->ir[w->pos];
+    const int32_t *red = &w->red[w->pos];
+    const int32_t *sum4 = &w->sum4[w->pos];
+    int32_t *x = w->scratch;
+    int32_t mean = w->ir_sum / PPG_WINDOW;
+    int32_t k, i;
+
+    // DC removed, inverted so valleys become peaks, 4-point moving average
+    int32_t th = 0;
+    for (k = 0; k < PPG_WINDOW - MA4_SIZE; k++) {
+        x[k] = (4 * mean - sum4[k + 3]) / 4;
+        th += x[k];
+    }
+    for (; k < PPG_WINDOW; k++) {
+        x[k] = mean - ir[k];
+        th += x[k];
+    }
+    th /= PPG_WINDOW;
+    if (th < 30) th = 30;
+    if (th > 60) th = 60;
+
+    int32_t locs[15] = { 0 };
+    int32_t npks;
+    maxim_find_peaks(locs, &npks, x, PPG_WINDOW, th, 4, 15);
+
+    result->ir_mean = mean;
+    result->hr_valid = npks >= 2;
+    result->heart_rate = -999;
+    if (npks >= 2) {
+        int32_t interval = 0;
+        for (k = 1; k < npks; k++) interval += locs[k] - locs[k - 1];
+        interval /= npks - 1;
+        result->heart_rate = (FreqS * 60) / interval;
+    }
+
+    result->spo2 = -999;
+    result->spo2_valid = false;
+    for (k = 0; k < npks; k++) {
+        if (locs[k] > PPG_WINDOW) return true;
+    }
+
+    // AC/DC of red over AC/DC of IR between each pair of valleys
+    int32_t ratio[5] = { 0 }, nratio = 0;
+    for (k = 0; k < npks - 1; k++) {
+        int32_t y_dc_max = -16777216, x_dc_max = -16777216;
+        int32_t y_dc_max_idx = 0, x_dc_max_idx = 0;
+        int32_t a = locs[k], b = locs[k + 1];
+        if (b - a <= 3) continue;
+        for (i = a; i < b; i++) {
+            if (ir[i] > x_dc_max) { x_dc_max = ir[i]; x_dc_max_idx = i; }
+            if (red[i] > y_dc_max) { y_dc_max = red[i]; y_dc_max_idx = i; }
+        }
+        int32_t y_ac = (red[b] - red[a]) * (y_dc_max_idx - a);
+        y_ac = red[a] + y_ac / (b - a);
+        y_ac = red[y_dc_max_idx] - y_ac;
+        int32_t x_ac = (ir[b] - ir[a]) * (x_dc_max_idx - a);
+        x_ac = ir[a] + x_ac / (b - a);
+        x_ac = ir[y_dc_max_idx] - x_ac;
+        int32_t nume = (y_ac * x_dc_max) >> 7;
+        int32_t denom = (x_ac * y_dc_max) >> 7;
+        if (denom > 0 && nratio < 5 && nume != 0) {
+            ratio[nratio++] = (nume * 100) / denom;
+        }
+    }
+    maxim_sort_ascend(ratio, nratio);
+    int32_t mid = nratio / 2;
+    int32_t ratio_average = mid > 1 ? (ratio[mid - 1] + ratio[mid]) / 2 : ratio[mid];
+    if (ratio_average > 2 && ratio_average < 184) {
+        result->spo2 = uch_spo2_table[ratio_average];
+        result->spo2_valid = true;
+    }
+    return true;
+}
@@ -0,0 +1,71 @@
+#ifndef PUBLISH_POLICY_H
+#define PUBLISH_POLICY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    #define PUBLISH_PENDING_MAX 16   // QoS > 0 publishes awaiting their ack
+
+    // When a reading of a topic goes out
+    typedef struct {
+        uint8_t qos;
+        bool retain;
+        bool change_only;         // skip readings within deadband of the last one sent
+        float deadband;           // 0 with change_only: any change is sent
+        uint32_t min_interval_ms; // readings closer than this to the last send are skipped
+        uint32_t max_interval_ms; // send anyway once this long has passed, 0 = never
+    } publish_policy_t;
+
+    typedef struct {
+        uint32_t published;   // handed to the MQTT client
+        uint32_t suppressed;  // skipped by the policy
+        uint32_t acked;       // PUBACK/PUBCOMP received
+        uint32_t failed;      // dropped from the outbox unacknowledged
+    } publish_stats_t;
+
+    typedef struct {
+        const char *topic;
+        publish_policy_t policy;
+        publish_stats_t stats;
+        bool has_last;
+        float last_value;
+        uint32_t last_ms;
+    } publish_topic_t;
+
+    // Policy state of a set of topics. Not thread safe; the caller provides locking.
+    typedef struct {
+        publish_topic_t *topics;
+        int count;
+        struct {
+            int msg_id;
+            int16_t topic;
+        } pending[PUBLISH_PENDING_MAX];
+        uint8_t pending_next;
+    } publish_table_t;
+
+    // topics[] holds topic and policy; stats and history are cleared
+    void publish_table_init(publish_table_t *table, publish_topic_t *topics, int count);
+
+    // True if the reading should be sent, otherwise counts it as suppressed.
+    // A reading that passes is taken as the new reference for the deadband.
+    bool publish_policy_check(publish_table_t *table, int topic, float value, uint32_t now_ms);
+
+    // Count a publish. msg_id > 0 (QoS > 0) is remembered until acked or
+    // failed; the oldest pending id is forgotten when more than
+    // PUBLISH_PENDING_MAX are outstanding.
+    void publish_policy_published(publish_table_t *table, int topic, int msg_id);
+
+    // Broker acknowledgement (MQTT_EVENT_PUBLISHED) or outbox expiry
+    // (MQTT_EVENT_DELETED). Returns the topic index, -1 for an unknown id.
+    int publish_policy_acked(publish_table_t *table, int msg_id);
+    int publish_policy_failed(publish_table_t *table, int msg_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PUBLISH_POLICY_H
@@ -0,0 +1,82 @@
+#include "publish_policy.h"
+#include <math.h>
+#include <string.h>
+
+void publish_table_init(publish_table_t *table, publish_topic_t *topics, int count)
+{
+    memset(table, 0, sizeof(*table));
+    table->topics = topics;
+    table->count = count;
+    for (int i = 0; i < count; i++) {
+        memset(&topics[i].stats, 0, sizeof(topics[i].stats));
+        topics[i].has_last = false;
+    }
+    for (int i = 0; i < PUBLISH_PENDING_MAX; i++) {
+        table->pending[i].topic = -1;
+    }
+}
+
+bool publish_policy_check(publish_table_t *table, int topic, float value, uint32_t now_ms)
+{
+    if (topic < 0 || topic >= table->count) return false;
+    publish_topic_t *t = &table->topics[topic];
+    const publish_policy_t *p = &t->policy;
+
+    bool send = true;
+    if (t->has_last) {
+        uint32_t since = now_ms - t->last_ms;
+        if (p->max_interval_ms && since >= p->max_interval_ms) {
+            send = true;
+        } else if (since < p->min_interval_ms) {
+            send = false;
+        } else if (p->change_only) {
+            float delta = fabsf(value - t->last_value);
+            send = p->deadband > 0 ? delta >= p->deadband : delta > 0;
+        }
+    }
+
+    if (!send) {
+        t->stats.suppressed++;
+        return false;
+    }
+    t->has_last = true;
+    t->last_value = value;
+    t->last_ms = now_ms;
+    return true;
+}
+
+void publish_policy_published(publish_table_t *table, int topic, int msg_id)
+{
+    if (topic < 0 || topic >= table->count) return;
+    table->topics[topic].stats.published++;
+    if (msg_id <= 0) return;
+    table->pending[table->pending_next].msg_id = msg_id;
+    table->pending[table->pending_next].topic = (int16_t)topic;
+    table->pending_next = (table->pending_next + 1) % PUBLISH_PENDING_MAX;
+}
+
+static int take_pending(publish_table_t *table, int msg_id)
+{
+    for (int i = 0; i < PUBLISH_PENDING_MAX; i++) {
+        if (table->pending[i].topic >= 0 && table->pending[i].msg_id == msg_id) {
+            int topic = table->pending[i].topic;
+            table->pending[i].topic = -1;
+            return topic;
+        }
+    }
+    return -1;
+}
+
+int publish_policy_acked(publish_table_t *table, int msg_id)
+{
+    int topic = take_pending(table, msg_id);
+    if (topic >= 0) table->topics[topic].stats.acked++;
+    return topic;
+}
+
+int publish_policy_failed(publish_table_t *table, int msg_id)
+{
+    int topic = take_pending(table, msg_id);
+    if (topic >= 0) table->topics[topic].stats.failed++;
+    return topic;
+}
@@ -0,0 +1,79 @@
+#ifndef SENSOR_SCHED_H
+#define SENSOR_SCHED_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    #define SENSOR_SCHED_MAX 12
+
+    // A sensor as the scheduler sees it. sample() must not block: it takes
+    // what a background reader (DMA, RMT, ISR) already has, or starts a
+    // transfer and picks up the result next period.
+    typedef struct {
+        const char *name;
+        uint32_t period_ms;
+        uint32_t offset_ms;                           // first run after start, spreads drivers out
+        esp_err_t (*init)(void *ctx);                 // optional
+        esp_err_t (*sample)(void *ctx);
+        int (*format)(void *ctx, char *buf, size_t len); // optional: last value as JSON members
+        void *ctx;
+    } sensor_driver_t;
+
+    typedef struct {
+        uint32_t runs;
+        uint32_t errors;          // sample() returned an error
+        uint32_t overruns;        // periods skipped because a run started a period or more late
+        uint32_t late_max_us;     // start time - deadline
+        uint64_t late_sum_us;
+        uint32_t exec_max_us;
+        uint64_t exec_sum_us;
+        esp_err_t last_err;
+    } sensor_stats_t;
+
+    typedef struct {
+        const sensor_driver_t *driver;
+        int64_t deadline_us;
+        sensor_stats_t stats;
+    } sensor_slot_t;
+
+    typedef int64_t (*sensor_clock_t)(void);
+
+    // Runs each driver at its own period, earliest deadline first, from one
+    // task. Deadlines advance by whole periods from the start time, so a late
+    // run does not shift the ones after it. Not thread safe.
+    typedef struct {
+        sensor_slot_t slots[SENSOR_SCHED_MAX];
+        int count;
+        sensor_clock_t clock;     // microseconds, e.g. esp_timer_get_time
+    } sensor_sched_t;
+
+    void sensor_sched_init(sensor_sched_t *s, sensor_clock_t clock);
+
+    // Returns the driver's id, or -1 if the table is full or the period is 0
+    int sensor_sched_add(sensor_sched_t *s, const sensor_driver_t *driver);
+
+    // Calls init() of every driver and sets the first deadlines. Drivers whose
+    // init fails stay registered and are counted as errors; the first failure
+    // is returned.
+    esp_err_t sensor_sched_start(sensor_sched_t *s);
+
+    // Run every driver that is due, each at most once. Returns microseconds
+    // until the next deadline (0 if one is already due again).
+    int64_t sensor_sched_run(sensor_sched_t *s);
+
+    const sensor_stats_t *sensor_sched_stats(const sensor_sched_t *s, int id);
+    void sensor_sched_reset_stats(sensor_sched_t *s);
+
+    // "name": {value members} of a driver, or 0 if it has no format()
+    int sensor_sched_format(const sensor_sched_t *s, int id, char *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SENSOR_SCHED_H
@@ -0,0 +1,115 @@
+#include "sensor_sched.h"
+#include <stdio.h>
+#include <string.h>
+#include "trace.h"
+
+void sensor_sched_init(sensor_sched_t *s, sensor_clock_t clock)
+{
+    memset(s, 0, sizeof(*s));
+    s->clock = clock;
+}
+
+int sensor_sched_add(sensor_sched_t *s, const sensor_driver_t *driver)
+{
+    if (s->count >= SENSOR_SCHED_MAX || driver->period_ms == 0 || driver->sample == NULL) return -1;
+    s->slots[s->count].driver = driver;
+    return s->count++;
+}
+
+esp_err_t sensor_sched_start(sensor_sched_t *s)
+{
+    esp_err_t first = ESP_OK;
+    int64_t now = s->clock();
+    for (int i = 0; i < s->count; i++) {
+        sensor_slot_t *slot = &s->slots[i];
+        const sensor_driver_t *d = slot->driver;
+        memset(&slot->stats, 0, sizeof(slot->stats));
+        slot->deadline_us = now + (int64_t)d->offset_ms * 1000;
+        esp_err_t err = d->init ? d->init(d->ctx) : ESP_OK;
+        if (err != ESP_OK) {
+            slot->stats.errors++;
+            slot->stats.last_err = err;
+            if (first == ESP_OK) first = err;
+        }
+    }
+    return first;
+}
+
+static sensor_slot_t *earliest(sensor_sched_t *s)
+{
+    sensor_slot_t *next = NULL;
+    for (int i = 0; i < s->count; i++) {
+        if (next == NULL || s->slots[i].deadline_us < next->deadline_us) next = &s->slots[i];
+    }
+    return next;
+}
+
+static void run_slot(sensor_sched_t *s, sensor_slot_t *slot, int64_t start)
+{
+    const sensor_driver_t *d = slot->driver;
+    sensor_stats_t *st = &slot->stats;
+    int64_t period = (int64_t)d->period_ms * 1000;
+
+    uint32_t late = (uint32_t)(start - slot->deadline_us);
+    st->late_sum_us += late;
+    if (late > st->late_max_us) st->late_max_us = late;
+
+    trace_span_t span = trace_begin("sensor", d->name);
+    esp_err_t err = d->sample(d->ctx);
+    trace_end(&span);
+    int64_t exec = s->clock() - start;
+    st->runs++;
+    st->exec_sum_us += exec;
+    if (exec > st->exec_max_us) st->exec_max_us = (uint32_t)exec;
+    if (err != ESP_OK) {
+        st->errors++;
+        st->last_err = err;
+    }
+
+    // next deadline in the future on the original grid; the periods jumped
+    // over were never sampled
+    int64_t skipped = late / period;
+    st->overruns += (uint32_t)skipped;
+    slot->deadline_us += (skipped + 1) * period;
+}
+
+int64_t sensor_sched_run(sensor_sched_t *s)
+{
+    // only what is due on entry: a run moves its deadline past its start, so
+    // each driver runs at most once per call even when the drivers together
+    // need more time than they are given
+    int64_t entry = s->clock();
+    while (1) {
+        sensor_slot_t *slot = earliest(s);
+        if (slot == NULL) return INT32_MAX;
+        int64_t now = s->clock();
+        if (slot->deadline_us > entry) return slot->deadline_us > now ? slot->deadline_us - now : 0;
+        run_slot(s, slot, now);
+    }
+}
+
+const sensor_stats_t *sensor_sched_stats(const sensor_sched_t *s, int id)
+{
+    return id >= 0 && id < s->count ? &s->slots[id].stats : NULL;
+}
+
+void sensor_sched_reset_stats(sensor_sched_t *s)
+{
+    for (int i = 0; i < s->count; i++) {
+        memset(&s->slots[i].stats, 0, sizeof(s->slots[i].stats));
+    }
+}
+
+int sensor_sched_format(const sensor_sched_t *s, int id, char *buf, size_t len)
+{
+    if (id < 0 || id >= s->count || len == 0) return 0;
+    const sensor_driver_t *d = s->slots[id].driver;
+    if (d->format == NULL) return 0;
+    int n = snprintf(buf, len, "\"%s\":{", d->name);
+    if (n < 0 || (size_t)n >= len) return 0;
+    int m = d->format(d->ctx, buf + n, len - n);
+    if (m < 0 || (size_t)(n + m + 1) >= len) return 0;
+    buf[n + m] = '}';
+    buf[n + m + 1] = '\0';
+    return n + m + 1;
+}
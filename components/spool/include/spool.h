@@ -0,0 +1,85 @@
+#ifndef SPOOL_H
+#define SPOOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // Flash-like storage: erased bytes read 0xFF, erase works on whole sectors
+    typedef struct {
+        void *ctx;
+        size_t size;          // multiple of sector_size
+        size_t sector_size;
+        esp_err_t (*read)(void *ctx, size_t offset, void *buf, size_t len);
+        esp_err_t (*write)(void *ctx, size_t offset, const void *buf, size_t len);
+        esp_err_t (*erase)(void *ctx, size_t offset, size_t len);
+    } spool_storage_t;
+
+    // Data partition by label (ESP-IDF builds only)
+    esp_err_t spool_storage_partition(spool_storage_t *storage, const char *label);
+
+    // Plain file emulating a flash partition, created and erased if missing
+    esp_err_t spool_storage_file(spool_storage_t *storage, const char *path, size_t size, size_t sector_size);
+    void spool_storage_file_close(spool_storage_t *storage);
+
+    #define SPOOL_MAX_RECORD 512
+
+    typedef struct {
+        uint32_t appended;
+        uint32_t replayed;    // consumed after a successful upload
+        uint32_t dropped;     // overwritten before they could be replayed
+        uint32_t corrupt;     // failed CRC (e.g. torn by a power cut)
+        uint32_t erases;
+    } spool_stats_t;
+
+    // Read position; sectors are identified by sequence number so a position
+    // stays meaningful after its sector has been recycled.
+    typedef struct {
+        uint32_t seq;
+        uint16_t sector;
+        uint32_t offset;
+    } spool_pos_t;
+
+    // Append-only record log over a ring of sectors. Sectors are written and
+    // erased in turn, so erase wear is spread evenly over the partition. When
+    // the ring is full the oldest sector is recycled and its records dropped.
+    // Not thread safe; the caller provides locking.
+    typedef struct {
+        spool_storage_t storage;
+        uint16_t sectors;
+        spool_pos_t head;     // next append
+        spool_pos_t tail;     // oldest record not yet consumed
+        uint32_t pending;     // records between tail and head
+        spool_stats_t stats;
+    } spool_t;
+
+    // Scan the storage and recover head/tail; blank or foreign storage is formatted.
+    esp_err_t spool_open(spool_t *sp, const spool_storage_t *storage);
+
+    esp_err_t spool_append(spool_t *sp, const void *data, size_t len);
+
+    // Read the record at *pos (start from spool_tail()) and advance *pos.
+    // Returns ESP_ERR_NOT_FOUND at the end of the log and ESP_ERR_INVALID_SIZE
+    // if the record does not fit in buf (pos is not advanced).
+    esp_err_t spool_read(spool_t *sp, spool_pos_t *pos, void *buf, size_t size, size_t *len);
+
+    // Mark every record before pos as consumed
+    esp_err_t spool_consume(spool_t *sp, const spool_pos_t *pos);
+
+    // Drop everything and start over
+    esp_err_t spool_format(spool_t *sp);
+
+    spool_pos_t spool_tail(const spool_t *sp);
+    uint32_t spool_pending(const spool_t *sp);
+    void spool_get_stats(const spool_t *sp, spool_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SPOOL_H
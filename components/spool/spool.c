@@ -0,0 +1,286 @@
+#include "spool.h"
+#include <string.h>
+
+// Sector: 16-byte header, then records back to back.
+// Record: 8-byte header, payload, 0xFF padding to 4 bytes.
+#define SECTOR_MAGIC    0x4C4F5053u   // "SPOL"
+#define SECTOR_HDR_SIZE 16
+#define REC_MAGIC       0xA5
+#define REC_HDR_SIZE    8
+#define REC_LIVE        0xFF          // as written; flash can clear bits without an erase
+#define REC_CONSUMED    0x00
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t crc;       // over magic and seq
+    uint32_t reserved;
+} sector_hdr_t;
+
+typedef struct {
+    uint16_t len;
+    uint8_t state;
+    uint8_t magic;
+    uint32_t crc;       // over the payload
+} rec_hdr_t;
+
+_Static_assert(sizeof(sector_hdr_t) == SECTOR_HDR_SIZE, "sector header size");
+_Static_assert(sizeof(rec_hdr_t) == REC_HDR_SIZE, "record header size");
+
+#define ALIGN4(x) (((x) + 3u) & ~3u)
+
+static uint32_t crc32(uint32_t crc, const void *data, size_t len) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    const uint8_t *p = data;
+    crc = ~crc;
+    while (len--) {
+        crc = (crc >> 4) ^ table[(crc ^ *p) & 0x0F];
+        crc = (crc >> 4) ^ table[(crc ^ (*p++ >> 4)) & 0x0F];
+    }
+    return ~crc;
+}
+
+static size_t sector_base(const spool_t *sp, uint16_t sector) {
+    return (size_t)sector * sp->storage.sector_size;
+}
+
+static bool pos_before(const spool_pos_t *a, const spool_pos_t *b) {
+    return a->seq < b->seq || (a->seq == b->seq && a->offset < b->offset);
+}
+
+static void next_sector(const spool_t *sp, spool_pos_t *pos) {
+    pos->seq++;
+    pos->sector = (pos->sector + 1) % sp->sectors;
+    pos->offset = SECTOR_HDR_SIZE;
+}
+
+static bool read_sector_hdr(const spool_t *sp, uint16_t sector, uint32_t *seq) {
+    sector_hdr_t hdr;
+    if (sp->storage.read(sp->storage.ctx, sector_base(sp, sector), &hdr, sizeof(hdr)) != ESP_OK) return false;
+    if (hdr.magic != SECTOR_MAGIC || hdr.crc != crc32(0, &hdr, 8)) return false;
+    *seq = hdr.seq;
+    return true;
+}
+
+static esp_err_t start_sector(spool_t *sp, uint16_t sector, uint32_t seq) {
+    esp_err_t err = sp->storage.erase(sp->storage.ctx, sector_base(sp, sector), sp->storage.sector_size);
+    if (err != ESP_OK) return err;
+    sp->stats.erases++;
+    sector_hdr_t hdr = { .magic = SECTOR_MAGIC, .seq = seq, .reserved = 0xFFFFFFFF };
+    hdr.crc = crc32(0, &hdr, 8);
+    return sp->storage.write(sp->storage.ctx, sector_base(sp, sector), &hdr, sizeof(hdr));
+}
+
+// ESP_OK: a record starts at pos. ESP_ERR_NOT_FOUND: erased space, nothing
+// more in this sector. ESP_ERR_INVALID_STATE: unreadable header, the rest of
+// the sector cannot be used.
+static esp_err_t record_at(const spool_t *sp, const spool_pos_t *pos, rec_hdr_t *hdr) {
+    if (pos->offset + REC_HDR_SIZE > sp->storage.sector_size) return ESP_ERR_NOT_FOUND;
+    esp_err_t err = sp->storage.read(sp->storage.ctx, sector_base(sp, pos->sector) + pos->offset, hdr, sizeof(*hdr));
+    if (err != ESP_OK) return err;
+    if (hdr->len == 0xFFFF && hdr->state == 0xFF && hdr->magic == 0xFF) return ESP_ERR_NOT_FOUND;
+    if (hdr->magic != REC_MAGIC || hdr->len == 0 || hdr->len > SPOOL_MAX_RECORD ||
+        pos->offset + REC_HDR_SIZE + ALIGN4(hdr->len) > sp->storage.sector_size) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return ESP_OK;
+}
+
+static uint32_t rec_size(const rec_hdr_t *hdr) {
+    return REC_HDR_SIZE + ALIGN4(hdr->len);
+}
+
+static esp_err_t mark_consumed(spool_t *sp, const spool_pos_t *pos) {
+    uint8_t state = REC_CONSUMED;
+    return sp->storage.write(sp->storage.ctx, sector_base(sp, pos->sector) + pos->offset + 2, &state, 1);
+}
+
+// Count live records from pos to the end of its sector
+static uint32_t count_live(const spool_t *sp, spool_pos_t pos, spool_pos_t *first_live) {
+    uint32_t live = 0;
+    rec_hdr_t hdr;
+    while (record_at(sp, &pos, &hdr) == ESP_OK) {
+        if (hdr.state == REC_LIVE) {
+            if (live == 0 && first_live) *first_live = pos;
+            live++;
+        }
+        pos.offset += rec_size(&hdr);
+    }
+    return live;
+}
+
+// Move the head into the next sector, recycling the oldest one if the ring is full
+static esp_err_t advance_head(spool_t *sp) {
+    spool_pos_t next = sp->head;
+    next_sector(sp, &next);
+    if (sp->pending > 0 && next.seq - sp->tail.seq >= sp->sectors) {
+        uint32_t lost = count_live(sp, sp->tail, NULL);
+        sp->stats.dropped += lost;
+        sp->pending -= lost;
+        next_sector(sp, &sp->tail);
+    }
+    esp_err_t err = start_sector(sp, next.sector, next.seq);
+    if (err != ESP_OK) return err;
+    sp->head = next;
+    if (sp->pending == 0) sp->tail = sp->head;
+    return ESP_OK;
+}
+
+esp_err_t spool_format(spool_t *sp) {
+    uint32_t seq = 0;
+    for (uint16_t s = 0; s < sp->sectors; s++) {
+        uint32_t sector_seq;
+        if (read_sector_hdr(sp, s, &sector_seq)) {
+            if (sector_seq > seq) seq = sector_seq;
+            esp_err_t err = sp->storage.erase(sp->storage.ctx, sector_base(sp, s), sp->storage.sector_size);
+            if (err != ESP_OK) return err;
+            sp->stats.erases++;
+        }
+    }
+    // Keep sequence numbers increasing across formats
+    sp->head = (spool_pos_t) { .seq = seq + 1, .sector = 0, .offset = SECTOR_HDR_SIZE };
+    sp->tail = sp->head;
+    sp->pending = 0;
+    return start_sector(sp, 0, sp->head.seq);
+}
+
+esp_err_t spool_open(spool_t *sp, const spool_storage_t *storage) {
+    memset(sp, 0, sizeof(*sp));
+    sp->storage = *storage;
+    if (storage->sector_size < SECTOR_HDR_SIZE + REC_HDR_SIZE + SPOOL_MAX_RECORD) return ESP_ERR_INVALID_ARG;
+    sp->sectors = storage->size / storage->sector_size;
+    if (sp->sectors < 2) return ESP_ERR_INVALID_ARG;
+
+    bool found = false;
+    for (uint16_t s = 0; s < sp->sectors; s++) {
+        uint32_t seq;
+        if (read_sector_hdr(sp, s, &seq) && (!found || seq > sp->head.seq)) {
+            sp->head = (spool_pos_t) { .seq = seq, .sector = s, .offset = SECTOR_HDR_SIZE };
+            found = true;
+        }
+    }
+    if (!found) return spool_format(sp);
+
+    // Walk the ring from the oldest sector that belongs to this log
+    bool have_tail = false;
+    for (int k = sp->sectors - 1; k >= 0; k--) {
+        spool_pos_t pos = {
+            .seq = sp->head.seq - k,
+            .sector = (sp->head.sector + sp->sectors - k) % sp->sectors,
+            .offset = SECTOR_HDR_SIZE,
+        };
+        uint32_t seq;
+        if (k > (int)sp->head.seq - 1 || !read_sector_hdr(sp, pos.sector, &seq) || seq != pos.seq) continue;
+        spool_pos_t first;
+        uint32_t live = count_live(sp, pos, &first);
+        if (live > 0 && !have_tail) {
+            sp->tail = first;
+            have_tail = true;
+        }
+        sp->pending += live;
+    }
+
+    // Find the end of the head sector
+    rec_hdr_t hdr;
+    esp_err_t err;
+    while ((err = record_at(sp, &sp->head, &hdr)) == ESP_OK) {
+        sp->head.offset += rec_size(&hdr);
+    }
+    if (!have_tail) sp->tail = sp->head;
+    if (err == ESP_ERR_INVALID_STATE) {
+        // Torn write: never append on top of it
+        return advance_head(sp);
+    }
+    return ESP_OK;
+}
+
+esp_err_t spool_append(spool_t *sp, const void *data, size_t len) {
+    if (len == 0 || len > SPOOL_MAX_RECORD) return ESP_ERR_INVALID_SIZE;
+    rec_hdr_t hdr = { .len = len, .state = REC_LIVE, .magic = REC_MAGIC, .crc = crc32(0, data, len) };
+    if (sp->head.offset + rec_size(&hdr) > sp->storage.sector_size) {
+        esp_err_t err = advance_head(sp);
+        if (err != ESP_OK) return err;
+    }
+
+    // Header first: a record cut short by a reset then fails its CRC
+    size_t at = sector_base(sp, sp->head.sector) + sp->head.offset;
+    esp_err_t err = sp->storage.write(sp->storage.ctx, at, &hdr, sizeof(hdr));
+    if (err == ESP_OK) err = sp->storage.write(sp->storage.ctx, at + REC_HDR_SIZE, data, len);
+    // Space is used even if the write failed part way
+    sp->head.offset += rec_size(&hdr);
+    if (err != ESP_OK) return err;
+    sp->pending++;
+    sp->stats.appended++;
+    return ESP_OK;
+}
+
+esp_err_t spool_read(spool_t *sp, spool_pos_t *pos, void *buf, size_t size, size_t *len) {
+    if (pos_before(pos, &sp->tail)) *pos = sp->tail; // older records were recycled meanwhile
+
+    while (pos_before(pos, &sp->head)) {
+        rec_hdr_t hdr;
+        esp_err_t err = record_at(sp, pos, &hdr);
+        if (err == ESP_ERR_NOT_FOUND || err == ESP_ERR_INVALID_STATE) {
+            next_sector(sp, pos);
+            continue;
+        }
+        if (err != ESP_OK) return err;
+        if (hdr.state != REC_LIVE) {
+            pos->offset += rec_size(&hdr);
+            continue;
+        }
+        if (hdr.len > size) return ESP_ERR_INVALID_SIZE;
+
+        err = sp->storage.read(sp->storage.ctx, sector_base(sp, pos->sector) + pos->offset + REC_HDR_SIZE, buf, hdr.len);
+        if (err != ESP_OK) return err;
+        if (crc32(0, buf, hdr.len) != hdr.crc) {
+            // Retire it now so it is not counted as pending again
+            mark_consumed(sp, pos);
+            sp->stats.corrupt++;
+            sp->pending--;
+            pos->offset += rec_size(&hdr);
+            continue;
+        }
+        pos->offset += rec_size(&hdr);
+        *len = hdr.len;
+        return ESP_OK;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t spool_consume(spool_t *sp, const spool_pos_t *pos) {
+    while (sp->pending > 0 && pos_before(&sp->tail, pos)) {
+        rec_hdr_t hdr;
+        esp_err_t err = record_at(sp, &sp->tail, &hdr);
+        if (err == ESP_ERR_NOT_FOUND || err == ESP_ERR_INVALID_STATE) {
+            if (sp->tail.seq == sp->head.seq) break;
+            next_sector(sp, &sp->tail);
+            continue;
+        }
+        if (err != ESP_OK) return err;
+        if (hdr.state == REC_LIVE) {
+            err = mark_consumed(sp, &sp->tail);
+            if (err != ESP_OK) return err;
+            sp->pending--;
+            sp->stats.replayed++;
+        }
+        sp->tail.offset += rec_size(&hdr);
+    }
+    if (sp->pending == 0) sp->tail = sp->head;
+    return ESP_OK;
+}
+
+spool_pos_t spool_tail(const spool_t *sp) {
+    return sp->tail;
+}
+
+uint32_t spool_pending(const spool_t *sp) {
+    return sp->pending;
+}
+
+void spool_get_stats(const spool_t *sp, spool_stats_t *stats) {
+    *stats = sp->stats;
+}
@@ -0,0 +1,58 @@
+#include "spool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// File-backed storage for host tests, or a VFS file on the device
+
+static esp_err_t file_read(void *ctx, size_t offset, void *buf, size_t len) {
+    FILE *f = ctx;
+    if (fseek(f, offset, SEEK_SET) != 0 || fread(buf, 1, len, f) != len) return ESP_FAIL;
+    return ESP_OK;
+}
+
+static esp_err_t file_write(void *ctx, size_t offset, const void *buf, size_t len) {
+    FILE *f = ctx;
+    if (fseek(f, offset, SEEK_SET) != 0 || fwrite(buf, 1, len, f) != len) return ESP_FAIL;
+    return ESP_OK;
+}
+
+static esp_err_t file_erase(void *ctx, size_t offset, size_t len) {
+    FILE *f = ctx;
+    uint8_t blank[256];
+    memset(blank, 0xFF, sizeof(blank));
+    if (fseek(f, offset, SEEK_SET) != 0) return ESP_FAIL;
+    while (len > 0) {
+        size_t n = len < sizeof(blank) ? len : sizeof(blank);
+        if (fwrite(blank, 1, n, f) != n) return ESP_FAIL;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+esp_err_t spool_storage_file(spool_storage_t *storage, const char *path, size_t size, size_t sector_size) {
+    if (sector_size == 0 || size % sector_size != 0) return ESP_ERR_INVALID_ARG;
+    FILE *f = fopen(path, "r+b");
+    if (f == NULL) {
+        f = fopen(path, "w+b");
+        if (f == NULL) return ESP_ERR_NOT_FOUND;
+        if (file_erase(f, 0, size) != ESP_OK) {
+            fclose(f);
+            return ESP_FAIL;
+        }
+    }
+    *storage = (spool_storage_t) {
+        .ctx = f,
+        .size = size,
+        .sector_size = sector_size,
+        .read = file_read,
+        .write = file_write,
+        .erase = file_erase,
+    };
+    return ESP_OK;
+}
+
+void spool_storage_file_close(spool_storage_t *storage) {
+    if (storage->ctx) fclose(storage->ctx);
+    storage->ctx = NULL;
+}
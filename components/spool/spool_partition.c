@@ -0,0 +1,29 @@
+#include "spool.h"
+#include "esp_partition.h"
+
+static esp_err_t part_read(void *ctx, size_t offset, void *buf, size_t len) {
+    return esp_partition_read(ctx, offset, buf, len);
+}
+
+static esp_err_t part_write(void *ctx, size_t offset, const void *buf, size_t len) {
+    return esp_partition_write(ctx, offset, buf, len);
+}
+
+static esp_err_t part_erase(void *ctx, size_t offset, size_t len) {
+    return esp_partition_erase_range(ctx, offset, len);
+}
+
+esp_err_t spool_storage_partition(spool_storage_t *storage, const char *label) {
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                           ESP_PARTITION_SUBTYPE_ANY, label);
+    if (part == NULL) return ESP_ERR_NOT_FOUND;
+    *storage = (spool_storage_t) {
+        .ctx = (void *)part,
+        .size = part->size - part->size % part->erase_size,
+        .sector_size = part->erase_size,
+        .read = part_read,
+        .write = part_write,
+        .erase = part_erase,
+    };
+    return ESP_OK;
+}
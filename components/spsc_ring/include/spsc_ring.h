@@ -0,0 +1,62 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    #define SPSC_CACHE_LINE 64
+
+    // Fixed-size items handed from one task to one other task by copy,
+    // without a lock or a critical section. Exactly one task pushes and
+    // exactly one task pops; not for ISRs. The producer writes only head,
+    // the consumer only tail, each on its own cache line next to a cached
+    // copy of the other index, so a batch costs two atomic loads at most.
+    typedef struct {
+        alignas(SPSC_CACHE_LINE) atomic_uint head;     // items pushed
+        unsigned tail_cache;                           // producer's last view of tail
+        alignas(SPSC_CACHE_LINE) atomic_uint tail;     // items popped
+        unsigned head_cache;                           // consumer's last view of head
+        alignas(SPSC_CACHE_LINE) _Atomic(TaskHandle_t) waiter;   // consumer parked in spsc_ring_wait()
+        uint8_t *buf;
+        uint32_t mask;
+        uint32_t item_size;
+    } spsc_ring_t;
+
+    // buf holds capacity items of item_size bytes; capacity is a power of
+    // two. False if it is not.
+    bool spsc_ring_init(spsc_ring_t *r, void *buf, size_t item_size, size_t capacity);
+
+    // Producer: copy in up to n items, as many as fit, and wake a consumer
+    // waiting in spsc_ring_wait(). Returns the number pushed; never blocks.
+    size_t spsc_ring_push(spsc_ring_t *r, const void *items, size_t n);
+
+    // Consumer: copy out up to max items, oldest first. Returns the number popped.
+    size_t spsc_ring_pop(spsc_ring_t *r, void *items, size_t max);
+
+    // Consumer: wait up to wait ticks for items. Parks on the calling task's
+    // notification count, so it can return false early if the task is also
+    // notified for other reasons; check the clock if that matters.
+    bool spsc_ring_wait(spsc_ring_t *r, TickType_t wait);
+
+    // Items waiting; exact on the consumer side, a snapshot anywhere else
+    size_t spsc_ring_count(const spsc_ring_t *r);
+
+    static inline size_t spsc_ring_capacity(const spsc_ring_t *r)
+    {
+        return r->mask + 1;
+    }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SPSC_RING_H
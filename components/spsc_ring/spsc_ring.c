@@ -0,0 +1,91 @@
+#include "spsc_ring.h"
+#include <string.h>
+
+bool spsc_ring_init(spsc_ring_t *r, void *buf, size_t item_size, size_t capacity)
+{
+    if (buf == NULL || item_size == 0 || capacity == 0 || (capacity & (capacity - 1)) != 0 ||
+        capacity > UINT32_MAX / 2) {
+        return false;
+    }
+    memset(r, 0, sizeof(*r));
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->waiter, NULL);
+    r->buf = buf;
+    r->mask = capacity - 1;
+    r->item_size = item_size;
+    return true;
+}
+
+// Copy n items between the ring, from index pos, and a flat array; at
+// most two pieces when the span wraps
+static void copy_ring(const spsc_ring_t *r, unsigned pos, uint8_t *flat, size_t n, bool into_ring)
+{
+    size_t at = pos & r->mask;
+    size_t first = n < spsc_ring_capacity(r) - at ? n : spsc_ring_capacity(r) - at;
+    uint8_t *slot = r->buf + at * r->item_size;
+    size_t first_bytes = first * r->item_size;
+    size_t rest_bytes = (n - first) * r->item_size;
+    if (into_ring) {
+        memcpy(slot, flat, first_bytes);
+        memcpy(r->buf, flat + first_bytes, rest_bytes);
+    } else {
+        memcpy(flat, slot, first_bytes);
+        memcpy(flat + first_bytes, r->buf, rest_bytes);
+    }
+}
+
+size_t spsc_ring_push(spsc_ring_t *r, const void *items, size_t n)
+{
+    unsigned head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    size_t cap = spsc_ring_capacity(r);
+    if (cap - (head - r->tail_cache) < n) {
+        r->tail_cache = atomic_load_explicit(&r->tail, memory_order_acquire);
+    }
+    size_t room = cap - (head - r->tail_cache);
+    if (n > room) n = room;
+    if (n == 0) return 0;
+
+    copy_ring(r, head, (uint8_t *)items, n, true);
+    atomic_store_explicit(&r->head, head + n, memory_order_release);
+
+    // Pairs with the fence in spsc_ring_wait(): either the consumer sees the
+    // new head before it parks, or this sees it parked
+    atomic_thread_fence(memory_order_seq_cst);
+    TaskHandle_t waiter = atomic_load_explicit(&r->waiter, memory_order_acquire);
+    if (waiter) xTaskNotifyGive(waiter);
+    return n;
+}
+
+size_t spsc_ring_pop(spsc_ring_t *r, void *items, size_t max)
+{
+    unsigned tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    if (r->head_cache - tail < max) {
+        r->head_cache = atomic_load_explicit(&r->head, memory_order_acquire);
+    }
+    size_t n = r->head_cache - tail;
+    if (n > max) n = max;
+    if (n == 0) return 0;
+
+    copy_ring(r, tail, items, n, false);
+    atomic_store_explicit(&r->tail, tail + n, memory_order_release);
+    return n;
+}
+
+size_t spsc_ring_count(const spsc_ring_t *r)
+{
+    unsigned tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    return atomic_load_explicit(&r->head, memory_order_acquire) - tail;
+}
+
+bool spsc_ring_wait(spsc_ring_t *r, TickType_t wait)
+{
+    if (spsc_ring_count(r) > 0) return true;
+    if (wait == 0) return false;
+
+    atomic_store_explicit(&r->waiter, xTaskGetCurrentTaskHandle(), memory_order_release);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (spsc_ring_count(r) == 0) ulTaskNotifyTake(pdTRUE, wait);
+    atomic_store_explicit(&r->waiter, NULL, memory_order_relaxed);
+    return spsc_ring_count(r) > 0;
+}
@@ -0,0 +1,69 @@
+#ifndef TELEMETRY_CODEC_H
+#define TELEMETRY_CODEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // Packed telemetry frame, all readings of one sampling cycle in one message.
+    // Little endian:
+    //   u8  version           TELEMETRY_CODEC_VERSION
+    //   u16 present           bit n set: field n follows
+    //   u32 device_id
+    //   u32 timestamp         unix seconds
+    //   u16 seq               frame counter, for loss detection
+    //   fields in telemetry_field_t order, fixed point, see telemetry_codec.c
+    // Decoders reject unknown versions; a new field needs a new version.
+    #define TELEMETRY_CODEC_VERSION 2   // 2: SpO2, present widened to u16
+    #define TELEMETRY_HEADER_SIZE   13
+    #define TELEMETRY_FRAME_MAX     (TELEMETRY_HEADER_SIZE + 14)
+
+    typedef enum {
+        TELEMETRY_LIGHT = 0,     // raw ADC value; JSON adds the derived voltage
+        TELEMETRY_MOTION,
+        TELEMETRY_CURRENT,       // A, 0.01 resolution
+        TELEMETRY_TEMPERATURE,   // degC, 0.1 resolution
+        TELEMETRY_HUMIDITY,      // %, 0.1 resolution
+        TELEMETRY_MOISTURE,
+        TELEMETRY_PUMP,
+        TELEMETRY_HEART_RATE,
+        TELEMETRY_SPO2,          // %
+        TELEMETRY_FIELD_COUNT
+    } telemetry_field_t;
+
+    typedef struct {
+        uint32_t device_id;
+        uint32_t timestamp;
+        uint16_t seq;
+        uint16_t present;
+        float value[TELEMETRY_FIELD_COUNT];
+    } telemetry_frame_t;
+
+    void telemetry_frame_init(telemetry_frame_t *frame, uint32_t device_id, uint32_t timestamp, uint16_t seq);
+    void telemetry_frame_set(telemetry_frame_t *frame, telemetry_field_t field, float value);
+    bool telemetry_frame_has(const telemetry_frame_t *frame, telemetry_field_t field);
+
+    // Returns the encoded length, 0 if buf is too small
+    size_t telemetry_encode(const telemetry_frame_t *frame, uint8_t *buf, size_t size);
+
+    // Values come back quantized to the field resolution. False on an unknown
+    // version or a length that does not match the present fields.
+    bool telemetry_decode(const uint8_t *buf, size_t len, telemetry_frame_t *frame);
+
+    // The JSON object the per-sensor topics carry, e.g. {"temperature":24.5}.
+    // Returns the snprintf length, or -1 if the field is not present.
+    int telemetry_field_json(const telemetry_frame_t *frame, telemetry_field_t field, char *buf, size_t size);
+
+    // Conversion for the light voltage in the JSON form. Defaults to a
+    // nominal 3.3 V full scale; the firmware installs its calibrated one.
+    void telemetry_set_light_volts(float (*raw_to_volts)(int raw));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TELEMETRY_CODEC_H
@@ -0,0 +1,141 @@
+#include "telemetry_codec.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// Wire encoding of each field. Values are multiplied by scale, rounded and
+// clamped to the integer type.
+typedef struct {
+    const char *key;
+    uint8_t bytes;
+    bool is_signed;
+    float scale;
+    uint8_t decimals;   // for the JSON form
+} field_spec_t;
+
+static const field_spec_t specs[TELEMETRY_FIELD_COUNT] = {
+    [TELEMETRY_LIGHT]       = { "light_value",     2, false, 1.0f,   0 },
+    [TELEMETRY_MOTION]      = { "motion_detected", 1, false, 1.0f,   0 },
+    [TELEMETRY_CURRENT]     = { "current",         2, false, 100.0f, 2 },
+    [TELEMETRY_TEMPERATURE] = { "temperature",     2, true,  10.0f,  1 },
+    [TELEMETRY_HUMIDITY]    = { "humidity",        2, false, 10.0f,  1 },
+    [TELEMETRY_MOISTURE]    = { "moisture",        2, false, 1.0f,   0 },
+    [TELEMETRY_PUMP]        = { "pump_state",      1, false, 1.0f,   0 },
+    [TELEMETRY_HEART_RATE]  = { "heart_rate",      1, false, 1.0f,   0 },
+    [TELEMETRY_SPO2]        = { "spo2",            1, false, 1.0f,   0 },
+};
+
+static float nominal_light_volts(int raw)
+{
+    return raw / 4095.0f * 3.3f;
+}
+
+static float (*light_volts)(int raw) = nominal_light_volts;
+
+void telemetry_set_light_volts(float (*raw_to_volts)(int raw))
+{
+    light_volts = raw_to_volts ? raw_to_volts : nominal_light_volts;
+}
+
+static void put_le(uint8_t *p, uint32_t v, int bytes)
+{
+    for (int i = 0; i < bytes; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint32_t get_le(const uint8_t *p, int bytes)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < bytes; i++) v |= (uint32_t)p[i] << (8 * i);
+    return v;
+}
+
+static uint32_t quantize(const field_spec_t *spec, float value)
+{
+    float q = roundf(value * spec->scale);
+    float bits = 8.0f * spec->bytes;
+    float hi = spec->is_signed ? ldexpf(1.0f, bits - 1) - 1 : ldexpf(1.0f, bits) - 1;
+    float lo = spec->is_signed ? -ldexpf(1.0f, bits - 1) : 0.0f;
+    if (!(q >= lo)) q = lo; // also catches NaN
+    if (q > hi) q = hi;
+    return (uint32_t)(int32_t)q;
+}
+
+static float dequantize(const field_spec_t *spec, uint32_t raw)
+{
+    int32_t v = (int32_t)raw;
+    if (spec->is_signed && (raw & (1u << (8 * spec->bytes - 1)))) {
+        v = (int32_t)(raw | ~((1u << (8 * spec->bytes)) - 1));
+    }
+    return v / spec->scale;
+}
+
+void telemetry_frame_init(telemetry_frame_t *frame, uint32_t device_id, uint32_t timestamp, uint16_t seq)
+{
+    memset(frame, 0, sizeof(*frame));
+    frame->device_id = device_id;
+    frame->timestamp = timestamp;
+    frame->seq = seq;
+}
+
+void telemetry_frame_set(telemetry_frame_t *frame, telemetry_field_t field, float value)
+{
+    if ((unsigned)field >= TELEMETRY_FIELD_COUNT) return;
+    frame->value[field] = value;
+    frame->present |= 1u << field;
+}
+
+bool telemetry_frame_has(const telemetry_frame_t *frame, telemetry_field_t field)
+{
+    return (unsigned)field < TELEMETRY_FIELD_COUNT && (frame->present & (1u << field));
+}
+
+size_t telemetry_encode(const telemetry_frame_t *frame, uint8_t *buf, size_t size)
+{
+    size_t len = TELEMETRY_HEADER_SIZE;
+    for (int f = 0; f < TELEMETRY_FIELD_COUNT; f++) {
+        if (frame->present & (1u << f)) len += specs[f].bytes;
+    }
+    if (len > size) return 0;
+
+    buf[0] = TELEMETRY_CODEC_VERSION;
+    put_le(buf + 1, frame->present, 2);
+    put_le(buf + 3, frame->device_id, 4);
+    put_le(buf + 7, frame->timestamp, 4);
+    put_le(buf + 11, frame->seq, 2);
+    uint8_t *p = buf + TELEMETRY_HEADER_SIZE;
+    for (int f = 0; f < TELEMETRY_FIELD_COUNT; f++) {
+        if (!(frame->present & (1u << f))) continue;
+        put_le(p, quantize(&specs[f], frame->value[f]), specs[f].bytes);
+        p += specs[f].bytes;
+    }
+    return len;
+}
+
+bool telemetry_decode(const uint8_t *buf, size_t len, telemetry_frame_t *frame)
+{
+    if (len < TELEMETRY_HEADER_SIZE || buf[0] != TELEMETRY_CODEC_VERSION) return false;
+    telemetry_frame_init(frame, get_le(buf + 3, 4), get_le(buf + 7, 4), (uint16_t)get_le(buf + 11, 2));
+    uint16_t present = (uint16_t)get_le(buf + 1, 2);
+    const uint8_t *p = buf + TELEMETRY_HEADER_SIZE;
+    const uint8_t *end = buf + len;
+    for (int f = 0; f < TELEMETRY_FIELD_COUNT; f++) {
+        if (!(present & (1u << f))) continue;
+        if (end - p < specs[f].bytes) return false;
+        telemetry_frame_set(frame, f, dequantize(&specs[f], get_le(p, specs[f].bytes)));
+        p += specs[f].bytes;
+    }
+    return p == end;
+}
+
+int telemetry_field_json(const telemetry_frame_t *frame, telemetry_field_t field, char *buf, size_t size)
+{
+    if (!telemetry_frame_has(frame, field)) return -1;
+    float v = frame->value[field];
+    if (field == TELEMETRY_LIGHT) {
+        return snprintf(buf, size, "{\"light_value\":%d,\"voltage\":%.2f}", (int)v, light_volts((int)v));
+    }
+    if (specs[field].decimals == 0) {
+        return snprintf(buf, size, "{\"%s\":%d}", specs[field].key, (int)lroundf(v));
+    }
+    return snprintf(buf, size, "{\"%s\":%.*f}", specs[field].key, specs[field].decimals, v);
+}
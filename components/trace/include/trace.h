@@ -0,0 +1,94 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#ifdef ESP_PLATFORM
+#include "esp_cpu.h"
+#else
+#include <time.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    #ifndef TRACE_RING_SIZE
+    #define TRACE_RING_SIZE 256       // spans kept per core, a power of two
+    #endif
+
+    // Span timestamps: CPU cycles on the device, nanoseconds on the host.
+    // 32 bits wrap after 17.9 s at 240 MHz (4.3 s on the host); the tick
+    // count taken with the start puts each span on the timeline.
+    static inline uint32_t trace_clock(void)
+    {
+#ifdef ESP_PLATFORM
+        return esp_cpu_get_cycle_count();
+#else
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+#endif
+    }
+
+    // trace_clock() units per microsecond
+    uint32_t trace_clock_per_us(void);
+
+    // An open span, on the caller's stack. cat and name must be static
+    // strings: the ring keeps the pointers.
+    typedef struct {
+        const char *cat;
+        const char *name;       // NULL while tracing is off: trace_end() ignores it
+        uint32_t start;
+        TickType_t tick;
+    } trace_span_t;
+
+    extern atomic_bool trace_on;
+
+    // Task context only (the tick count is read with xTaskGetTickCount)
+    static inline trace_span_t trace_begin(const char *cat, const char *name)
+    {
+        trace_span_t span = { cat, NULL, 0, 0 };
+        if (atomic_load_explicit(&trace_on, memory_order_relaxed)) {
+            span.name = name;
+            span.tick = xTaskGetTickCount();
+            span.start = trace_clock();
+        }
+        return span;
+    }
+
+    // Close the span on the calling task's row of the timeline
+    void trace_end(const trace_span_t *span);
+    // Close a span that was not one stretch of one task (an HTTP request
+    // the engine advances in steps); it gets a row of its own named track
+    void trace_end_on(const trace_span_t *span, const char *track);
+
+    // Record a span timed by the caller; task NULL with a track as above
+    void trace_record(const char *cat, const char *name, uint32_t start, uint32_t cycles, TickType_t tick,
+                      TaskHandle_t task, const char *track);
+
+    // Recording starts on. Turning it off keeps what is in the rings, e.g.
+    // to hold the spans around an overrun until they are dumped.
+    void trace_set_enabled(bool enabled);
+    bool trace_enabled(void);
+    void trace_reset(void);
+
+    // Receives the export in pieces; false stops it
+    typedef bool (*trace_write_t)(const char *data, size_t len, void *ctx);
+
+    // Write the rings as Chrome trace JSON (chrome://tracing, Perfetto):
+    // one complete event per span, one process per core, one thread per
+    // task or track. Times are microseconds since boot. Recording pauses
+    // during the export. Returns the number of spans written, -1 if the
+    // writer gave up.
+    int trace_export_chrome(trace_write_t write, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACE_H
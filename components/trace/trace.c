@@ -0,0 +1,264 @@
+#include "trace.h"
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+_Static_assert((TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)) == 0, "TRACE_RING_SIZE must be a power of two");
+
+#define TRACE_THREADS 32        // distinct tasks and tracks named in one export
+
+typedef struct {
+    atomic_uint seq;            // reservation number + 1 once written, 0 while being written
+    const char *cat;
+    const char *name;
+    const void *owner;          // TaskHandle_t, or the track name
+    uint32_t start;
+    uint32_t cycles;
+    TickType_t tick;
+    bool track;
+} trace_event_t;
+
+// One ring per core: tasks that preempt each other on a core, and ISRs
+// that fall back to trace_record(), reserve slots with one atomic add, so
+// recording never blocks and the oldest spans are overwritten
+typedef struct {
+    atomic_uint head;
+    trace_event_t events[TRACE_RING_SIZE];
+} trace_ring_t;
+
+atomic_bool trace_on = true;
+static trace_ring_t rings[portNUM_PROCESSORS];
+
+uint32_t trace_clock_per_us(void)
+{
+#ifdef ESP_PLATFORM
+    return CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+#else
+    return 1000;
+#endif
+}
+
+void trace_record(const char *cat, const char *name, uint32_t start, uint32_t cycles, TickType_t tick,
+                  TaskHandle_t task, const char *track)
+{
+    if (!atomic_load_explicit(&trace_on, memory_order_relaxed)) return;
+    trace_ring_t *r = &rings[xPortGetCoreID()];
+    unsigned n = atomic_fetch_add_explicit(&r->head, 1, memory_order_relaxed);
+    trace_event_t *e = &r->events[n & (TRACE_RING_SIZE - 1)];
+
+    atomic_store_explicit(&e->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    e->cat = cat;
+    e->name = name;
+    e->owner = task ? (const void *)task : (const void *)track;
+    e->track = task == NULL;
+    e->start = start;
+    e->cycles = cycles;
+    e->tick = tick;
+    atomic_store_explicit(&e->seq, n + 1, memory_order_release);
+}
+
+void trace_end(const trace_span_t *span)
+{
+    if (span->name == NULL) return;
+    uint32_t end = trace_clock();
+    trace_record(span->cat, span->name, span->start, end - span->start, span->tick,
+                 xTaskGetCurrentTaskHandle(), NULL);
+}
+
+void trace_end_on(const trace_span_t *span, const char *track)
+{
+    if (span->name == NULL) return;
+    uint32_t end = trace_clock();
+    trace_record(span->cat, span->name, span->start, end - span->start, span->tick, NULL, track);
+}
+
+void trace_set_enabled(bool enabled)
+{
+    atomic_store(&trace_on, enabled);
+}
+
+bool trace_enabled(void)
+{
+    return atomic_load(&trace_on);
+}
+
+void trace_reset(void)
+{
+    for (int c = 0; c < portNUM_PROCESSORS; c++) {
+        for (int i = 0; i < TRACE_RING_SIZE; i++) atomic_store(&rings[c].events[i].seq, 0);
+        atomic_store(&rings[c].head, 0);
+    }
+}
+
+// Copy of slot i of ring r if it holds one of the last TRACE_RING_SIZE
+// reservations and was not being rewritten meanwhile
+static bool read_event(trace_ring_t *r, unsigned i, trace_event_t *out)
+{
+    trace_event_t *e = &r->events[i & (TRACE_RING_SIZE - 1)];
+    unsigned seq = atomic_load_explicit(&e->seq, memory_order_acquire);
+    if (seq != i + 1) return false;
+    out->cat = e->cat;
+    out->name = e->name;
+    out->owner = e->owner;
+    out->track = e->track;
+    out->start = e->start;
+    out->cycles = e->cycles;
+    out->tick = e->tick;
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&e->seq, memory_order_relaxed) == seq;
+}
+
+// The 32-bit start of e on the cycle count of the reference span: the tick
+// counts say about how far apart they are, the low 32 bits say exactly
+static int64_t unwrap(const trace_event_t *e, const trace_event_t *ref, int64_t per_ms)
+{
+    int64_t est = (int64_t)(int32_t)(e->tick - ref->tick) * portTICK_PERIOD_MS * per_ms;
+    return est + (int32_t)((uint32_t)(e->start - ref->start) - (uint32_t)est);
+}
+
+typedef struct {
+    trace_write_t write;
+    void *ctx;
+    bool failed;
+    size_t len;
+    char buf[512];
+} out_t;
+
+static void flush(out_t *o)
+{
+    if (o->len && !o->failed && !o->write(o->buf, o->len, o->ctx)) o->failed = true;
+    o->len = 0;
+}
+
+static void emit(out_t *o, const char *fmt, ...)
+{
+    char line[224];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (n < 0) return;
+    if ((size_t)n >= sizeof(line)) n = sizeof(line) - 1;
+    if (o->len + n > sizeof(o->buf)) flush(o);
+    memcpy(o->buf + o->len, line, n);
+    o->len += n;
+}
+
+typedef struct {
+    const void *owner;
+    bool track;
+    uint8_t cores;              // bit per core the thread has spans on
+} thread_t;
+
+static int thread_id(thread_t *threads, int *count, const trace_event_t *e, int core)
+{
+    for (int i = 0; i < *count; i++) {
+        if (threads[i].owner == e->owner && threads[i].track == e->track) {
+            threads[i].cores |= 1 << core;
+            return i + 1;
+        }
+    }
+    if (*count == TRACE_THREADS) return TRACE_THREADS + 1;     // shared "other" row
+    threads[*count] = (thread_t){ e->owner, e->track, (uint8_t)(1 << core) };
+    return ++*count;
+}
+
+static const char *task_name(const void *task, const TaskStatus_t *status, int n)
+{
+    for (int i = 0; i < n; i++) {
+        if (status[i].xHandle == task) return status[i].pcTaskName;
+    }
+    return "exited task";   // the handle may be reused: do not dereference it
+}
+
+int trace_export_chrome(trace_write_t write, void *ctx)
+{
+    bool was_on = atomic_exchange(&trace_on, false);
+    out_t *o = malloc(sizeof(out_t));
+    thread_t *threads = calloc(TRACE_THREADS, sizeof(thread_t));
+    if (o == NULL || threads == NULL) {
+        free(o);
+        free(threads);
+        atomic_store(&trace_on, was_on);
+        return -1;
+    }
+    *o = (out_t){ .write = write, .ctx = ctx };
+    int thread_count = 0;
+    int spans = 0;
+    const int64_t per_us = trace_clock_per_us();
+    const int64_t per_ms = per_us * 1000;
+    const int64_t tick_cycles = portTICK_PERIOD_MS * per_ms;
+
+    emit(o, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    for (int c = 0; c < portNUM_PROCESSORS; c++) {
+        trace_ring_t *r = &rings[c];
+        unsigned head = atomic_load_explicit(&r->head, memory_order_acquire);
+        unsigned first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+        trace_event_t ref, e;
+        bool have_ref = false;
+        for (unsigned i = head; i-- > first && !have_ref;) have_ref = read_event(r, i, &ref);
+        if (!have_ref) continue;
+
+        // Where the reference start sits on the tick timeline. Every span
+        // started at or after the tick it read; most within that tick too.
+        int64_t lo = INT64_MIN, hi = INT64_MAX;
+        for (unsigned i = first; i < head; i++) {
+            if (!read_event(r, i, &e)) continue;
+            int64_t rel = unwrap(&e, &ref, per_ms);
+            int64_t at = (int64_t)e.tick * portTICK_PERIOD_MS * per_ms - rel;
+            if (at > lo) lo = at;
+            if (at + tick_cycles < hi) hi = at + tick_cycles;
+        }
+        int64_t origin = hi > lo ? lo + (hi - lo) / 2 : lo;
+
+        for (unsigned i = first; i < head && !o->failed; i++) {
+            if (!read_event(r, i, &e)) continue;
+            int64_t at = origin + unwrap(&e, &ref, per_ms);
+            emit(o, "%s{\"ph\":\"X\",\"cat\":\"%s\",\"name\":\"%s\",\"pid\":%d,\"tid\":%d,"
+                 "\"ts\":%" PRId64 ".%03" PRId64 ",\"dur\":%" PRIu32 ".%03" PRIu32 "}",
+                 spans ? ",\n" : "\n", e.cat ? e.cat : "", e.name, c, thread_id(threads, &thread_count, &e, c),
+                 at / per_us, at % per_us * 1000 / per_us,
+                 e.cycles / (uint32_t)per_us, e.cycles % (uint32_t)per_us * 1000 / (uint32_t)per_us);
+            spans++;
+        }
+    }
+
+    // Names for the rows: cores as processes, tasks and tracks as threads
+    TaskStatus_t *status = NULL;
+    int task_count = 0;
+#if configUSE_TRACE_FACILITY
+    UBaseType_t size = uxTaskGetNumberOfTasks() + 4;
+    status = malloc(size * sizeof(TaskStatus_t));
+    if (status) task_count = uxTaskGetSystemState(status, size, NULL);
+#endif
+    bool first_meta = spans == 0;
+    for (int c = 0; c < portNUM_PROCESSORS; c++) {
+        bool used = false;
+        for (int t = 0; t < thread_count; t++) {
+            if (!(threads[t].cores & (1 << c))) continue;
+            used = true;
+            emit(o, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                 first_meta ? "\n" : ",\n", c, t + 1,
+                 threads[t].track ? (const char *)threads[t].owner : task_name(threads[t].owner, status, task_count));
+            first_meta = false;
+        }
+        if (used) {
+            emit(o, ",\n{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,\"args\":{\"name\":\"core %d\"}}", c, c);
+        }
+    }
+    free(status);
+    emit(o, "\n]}\n");
+    flush(o);
+
+    int result = o->failed ? -1 : spans;
+    free(o);
+    free(threads);
+    atomic_store(&trace_on, was_on);
+    return result;
+}
@@ -0,0 +1,78 @@
+#ifndef UART_FRAME_H
+#define UART_FRAME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    #define UART_FRAME_RING 512     // receive ring, power of two
+    #define UART_FRAME_MAX  128     // longest line kept, CRC suffix included
+
+    typedef struct {
+        uint32_t bytes;
+        uint32_t frames;            // lines with a good CRC; every frame in binary mode
+        uint32_t unchecked;         // lines without a CRC suffix
+        uint32_t rejected;          // unchecked lines dropped because a CRC is required
+        uint32_t crc_errors;
+        uint32_t oversize;          // lines longer than UART_FRAME_MAX, dropped
+        uint32_t overruns;          // bytes lost because the ring was full
+    } uart_frame_stats_t;
+
+    // One line, without the "*XX" CRC suffix and the line ending
+    typedef struct {
+        const char *data;
+        size_t len;
+        bool checked;               // carried a CRC and it matched
+    } uart_frame_t;
+
+    // Splits a byte stream into newline-terminated lines. A line may end in
+    // "*XX", the CRC-8 of the text before it in hex, which is then checked.
+    // Bytes can arrive in any chunking; partial lines wait in the ring,
+    // garbage and overlong lines are skipped up to the next newline.
+    // In binary mode frames end in 0x00 instead (COBS, see uno_link.h) and
+    // are returned as they are, with no CRC suffix or '\r' handling.
+    typedef struct {
+        uint8_t ring[UART_FRAME_RING];
+        uint32_t head;              // next write
+        uint32_t tail;              // start of the pending line
+        uint32_t scan;              // next byte to check for '\n'
+        bool discarding;            // inside an overlong line
+        bool require_crc;
+        bool binary;
+        uint8_t delimiter;
+        char scratch[UART_FRAME_MAX];   // a line that wraps the ring end is copied here
+        uart_frame_stats_t stats;
+    } uart_framer_t;
+
+    void uart_framer_init(uart_framer_t *f, bool require_crc);
+    void uart_framer_init_binary(uart_framer_t *f);
+
+    // Drop buffered bytes, e.g. after the UART FIFO overflowed or the baud
+    // rate changed
+    void uart_framer_reset(uart_framer_t *f);
+
+    // Contiguous free space at the write position, so the UART driver can
+    // read straight into the ring; commit what was written
+    uint8_t *uart_framer_write_ptr(uart_framer_t *f, size_t *space);
+    void uart_framer_commit(uart_framer_t *f, size_t n);
+
+    // Copying alternative to write_ptr/commit; returns the bytes taken
+    size_t uart_framer_feed(uart_framer_t *f, const void *data, size_t len);
+
+    // Next complete line. frame->data points into the ring (or the scratch
+    // buffer for a line that wraps) and is valid until the next write or
+    // call to uart_framer_next().
+    bool uart_framer_next(uart_framer_t *f, uart_frame_t *frame);
+
+    // CRC-8, polynomial 0x07, initial value 0 (the Uno computes the same)
+    uint8_t uart_frame_crc8(const void *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UART_FRAME_H
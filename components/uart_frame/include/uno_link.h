@@ -0,0 +1,99 @@
+#ifndef UNO_LINK_H
+#define UNO_LINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // Binary packets between the Uno and the ESP32. On the wire each packet
+    // is COBS encoded and ends with a 0x00 byte:
+    //   type u8, seq u8, payload, CRC-8 of type..payload (uart_frame_crc8)
+    // seq counts per direction, so the receiver sees lost packets. Multi-byte
+    // fields are little endian. eee4464-uno.ino implements the Uno side.
+    #define UNO_LINK_VERSION      1
+    #define UNO_LINK_BAUD_DEFAULT 9600    // both ends start here and fall back to it
+    #define UNO_LINK_MAX_SAMPLES  16
+    #define UNO_LINK_MAX_PACKET   (2 + 1 + UNO_LINK_MAX_SAMPLES * 6 + 1)
+    #define UNO_LINK_MAX_FRAME    (UNO_LINK_MAX_PACKET + 2)   // COBS overhead and delimiter
+
+    typedef enum {
+        // Uno -> ESP32
+        UNO_PKT_HELLO    = 0x01,    // version u8, max_baud u32; also the Uno's keepalive
+        UNO_PKT_HR       = 0x02,    // bpm u8
+        UNO_PKT_SPO2     = 0x03,    // spo2 u8, hr u8, flags u8
+        UNO_PKT_SAMPLES  = 0x04,    // count u8, count x (ir u24, red u24)
+        UNO_PKT_IR_EVENT = 0x05,    // command u8, lights u8, brightness u8, color_temp u8
+        UNO_PKT_BAUD_ACK = 0x06,    // baud u32, sent at the old rate before switching
+        // ESP32 -> Uno
+        UNO_PKT_BAUD_SET = 0x81,    // baud u32
+        UNO_PKT_PING     = 0x82,    // no payload; keeps the Uno at the negotiated rate
+    } uno_pkt_type_t;
+
+    #define UNO_SPO2_VALID 0x01
+    #define UNO_HR_VALID   0x02
+
+    #define UNO_LIGHT_FOG   0x01
+    #define UNO_LIGHT_CLEAR 0x02
+    #define UNO_LIGHT_AUX   0x04
+
+    typedef struct {
+        uint32_t ir;
+        uint32_t red;
+    } uno_sample_t;
+
+    typedef struct {
+        uint8_t type;
+        uint8_t seq;
+        union {
+            struct { uint8_t version; uint32_t max_baud; } hello;
+            struct { uint8_t bpm; } hr;
+            struct { uint8_t spo2; uint8_t hr; uint8_t flags; } spo2;
+            struct { uint8_t count; uno_sample_t s[UNO_LINK_MAX_SAMPLES]; } samples;
+            struct { uint8_t command; uint8_t lights; uint8_t brightness; uint8_t color_temp; } ir;
+            struct { uint32_t baud; } baud;
+        };
+    } uno_packet_t;
+
+    typedef enum {
+        UNO_LINK_OK = 0,
+        UNO_LINK_COBS,              // malformed COBS
+        UNO_LINK_CRC,
+        UNO_LINK_LENGTH,            // payload size does not match the type
+        UNO_LINK_TYPE,              // unknown type
+    } uno_link_status_t;
+
+    // COBS frame of the packet including the trailing 0x00; 0 if out is
+    // too small or the packet is invalid
+    size_t uno_link_encode(const uno_packet_t *p, uint8_t *out, size_t size);
+
+    // frame without the 0x00 delimiter, as uart_framer_next() returns it in
+    // binary mode
+    uno_link_status_t uno_link_decode(const uint8_t *frame, size_t len, uno_packet_t *p);
+
+    const char *uno_link_status_str(uno_link_status_t status);
+
+    // COBS (Cheshire & Baker): out needs len + len / 254 + 1 bytes; no
+    // delimiter is written. decode returns 0 on malformed input.
+    size_t cobs_encode(const uint8_t *in, size_t len, uint8_t *out);
+    size_t cobs_decode(const uint8_t *in, size_t len, uint8_t *out, size_t size);
+
+    // Sequence tracking on the receiving side
+    typedef struct {
+        bool synced;
+        uint8_t next;
+        uint32_t received;
+        uint32_t lost;              // gaps in seq
+    } uno_link_seq_t;
+
+    // Returns the number of packets missing before this one
+    uint32_t uno_link_seq_update(uno_link_seq_t *s, uint8_t seq);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UNO_LINK_H
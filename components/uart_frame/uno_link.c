@@ -0,0 +1,204 @@
+#include "uno_link.h"
+#include <string.h>
+#include "uart_frame.h"
+
+size_t cobs_encode(const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t code_at = 0, o = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < len; i++) {
+        if (in[i] == 0) {
+            out[code_at] = code;
+            code_at = o++;
+            code = 1;
+            continue;
+        }
+        out[o++] = in[i];
+        // a full block of 254 bytes closes without an implied zero
+        if (++code == 0xFF && i + 1 < len) {
+            out[code_at] = code;
+            code_at = o++;
+            code = 1;
+        }
+    }
+    out[code_at] = code;
+    return o;
+}
+
+size_t cobs_decode(const uint8_t *in, size_t len, uint8_t *out, size_t size)
+{
+    size_t i = 0, o = 0;
+    while (i < len) {
+        uint8_t code = in[i++];
+        if (code == 0 || i + code - 1 > len) return 0;
+        for (uint8_t k = 1; k < code; k++) {
+            if (in[i] == 0 || o >= size) return 0;
+            out[o++] = in[i++];
+        }
+        if (code != 0xFF && i < len) {
+            if (o >= size) return 0;
+            out[o++] = 0;
+        }
+    }
+    return o;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint32_t get24(const uint8_t *p)
+{
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16;
+}
+
+// Payload size for a type, or -1 if unknown; samples depend on their count
+static int payload_len(uint8_t type, uint8_t count)
+{
+    switch (type) {
+    case UNO_PKT_HELLO:    return 5;
+    case UNO_PKT_HR:       return 1;
+    case UNO_PKT_SPO2:     return 3;
+    case UNO_PKT_SAMPLES:  return count <= UNO_LINK_MAX_SAMPLES ? 1 + count * 6 : -1;
+    case UNO_PKT_IR_EVENT: return 4;
+    case UNO_PKT_BAUD_ACK:
+    case UNO_PKT_BAUD_SET: return 4;
+    case UNO_PKT_PING:     return 0;
+    }
+    return -1;
+}
+
+size_t uno_link_encode(const uno_packet_t *p, uint8_t *out, size_t size)
+{
+    uint8_t raw[UNO_LINK_MAX_PACKET];
+    uint8_t *b = raw + 2;
+    int len = payload_len(p->type, p->type == UNO_PKT_SAMPLES ? p->samples.count : 0);
+    if (len < 0) return 0;
+    raw[0] = p->type;
+    raw[1] = p->seq;
+    switch (p->type) {
+    case UNO_PKT_HELLO:
+        b[0] = p->hello.version;
+        put32(b + 1, p->hello.max_baud);
+        break;
+    case UNO_PKT_HR:
+        b[0] = p->hr.bpm;
+        break;
+    case UNO_PKT_SPO2:
+        b[0] = p->spo2.spo2;
+        b[1] = p->spo2.hr;
+        b[2] = p->spo2.flags;
+        break;
+    case UNO_PKT_SAMPLES:
+        b[0] = p->samples.count;
+        for (int i = 0; i < p->samples.count; i++) {
+            uint8_t *s = b + 1 + i * 6;
+            s[0] = p->samples.s[i].ir;
+            s[1] = p->samples.s[i].ir >> 8;
+            s[2] = p->samples.s[i].ir >> 16;
+            s[3] = p->samples.s[i].red;
+            s[4] = p->samples.s[i].red >> 8;
+            s[5] = p->samples.s[i].red >> 16;
+        }
+        break;
+    case UNO_PKT_IR_EVENT:
+        b[0] = p->ir.command;
+        b[1] = p->ir.lights;
+        b[2] = p->ir.brightness;
+        b[3] = p->ir.color_temp;
+        break;
+    case UNO_PKT_BAUD_ACK:
+    case UNO_PKT_BAUD_SET:
+        put32(b, p->baud.baud);
+        break;
+    }
+    size_t raw_len = 2 + len;
+    raw[raw_len] = uart_frame_crc8(raw, raw_len);
+    raw_len++;
+
+    if (size < raw_len + raw_len / 254 + 2) return 0;
+    size_t n = cobs_encode(raw, raw_len, out);
+    out[n++] = 0;
+    return n;
+}
+
+uno_link_status_t uno_link_decode(const uint8_t *frame, size_t len, uno_packet_t *p)
+{
+    uint8_t raw[UNO_LINK_MAX_PACKET];
+    size_t n = cobs_decode(frame, len, raw, sizeof(raw));
+    if (n == 0) return UNO_LINK_COBS;
+    if (n < 3) return UNO_LINK_LENGTH;
+    if (uart_frame_crc8(raw, n - 1) != raw[n - 1]) return UNO_LINK_CRC;
+
+    const uint8_t *b = raw + 2;
+    int expect = payload_len(raw[0], n > 3 ? b[0] : 0);
+    if (expect < 0) return UNO_LINK_TYPE;
+    if ((size_t)expect != n - 3) return UNO_LINK_LENGTH;
+
+    memset(p, 0, sizeof(*p));
+    p->type = raw[0];
+    p->seq = raw[1];
+    switch (p->type) {
+    case UNO_PKT_HELLO:
+        p->hello.version = b[0];
+        p->hello.max_baud = get32(b + 1);
+        break;
+    case UNO_PKT_HR:
+        p->hr.bpm = b[0];
+        break;
+    case UNO_PKT_SPO2:
+        p->spo2.spo2 = b[0];
+        p->spo2.hr = b[1];
+        p->spo2.flags = b[2];
+        break;
+    case UNO_PKT_SAMPLES:
+        p->samples.count = b[0];
+        for (int i = 0; i < p->samples.count; i++) {
+            p->samples.s[i].ir = get24(b + 1 + i * 6);
+            p->samples.s[i].red = get24(b + 4 + i * 6);
+        }
+        break;
+    case UNO_PKT_IR_EVENT:
+        p->ir.command = b[0];
+        p->ir.lights = b[1];
+        p->ir.brightness = b[2];
+        p->ir.color_temp = b[3];
+        break;
+    case UNO_PKT_BAUD_ACK:
+    case UNO_PKT_BAUD_SET:
+        p->baud.baud = get32(b);
+        break;
+    }
+    return UNO_LINK_OK;
+}
+
+const char *uno_link_status_str(uno_link_status_t status)
+{
+    switch (status) {
+    case UNO_LINK_OK:     return "ok";
+    case UNO_LINK_COBS:   return "bad COBS";
+    case UNO_LINK_CRC:    return "CRC";
+    case UNO_LINK_LENGTH: return "length";
+    case UNO_LINK_TYPE:   return "unknown type";
+    }
+    return "?";
+}
+
+uint32_t uno_link_seq_update(uno_link_seq_t *s, uint8_t seq)
+{
+    uint32_t missing = s->synced ? (uint8_t)(seq - s->next) : 0;
+    s->synced = true;
+    s->next = seq + 1;
+    s->received++;
+    s->lost += missing;
+    return missing;
+}
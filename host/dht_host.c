@@ -0,0 +1,124 @@
+// dht.h for the host build. A read turns the simulated temperature and
+// humidity into the pulse train the DHT11 would send and decodes it with
+// dht_decode, like the RMT capture on the device.
+#include "dht.h"
+#include "dht_decode.h"
+#include <stdbool.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "hw_time.h"
+#include "sim.h"
+
+#define START_LOW_MS  20
+#define TASK_STACK    3072
+#define TASK_PRIORITY 7
+
+static const char *TAG = "DHT";
+
+static dht_sensor_type_t sensor_type;
+static dht_callback_t callback;
+static void *callback_ctx;
+static TaskHandle_t task_handle;
+static volatile bool busy;
+static dht_stats_t stats;
+
+static uint8_t clamp_byte(float v)
+{
+    return v < 0 ? 0 : v > 255 ? 255 : (uint8_t)v;
+}
+
+// Undo the correction main.c applies to this DHT11's readings, so the
+// firmware reports what the script asked for
+static void sensor_bytes(uint8_t data[5])
+{
+    float humidity = (sim_get(SIM_HUMIDITY) - 25.0f) / 0.375f;
+    float temperature = sim_get(SIM_TEMPERATURE) + 30.0f;
+    data[0] = clamp_byte(humidity);
+    data[1] = clamp_byte((humidity - data[0]) * 10);
+    data[2] = clamp_byte(temperature);
+    data[3] = clamp_byte((temperature - data[2]) * 10);
+    data[4] = data[0] + data[1] + data[2] + data[3];
+}
+
+// Acknowledge, 40 bits (50 us low, then 26 us high for 0 or 70 us for 1)
+static size_t to_pulses(const uint8_t data[5], dht_pulse_t *pulses)
+{
+    size_t n = 0;
+    pulses[n++] = (dht_pulse_t){ 0, 80 };
+    pulses[n++] = (dht_pulse_t){ 1, 80 };
+    for (int bit = 0; bit < 40; bit++) {
+        bool one = data[bit / 8] & (0x80 >> (bit % 8));
+        pulses[n++] = (dht_pulse_t){ 0, 50 };
+        pulses[n++] = (dht_pulse_t){ 1, one ? 70 : 26 };
+    }
+    pulses[n++] = (dht_pulse_t){ 0, 50 };
+    return n;
+}
+
+static void read_once(dht_reading_t *r)
+{
+    int64_t start = hw_time_us();
+    vTaskDelay(pdMS_TO_TICKS(START_LOW_MS) + 1);
+    if (sim_get(SIM_DHT_FAIL) != 0) {
+        r->err = ESP_ERR_TIMEOUT;
+        stats.timeouts++;
+        ESP_LOGW(TAG, "Read failed: %s", dht_decode_status_str(DHT_DECODE_NO_RESPONSE));
+        return;
+    }
+    uint8_t data[5];
+    dht_pulse_t pulses[84];
+    sensor_bytes(data);
+    dht_decode_status_t status = dht_decode(pulses, to_pulses(data, pulses), r->data);
+    r->capture_us = hw_time_us() - start;
+    if (status != DHT_DECODE_OK) {
+        r->err = ESP_ERR_INVALID_RESPONSE;
+        stats.malformed++;
+        ESP_LOGW(TAG, "Read failed: %s", dht_decode_status_str(status));
+        return;
+    }
+    r->err = ESP_OK;
+    stats.ok++;
+    if (sensor_type == DHT_TYPE_DHT22) {
+        dht22_convert(r->data, &r->humidity, &r->temperature);
+    } else {
+        dht11_convert(r->data, &r->humidity, &r->temperature);
+    }
+}
+
+static void dht_task(void *arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        dht_reading_t reading = { 0 };
+        read_once(&reading);
+        busy = false;
+        if (callback) callback(&reading, callback_ctx);
+    }
+}
+
+esp_err_t dht_start(dht_sensor_type_t type, gpio_num_t pin, dht_callback_t cb, void *ctx)
+{
+    if (task_handle) return ESP_ERR_INVALID_STATE;
+    sensor_type = type;
+    callback = cb;
+    callback_ctx = ctx;
+    if (xTaskCreate(dht_task, "dht", TASK_STACK, NULL, TASK_PRIORITY, &task_handle) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Simulated sensor on GPIO %d", pin);
+    return ESP_OK;
+}
+
+esp_err_t dht_request(void)
+{
+    if (task_handle == NULL || busy) return ESP_ERR_INVALID_STATE;
+    busy = true;
+    xTaskNotifyGive(task_handle);
+    return ESP_OK;
+}
+
+void dht_get_stats(dht_stats_t *out)
+{
+    *out = stats;
+}
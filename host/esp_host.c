@@ -0,0 +1,90 @@
+// esp_err, esp_log and the heap statistics for the host build
+#include <malloc.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "hw_http.h"
+
+static esp_log_level_t log_level = ESP_LOG_INFO;
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK:                    return "ESP_OK";
+    case ESP_FAIL:                  return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:            return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:       return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:     return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:      return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:         return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:     return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:           return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE:  return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC:       return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_INVALID_VERSION:   return "ESP_ERR_INVALID_VERSION";
+    case ESP_ERR_INVALID_MAC:       return "ESP_ERR_INVALID_MAC";
+    case ESP_ERR_NOT_FINISHED:      return "ESP_ERR_NOT_FINISHED";
+    case ESP_ERR_NOT_ALLOWED:       return "ESP_ERR_NOT_ALLOWED";
+    case HW_HTTP_ERR_EAGAIN:        return "ESP_ERR_HTTP_EAGAIN";
+    default:                        return "UNKNOWN ERROR";
+    }
+}
+
+void host_error_check_failed(esp_err_t err, const char *file, int line, const char *expr)
+{
+    fprintf(stderr, "ESP_ERROR_CHECK failed: esp_err_t 0x%x (%s) at %s:%d\nexpression: %s\n",
+            err, esp_err_to_name(err), file, line, expr);
+    abort();
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    if (tag[0] == '*' && tag[1] == '\0') log_level = level;
+}
+
+// The ESP-IDF console format: level letter, milliseconds since boot, tag
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    if (level > log_level) return;
+    static const char letters[] = "NEWIDV";
+    va_list args;
+    va_start(args, format);
+    pthread_mutex_lock(&log_lock);
+    fprintf(stdout, "%c (%u) %s: ", letters[level], (unsigned)xTaskGetTickCount(), tag);
+    vfprintf(stdout, format, args);
+    fputc('\n', stdout);
+    fflush(stdout);
+    pthread_mutex_unlock(&log_lock);
+    va_end(args);
+}
+
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t heap_min_free = SIZE_MAX;
+
+// Free bytes inside the malloc arenas; the minimum is over the calls made
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    struct mallinfo2 mi = mallinfo2();
+    pthread_mutex_lock(&heap_lock);
+    if (mi.fordblks < heap_min_free) heap_min_free = mi.fordblks;
+    pthread_mutex_unlock(&heap_lock);
+    return mi.fordblks;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+    size_t free_now = heap_caps_get_free_size(caps);
+    return heap_min_free < free_now ? heap_min_free : free_now;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    return heap_caps_get_free_size(caps);
+}
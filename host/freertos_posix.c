@@ -0,0 +1,565 @@
+// FreeRTOS on POSIX threads: every task is a detached pthread, every
+// blocking call a condition variable wait with a deadline.
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
+struct host_task {
+    TaskFunction_t fn;
+    void *arg;
+    char name[16];
+    uint32_t stack_depth;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify_value;
+    bool notify_pending;
+    UBaseType_t priority;
+    BaseType_t core;
+    pthread_t thread;           // valid while the task is on the task list
+    struct host_task *next;
+};
+
+static __thread struct host_task *current_task;
+
+// Running tasks, for uxTaskGetSystemState()
+static pthread_mutex_t task_list_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct host_task *task_list;
+static UBaseType_t task_count;
+
+void host_assert_failed(const char *file, int line)
+{
+    fprintf(stderr, "assert failed at %s:%d\n", file, line);
+    abort();
+}
+
+static struct timespec monotonic_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts;
+}
+
+// Absolute CLOCK_MONOTONIC deadline for a wait of ticks
+static struct timespec deadline_after(TickType_t ticks)
+{
+    struct timespec ts = monotonic_now();
+    ts.tv_sec += ticks / 1000;
+    ts.tv_nsec += (long)(ticks % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+static void cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+// Wait on cond until signalled or the deadline passes; false on timeout.
+// portMAX_DELAY waits forever.
+static bool cond_wait(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t wait, const struct timespec *deadline)
+{
+    if (wait == portMAX_DELAY) {
+        pthread_cond_wait(cond, lock);
+        return true;
+    }
+    return pthread_cond_timedwait(cond, lock, deadline) != ETIMEDOUT;
+}
+
+/* ---------------------------------------------------------------- tasks */
+
+static struct host_task *task_new(const char *name, uint32_t stack_depth)
+{
+    struct host_task *t = calloc(1, sizeof(*t));
+    if (t == NULL) return NULL;
+    snprintf(t->name, sizeof(t->name), "%s", name ? name : "");
+    t->stack_depth = stack_depth;
+    pthread_mutex_init(&t->lock, NULL);
+    cond_init(&t->cond);
+    return t;
+}
+
+static void task_list_add(struct host_task *t)
+{
+    t->thread = pthread_self();
+    pthread_mutex_lock(&task_list_lock);
+    t->next = task_list;
+    task_list = t;
+    task_count++;
+    pthread_mutex_unlock(&task_list_lock);
+}
+
+// Threads the shim did not start (main, libc) get a handle on first use
+static struct host_task *self(void)
+{
+    if (current_task == NULL) {
+        current_task = task_new("main", 0);
+        if (current_task) task_list_add(current_task);
+    }
+    return current_task;
+}
+
+static void *task_entry(void *p)
+{
+    current_task = p;
+    task_list_add(current_task);
+    pthread_setname_np(pthread_self(), current_task->name);
+    current_task->fn(current_task->arg);
+    fprintf(stderr, "task %s returned without vTaskDelete(NULL)\n", current_task->name);
+    abort();
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core)
+{
+    struct host_task *t = task_new(name, stack_depth);
+    if (t == NULL) return pdFAIL;
+    t->fn = fn;
+    t->arg = arg;
+    t->priority = priority;
+    t->core = core;
+    // Published before the thread runs, as a task can be notified at once
+    if (handle) *handle = t;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setstacksize(&attr, stack_depth > HOST_TASK_MIN_STACK ? stack_depth : HOST_TASK_MIN_STACK);
+    pthread_t thread;
+    int rc = pthread_create(&thread, &attr, task_entry, t);
+    pthread_attr_destroy(&attr);
+    if (rc != 0) {
+        if (handle) *handle = NULL;
+        free(t);
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle)
+{
+    return xTaskCreatePinnedToCore(fn, name, stack_depth, arg, priority, handle, 0);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    configASSERT(task == NULL || task == current_task);
+    struct host_task *t = self();
+    pthread_mutex_lock(&task_list_lock);
+    for (struct host_task **p = &task_list; *p; p = &(*p)->next) {
+        if (*p == t) {
+            *p = t->next;
+            task_count--;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&task_list_lock);
+    // The handle stays valid: other tasks may still hold it
+    pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    if (ticks == 0) {
+        sched_yield();
+        return;
+    }
+    struct timespec ts = deadline_after(ticks);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t period)
+{
+    *previous_wake += period;
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(*previous_wake - now) > 0) vTaskDelay(*previous_wake - now);
+}
+
+static struct timespec boot;
+
+__attribute__((constructor)) static void boot_time(void)
+{
+    boot = monotonic_now();
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec now = monotonic_now();
+    return (TickType_t)((now.tv_sec - boot.tv_sec) * 1000 + (now.tv_nsec - boot.tv_nsec) / 1000000);
+}
+
+TickType_t xTaskGetTickCountFromISR(void)
+{
+    return xTaskGetTickCount();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return self();
+}
+
+const char *pcTaskGetName(TaskHandle_t task)
+{
+    return (task ? task : self())->name;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    return (task ? task : self())->stack_depth;
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    return 0;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void)
+{
+    pthread_mutex_lock(&task_list_lock);
+    UBaseType_t n = task_count;
+    pthread_mutex_unlock(&task_list_lock);
+    return n;
+}
+
+static uint32_t clock_us(clockid_t clock)
+{
+    struct timespec ts;
+    if (clock_gettime(clock, &ts) != 0) return 0;
+    return (uint32_t)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+// Run time is the thread's CPU time in microseconds, the total is the time
+// since boot, so a task's share can exceed 100 % only on a multi-core host
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *status, UBaseType_t size, uint32_t *total_run_time)
+{
+    UBaseType_t n = 0;
+    pthread_mutex_lock(&task_list_lock);
+    if (size >= task_count) {
+        for (struct host_task *t = task_list; t; t = t->next, n++) {
+            clockid_t cpu;
+            status[n] = (TaskStatus_t){
+                .xHandle = t,
+                .pcTaskName = t->name,
+                .xTaskNumber = n,
+                .uxCurrentPriority = t->priority,
+                .ulRunTimeCounter = pthread_getcpuclockid(t->thread, &cpu) == 0 ? clock_us(cpu) : 0,
+                .usStackHighWaterMark = t->stack_depth,
+                .xCoreID = t->core,
+            };
+        }
+    }
+    pthread_mutex_unlock(&task_list_lock);
+    if (total_run_time) {
+        struct timespec now = monotonic_now();
+        *total_run_time = (uint32_t)((now.tv_sec - boot.tv_sec) * 1000000ULL + (now.tv_nsec - boot.tv_nsec) / 1000);
+    }
+    return n;
+}
+
+/* -------------------------------------------------------- notifications */
+
+BaseType_t xTaskGenericNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    configASSERT(task != NULL);
+    BaseType_t ok = pdPASS;
+    pthread_mutex_lock(&task->lock);
+    switch (action) {
+    case eSetBits:
+        task->notify_value |= value;
+        break;
+    case eIncrement:
+        task->notify_value++;
+        break;
+    case eSetValueWithOverwrite:
+        task->notify_value = value;
+        break;
+    case eSetValueWithoutOverwrite:
+        if (task->notify_pending) ok = pdFAIL;
+        else task->notify_value = value;
+        break;
+    case eNoAction:
+        break;
+    }
+    task->notify_pending = true;
+    pthread_cond_broadcast(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return ok;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t wait)
+{
+    struct host_task *t = self();
+    struct timespec deadline = deadline_after(wait);
+    pthread_mutex_lock(&t->lock);
+    // Like FreeRTOS, any notification ends the wait, even one that left the value at 0
+    while (t->notify_value == 0 && !t->notify_pending && wait > 0 &&
+           cond_wait(&t->cond, &t->lock, wait, &deadline)) {
+    }
+    uint32_t value = t->notify_value;
+    if (value > 0) t->notify_value = clear_on_exit ? 0 : value - 1;
+    t->notify_pending = false;
+    pthread_mutex_unlock(&t->lock);
+    return value;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t wait)
+{
+    struct host_task *t = self();
+    struct timespec deadline = deadline_after(wait);
+    pthread_mutex_lock(&t->lock);
+    if (!t->notify_pending) {
+        t->notify_value &= ~clear_on_entry;
+        while (!t->notify_pending && wait > 0 && cond_wait(&t->cond, &t->lock, wait, &deadline)) {
+        }
+    }
+    BaseType_t got = t->notify_pending ? pdTRUE : pdFALSE;
+    if (value) *value = t->notify_value;
+    if (got) t->notify_value &= ~clear_on_exit;
+    t->notify_pending = false;
+    pthread_mutex_unlock(&t->lock);
+    return got;
+}
+
+/* --------------------------------------------------- queues, semaphores */
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    UBaseType_t length;
+    UBaseType_t item_size;          // 0 for semaphores
+    UBaseType_t count;
+    UBaseType_t head;               // index of the oldest item
+    uint8_t *items;
+};
+
+static QueueHandle_t queue_new(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *q = calloc(1, sizeof(*q));
+    if (q == NULL) return NULL;
+    if (item_size > 0 && (q->items = malloc((size_t)length * item_size)) == NULL) {
+        free(q);
+        return NULL;
+    }
+    q->length = length;
+    q->item_size = item_size;
+    pthread_mutex_init(&q->lock, NULL);
+    cond_init(&q->not_empty);
+    cond_init(&q->not_full);
+    return q;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    return length > 0 ? queue_new(length, item_size) : NULL;
+}
+
+QueueHandle_t host_queue_create_semaphore(UBaseType_t max, UBaseType_t initial)
+{
+    struct host_queue *q = queue_new(max, 0);
+    if (q) q->count = initial;
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    if (q == NULL) return;
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+    free(q->items);
+    free(q);
+}
+
+static uint8_t *slot(struct host_queue *q, UBaseType_t i)
+{
+    return q->items + (size_t)((q->head + i) % q->length) * q->item_size;
+}
+
+static BaseType_t queue_send(QueueHandle_t q, const void *item, TickType_t wait, bool front)
+{
+    struct timespec deadline = deadline_after(wait);
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->length) {
+        if (wait == 0 || !cond_wait(&q->not_full, &q->lock, wait, &deadline)) {
+            pthread_mutex_unlock(&q->lock);
+            return pdFAIL;
+        }
+    }
+    if (q->item_size > 0) {
+        if (front) {
+            q->head = (q->head + q->length - 1) % q->length;
+            memcpy(slot(q, 0), item, q->item_size);
+        } else {
+            memcpy(slot(q, q->count), item, q->item_size);
+        }
+    }
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+    return pdPASS;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t wait)
+{
+    return queue_send(q, item, wait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t q, const void *item, TickType_t wait)
+{
+    return queue_send(q, item, wait, true);
+}
+
+static BaseType_t queue_receive(QueueHandle_t q, void *item, TickType_t wait, bool remove)
+{
+    struct timespec deadline = deadline_after(wait);
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0) {
+        if (wait == 0 || !cond_wait(&q->not_empty, &q->lock, wait, &deadline)) {
+            pthread_mutex_unlock(&q->lock);
+            return pdFAIL;
+        }
+    }
+    if (item && q->item_size > 0) memcpy(item, slot(q, 0), q->item_size);
+    if (remove) {
+        q->head = (q->head + 1) % q->length;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+    } else {
+        pthread_cond_signal(&q->not_empty);     // a peek leaves the item for the next reader
+    }
+    pthread_mutex_unlock(&q->lock);
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t wait)
+{
+    return queue_receive(q, item, wait, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t q, void *item, TickType_t wait)
+{
+    return queue_receive(q, item, wait, false);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t q, const void *item)
+{
+    configASSERT(q->length == 1);
+    pthread_mutex_lock(&q->lock);
+    memcpy(q->items, item, q->item_size);
+    q->head = 0;
+    q->count = 1;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+    return pdPASS;
+}
+
+BaseType_t xQueueReset(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    q->count = 0;
+    q->head = 0;
+    pthread_cond_broadcast(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t n = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t n = q->length - q->count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+/* --------------------------------------------------------- event groups */
+
+struct host_event_group {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    EventBits_t bits;
+};
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    struct host_event_group *g = calloc(1, sizeof(*g));
+    if (g == NULL) return NULL;
+    pthread_mutex_init(&g->lock, NULL);
+    cond_init(&g->changed);
+    return g;
+}
+
+void vEventGroupDelete(EventGroupHandle_t g)
+{
+    if (g == NULL) return;
+    pthread_mutex_destroy(&g->lock);
+    pthread_cond_destroy(&g->changed);
+    free(g);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t g, EventBits_t bits)
+{
+    pthread_mutex_lock(&g->lock);
+    g->bits |= bits;
+    EventBits_t now = g->bits;
+    pthread_cond_broadcast(&g->changed);
+    pthread_mutex_unlock(&g->lock);
+    return now;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t g, EventBits_t bits)
+{
+    pthread_mutex_lock(&g->lock);
+    EventBits_t before = g->bits;
+    g->bits &= ~bits;
+    pthread_mutex_unlock(&g->lock);
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t g)
+{
+    pthread_mutex_lock(&g->lock);
+    EventBits_t now = g->bits;
+    pthread_mutex_unlock(&g->lock);
+    return now;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t g, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t wait)
+{
+    struct timespec deadline = deadline_after(wait);
+    pthread_mutex_lock(&g->lock);
+    for (;;) {
+        EventBits_t set = g->bits & bits;
+        if (wait_for_all ? set == bits : set != 0) break;
+        if (wait == 0 || !cond_wait(&g->changed, &g->lock, wait, &deadline)) break;
+    }
+    EventBits_t now = g->bits;
+    EventBits_t set = now & bits;
+    if (clear_on_exit && (wait_for_all ? set == bits : set != 0)) g->bits &= ~bits;
+    pthread_mutex_unlock(&g->lock);
+    return now;
+}
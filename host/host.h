@@ -0,0 +1,40 @@
+#ifndef HOST_H
+#define HOST_H
+
+// Host build only: run options and the far ends of the hw_* peripherals,
+// which the simulator (sim.c, sim_uno.c) plugs into.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "hal/adc_types.h"
+#include "hal/gpio_types.h"
+#include "hal/uart_types.h"
+
+typedef struct {
+    const char *script;         // sensor script, NULL for a quiet room
+    const char *http_origin;    // cloud stand-in, e.g. "http://127.0.0.1:8443"
+    const char *mqtt_uri;       // broker in place of MQTT_BROKER_URI, e.g. "mqtt://127.0.0.1:1883"
+    const char *state_dir;      // where flash partitions are kept as files
+    bool uno;                   // run the simulated Uno on UART2
+    const char *trace_file;     // Chrome trace JSON written at the end of the run
+} host_options_t;
+
+extern host_options_t host_options;
+
+// Drive an input pin from outside; fires its ISR on a matching edge
+void hw_gpio_host_drive(gpio_num_t pin, int level);
+
+// Raw 12-bit reading of an ADC1 channel at t_us, asked for every conversion
+typedef int (*hw_adc_host_source_t)(adc_channel_t channel, int64_t t_us, void *ctx);
+void hw_adc_host_set_source(hw_adc_host_source_t source, void *ctx);
+
+// The device on the other end of a UART. tx gets what the firmware writes,
+// with the baud rate it was sent at.
+typedef void (*hw_uart_host_tx_t)(uart_port_t port, const uint8_t *data, size_t len, uint32_t baud, void *ctx);
+void hw_uart_host_attach(uart_port_t port, hw_uart_host_tx_t tx, void *ctx);
+// Bytes from the far end sent at baud; they arrive as noise if the port
+// is set to another rate. Returns how many fitted in the receive buffer.
+size_t hw_uart_host_receive(uart_port_t port, const uint8_t *data, size_t len, uint32_t baud);
+
+#endif // HOST_H
@@ -0,0 +1,114 @@
+// Continuous ADC: a thread converts the pattern round-robin in real time,
+// asking the simulator for every value, and hands over frames of
+// HW_ADC_READ_MAX conversions through a pool like the DMA driver's
+#include "hw_adc.h"
+#include <pthread.h>
+#include <time.h>
+#include "esp_log.h"
+#include "adc_lut.h"
+#include "host.h"
+#include "hw_time.h"
+
+#define PATTERN_MAX  16
+#define POOL_SAMPLES 1024           // 2 KB of 16-bit results, as on the device
+
+static const char *TAG = "hw_adc";
+static hw_adc_pattern_t pattern[PATTERN_MAX];
+static int pattern_len;
+static uint32_t freq_hz;
+static hw_adc_ready_t ready_cb;
+static void *ready_ctx;
+static hw_adc_host_source_t source;
+static void *source_ctx;
+static volatile uint32_t overflows;
+static bool started;
+
+static hw_adc_sample_t pool[POOL_SAMPLES];
+static size_t pool_head, pool_count;     // oldest sample, samples held
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void hw_adc_host_set_source(hw_adc_host_source_t src, void *ctx)
+{
+    source_ctx = ctx;
+    source = src;
+}
+
+static void *conversion_thread(void *arg)
+{
+    pthread_setname_np(pthread_self(), "adc_dma");
+    int64_t frame_us = (int64_t)HW_ADC_READ_MAX * 1000000 / freq_hz;
+    int64_t t_us = hw_time_us();
+    int next = 0;
+    hw_adc_sample_t frame[HW_ADC_READ_MAX];
+    while (1) {
+        for (int i = 0; i < HW_ADC_READ_MAX; i++) {
+            adc_channel_t ch = pattern[next].channel;
+            int raw = source ? source(ch, t_us + (int64_t)i * 1000000 / freq_hz, source_ctx) : 0;
+            frame[i].channel = ch;
+            frame[i].raw = raw < 0 ? 0 : raw > 4095 ? 4095 : raw;
+            next = (next + 1) % pattern_len;
+        }
+        t_us += frame_us;
+
+        pthread_mutex_lock(&pool_lock);
+        bool fits = pool_count + HW_ADC_READ_MAX <= POOL_SAMPLES;
+        for (int i = 0; fits && i < HW_ADC_READ_MAX; i++) {
+            pool[(pool_head + pool_count++) % POOL_SAMPLES] = frame[i];
+        }
+        pthread_mutex_unlock(&pool_lock);
+        if (fits) ready_cb(ready_ctx);
+        else overflows++;
+
+        // the frame was "converted" over the last frame_us; sleep until the next is done
+        int64_t ahead_us = t_us - hw_time_us();
+        if (ahead_us > 0) {
+            struct timespec ts = { ahead_us / 1000000, (ahead_us % 1000000) * 1000 };
+            nanosleep(&ts, NULL);
+        }
+    }
+    return NULL;
+}
+
+esp_err_t hw_adc_continuous_start(const hw_adc_pattern_t *patt, int count, uint32_t sample_freq_hz,
+                                  hw_adc_ready_t ready, void *ctx)
+{
+    if (started) return ESP_ERR_INVALID_STATE;
+    if (count <= 0 || count > PATTERN_MAX || sample_freq_hz < 611) return ESP_ERR_INVALID_ARG;
+    for (int i = 0; i < count; i++) pattern[i] = patt[i];
+    pattern_len = count;
+    freq_hz = sample_freq_hz;
+    ready_cb = ready;
+    ready_ctx = ctx;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, conversion_thread, NULL) != 0) return ESP_ERR_NO_MEM;
+    pthread_detach(thread);
+    started = true;
+    ESP_LOGI(TAG, "%d channels at %u Hz, values from the simulator", count, (unsigned)sample_freq_hz);
+    return ESP_OK;
+}
+
+int hw_adc_continuous_read(hw_adc_sample_t *out, int max)
+{
+    if (max > HW_ADC_READ_MAX) max = HW_ADC_READ_MAX;
+    pthread_mutex_lock(&pool_lock);
+    int n = 0;
+    for (; n < max && pool_count > 0; n++) {
+        out[n] = pool[pool_head];
+        pool_head = (pool_head + 1) % POOL_SAMPLES;
+        pool_count--;
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return n;
+}
+
+uint32_t hw_adc_overflows(void)
+{
+    return overflows;
+}
+
+// No eFuse here: the firmware falls back to the nominal scale
+esp_err_t adc_lut_build_cali(adc_lut_t *lut, adc_unit_t unit, adc_atten_t atten)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
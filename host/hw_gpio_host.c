@@ -0,0 +1,105 @@
+// GPIO pins as plain state; inputs are driven by the simulator, whose
+// thread runs the ISRs
+#include "hw_gpio.h"
+#include <pthread.h>
+#include "host.h"
+
+typedef struct {
+    bool output;
+    hw_gpio_pull_t pull;
+    int out_level;
+    int driven;                 // level forced from outside, -1 if floating
+    hw_gpio_edge_t edge;
+    hw_gpio_isr_t isr;
+    void *arg;
+} pin_t;
+
+static pin_t pins[GPIO_NUM_MAX];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+__attribute__((constructor)) static void pins_init(void)
+{
+    for (int i = 0; i < GPIO_NUM_MAX; i++) pins[i].driven = -1;
+}
+
+static bool valid(gpio_num_t pin)
+{
+    return pin >= 0 && pin < GPIO_NUM_MAX;
+}
+
+// Called with lock held
+static int level_of(const pin_t *p)
+{
+    if (p->output) return p->out_level;
+    if (p->driven >= 0) return p->driven;
+    return p->pull == HW_GPIO_PULL_UP;
+}
+
+esp_err_t hw_gpio_output(gpio_num_t pin, bool strong)
+{
+    if (!valid(pin)) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&lock);
+    pins[pin].output = true;
+    pins[pin].out_level = 0;
+    pins[pin].isr = NULL;
+    pthread_mutex_unlock(&lock);
+    return ESP_OK;
+}
+
+esp_err_t hw_gpio_input(gpio_num_t pin, hw_gpio_pull_t pull)
+{
+    if (!valid(pin)) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&lock);
+    pins[pin].output = false;
+    pins[pin].pull = pull;
+    pins[pin].isr = NULL;
+    pthread_mutex_unlock(&lock);
+    return ESP_OK;
+}
+
+void hw_gpio_set(gpio_num_t pin, int level)
+{
+    if (!valid(pin)) return;
+    pthread_mutex_lock(&lock);
+    pins[pin].out_level = level != 0;
+    pthread_mutex_unlock(&lock);
+}
+
+int hw_gpio_get(gpio_num_t pin)
+{
+    if (!valid(pin)) return 0;
+    pthread_mutex_lock(&lock);
+    int level = level_of(&pins[pin]);
+    pthread_mutex_unlock(&lock);
+    return level;
+}
+
+esp_err_t hw_gpio_isr_add(gpio_num_t pin, hw_gpio_edge_t edge, hw_gpio_isr_t isr, void *arg)
+{
+    if (!valid(pin) || isr == NULL) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&lock);
+    pins[pin].edge = edge;
+    pins[pin].isr = isr;
+    pins[pin].arg = arg;
+    pthread_mutex_unlock(&lock);
+    return ESP_OK;
+}
+
+void hw_gpio_host_drive(gpio_num_t pin, int level)
+{
+    if (!valid(pin)) return;
+    pin_t *p = &pins[pin];
+    pthread_mutex_lock(&lock);
+    int before = level_of(p);
+    p->driven = level < 0 ? -1 : level != 0;
+    int after = level_of(p);
+    hw_gpio_isr_t isr = NULL;
+    if (before != after && !p->output && p->isr &&
+        (p->edge == HW_GPIO_EDGE_ANY || (p->edge == HW_GPIO_EDGE_RISING) == (after == 1))) {
+        isr = p->isr;
+    }
+    void *arg = p->arg;
+    pthread_mutex_unlock(&lock);
+    // The ISR reads the pin, so it runs outside the lock
+    if (isr) isr(arg);
+}
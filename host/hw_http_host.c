@@ -0,0 +1,363 @@
+// HTTP/1.1 client on a plain socket, blocking, with keep-alive. Enough of
+// esp_http_client for cloudflare_api against the stand-in worker.
+#include "hw_http.h"
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "esp_log.h"
+
+#define MAX_HEADERS 8
+#define HEADER_MAX  1024            // one response header line
+
+static const char *TAG = "hw_http";
+
+struct hw_http_client {
+    hw_http_event_cb_t event_handler;
+    void *user_data;
+    int timeout_ms;
+    bool keep_alive;
+
+    char url[256];
+    hw_http_method_t method;
+    char *header_keys[MAX_HEADERS];
+    char *header_values[MAX_HEADERS];
+    const char *body;
+    int body_len;
+    int status;
+
+    int fd;                         // -1 when not connected
+    char conn_host[128];
+    int conn_port;
+
+    // receive buffer
+    char *rbuf;
+    int rsize, rpos, rlen;
+};
+
+static void emit(hw_http_handle_t c, hw_http_event_id_t id, const char *key, const char *value,
+                 const char *data, int len)
+{
+    if (c->event_handler == NULL) return;
+    hw_http_event_t evt = {
+        .id = id, .header_key = key, .header_value = value, .data = data, .data_len = len,
+        .user_data = c->user_data,
+    };
+    c->event_handler(&evt);
+}
+
+hw_http_handle_t hw_http_init(const hw_http_config_t *config)
+{
+    hw_http_handle_t c = calloc(1, sizeof(*c));
+    if (c == NULL) return NULL;
+    c->rsize = config->buffer_size > 0 ? config->buffer_size : 512;
+    c->rbuf = malloc(c->rsize);
+    if (c->rbuf == NULL) {
+        free(c);
+        return NULL;
+    }
+    c->event_handler = config->event_handler;
+    c->user_data = config->user_data;
+    c->timeout_ms = config->timeout_ms > 0 ? config->timeout_ms : 5000;
+    c->keep_alive = config->keep_alive;
+    c->fd = -1;
+    if (config->url) snprintf(c->url, sizeof(c->url), "%s", config->url);
+    return c;
+}
+
+void hw_http_close(hw_http_handle_t c)
+{
+    if (c->fd < 0) return;
+    close(c->fd);
+    c->fd = -1;
+    emit(c, HW_HTTP_EVENT_DISCONNECTED, NULL, NULL, NULL, 0);
+}
+
+void hw_http_cleanup(hw_http_handle_t c)
+{
+    if (c == NULL) return;
+    hw_http_close(c);
+    for (int i = 0; i < MAX_HEADERS; i++) {
+        free(c->header_keys[i]);
+        free(c->header_values[i]);
+    }
+    free(c->rbuf);
+    free(c);
+}
+
+void hw_http_set_url(hw_http_handle_t c, const char *url)
+{
+    snprintf(c->url, sizeof(c->url), "%s", url);
+}
+
+void hw_http_set_method(hw_http_handle_t c, hw_http_method_t method)
+{
+    c->method = method;
+}
+
+void hw_http_set_timeout_ms(hw_http_handle_t c, int timeout_ms)
+{
+    c->timeout_ms = timeout_ms;
+}
+
+void hw_http_delete_header(hw_http_handle_t c, const char *key)
+{
+    for (int i = 0; i < MAX_HEADERS; i++) {
+        if (c->header_keys[i] && strcasecmp(c->header_keys[i], key) == 0) {
+            free(c->header_keys[i]);
+            free(c->header_values[i]);
+            c->header_keys[i] = c->header_values[i] = NULL;
+        }
+    }
+}
+
+void hw_http_set_header(hw_http_handle_t c, const char *key, const char *value)
+{
+    hw_http_delete_header(c, key);
+    for (int i = 0; i < MAX_HEADERS; i++) {
+        if (c->header_keys[i] == NULL) {
+            c->header_keys[i] = strdup(key);
+            c->header_values[i] = strdup(value);
+            return;
+        }
+    }
+    ESP_LOGW(TAG, "Too many headers, %s not sent", key);
+}
+
+void hw_http_set_body(hw_http_handle_t c, const char *data, int len)
+{
+    c->body = data;
+    c->body_len = data ? len : 0;
+}
+
+int hw_http_status(hw_http_handle_t c)
+{
+    return c->status;
+}
+
+// "http://host[:port]/path"
+static esp_err_t parse_url(const char *url, char *host, size_t host_size, int *port, const char **path)
+{
+    if (strncmp(url, "https://", 8) == 0) return ESP_ERR_NOT_SUPPORTED;
+    if (strncmp(url, "http://", 7) != 0) return ESP_ERR_INVALID_ARG;
+    const char *h = url + 7;
+    const char *end = h + strcspn(h, ":/");
+    if (end == h || (size_t)(end - h) >= host_size) return ESP_ERR_INVALID_ARG;
+    memcpy(host, h, end - h);
+    host[end - h] = '\0';
+    *port = 80;
+    if (*end == ':') *port = (int)strtol(end + 1, (char **)&end, 10);
+    *path = *end == '/' ? end : "/";
+    return ESP_OK;
+}
+
+static esp_err_t connect_to(hw_http_handle_t c, const char *host, int port)
+{
+    char service[8];
+    snprintf(service, sizeof(service), "%d", port);
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM }, *res;
+    if (getaddrinfo(host, service, &hints, &res) != 0) return ESP_ERR_NOT_FOUND;
+    int fd = -1;
+    for (struct addrinfo *ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    if (fd < 0) return ESP_FAIL;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (c->keep_alive) setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+    c->fd = fd;
+    snprintf(c->conn_host, sizeof(c->conn_host), "%s", host);
+    c->conn_port = port;
+    emit(c, HW_HTTP_EVENT_CONNECTED, NULL, NULL, NULL, 0);
+    return ESP_OK;
+}
+
+static esp_err_t send_all(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return (errno == EAGAIN || errno == EWOULDBLOCK) ? ESP_ERR_TIMEOUT : ESP_FAIL;
+        data += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+// Refill the receive buffer; ESP_FAIL if the server closed the connection
+static esp_err_t fill(hw_http_handle_t c)
+{
+    if (c->rpos > 0) {
+        memmove(c->rbuf, c->rbuf + c->rpos, c->rlen - c->rpos);
+        c->rlen -= c->rpos;
+        c->rpos = 0;
+    }
+    if (c->rlen == c->rsize) return ESP_ERR_INVALID_SIZE;
+    ssize_t n;
+    do {
+        n = recv(c->fd, c->rbuf + c->rlen, c->rsize - c->rlen, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) return (errno == EAGAIN || errno == EWOULDBLOCK) ? ESP_ERR_TIMEOUT : ESP_FAIL;
+    if (n == 0) return ESP_FAIL;
+    c->rlen += n;
+    return ESP_OK;
+}
+
+// One CRLF-terminated line, without the CRLF
+static esp_err_t read_line(hw_http_handle_t c, char *line, size_t size)
+{
+    while (1) {
+        char *nl = memchr(c->rbuf + c->rpos, '\n', c->rlen - c->rpos);
+        if (nl) {
+            size_t len = nl - (c->rbuf + c->rpos);
+            if (len > 0 && nl[-1] == '\r') len--;
+            if (len >= size) len = size - 1;
+            memcpy(line, c->rbuf + c->rpos, len);
+            line[len] = '\0';
+            c->rpos = nl + 1 - c->rbuf;
+            return ESP_OK;
+        }
+        esp_err_t err = fill(c);
+        if (err != ESP_OK) return err;
+    }
+}
+
+// Pass len body bytes (-1: until the server closes) to the event handler
+static esp_err_t read_body(hw_http_handle_t c, long len)
+{
+    while (len != 0) {
+        if (c->rpos == c->rlen) {
+            esp_err_t err = fill(c);
+            if (err == ESP_FAIL && len < 0) return ESP_OK;
+            if (err != ESP_OK) return err;
+        }
+        long n = c->rlen - c->rpos;
+        if (len > 0 && n > len) n = len;
+        emit(c, HW_HTTP_EVENT_DATA, NULL, NULL, c->rbuf + c->rpos, (int)n);
+        c->rpos += n;
+        if (len > 0) len -= n;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t read_chunked(hw_http_handle_t c)
+{
+    char line[64];
+    while (1) {
+        esp_err_t err = read_line(c, line, sizeof(line));
+        if (err != ESP_OK) return err;
+        long size = strtol(line, NULL, 16);
+        if (size == 0) break;
+        if ((err = read_body(c, size)) != ESP_OK) return err;
+        if ((err = read_line(c, line, sizeof(line))) != ESP_OK) return err;
+    }
+    // trailers up to the empty line
+    do {
+        esp_err_t err = read_line(c, line, sizeof(line));
+        if (err != ESP_OK) return err;
+    } while (line[0]);
+    return ESP_OK;
+}
+
+static esp_err_t exchange(hw_http_handle_t c, const char *host, int port, const char *path)
+{
+    static const char *const methods[] = { "GET", "POST", "PUT" };
+    char head[1024];
+    int n = snprintf(head, sizeof(head), "%s %s HTTP/1.1\r\nHost: %s:%d\r\nUser-Agent: ESP32 HTTP Client/1.0\r\n",
+                     methods[c->method], path, host, port);
+    if (c->method != HW_HTTP_GET || c->body_len > 0) {
+        n += snprintf(head + n, sizeof(head) - n, "Content-Length: %d\r\n", c->body_len);
+    }
+    for (int i = 0; i < MAX_HEADERS; i++) {
+        if (c->header_keys[i] && n < (int)sizeof(head)) {
+            n += snprintf(head + n, sizeof(head) - n, "%s: %s\r\n", c->header_keys[i], c->header_values[i]);
+        }
+    }
+    if (n + 2 >= (int)sizeof(head)) return ESP_ERR_INVALID_SIZE;
+    n += snprintf(head + n, sizeof(head) - n, "\r\n");
+
+    struct timeval tv = { c->timeout_ms / 1000, (c->timeout_ms % 1000) * 1000 };
+    setsockopt(c->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(c->fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    esp_err_t err = send_all(c->fd, head, n);
+    if (err == ESP_OK && c->body_len > 0) err = send_all(c->fd, c->body, c->body_len);
+    if (err != ESP_OK) return err;
+
+    c->rpos = c->rlen = 0;
+    char line[HEADER_MAX];
+    do {    // skip 100 Continue
+        if ((err = read_line(c, line, sizeof(line))) != ESP_OK) return err;
+        if (strncmp(line, "HTTP/1.", 7) != 0) return ESP_ERR_INVALID_RESPONSE;
+        c->status = atoi(line + 9);
+        if (c->status == 100) {
+            do {
+                if ((err = read_line(c, line, sizeof(line))) != ESP_OK) return err;
+            } while (line[0]);
+        }
+    } while (c->status == 100);
+
+    long content_length = -1;
+    bool chunked = false, close_after = false;
+    while (1) {
+        if ((err = read_line(c, line, sizeof(line))) != ESP_OK) return err;
+        if (line[0] == '\0') break;
+        char *colon = strchr(line, ':');
+        if (colon == NULL) continue;
+        *colon = '\0';
+        char *value = colon + 1;
+        while (*value == ' ') value++;
+        if (strcasecmp(line, "Content-Length") == 0) content_length = atol(value);
+        else if (strcasecmp(line, "Transfer-Encoding") == 0) chunked = strcasestr(value, "chunked") != NULL;
+        else if (strcasecmp(line, "Connection") == 0) close_after = strcasecmp(value, "close") == 0;
+        emit(c, HW_HTTP_EVENT_HEADER, line, value, NULL, 0);
+    }
+
+    if (c->status == 204 || c->status == 304) err = ESP_OK;
+    else if (chunked) err = read_chunked(c);
+    else if (content_length >= 0) err = read_body(c, content_length);
+    else {
+        err = read_body(c, -1);
+        close_after = true;
+    }
+    if (err != ESP_OK) return err;
+    emit(c, HW_HTTP_EVENT_FINISH, NULL, NULL, NULL, 0);
+    if (close_after) hw_http_close(c);
+    return ESP_OK;
+}
+
+// Blocking even with is_async set; returns once the response is read
+esp_err_t hw_http_perform(hw_http_handle_t c)
+{
+    char host[128];
+    int port;
+    const char *path;
+    esp_err_t err = parse_url(c->url, host, sizeof(host), &port, &path);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot request %s: %s", c->url, err == ESP_ERR_NOT_SUPPORTED ? "no TLS on the host" : "bad URL");
+        emit(c, HW_HTTP_EVENT_ERROR, NULL, NULL, NULL, 0);
+        return err;
+    }
+    if (c->fd >= 0 && (port != c->conn_port || strcmp(host, c->conn_host) != 0)) hw_http_close(c);
+    if (c->fd < 0 && (err = connect_to(c, host, port)) != ESP_OK) {
+        emit(c, HW_HTTP_EVENT_ERROR, NULL, NULL, NULL, 0);
+        return err;
+    }
+    c->status = 0;
+    err = exchange(c, host, port, path);
+    if (err != ESP_OK) {
+        emit(c, HW_HTTP_EVENT_ERROR, NULL, NULL, NULL, 0);
+        hw_http_close(c);
+    }
+    return err;
+}
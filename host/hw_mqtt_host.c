@@ -0,0 +1,447 @@
+// MQTT 3.1.1 over plain TCP, enough of esp-mqtt for the firmware: one task
+// per client that connects, reconnects and reads; an outbox that holds QoS 1
+// publishes until they are acknowledged or expire.
+#include "hw_mqtt.h"
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "host.h"
+
+#define OUTBOX_SIZE        64
+#define OUTBOX_EXPIRE_MS   30000    // esp-mqtt's default
+#define KEEPALIVE_S        120
+#define RECONNECT_MS       10000
+#define NETWORK_TIMEOUT_MS 10000
+#define RX_MAX             (64 * 1024)
+
+static const char *TAG = "hw_mqtt";
+
+typedef struct {
+    uint8_t *packet;            // NULL for a free slot
+    size_t len;
+    int msg_id;
+    int qos;
+    bool sent;
+    TickType_t queued;
+} outbox_entry_t;
+
+struct hw_mqtt_client {
+    char host[128];
+    int port;
+    char *username, *password;
+    hw_mqtt_event_cb_t cb;
+    void *ctx;
+
+    pthread_mutex_t lock;       // fd writes, outbox, next_id
+    int fd;
+    bool connected;
+    uint16_t next_id;
+    outbox_entry_t outbox[OUTBOX_SIZE];
+    TickType_t last_tx;
+};
+
+static void emit(hw_mqtt_handle_t c, hw_mqtt_event_id_t id, int msg_id)
+{
+    hw_mqtt_event_t e = { .id = id, .client = c, .msg_id = msg_id };
+    c->cb(&e, c->ctx);
+}
+
+// "mqtt://[user:pass@]host[:port]"
+static bool parse_uri(hw_mqtt_handle_t c, const char *uri)
+{
+    if (strncmp(uri, "mqtt://", 7) != 0) return false;
+    const char *h = uri + 7;
+    const char *at = strchr(h, '@');
+    if (at) h = at + 1;
+    size_t len = strcspn(h, ":/");
+    if (len == 0 || len >= sizeof(c->host)) return false;
+    memcpy(c->host, h, len);
+    c->host[len] = '\0';
+    c->port = h[len] == ':' ? atoi(h + len + 1) : 1883;
+    return true;
+}
+
+static uint8_t *put_u16(uint8_t *p, uint16_t v)
+{
+    *p++ = v >> 8;
+    *p++ = v & 0xFF;
+    return p;
+}
+
+static uint8_t *put_str(uint8_t *p, const char *s, size_t len)
+{
+    p = put_u16(p, (uint16_t)len);
+    memcpy(p, s, len);
+    return p + len;
+}
+
+// Fixed header plus room for body_len bytes; returns the packet and where
+// the body goes
+static uint8_t *packet_new(uint8_t type, size_t body_len, size_t *total, uint8_t **body)
+{
+    uint8_t *pkt = malloc(5 + body_len);
+    if (pkt == NULL) return NULL;
+    uint8_t *p = pkt;
+    *p++ = type;
+    size_t rem = body_len;
+    do {
+        uint8_t b = rem & 0x7F;
+        rem >>= 7;
+        *p++ = rem ? b | 0x80 : b;
+    } while (rem);
+    *body = p;
+    *total = (p - pkt) + body_len;
+    return pkt;
+}
+
+static bool send_all(int fd, const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// With the lock held. A failed write shuts the socket down so the reader
+// notices and reconnects.
+static bool send_locked(hw_mqtt_handle_t c, const uint8_t *data, size_t len)
+{
+    if (c->fd < 0) return false;
+    if (!send_all(c->fd, data, len)) {
+        shutdown(c->fd, SHUT_RDWR);
+        return false;
+    }
+    c->last_tx = xTaskGetTickCount();
+    return true;
+}
+
+static bool read_full(int fd, uint8_t *buf, size_t len)
+{
+    while (len > 0) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        if (poll(&pfd, 1, NETWORK_TIMEOUT_MS) <= 0) return false;
+        ssize_t n = recv(fd, buf, len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+// One packet; the body is malloc'd
+static bool read_packet(int fd, uint8_t *type, uint8_t **body, size_t *len)
+{
+    uint8_t b;
+    if (!read_full(fd, type, 1)) return false;
+    size_t rem = 0;
+    for (int shift = 0; shift < 28; shift += 7) {
+        if (!read_full(fd, &b, 1)) return false;
+        rem |= (size_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) break;
+    }
+    if (rem > RX_MAX) return false;
+    *body = malloc(rem + 1);
+    if (*body == NULL) return false;
+    if (!read_full(fd, *body, rem)) {
+        free(*body);
+        return false;
+    }
+    *len = rem;
+    return true;
+}
+
+static int open_socket(hw_mqtt_handle_t c)
+{
+    char service[8];
+    snprintf(service, sizeof(service), "%d", c->port);
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM }, *res;
+    if (getaddrinfo(c->host, service, &hints, &res) != 0) return -1;
+    int fd = -1;
+    for (struct addrinfo *ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    if (fd >= 0) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+static bool mqtt_connect(hw_mqtt_handle_t c, int fd)
+{
+    char client_id[24];
+    snprintf(client_id, sizeof(client_id), "ESP32_host_%04x", (unsigned)(getpid() & 0xFFFF));
+    size_t ulen = c->username ? strlen(c->username) : 0, plen = c->password ? strlen(c->password) : 0;
+    size_t body_len = 10 + 2 + strlen(client_id) + (ulen ? 2 + ulen : 0) + (plen ? 2 + plen : 0), total;
+    uint8_t *body, *pkt = packet_new(0x10, body_len, &total, &body);
+    if (pkt == NULL) return false;
+    uint8_t *p = put_str(body, "MQTT", 4);
+    *p++ = 4;                                            // 3.1.1
+    *p++ = 0x02 | (ulen ? 0x80 : 0) | (plen ? 0x40 : 0); // clean session
+    p = put_u16(p, KEEPALIVE_S);
+    p = put_str(p, client_id, strlen(client_id));
+    if (ulen) p = put_str(p, c->username, ulen);
+    if (plen) put_str(p, c->password, plen);
+    bool ok = send_all(fd, pkt, total);
+    free(pkt);
+
+    uint8_t type, *ack;
+    size_t len;
+    if (!ok || !read_packet(fd, &type, &ack, &len)) return false;
+    ok = (type >> 4) == 2 && len >= 2 && ack[1] == 0;
+    if ((type >> 4) == 2 && len >= 2 && ack[1] != 0) ESP_LOGE(TAG, "Connection refused, return code %d", ack[1]);
+    free(ack);
+    return ok;
+}
+
+static int next_id(hw_mqtt_handle_t c)
+{
+    if (++c->next_id == 0) c->next_id = 1;
+    return c->next_id;
+}
+
+static int outbox_add(hw_mqtt_handle_t c, uint8_t *pkt, size_t len, int msg_id, int qos)
+{
+    for (int i = 0; i < OUTBOX_SIZE; i++) {
+        outbox_entry_t *e = &c->outbox[i];
+        if (e->packet) continue;
+        *e = (outbox_entry_t){ pkt, len, msg_id, qos, false, xTaskGetTickCount() };
+        return i;
+    }
+    return -1;
+}
+
+static void outbox_free(outbox_entry_t *e)
+{
+    free(e->packet);
+    e->packet = NULL;
+}
+
+// Send what is queued, resend unacknowledged QoS 1 after a reconnect
+// (resend set), expire what is too old. DELETED events are emitted after
+// the lock is dropped.
+static void outbox_service(hw_mqtt_handle_t c, bool resend)
+{
+    int expired[OUTBOX_SIZE], n_expired = 0;
+    TickType_t now = xTaskGetTickCount();
+    pthread_mutex_lock(&c->lock);
+    for (int i = 0; i < OUTBOX_SIZE; i++) {
+        outbox_entry_t *e = &c->outbox[i];
+        if (e->packet == NULL) continue;
+        if (now - e->queued > pdMS_TO_TICKS(OUTBOX_EXPIRE_MS)) {
+            if (e->qos > 0) expired[n_expired++] = e->msg_id;
+            outbox_free(e);
+            continue;
+        }
+        if (!c->connected || (e->sent && !resend)) continue;
+        if (e->sent) e->packet[0] |= 0x08;  // DUP
+        if (!send_locked(c, e->packet, e->len)) break;
+        e->sent = true;
+        if (e->qos == 0) outbox_free(e);
+    }
+    pthread_mutex_unlock(&c->lock);
+    for (int i = 0; i < n_expired; i++) emit(c, HW_MQTT_DELETED, expired[i]);
+}
+
+static void on_publish(hw_mqtt_handle_t c, uint8_t type, uint8_t *body, size_t len)
+{
+    int qos = (type >> 1) & 3;
+    if (len < 2) return;
+    size_t topic_len = (body[0] << 8) | body[1];
+    size_t pos = 2 + topic_len;
+    int msg_id = 0;
+    if (qos > 0) {
+        if (pos + 2 > len) return;
+        msg_id = (body[pos] << 8) | body[pos + 1];
+        pos += 2;
+    }
+    if (pos > len) return;
+    hw_mqtt_event_t e = {
+        .id = HW_MQTT_DATA, .client = c, .msg_id = msg_id,
+        .topic = (const char *)body + 2, .topic_len = (int)topic_len,
+        .data = (const char *)body + pos, .data_len = (int)(len - pos),
+        .current_data_offset = 0, .total_data_len = (int)(len - pos),
+    };
+    c->cb(&e, c->ctx);
+    if (qos > 0) {
+        uint8_t ack[4] = { 0x40, 2, msg_id >> 8, msg_id & 0xFF };
+        pthread_mutex_lock(&c->lock);
+        send_locked(c, ack, sizeof(ack));
+        pthread_mutex_unlock(&c->lock);
+    }
+}
+
+static void on_puback(hw_mqtt_handle_t c, int msg_id)
+{
+    bool found = false;
+    pthread_mutex_lock(&c->lock);
+    for (int i = 0; i < OUTBOX_SIZE; i++) {
+        outbox_entry_t *e = &c->outbox[i];
+        if (e->packet && e->qos > 0 && e->msg_id == msg_id) {
+            outbox_free(e);
+            found = true;
+        }
+    }
+    pthread_mutex_unlock(&c->lock);
+    if (found) emit(c, HW_MQTT_PUBLISHED, msg_id);
+}
+
+static void client_task(void *arg)
+{
+    hw_mqtt_handle_t c = arg;
+    while (1) {
+        int fd = open_socket(c);
+        if (fd < 0 || !mqtt_connect(c, fd)) {
+            if (fd >= 0) close(fd);
+            ESP_LOGW(TAG, "Cannot connect to %s:%d, retrying in %d s", c->host, c->port, RECONNECT_MS / 1000);
+            outbox_service(c, false);
+            vTaskDelay(pdMS_TO_TICKS(RECONNECT_MS));
+            continue;
+        }
+        pthread_mutex_lock(&c->lock);
+        c->fd = fd;
+        c->connected = true;
+        c->last_tx = xTaskGetTickCount();
+        pthread_mutex_unlock(&c->lock);
+        emit(c, HW_MQTT_CONNECTED, 0);
+        outbox_service(c, true);
+
+        while (1) {
+            struct pollfd pfd = { .fd = fd, .events = POLLIN };
+            int ready = poll(&pfd, 1, 100);
+            if (ready < 0 && errno != EINTR) break;
+            if (ready > 0) {
+                uint8_t type, *body;
+                size_t len;
+                if (!read_packet(fd, &type, &body, &len)) break;
+                int msg_id = len >= 2 ? (body[0] << 8) | body[1] : 0;
+                switch (type >> 4) {
+                case 3:  on_publish(c, type, body, len); break;
+                case 4:  on_puback(c, msg_id); break;
+                case 9:  emit(c, HW_MQTT_SUBSCRIBED, msg_id); break;
+                default: break;     // PINGRESP and the rest
+                }
+                free(body);
+            }
+            outbox_service(c, false);
+            pthread_mutex_lock(&c->lock);
+            if (xTaskGetTickCount() - c->last_tx > pdMS_TO_TICKS(KEEPALIVE_S * 1000 / 2)) {
+                static const uint8_t ping[2] = { 0xC0, 0 };
+                send_locked(c, ping, sizeof(ping));
+            }
+            pthread_mutex_unlock(&c->lock);
+        }
+
+        pthread_mutex_lock(&c->lock);
+        c->connected = false;
+        c->fd = -1;
+        close(fd);
+        pthread_mutex_unlock(&c->lock);
+        emit(c, HW_MQTT_DISCONNECTED, 0);
+        vTaskDelay(pdMS_TO_TICKS(RECONNECT_MS));
+    }
+}
+
+hw_mqtt_handle_t hw_mqtt_start(const hw_mqtt_config_t *config, hw_mqtt_event_cb_t cb, void *ctx)
+{
+    struct hw_mqtt_client *c = calloc(1, sizeof(*c));
+    if (c == NULL) return NULL;
+    const char *uri = host_options.mqtt_uri ? host_options.mqtt_uri : config->uri;
+    if (!parse_uri(c, uri)) {
+        ESP_LOGE(TAG, "Cannot use broker %s: the host client has no TLS, pass an mqtt:// broker", uri);
+        free(c);
+        return NULL;
+    }
+    c->username = config->username ? strdup(config->username) : NULL;
+    c->password = config->password ? strdup(config->password) : NULL;
+    c->cb = cb;
+    c->ctx = ctx;
+    c->fd = -1;
+    pthread_mutex_init(&c->lock, NULL);
+    xTaskCreate(client_task, "mqtt_task", 6144, c, 5, NULL);
+    return c;
+}
+
+static int publish(hw_mqtt_handle_t c, const char *topic, const char *data, int len, int qos, bool retain,
+                   bool send_now)
+{
+    if (c == NULL) return -1;
+    if (len == 0) len = (int)strlen(data);
+    size_t tlen = strlen(topic), total;
+    uint8_t *body, *pkt = packet_new(0x30 | (qos > 0 ? 0x02 : 0) | (retain ? 1 : 0),
+                                     2 + tlen + (qos > 0 ? 2 : 0) + len, &total, &body);
+    if (pkt == NULL) return -1;
+
+    pthread_mutex_lock(&c->lock);
+    int msg_id = qos > 0 ? next_id(c) : 0;
+    uint8_t *p = put_str(body, topic, tlen);
+    if (qos > 0) p = put_u16(p, (uint16_t)msg_id);
+    memcpy(p, data, len);
+
+    int ret = msg_id;
+    if (!c->connected && qos == 0) {
+        ret = -1;           // nothing is kept for QoS 0 while offline
+        free(pkt);
+    } else if (send_now && c->connected && qos == 0) {
+        if (!send_locked(c, pkt, total)) ret = -1;
+        free(pkt);
+    } else {
+        int slot = outbox_add(c, pkt, total, msg_id, qos);
+        if (slot < 0) {
+            ret = -1;
+            free(pkt);
+        } else if (send_now && c->connected && send_locked(c, pkt, total)) {
+            c->outbox[slot].sent = true;
+        }
+    }
+    pthread_mutex_unlock(&c->lock);
+    return ret;
+}
+
+int hw_mqtt_publish(hw_mqtt_handle_t client, const char *topic, const char *data, int len, int qos, bool retain)
+{
+    return publish(client, topic, data, len, qos, retain, true);
+}
+
+int hw_mqtt_enqueue(hw_mqtt_handle_t client, const char *topic, const char *data, int len, int qos, bool retain)
+{
+    return publish(client, topic, data, len, qos, retain, false);
+}
+
+int hw_mqtt_subscribe(hw_mqtt_handle_t c, const char *topic, int qos)
+{
+    if (c == NULL) return -1;
+    size_t tlen = strlen(topic), total;
+    uint8_t *body, *pkt = packet_new(0x82, 2 + 2 + tlen + 1, &total, &body);
+    if (pkt == NULL) return -1;
+    pthread_mutex_lock(&c->lock);
+    int msg_id = next_id(c);
+    uint8_t *p = put_u16(body, (uint16_t)msg_id);
+    p = put_str(p, topic, tlen);
+    *p = (uint8_t)qos;
+    bool ok = c->connected && send_locked(c, pkt, total);
+    pthread_mutex_unlock(&c->lock);
+    free(pkt);
+    return ok ? msg_id : -1;
+}
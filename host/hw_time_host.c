@@ -0,0 +1,31 @@
+#include "hw_time.h"
+#include <time.h>
+#include "esp_log.h"
+
+static const char *TAG = "hw_time";
+static struct timespec boot;
+static volatile bool synced;
+
+__attribute__((constructor)) static void boot_time(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &boot);
+}
+
+int64_t hw_time_us(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)(now.tv_sec - boot.tv_sec) * 1000000 + (now.tv_nsec - boot.tv_nsec) / 1000;
+}
+
+// The host clock is already kept in sync by the OS
+void hw_time_sync_start(const char *server)
+{
+    ESP_LOGI(TAG, "Using the host clock instead of %s", server);
+    synced = true;
+}
+
+bool hw_time_synced(void)
+{
+    return synced;
+}
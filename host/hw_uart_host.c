@@ -0,0 +1,162 @@
+// UARTs whose far end is a simulated device (host.h). Receive goes into a
+// ring like the driver's; bytes sent at another baud rate arrive as noise.
+#include "hw_uart.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include "host.h"
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t rx_ready;
+    bool open;
+    uint32_t baud;
+    uint8_t *rx;
+    size_t rx_size, rx_head, rx_count;
+    bool overflow;
+    hw_uart_host_tx_t tx;
+    void *tx_ctx;
+    uint32_t noise;
+} port_t;
+
+static port_t ports[UART_NUM_MAX];
+
+__attribute__((constructor)) static void ports_init(void)
+{
+    for (int i = 0; i < UART_NUM_MAX; i++) {
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_mutex_init(&ports[i].lock, NULL);
+        pthread_cond_init(&ports[i].rx_ready, &attr);
+        pthread_condattr_destroy(&attr);
+        ports[i].noise = 0x9E3779B9u + i;
+    }
+}
+
+static port_t *get(uart_port_t port)
+{
+    return port >= 0 && port < UART_NUM_MAX && ports[port].open ? &ports[port] : NULL;
+}
+
+esp_err_t hw_uart_open(uart_port_t port, uint32_t baud, gpio_num_t tx_pin, gpio_num_t rx_pin, size_t rx_buf_size)
+{
+    if (port < 0 || port >= UART_NUM_MAX || rx_buf_size == 0) return ESP_ERR_INVALID_ARG;
+    port_t *p = &ports[port];
+    pthread_mutex_lock(&p->lock);
+    if (p->open) {
+        pthread_mutex_unlock(&p->lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    p->rx = malloc(rx_buf_size);
+    if (p->rx == NULL) {
+        pthread_mutex_unlock(&p->lock);
+        return ESP_ERR_NO_MEM;
+    }
+    p->rx_size = rx_buf_size;
+    p->rx_head = p->rx_count = 0;
+    p->baud = baud;
+    p->open = true;
+    pthread_mutex_unlock(&p->lock);
+    return ESP_OK;
+}
+
+int hw_uart_wait(uart_port_t port, uint32_t timeout_ms)
+{
+    port_t *p = get(port);
+    if (p == NULL) return 0;
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&p->lock);
+    while (p->rx_count == 0 && !p->overflow) {
+        if (pthread_cond_timedwait(&p->rx_ready, &p->lock, &deadline) == ETIMEDOUT) break;
+    }
+    int ready = (int)p->rx_count;
+    if (p->overflow) {
+        p->overflow = false;
+        p->rx_head = p->rx_count = 0;
+        ready = -1;
+    }
+    pthread_mutex_unlock(&p->lock);
+    return ready;
+}
+
+int hw_uart_read(uart_port_t port, void *buf, size_t len)
+{
+    port_t *p = get(port);
+    if (p == NULL) return -1;
+    pthread_mutex_lock(&p->lock);
+    size_t n = 0;
+    for (; n < len && p->rx_count > 0; n++) {
+        ((uint8_t *)buf)[n] = p->rx[p->rx_head];
+        p->rx_head = (p->rx_head + 1) % p->rx_size;
+        p->rx_count--;
+    }
+    pthread_mutex_unlock(&p->lock);
+    return (int)n;
+}
+
+int hw_uart_write(uart_port_t port, const void *buf, size_t len)
+{
+    port_t *p = get(port);
+    if (p == NULL) return -1;
+    pthread_mutex_lock(&p->lock);
+    hw_uart_host_tx_t tx = p->tx;
+    void *ctx = p->tx_ctx;
+    uint32_t baud = p->baud;
+    pthread_mutex_unlock(&p->lock);
+    if (tx) tx(port, buf, len, baud, ctx);
+    return (int)len;
+}
+
+// Writes go out synchronously, so there is nothing left to wait for
+esp_err_t hw_uart_set_baud(uart_port_t port, uint32_t baud)
+{
+    port_t *p = get(port);
+    if (p == NULL) return ESP_ERR_INVALID_STATE;
+    pthread_mutex_lock(&p->lock);
+    p->baud = baud;
+    p->rx_head = p->rx_count = 0;
+    p->overflow = false;
+    pthread_mutex_unlock(&p->lock);
+    return ESP_OK;
+}
+
+void hw_uart_host_attach(uart_port_t port, hw_uart_host_tx_t tx, void *ctx)
+{
+    if (port < 0 || port >= UART_NUM_MAX) return;
+    pthread_mutex_lock(&ports[port].lock);
+    ports[port].tx_ctx = ctx;
+    ports[port].tx = tx;
+    pthread_mutex_unlock(&ports[port].lock);
+}
+
+size_t hw_uart_host_receive(uart_port_t port, const uint8_t *data, size_t len, uint32_t baud)
+{
+    port_t *p = get(port);
+    if (p == NULL) return 0;
+    pthread_mutex_lock(&p->lock);
+    size_t n = 0;
+    for (; n < len; n++) {
+        if (p->rx_count == p->rx_size) {
+            p->overflow = true;
+            break;
+        }
+        uint8_t c = data[n];
+        if (baud != p->baud) {
+            p->noise = p->noise * 1103515245u + 12345u;
+            c = p->noise >> 24;
+        }
+        p->rx[(p->rx_head + p->rx_count++) % p->rx_size] = c;
+    }
+    pthread_cond_signal(&p->rx_ready);
+    pthread_mutex_unlock(&p->lock);
+    return n;
+}
@@ -0,0 +1,9 @@
+#ifndef HOST_ESP_ATTR_H
+#define HOST_ESP_ATTR_H
+
+// Placement attributes mean nothing on the host
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+
+#endif // HOST_ESP_ATTR_H
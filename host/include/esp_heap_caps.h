@@ -0,0 +1,18 @@
+#ifndef HOST_ESP_HEAP_CAPS_H
+#define HOST_ESP_HEAP_CAPS_H
+
+// Heap statistics from glibc's mallinfo2(), for the runtime metrics. Caps
+// are ignored. glibc does not report its largest free chunk, so the free
+// total stands in for it and fragmentation reads as 0.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_DEFAULT (1 << 12)
+#define MALLOC_CAP_8BIT    (1 << 2)
+
+size_t heap_caps_get_free_size(uint32_t caps);
+size_t heap_caps_get_minimum_free_size(uint32_t caps);
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+
+#endif // HOST_ESP_HEAP_CAPS_H
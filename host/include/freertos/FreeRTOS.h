@@ -0,0 +1,61 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+// The part of the FreeRTOS API the firmware uses, on POSIX threads. Ticks
+// are milliseconds; priorities and core affinity are accepted and ignored.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include "esp_attr.h"
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t StackType_t;
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define pdFAIL  0
+#define pdPASS  1
+
+#define configTICK_RATE_HZ   1000
+#define configMAX_PRIORITIES 25
+#define portNUM_PROCESSORS   2
+#define portTICK_PERIOD_MS   1
+#define portMAX_DELAY        ((TickType_t)0xffffffffu)
+
+#define configUSE_TRACE_FACILITY       1
+#define configGENERATE_RUN_TIME_STATS  1
+
+#define pdMS_TO_TICKS(ms)    ((TickType_t)(ms))
+#define pdTICKS_TO_MS(ticks) ((uint32_t)(ticks))
+
+#define configASSERT(x) do { if (!(x)) host_assert_failed(__FILE__, __LINE__); } while (0)
+void host_assert_failed(const char *file, int line);
+
+#define BIT0  0x00000001
+#define BIT1  0x00000002
+#define BIT2  0x00000004
+#define BIT3  0x00000008
+#define BIT4  0x00000010
+#define BIT5  0x00000020
+#define BIT6  0x00000040
+#define BIT7  0x00000080
+
+// Critical sections exclude the other threads, "ISRs" included
+typedef struct {
+    pthread_mutex_t lock;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED { PTHREAD_MUTEX_INITIALIZER }
+
+#define portENTER_CRITICAL(mux)     pthread_mutex_lock(&(mux)->lock)
+#define portEXIT_CRITICAL(mux)      pthread_mutex_unlock(&(mux)->lock)
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)  portEXIT_CRITICAL(mux)
+#define portYIELD_FROM_ISR(...)     sched_yield()
+#define portYIELD()                 sched_yield()
+
+#endif // HOST_FREERTOS_H
@@ -0,0 +1,24 @@
+#ifndef HOST_FREERTOS_QUEUE_H
+#define HOST_FREERTOS_QUEUE_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_queue *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait);
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t wait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait);
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t wait);
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item);
+BaseType_t xQueueReset(QueueHandle_t queue);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue);
+
+#define xQueueSendToBack(queue, item, wait) xQueueSend((queue), (item), (wait))
+#define xQueueSendFromISR(queue, item, woken) ((void)(woken), xQueueSend((queue), (item), 0))
+#define xQueueReceiveFromISR(queue, item, woken) ((void)(woken), xQueueReceive((queue), (item), 0))
+#define xQueueOverwriteFromISR(queue, item, woken) ((void)(woken), xQueueOverwrite((queue), (item)))
+
+#endif // HOST_FREERTOS_QUEUE_H
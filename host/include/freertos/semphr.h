@@ -0,0 +1,22 @@
+#ifndef HOST_FREERTOS_SEMPHR_H
+#define HOST_FREERTOS_SEMPHR_H
+
+#include "freertos/queue.h"
+
+// Semaphores are queues of zero-size items, as in FreeRTOS. Mutexes are
+// binary semaphores that start out given (no priority inheritance).
+typedef QueueHandle_t SemaphoreHandle_t;
+
+QueueHandle_t host_queue_create_semaphore(UBaseType_t max, UBaseType_t initial);
+
+#define xSemaphoreCreateMutex()                  host_queue_create_semaphore(1, 1)
+#define xSemaphoreCreateBinary()                 host_queue_create_semaphore(1, 0)
+#define xSemaphoreCreateCounting(max, initial)   host_queue_create_semaphore((max), (initial))
+#define vSemaphoreDelete(sem)                    vQueueDelete(sem)
+#define xSemaphoreTake(sem, wait)                xQueueReceive((sem), NULL, (wait))
+#define xSemaphoreGive(sem)                      xQueueSend((sem), NULL, 0)
+#define xSemaphoreGiveFromISR(sem, woken)        ((void)(woken), xQueueSend((sem), NULL, 0))
+#define xSemaphoreTakeFromISR(sem, woken)        ((void)(woken), xQueueReceive((sem), NULL, 0))
+#define uxSemaphoreGetCount(sem)                 uxQueueMessagesWaiting(sem)
+
+#endif // HOST_FREERTOS_SEMPHR_H
@@ -0,0 +1,66 @@
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *arg);
+
+typedef enum {
+    eNoAction = 0,
+    eSetBits,
+    eIncrement,
+    eSetValueWithOverwrite,
+    eSetValueWithoutOverwrite,
+} eNotifyAction;
+
+// Stack depths are in bytes as on ESP-IDF; every task gets at least
+// HOST_TASK_MIN_STACK because libc on the host wants more than newlib
+#define HOST_TASK_MIN_STACK (256 * 1024)
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core);
+// Only the calling task can delete itself (NULL)
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t period);
+TickType_t xTaskGetTickCount(void);
+TickType_t xTaskGetTickCountFromISR(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+const char *pcTaskGetName(TaskHandle_t task);
+// The host cannot measure stack use; reports the untouched requested depth
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+BaseType_t xPortGetCoreID(void);
+
+// configUSE_TRACE_FACILITY; fields the host does not track are left zero
+typedef struct {
+    TaskHandle_t xHandle;
+    const char *pcTaskName;
+    UBaseType_t xTaskNumber;
+    UBaseType_t uxCurrentPriority;
+    UBaseType_t uxBasePriority;
+    uint32_t ulRunTimeCounter;          // CPU time of the thread, microseconds
+    uint32_t usStackHighWaterMark;      // as uxTaskGetStackHighWaterMark()
+    BaseType_t xCoreID;
+} TaskStatus_t;
+
+UBaseType_t uxTaskGetNumberOfTasks(void);
+// Returns 0 if size is less than uxTaskGetNumberOfTasks()
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *status, UBaseType_t size, uint32_t *total_run_time);
+
+BaseType_t xTaskGenericNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t wait);
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t wait);
+
+#define xTaskNotify(task, value, action) xTaskGenericNotify((task), (value), (action))
+#define xTaskNotifyGive(task) xTaskGenericNotify((task), 0, eIncrement)
+#define xTaskNotifyFromISR(task, value, action, woken) \
+    ((void)(woken), xTaskGenericNotify((task), (value), (action)))
+#define taskYIELD() sched_yield()
+
+#define vTaskNotifyGiveFromISR(task, woken) \
+    ((void)(woken), (void)xTaskGenericNotify((task), 0, eIncrement))
+
+#endif // HOST_FREERTOS_TASK_H
@@ -0,0 +1,30 @@
+#ifndef HOST_HAL_ADC_TYPES_H
+#define HOST_HAL_ADC_TYPES_H
+
+typedef enum {
+    ADC_UNIT_1 = 0,
+    ADC_UNIT_2,
+} adc_unit_t;
+
+typedef enum {
+    ADC_CHANNEL_0 = 0, ADC_CHANNEL_1, ADC_CHANNEL_2, ADC_CHANNEL_3, ADC_CHANNEL_4,
+    ADC_CHANNEL_5, ADC_CHANNEL_6, ADC_CHANNEL_7, ADC_CHANNEL_8, ADC_CHANNEL_9,
+} adc_channel_t;
+
+typedef enum {
+    ADC_ATTEN_DB_0 = 0,
+    ADC_ATTEN_DB_2_5 = 1,
+    ADC_ATTEN_DB_6 = 2,
+    ADC_ATTEN_DB_12 = 3,
+    ADC_ATTEN_DB_11 = ADC_ATTEN_DB_12,
+} adc_atten_t;
+
+typedef enum {
+    ADC_BITWIDTH_DEFAULT = 0,
+    ADC_BITWIDTH_9 = 9,
+    ADC_BITWIDTH_10 = 10,
+    ADC_BITWIDTH_11 = 11,
+    ADC_BITWIDTH_12 = 12,
+} adc_bitwidth_t;
+
+#endif // HOST_HAL_ADC_TYPES_H
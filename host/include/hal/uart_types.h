@@ -0,0 +1,11 @@
+#ifndef HOST_HAL_UART_TYPES_H
+#define HOST_HAL_UART_TYPES_H
+
+typedef enum {
+    UART_NUM_0 = 0,
+    UART_NUM_1,
+    UART_NUM_2,
+    UART_NUM_MAX,
+} uart_port_t;
+
+#endif // HOST_HAL_UART_TYPES_H
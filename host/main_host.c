@@ -0,0 +1,112 @@
+// Entry point of the host build: the firmware's app_main() on POSIX threads,
+// with the simulated board and the network endpoints from the command line.
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "cloudflare_api.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "host.h"
+#include "hw_time.h"
+#include "sim.h"
+#include "trace.h"
+
+#define DEFAULT_SECONDS 30
+
+host_options_t host_options = { .state_dir = ".", .uno = true };
+
+void app_main(void);
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [options] [seconds]\n"
+            "  --script FILE   sensor script (see host/scripts)\n"
+            "  --http ORIGIN   cloud API stand-in, e.g. http://127.0.0.1:8443\n"
+            "  --mqtt URI      broker, e.g. mqtt://127.0.0.1:1883\n"
+            "  --state DIR     where the flash partitions are kept (default .)\n"
+            "  --no-uno        leave UART2 unconnected\n"
+            "  --trace FILE    write the span trace as Chrome trace JSON at the end\n"
+            "  -q              warnings and errors only\n"
+            "Runs for %d s by default, 0 runs until interrupted.\n",
+            argv0, DEFAULT_SECONDS);
+}
+
+static bool write_file(const char *data, size_t len, void *ctx)
+{
+    return fwrite(data, 1, len, ctx) == len;
+}
+
+static void write_trace(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    int spans = f ? trace_export_chrome(write_file, f) : -1;
+    if (f && fclose(f) != 0) spans = -1;
+    if (spans < 0) {
+        ESP_LOGE("host", "Could not write the trace to %s", path);
+    } else {
+        ESP_LOGI("host", "Wrote %d spans to %s", spans, path);
+    }
+}
+
+static void app_task(void *arg)
+{
+    app_main();     // ends with vTaskDelete(NULL)
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option long_options[] = {
+        { "script", required_argument, NULL, 's' },
+        { "http",   required_argument, NULL, 'h' },
+        { "mqtt",   required_argument, NULL, 'm' },
+        { "state",  required_argument, NULL, 'd' },
+        { "no-uno", no_argument,       NULL, 'u' },
+        { "trace",  required_argument, NULL, 't' },
+        { NULL, 0, NULL, 0 },
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "q", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 's': host_options.script = optarg; break;
+        case 'h': host_options.http_origin = optarg; break;
+        case 'm': host_options.mqtt_uri = optarg; break;
+        case 'd': host_options.state_dir = optarg; break;
+        case 'u': host_options.uno = false; break;
+        case 't': host_options.trace_file = optarg; break;
+        case 'q': esp_log_level_set("*", ESP_LOG_WARN); break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    int seconds = optind < argc ? atoi(argv[optind]) : DEFAULT_SECONDS;
+
+    // lets a harness turn script and log times into wall-clock times
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    ESP_LOGI("host", "Boot at unix time %.6f", tv.tv_sec + tv.tv_usec / 1e6 - hw_time_us() / 1e6);
+
+    if (sim_start(host_options.script) != ESP_OK) return 1;
+    if (host_options.uno) sim_uno_start();
+    xTaskCreate(app_task, "main", 8192, NULL, 1, NULL);
+
+    if (seconds <= 0) {
+        while (1) pause();
+    }
+    sleep(seconds);
+
+    cloudflare_pool_stats_t pool;
+    cloudflare_api_get_pool_stats(&pool);
+    esp_log_level_set("*", ESP_LOG_INFO);
+    ESP_LOGI("host", "HTTP: %u requests, %u connections, %u failures, %u of %u conditional GETs not modified",
+             (unsigned)pool.requests, (unsigned)pool.handshakes, (unsigned)pool.failures,
+             (unsigned)pool.not_modified, (unsigned)pool.conditional);
+    if (host_options.uno) sim_uno_log_stats();
+    if (host_options.trace_file) write_trace(host_options.trace_file);
+    ESP_LOGI("host", "Host run finished after %d s", seconds);
+    exit(0);
+}
@@ -0,0 +1,83 @@
+// components/ppg on the host: the sliding window must give the Maxim
+// reference result for every window of a set of synthetic traces, and at
+// one result a second as many results as the shift-and-recompute loop of
+// the Arduino examples. The cost of both is printed, not checked: it depends
+// on the machine and its load. The traces are those of tests/ppg_traces.c.
+#include <stdio.h>
+#include <time.h>
+#include "ppg_traces.h"
+
+#define ROUNDS 50
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Windows that differ from the reference, hop 1 so every window is checked
+static int check_equal(const ppg_trace_t *t)
+{
+    static ppg_window_t w;
+    int mismatches = 0, compared = 0;
+    ppg_make_trace(t);
+    ppg_window_init(&w, 1);
+    for (int i = 0; i < PPG_TRACE_LEN; i++) {
+        ppg_result_t got, want;
+        if (!ppg_window_push(&w, ppg_ir_trace[i], ppg_red_trace[i], &got)) continue;
+        ppg_reference(&ppg_ir_trace[i + 1 - PPG_WINDOW], &ppg_red_trace[i + 1 - PPG_WINDOW], &want);
+        if (got.hr_valid != want.hr_valid || got.heart_rate != want.heart_rate ||
+            got.spo2_valid != want.spo2_valid || got.spo2 != want.spo2) {
+            if (mismatches++ == 0) {
+                printf("%s, window ending at %d: hr %d/%d valid %d/%d, spo2 %d/%d valid %d/%d\n", t->name, i,
+                       (int)got.heart_rate, (int)want.heart_rate, got.hr_valid, want.hr_valid,
+                       (int)got.spo2, (int)want.spo2, got.spo2_valid, want.spo2_valid);
+            }
+        }
+        compared++;
+    }
+    if (compared != PPG_TRACE_LEN - PPG_WINDOW + 1) mismatches++;
+    printf("%-18s %d windows, %d differ\n", t->name, compared, mismatches);
+    return mismatches;
+}
+
+int main(void)
+{
+    int failed = 0;
+    for (size_t t = 0; t < ppg_trace_count; t++) {
+        if (check_equal(&ppg_traces[t])) failed = 1;
+    }
+
+    static ppg_window_t w;
+    volatile int32_t sink = 0;
+    ppg_make_trace(&ppg_traces[1]);
+
+    int64_t start = now_us();
+    int ref_results = ppg_shift_recompute(ROUNDS, &sink);
+    int64_t ref_us = now_us() - start;
+
+    start = now_us();
+    int win_results = 0;
+    for (int r = 0; r < ROUNDS; r++) {
+        ppg_window_init(&w, PPG_RATE_HZ);
+        for (int i = 0; i < PPG_TRACE_LEN; i++) {
+            ppg_result_t res;
+            if (ppg_window_push(&w, ppg_ir_trace[i], ppg_red_trace[i], &res)) {
+                sink += res.spo2 + res.heart_rate;
+                win_results++;
+            }
+        }
+    }
+    int64_t win_us = now_us() - start;
+    (void)sink;
+
+    printf("shift + recompute: %d results, %.2f us each\n", ref_results, (double)ref_us / ref_results);
+    printf("window:            %d results, %.2f us each\n", win_results, (double)win_us / win_results);
+    if (win_results != ref_results) {
+        printf("result counts differ\n");
+        failed = 1;
+    }
+    printf(failed ? "PPG check FAILED\n" : "PPG check passed\n");
+    return failed;
+}
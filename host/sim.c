@@ -0,0 +1,201 @@
+// Scripted sensor inputs for the host build. The ADC channels and the GPIO
+// inputs are driven from here; the DHT11 and the Uno read sim_get().
+#include "sim.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "host.h"
+#include "hw_time.h"
+
+// As wired in main.c
+#define SIM_RCWL_GPIO    GPIO_NUM_32
+#define SIM_BUTTON_GPIO  GPIO_NUM_4
+#define SIM_ACS712_ADC   ADC_CHANNEL_6
+#define SIM_LIGHT_ADC    ADC_CHANNEL_7
+#define SIM_SOIL_ADC     ADC_CHANNEL_0
+
+// ACS712 5 A module behind the 660 per mille divider, 3.3 V ADC full scale
+#define ACS712_ZERO_MV   2500
+#define ACS712_MV_PER_A  185
+#define DIVIDER_PERMILLE 660
+#define ADC_FULL_MV      3300
+#define MAINS_HZ         50
+
+#define MAX_EVENTS       256
+
+static const char *TAG = "sim";
+
+static const char *const names[SIM_INPUT_COUNT] = {
+    "temperature", "humidity", "soil", "light", "current", "motion", "button",
+    "heart_rate", "spo2", "finger", "dht_fail", "uno", "load",
+};
+
+static const float defaults[SIM_INPUT_COUNT] = {
+    [SIM_TEMPERATURE] = 24, [SIM_HUMIDITY] = 55, [SIM_SOIL] = 2000, [SIM_LIGHT] = 1800,
+    [SIM_CURRENT] = 0.5f, [SIM_HEART_RATE] = 72, [SIM_SPO2] = 97, [SIM_FINGER] = 1, [SIM_UNO] = 1,
+};
+
+typedef struct {
+    float from, to;
+    int64_t t0_us, t1_us;       // ramp from t0 to t1
+} input_t;
+
+typedef struct {
+    int64_t at_us;
+    sim_input_t input;
+    float value;
+    int64_t ramp_us;
+} event_t;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static input_t inputs[SIM_INPUT_COUNT];
+static event_t events[MAX_EVENTS];
+static int event_count;
+
+const char *sim_input_name(sim_input_t input)
+{
+    return input < SIM_INPUT_COUNT ? names[input] : "?";
+}
+
+static float value_at(const input_t *in, int64_t t_us)
+{
+    if (t_us >= in->t1_us) return in->to;
+    if (t_us <= in->t0_us) return in->from;
+    return in->from + (in->to - in->from) * (float)(t_us - in->t0_us) / (float)(in->t1_us - in->t0_us);
+}
+
+float sim_get(sim_input_t input)
+{
+    pthread_mutex_lock(&lock);
+    float v = value_at(&inputs[input], hw_time_us());
+    pthread_mutex_unlock(&lock);
+    return v;
+}
+
+float load_test_rate(void)
+{
+    return sim_get(SIM_LOAD);
+}
+
+static void apply(const event_t *e)
+{
+    int64_t now = hw_time_us();
+    pthread_mutex_lock(&lock);
+    input_t *in = &inputs[e->input];
+    in->from = value_at(in, now);
+    in->to = e->value;
+    in->t0_us = now;
+    in->t1_us = now + e->ramp_us;
+    pthread_mutex_unlock(&lock);
+
+    if (e->input == SIM_MOTION) hw_gpio_host_drive(SIM_RCWL_GPIO, e->value != 0);
+    if (e->input == SIM_BUTTON) hw_gpio_host_drive(SIM_BUTTON_GPIO, e->value == 0);   // active low
+    ESP_LOGI(TAG, "%s -> %g%s", names[e->input], e->value, e->ramp_us ? " (ramp)" : "");
+}
+
+static int event_cmp(const void *a, const void *b)
+{
+    const event_t *x = a, *y = b;
+    return (x->at_us > y->at_us) - (x->at_us < y->at_us);
+}
+
+static esp_err_t load(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        ESP_LOGE(TAG, "Cannot open script %s", path);
+        return ESP_ERR_NOT_FOUND;
+    }
+    char line[160];
+    int lineno = 0;
+    esp_err_t err = ESP_OK;
+    while (fgets(line, sizeof(line), f) && err == ESP_OK) {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        double t, value, ramp = 0;
+        char name[32], word[16];
+        int n = sscanf(line, "%lf %31s %lf %15s %lf", &t, name, &value, word, &ramp);
+        if (n <= 0) continue;
+        int input = 0;
+        while (input < SIM_INPUT_COUNT && (n < 2 || strcmp(name, names[input]) != 0)) input++;
+        if (n < 3 || input == SIM_INPUT_COUNT || (n > 3 && (n != 5 || strcmp(word, "ramp") != 0))) {
+            ESP_LOGE(TAG, "%s:%d: expected \"<seconds> <input> <value> [ramp <seconds>]\"", path, lineno);
+            err = ESP_ERR_INVALID_ARG;
+        } else if (event_count == MAX_EVENTS) {
+            ESP_LOGE(TAG, "%s: more than %d events", path, MAX_EVENTS);
+            err = ESP_ERR_NO_MEM;
+        } else {
+            events[event_count++] = (event_t){ (int64_t)(t * 1e6), input, (float)value, (int64_t)(ramp * 1e6) };
+        }
+    }
+    fclose(f);
+    // stable for equal times, so a script can press and release in order
+    for (int i = 1; i < event_count; i++) {
+        for (int j = i; j > 0 && event_cmp(&events[j - 1], &events[j]) > 0; j--) {
+            event_t e = events[j];
+            events[j] = events[j - 1];
+            events[j - 1] = e;
+        }
+    }
+    return err;
+}
+
+static void sim_task(void *arg)
+{
+    for (int i = 0; i < event_count; i++) {
+        int64_t wait_us = events[i].at_us - hw_time_us();
+        if (wait_us > 0) vTaskDelay(pdMS_TO_TICKS((wait_us + 999) / 1000));
+        apply(&events[i]);
+    }
+    vTaskDelete(NULL);
+}
+
+static uint32_t noise_state = 12345;
+
+static int noise(int amplitude)
+{
+    noise_state = noise_state * 1103515245u + 12345u;
+    return (int)((noise_state >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+static int adc_raw(int mv)
+{
+    int raw = mv * 4095 / ADC_FULL_MV + noise(2);
+    return raw < 0 ? 0 : raw > 4095 ? 4095 : raw;
+}
+
+// Called by the ADC conversion thread for every sample
+static int adc_source(adc_channel_t channel, int64_t t_us, void *ctx)
+{
+    switch (channel) {
+    case SIM_ACS712_ADC: {
+        float amps = sim_get(SIM_CURRENT) * sqrtf(2) * sinf(2 * (float)M_PI * MAINS_HZ * (t_us % 1000000) / 1e6f);
+        return adc_raw((int)((ACS712_ZERO_MV + ACS712_MV_PER_A * amps) * DIVIDER_PERMILLE / 1000));
+    }
+    case SIM_LIGHT_ADC:
+        return adc_raw((int)sim_get(SIM_LIGHT) * ADC_FULL_MV / 4095);
+    case SIM_SOIL_ADC:
+        return adc_raw((int)sim_get(SIM_SOIL) * ADC_FULL_MV / 4095);
+    default:
+        return 0;
+    }
+}
+
+esp_err_t sim_start(const char *script)
+{
+    for (int i = 0; i < SIM_INPUT_COUNT; i++) inputs[i].from = inputs[i].to = defaults[i];
+    if (script) {
+        esp_err_t err = load(script);
+        if (err != ESP_OK) return err;
+        ESP_LOGI(TAG, "%d events from %s", event_count, script);
+    }
+    hw_adc_host_set_source(adc_source, NULL);
+    if (event_count > 0) xTaskCreate(sim_task, "sim", 4096, NULL, 3, NULL);
+    return ESP_OK;
+}
@@ -0,0 +1,41 @@
+#ifndef SIM_H
+#define SIM_H
+
+// The world around the board in the host build: what the sensors see,
+// changed over time by a script. Script lines are
+//     <seconds> <input> <value> [ramp <seconds>]
+// e.g. "30 soil 3200 ramp 20"; '#' starts a comment.
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+typedef enum {
+    SIM_TEMPERATURE = 0,    // degrees C, as the firmware reports it
+    SIM_HUMIDITY,           // %, as the firmware reports it
+    SIM_SOIL,               // raw 12-bit reading, higher is drier
+    SIM_LIGHT,              // raw 12-bit reading
+    SIM_CURRENT,            // A rms, 50 Hz
+    SIM_MOTION,             // RCWL-0516 output, 0 or 1
+    SIM_BUTTON,             // 1 while the test button is held
+    SIM_HEART_RATE,         // bpm
+    SIM_SPO2,               // %
+    SIM_FINGER,             // 1 with a finger on the MAX30102
+    SIM_DHT_FAIL,           // 1: the DHT11 does not answer
+    SIM_UNO,                // 0: the Uno is unplugged
+    SIM_LOAD,               // synthetic readings per second (CONFIG_LOAD_TEST)
+    SIM_INPUT_COUNT,
+} sim_input_t;
+
+// Load the script (NULL for none) and start applying it
+esp_err_t sim_start(const char *script);
+float sim_get(sim_input_t input);
+const char *sim_input_name(sim_input_t input);
+
+// SIM_LOAD, for the load driver in main.c
+float load_test_rate(void);
+
+// The simulated Uno on UART2 (sim_uno.c)
+void sim_uno_start(void);
+void sim_uno_log_stats(void);
+
+#endif // SIM_H
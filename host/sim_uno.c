@@ -0,0 +1,190 @@
+// The Arduino Uno on UART2, as eee4464-uno.ino behaves: HELLO every second
+// at 9600, switch to the rate the ESP32 asks for after acknowledging it,
+// fall back to 9600 after 5 s without hearing from it, and stream MAX30102
+// samples at 25 Hz, five to a packet. Bytes take their time on the wire.
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "host.h"
+#include "hw_time.h"
+#include "ppg_window.h"
+#include "sim.h"
+#include "spo2_algorithm.h"
+#include "uart_frame.h"
+#include "uno_link.h"
+
+#define UNO_UART            UART_NUM_2
+#define UNO_MAX_BAUD        250000
+#define UNO_TIMEOUT_US      5000000
+#define HELLO_PERIOD_US     1000000
+#define SAMPLES_PER_PACKET  5
+#define SAMPLE_PERIOD_US    (1000000 / PPG_RATE_HZ)
+#define IR_DC               110000
+#define RED_DC              90000
+#define PERFUSION           0.02f
+
+static const char *TAG = "sim_uno";
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static uart_framer_t framer;        // what the ESP32 sends, under lock
+static uint32_t baud = UNO_LINK_BAUD_DEFAULT;
+static uint32_t baud_requested;     // BAUD_SET seen, ACK not sent yet
+static int64_t last_rx_us;
+static uint8_t tx_seq;
+static int64_t line_free_us;        // end of the last byte on the wire
+
+static struct {
+    uint32_t packets;
+    uint32_t bytes;
+    uint32_t switches;
+    uint32_t fallbacks;
+    uint32_t rx_packets;
+    uint32_t rx_bad;
+} stats;
+
+// Bytes from the ESP32; anything sent at another rate is lost
+static void on_tx(uart_port_t port, const uint8_t *data, size_t len, uint32_t esp_baud, void *ctx)
+{
+    pthread_mutex_lock(&lock);
+    if (esp_baud == baud && sim_get(SIM_UNO) != 0) {
+        uart_framer_feed(&framer, data, len);
+        uart_frame_t frame;
+        while (uart_framer_next(&framer, &frame)) {
+            uno_packet_t p;
+            if (uno_link_decode((const uint8_t *)frame.data, frame.len, &p) != UNO_LINK_OK) {
+                stats.rx_bad++;
+                continue;
+            }
+            stats.rx_packets++;
+            last_rx_us = hw_time_us();
+            if (p.type == UNO_PKT_BAUD_SET && p.baud.baud <= UNO_MAX_BAUD) baud_requested = p.baud.baud;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+// Wait for the line like Serial.write() does, then deliver
+static void send(uno_packet_t *p)
+{
+    uint8_t buf[UNO_LINK_MAX_FRAME];
+    p->seq = tx_seq++;
+    size_t len = uno_link_encode(p, buf, sizeof(buf));
+    if (len == 0) return;
+    int64_t now = hw_time_us();
+    if (line_free_us < now) line_free_us = now;
+    line_free_us += (int64_t)len * 10 * 1000000 / baud;     // 8N1
+    int64_t wait_us = line_free_us - now;
+    if (wait_us >= 1000) vTaskDelay(pdMS_TO_TICKS(wait_us / 1000));
+    hw_uart_host_receive(UNO_UART, buf, len, baud);
+    stats.packets++;
+    stats.bytes += len;
+}
+
+static void set_baud(uint32_t new_baud)
+{
+    pthread_mutex_lock(&lock);
+    baud = new_baud;
+    baud_requested = 0;
+    uart_framer_reset(&framer);
+    last_rx_us = hw_time_us();
+    pthread_mutex_unlock(&lock);
+}
+
+// SpO2 -> the red/IR ratio the Maxim table maps to it
+static float spo2_ratio(float spo2)
+{
+    int best = 0;
+    for (int i = 1; i < (int)sizeof(uch_spo2_table); i++) {
+        if (fabsf(uch_spo2_table[i] - spo2) < fabsf(uch_spo2_table[best] - spo2)) best = i;
+    }
+    return best / 100.0f;
+}
+
+static float pulse_shape(float phase)
+{
+    float a = (phase - 0.18f) / 0.08f, b = (phase - 0.38f) / 0.12f;
+    return expf(-a * a) + 0.2f * expf(-b * b);
+}
+
+static uno_sample_t make_sample(float *phase)
+{
+    static uint32_t noise = 99;
+    noise = noise * 1103515245u + 12345u;
+    int jitter = (int)((noise >> 16) % 41) - 20;
+    if (sim_get(SIM_FINGER) == 0) return (uno_sample_t){ 1500 + jitter, 1200 + jitter };
+    *phase += sim_get(SIM_HEART_RATE) / 60 / PPG_RATE_HZ;
+    *phase -= floorf(*phase);
+    float p = pulse_shape(*phase);
+    return (uno_sample_t){
+        .ir = (uint32_t)(IR_DC * (1 - PERFUSION * p) + jitter),
+        .red = (uint32_t)(RED_DC * (1 - PERFUSION * spo2_ratio(sim_get(SIM_SPO2)) * p) + jitter),
+    };
+}
+
+static void uno_task(void *arg)
+{
+    int64_t next_hello = hw_time_us(), next_sample = next_hello;
+    float phase = 0;
+    uno_packet_t samples = { .type = UNO_PKT_SAMPLES };
+    while (1) {
+        int64_t now = hw_time_us();
+        if (sim_get(SIM_UNO) == 0) {    // unplugged: comes back reset
+            if (baud != UNO_LINK_BAUD_DEFAULT) set_baud(UNO_LINK_BAUD_DEFAULT);
+            samples.samples.count = 0;
+            next_hello = next_sample = now;
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+
+        pthread_mutex_lock(&lock);
+        uint32_t requested = baud_requested;
+        bool quiet = baud != UNO_LINK_BAUD_DEFAULT && now - last_rx_us > UNO_TIMEOUT_US;
+        pthread_mutex_unlock(&lock);
+        if (requested) {
+            uno_packet_t ack = { .type = UNO_PKT_BAUD_ACK, .baud.baud = requested };
+            send(&ack);
+            set_baud(requested);
+            stats.switches++;
+            ESP_LOGI(TAG, "Now at %u baud", (unsigned)requested);
+        } else if (quiet) {
+            set_baud(UNO_LINK_BAUD_DEFAULT);
+            stats.fallbacks++;
+            ESP_LOGW(TAG, "ESP32 quiet, back to %d baud", UNO_LINK_BAUD_DEFAULT);
+        }
+
+        if (now >= next_hello) {
+            uno_packet_t hello = { .type = UNO_PKT_HELLO, .hello = { UNO_LINK_VERSION, UNO_MAX_BAUD } };
+            send(&hello);
+            next_hello += HELLO_PERIOD_US;
+        }
+        while (now >= next_sample) {
+            samples.samples.s[samples.samples.count++] = make_sample(&phase);
+            next_sample += SAMPLE_PERIOD_US;
+            if (samples.samples.count == SAMPLES_PER_PACKET) {
+                send(&samples);
+                samples.samples.count = 0;
+            }
+        }
+        int64_t wait_us = (next_sample < next_hello ? next_sample : next_hello) - hw_time_us();
+        vTaskDelay(wait_us > 1000 ? pdMS_TO_TICKS(wait_us / 1000) : 1);
+    }
+}
+
+void sim_uno_start(void)
+{
+    uart_framer_init_binary(&framer);
+    hw_uart_host_attach(UNO_UART, on_tx, NULL);
+    xTaskCreate(uno_task, "sim_uno", 4096, NULL, 9, NULL);
+}
+
+void sim_uno_log_stats(void)
+{
+    pthread_mutex_lock(&lock);
+    ESP_LOGI(TAG, "Uno: %u baud, sent %u packets (%u bytes), received %u (%u bad), %u switches, %u fallbacks",
+             (unsigned)baud, (unsigned)stats.packets, (unsigned)stats.bytes, (unsigned)stats.rx_packets,
+             (unsigned)stats.rx_bad, (unsigned)stats.switches, (unsigned)stats.fallbacks);
+    pthread_mutex_unlock(&lock);
+}
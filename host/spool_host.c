@@ -0,0 +1,26 @@
+// spool_storage_partition() for the host build: the data partitions of
+// partitions.csv are files in the state directory, so the spool survives
+// restarts like it does in flash.
+#include <stdio.h>
+#include <string.h>
+#include "host.h"
+#include "spool.h"
+
+#define SECTOR_SIZE 4096
+
+static const struct {
+    const char *label;
+    size_t size;
+} partitions[] = {
+    { "spool", 0x40000 },
+};
+
+esp_err_t spool_storage_partition(spool_storage_t *storage, const char *label) {
+    for (size_t i = 0; i < sizeof(partitions) / sizeof(partitions[0]); i++) {
+        if (strcmp(partitions[i].label, label) != 0) continue;
+        char path[256];
+        snprintf(path, sizeof(path), "%s/%s.bin", host_options.state_dir ? host_options.state_dir : ".", label);
+        return spool_storage_file(storage, path, partitions[i].size, SECTOR_SIZE);
+    }
+    return ESP_ERR_NOT_FOUND;
+}
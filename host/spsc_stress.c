@@ -0,0 +1,111 @@
+// Stress test of components/spsc_ring on real threads: several producer and
+// consumer pairs at once, random batch sizes, producers that pause so the
+// consumers park in spsc_ring_wait(). Every item must arrive once, in order
+// and intact, and no consumer may sleep through a push.
+#include <stdio.h>
+#include <stdlib.h>
+#include "hw_time.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "spsc_ring.h"
+
+#define PAIRS          4
+#define ITEMS          1000000
+#define RING_ITEMS     64
+#define WAIT_TICKS     pdMS_TO_TICKS(2000)   // far more than any pause below
+
+typedef struct {
+    uint32_t seq;
+    uint32_t check;     // ~seq
+    uint8_t pad[16];
+} item_t;
+
+typedef struct {
+    spsc_ring_t ring;
+    item_t buf[RING_ITEMS];
+    uint32_t seed;
+    uint32_t received;
+    uint32_t errors;
+    uint32_t parked;        // waits that had to sleep
+    uint32_t slept_through; // waits that ran to the timeout with items pushed
+    SemaphoreHandle_t done;
+} pair_t;
+
+static uint32_t next_rand(uint32_t *seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 16;
+}
+
+static void producer(void *arg)
+{
+    pair_t *p = arg;
+    item_t batch[32];
+    uint32_t seed = p->seed, seq = 0;
+    while (seq < ITEMS) {
+        size_t n = 1 + next_rand(&seed) % 32;
+        if (n > ITEMS - seq) n = ITEMS - seq;
+        for (size_t i = 0; i < n; i++) batch[i] = (item_t){ .seq = seq + i, .check = ~(seq + i) };
+        size_t pushed = spsc_ring_push(&p->ring, batch, n);
+        seq += pushed;
+        if (pushed < n) {
+            taskYIELD();
+        } else if (next_rand(&seed) % 4096 == 0) {
+            vTaskDelay(1);      // let the consumer drain and park
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+static void consumer(void *arg)
+{
+    pair_t *p = arg;
+    item_t got[32];
+    uint32_t seed = p->seed ^ 0x5a5a;
+    while (p->received < ITEMS) {
+        if (spsc_ring_count(&p->ring) == 0) {
+            p->parked++;
+            int64_t start = hw_time_us();
+            bool ready = spsc_ring_wait(&p->ring, WAIT_TICKS);
+            if (!ready && hw_time_us() - start >= WAIT_TICKS * 1000LL) p->slept_through++;
+        }
+        size_t n = spsc_ring_pop(&p->ring, got, 1 + next_rand(&seed) % 32);
+        for (size_t i = 0; i < n; i++, p->received++) {
+            if (got[i].seq != p->received || got[i].check != ~p->received) p->errors++;
+        }
+    }
+    xSemaphoreGive(p->done);
+    vTaskDelete(NULL);
+}
+
+int main(void)
+{
+    static pair_t pairs[PAIRS];
+    int64_t start = hw_time_us();
+    for (int i = 0; i < PAIRS; i++) {
+        pair_t *p = &pairs[i];
+        if (!spsc_ring_init(&p->ring, p->buf, sizeof(item_t), RING_ITEMS)) return 1;
+        p->seed = 1 + i;
+        p->done = xSemaphoreCreateBinary();
+        xTaskCreate(consumer, "consumer", 4096, p, 5, NULL);
+        xTaskCreate(producer, "producer", 4096, p, 5, NULL);
+    }
+
+    int failed = 0;
+    for (int i = 0; i < PAIRS; i++) {
+        pair_t *p = &pairs[i];
+        if (xSemaphoreTake(p->done, pdMS_TO_TICKS(60000)) != pdTRUE) {
+            printf("pair %d: stuck after %u of %u items\n", i, (unsigned)p->received, ITEMS);
+            failed = 1;
+            continue;
+        }
+        printf("pair %d: %u items, %u out of order or torn, %u parked waits, %u slept through a push\n", i,
+               (unsigned)p->received, (unsigned)p->errors, (unsigned)p->parked, (unsigned)p->slept_through);
+        if (p->errors || p->slept_through) failed = 1;
+    }
+    double s = (hw_time_us() - start) / 1e6;
+    printf("%d pairs, %.2f s, %.0f items/s per pair\n", PAIRS, s, ITEMS / s);
+    printf(failed ? "SPSC stress FAILED\n" : "SPSC stress passed\n");
+    return failed;
+}
@@ -0,0 +1,45 @@
+// The network side of main.h for the host build: the host is always
+// "connected", and the cloud endpoint comes from the command line.
+#include <stdio.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "cloudflare_api.h"
+#include "host.h"
+#include "main.h"
+
+EventGroupHandle_t wifi_event_group;
+const int WIFI_CONNECTED_BIT = BIT0;
+
+static const char *TAG = "wifi_setup";
+
+bool is_ap_mode_enabled(void)
+{
+    return false;
+}
+
+void wifi_reset_check(void)
+{
+}
+
+void wifi_setup(void)
+{
+    wifi_event_group = xEventGroupCreate();
+    if (host_options.http_origin) {
+        const cloudflare_api_config_t cfg = { .base_url = host_options.http_origin, .reuse_connections = true };
+        ESP_ERROR_CHECK(cloudflare_api_configure(&cfg));
+        ESP_LOGI(TAG, "Cloud API at %s", host_options.http_origin);
+    } else {
+        ESP_LOGW(TAG, "No --http origin, cloud requests will fail (no TLS on the host)");
+    }
+    xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_BIT);
+}
+
+void print_chip_info(void)
+{
+    struct utsname u;
+    if (uname(&u) == 0) {
+        ESP_LOGI("Device", "Host build on %s %s %s, %ld CPU(s)", u.sysname, u.release, u.machine,
+                 sysconf(_SC_NPROCESSORS_ONLN));
+    }
+}
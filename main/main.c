@@ -6,58 +6,64 @@
 
 #include <stdio.h>
 #include <inttypes.h>
-#include "sdkconfig.h"
+#include <stdlib.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "esp_chip_info.h"
-#include "esp_flash.h"
-#include "esp_system.h"
 #include <sys/param.h>
 #include <time.h>
+#include <sys/time.h>
 #include <string.h>
 #include "dht.h"
-#include "esp_netif_ip_addr.h"
-
-// ESP-IDF WiFi AP/Web config includes
-#include "esp_wifi.h"
-#include "esp_event.h"
-#include "nvs_flash.h"
 #include "esp_log.h"
-#include "esp_netif.h"
-#include "esp_http_server.h"
-#include "cJSON.h"
-#include "driver/gpio.h"
-#include "esp_adc/adc_oneshot.h"
-#include "esp_adc/adc_continuous.h"
-#include "esp_adc/adc_cali.h"
-#include "esp_adc/adc_cali_scheme.h"
-
-#include "esp_sntp.h"
-#include "esp_sntp.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
 #include <math.h>
 // API
 #include "cloudflare_api.h"
+#include "sensor_batch.h"
+#include "control_scan.h"
+#include "http_pqueue.h"
+#include "http_msg_store.h"
+#include "spool.h"
+#include "telemetry_codec.h"
+#include "publish_policy.h"
+#include "adc_sampler.h"
+#include "ac_meter.h"
+#include "adc_lut.h"
+#include "sensor_sched.h"
+#include "motion_rcwl.h"
+#include "uart_frame.h"
+#include "uno_link.h"
+#include "ppg_window.h"
+#include "metrics.h"
+#include "spsc_ring.h"
+#include "trace.h"
+// hardware and network, esp-idf on the device and host/ in the host build
+#include "hw_gpio.h"
+#include "hw_uart.h"
+#include "hw_mqtt.h"
+#include "hw_time.h"
+#include "main.h"
 
 #include "freertos/event_groups.h"
-#include "driver/temperature_sensor.h"
-
 #include "freertos/queue.h"
-#include "mqtt_client.h"
-#include "esp_task_wdt.h"
-#include "driver/uart.h"
 // --------------------------- Button Interrupt/Task Implementation -----------------------------
 #include "freertos/queue.h"
 #include "freertos/semphr.h"
+#include <stdarg.h>
+#include <stdatomic.h>
 
 #define CONFIG_USE_MQTT // use mqtt instead of HTTP for sensor data
+// #define CONFIG_TELEMETRY_BINARY // one packed frame per cycle on iot/<device_id>/telemetry
 // define GPIO
 #define LED_STATUS_GPIO GPIO_NUM_5
 
 #define SOIL_RELAY_GPIO GPIO_NUM_25
 #define TEST_BUTTON_GPIO GPIO_NUM_4 // GPIO4 for test button
-#define MAX_CONTROLS_BUFFER 1024  // 從 256 增加到 1024
 
 #define RCWL_GPIO GPIO_NUM_32 // RCWL-0516 sensor GPIO
+#define RCWL_MIN_HIGH_MS 10   // shorter highs on the radar output are noise
+#define RCWL_HOLD_MS 3000     // motion ends this long after the output falls
 #define DHT_GPIO GPIO_NUM_0
 
 #define PHOTORESISTOR_ADC_WIDTH ADC_WIDTH_BIT_12
@@ -66,6 +72,16 @@
 #define ACS712_ADC_CHANNEL      ADC_CHANNEL_6   // GPIO34
 #define ACS712_ADC_WIDTH        ADC_BITWIDTH_12
 #define ACS712_ADC_ATTEN        ADC_ATTEN_DB_12
+// The ACS712 output (0-5 V, 2.5 V at 0 A) reaches the 3.3 V ADC input through
+// a divider; the old raw / 4095 * 5 scaling implied a ratio of 0.66.
+#define ADC_FULL_SCALE_MV       3300    // only if the chip has no eFuse calibration
+#ifndef ACS712_DIVIDER_PERMILLE
+#define ACS712_DIVIDER_PERMILLE 660     // mV at the ADC pin per V of sensor output
+#endif
+#define ACS712_MV_PER_A         185     // 5 A module
+#define ACS712_RMS_CYCLES       10      // RMS window, 200 ms at 50 Hz
+#define MAINS_HZ                50
+#define MAINS_VOLTS             220     // for energy only, the line voltage is not measured
 
 #define PHOTORESISTOR_ADC       ADC_CHANNEL_7   // GPIO15
 #define PHOTORESISTOR_ADC_ATTEN ADC_ATTEN_DB_12
@@ -73,13 +89,21 @@
 #define SOIL_SENSOR_ADC         ADC_CHANNEL_0   // GPIO36
 #define SOIL_SENSOR_ADC_WIDTH   ADC_BITWIDTH_12
 #define SOIL_SENSOR_ADC_ATTEN   ADC_ATTEN_DB_12
+
+// All three analog inputs are on ADC1 and sampled continuously by DMA;
+// readers take the filtered value of the last ADC_RING_SAMPLES samples.
+#define ADC_SAMPLE_FREQ_HZ      24000   // 8 kHz per channel, 160 samples per 50 Hz cycle
+#define ADC_RING_SAMPLES        512     // 64 ms per channel
 // ___________________________________________________
 #define BUTTON_TASK_STACK 8192   // TLS + HTTP needs larger stack
-#define WIFI_RESET_GPIO GPIO_NUM_16
+#define TRACE_DUMP_TASK_STACK 4096
 #define EX_UART_NUM UART_NUM_2
 #define UART_TX_PIN GPIO_NUM_21
 #define UART_RX_PIN GPIO_NUM_22
 #define UART_BUF_SIZE 1024
+#define UNO_LINK_BAUD        250000  // exact from the Uno's 16 MHz clock; 115200 is 2 % off
+#define UNO_LINK_PING_MS     1000
+#define UNO_LINK_TIMEOUT_MS  5000    // nothing valid from the Uno for this long: back to 9600
 
 // MQTT topics for sensors
 #define MQTT_TOPIC_TEMPERATURE "iot/temperature"
@@ -89,7 +113,33 @@
 #define MQTT_TOPIC_LIGHT       "iot/light"
 #define MQTT_TOPIC_MOTION      "iot/motion"
 #define MQTT_TOPIC_HEART_RATE  "iot/heart_rate"
+#define MQTT_TOPIC_SPO2        "iot/spo2"
 #define MQTT_TOPIC_CURRENT     "iot/current"
+// With CONFIG_TELEMETRY_BINARY each sampling cycle goes out as one
+// telemetry_codec frame instead of a JSON message per sensor
+#define TELEMETRY_TOPIC_FMT    "iot/%d/telemetry"
+#ifdef CONFIG_LOAD_TEST
+#define LOAD_TOPIC_FMT         "iot/%d/load"         // synthetic readings, see load_sample()
+#define LOAD_STATS_TOPIC_FMT   "iot/%d/load_stats"   // what the device made and dropped of them
+#endif
+
+// Broker override for benches against a local Mosquitto (e.g. "mqtt://192.168.1.10:1883")
+#ifndef MQTT_BROKER_URI
+#define MQTT_BROKER_URI "mqtts://6bdeb9e091414b898b8a01d7ab63bcd2.s1.eu.hivemq.cloud:8883"
+#endif
+
+// Controls are pushed on iot/<device_id>/control as the same JSON rows
+// /api/controls returns (one object or an array), e.g.
+//   {"control_id":446400104,"control_type":"switch","state":"on"}
+//   {"device_id":4464001,"dry_threshold":2900,"wet_threshold":1400}
+// Every applied message is acknowledged on iot/<device_id>/control/ack.
+// While subscribed, /api/controls is only polled to reconcile missed messages.
+#define CONTROL_TOPIC_FMT     "iot/%d/control"
+#define CONTROL_ACK_TOPIC_FMT "iot/%d/control/ack"
+#define CONTROL_POLL_MS       1000
+#ifndef CONTROL_RECONCILE_MS  // set to CONTROL_POLL_MS for a polling-only baseline
+#define CONTROL_RECONCILE_MS  60000
+#endif
 /*
 Topic: iot/current {"current":0.29}
 Topic: iot/humidity {"humidity":61.0}
@@ -104,16 +154,19 @@ static TaskHandle_t button_task_handle = NULL;
 
 // Manual relay state
 static bool relay_state = false;
-bool is_ap_mode_enabled(void);
 
+#ifdef ESP_PLATFORM
 extern const uint8_t ca_cert_pem_start[] asm("_binary_ca_cert_pem_start");
-extern const uint8_t ca_cert_pem_end[]   asm("_binary_ca_cert_pem_end");
-// Global event group for WiFi connection
-EventGroupHandle_t wifi_event_group;
-const int WIFI_CONNECTED_BIT = BIT0;
+#define MQTT_BROKER_CERT ((const char *)ca_cert_pem_start)
+#else
+#define MQTT_BROKER_CERT NULL   // the host client has no TLS
+#endif
 
-static const char *TAG = "wifi_setup";
-static char controls_buf[MAX_CONTROLS_BUFFER];
+// /api/controls is parsed as it streams in, whatever its size
+static control_scan_t controls_scan;
+// handle_cloud_controls has applied the response it accepted, so a 304 for
+// it changes nothing
+static bool controls_scan_applied = false;
 
 // register device information
 char url_control[128];
@@ -135,6 +188,7 @@ struct Sensor  sensors[] = {
         {device_id * 100 + 6,"Microwave Radar Sensor" ,"Radar"},
         {device_id * 100 + 7,"Photoresistor Sensor" ,"Light"},
         {device_id * 100 + 8,"Heart Rate Sensor" ,"HeartRate"},
+        {device_id * 100 + 9,"Pulse Oximeter" ,"SpO2"},
 };
 const int sensor_count = sizeof(sensors) / sizeof(sensors[0]);
 
@@ -142,438 +196,742 @@ const int sensor_count = sizeof(sensors) / sizeof(sensors[0]);
 int dry_threshold = 3000;
 int wet_threshold = 2000;
 bool pump_on = false;
+// Pump and threshold changes come from MQTT, the control poll, the button
+// and the soil hysteresis; each is applied whole under control_lock
+static SemaphoreHandle_t control_lock = NULL;
 
 
 // async HTTP client
-typedef struct {
-    char endpoint[64];
-    char json_body[256];
-} http_request_t;
-// Increase queue length for more capacity
+// Outbound requests are held in one FIFO per class (see http_pqueue.h).
+// Controls are dispatched first; when the queue is full the oldest
+// telemetry is evicted before anything more important. A queued control
+// is never dropped: a newer PUT to the same control takes its place, and
+// a control with no room left is refused back to the caller.
+// The queue only carries handles; endpoint and body are formatted straight
+// into a shared arena (see http_msg_store.h) and sized to fit.
 #define HTTP_QUEUE_LENGTH 40
-static QueueHandle_t http_request_queue = NULL;
+#define HTTP_MSG_ARENA_SIZE 6144
+#define HTTP_MSG_MAX_BODY   2048
+static http_pqueue_t http_request_queue;
+static uint32_t http_msg_arena[HTTP_MSG_ARENA_SIZE / sizeof(uint32_t)];
+static http_msg_store_t http_msg_store;
+static SemaphoreHandle_t http_queue_lock = NULL;
+static TaskHandle_t http_task_handle = NULL;
+static const http_class_config_t http_class_config[HTTP_CLASS_COUNT] = {
+    [HTTP_CLASS_CONTROL]   = { .capacity = 8,  .max_age_ms = 0, .never_evict = true },   // never stale
+    [HTTP_CLASS_MESSAGE]   = { .capacity = 16, .max_age_ms = 60000 },
+    [HTTP_CLASS_TELEMETRY] = { .capacity = 32, .max_age_ms = 30000 },
+};
+
+// /api/sensor_data uploads are coalesced into one JSON array POST.
+// A batch is sent when it holds SENSOR_BATCH_MAX_COUNT readings or has been
+// open for SENSOR_BATCH_WINDOW_MS, whichever comes first.
+#define SENSOR_BATCH_MAX_COUNT  9     // one reading from each entry in sensors[]
+#define SENSOR_BATCH_WINDOW_MS  2000
+#define SENSOR_BATCH_MAX_BYTES  2048
+static atomic_uint sensor_batch_rejected;  // readings too big for an empty batch
+
+// Dropped requests of a class; a telemetry reading no batch could hold is
+// dropped too. Caller holds http_queue_lock.
+static uint32_t http_class_dropped(int c) {
+    uint32_t dropped = http_pqueue_dropped(&http_request_queue, c);
+    if (c == HTTP_CLASS_TELEMETRY) dropped += atomic_load(&sensor_batch_rejected);
+    return dropped;
+}
+
+// While WiFi or MQTT is down, readings are appended to the "spool" flash
+// partition instead of being lost. Once the uplink is back they are replayed
+// to /api/sensor_data as large batches, at most one per SPOOL_DRAIN_INTERVAL_MS.
+#define SPOOL_PARTITION_LABEL   "spool"
+#define SPOOL_DRAIN_BATCH_BYTES 3072
+#define SPOOL_DRAIN_INTERVAL_MS 1000
+#define SPOOL_RETRY_MS          10000
+static spool_t telemetry_spool;
+static SemaphoreHandle_t spool_lock = NULL;
+static bool spool_ready = false;
+static volatile bool mqtt_connected = false;
+
+static char control_topic[32];
+static char control_ack_topic[40];
+static control_scan_t mqtt_control_scan;   // fed from HW_MQTT_DATA fragments
+static bool mqtt_control_in_progress = false;
+static volatile bool control_subscribed = false;
+static volatile bool control_resync = false;  // poll once right after (re)subscribing
+
+// QoS, retain and rate of each telemetry topic, indexed by telemetry_field_t.
+// Slow-moving values are only sent when they move by more than the deadband,
+// with a refresh every max_interval_ms so retained values do not go stale.
+// Pump state is retained so a new subscriber sees it at once.
+#define TELEMETRY_FRAME_TOPIC TELEMETRY_FIELD_COUNT   // the CONFIG_TELEMETRY_BINARY frame
+#ifdef CONFIG_LOAD_TEST
+#define LOAD_TOPIC            (TELEMETRY_FRAME_TOPIC + 1)
+#define PUBLISH_TOPIC_COUNT   (LOAD_TOPIC + 1)
+static char load_topic[32];
+static char load_stats_topic[32];
+#else
+#define PUBLISH_TOPIC_COUNT   (TELEMETRY_FRAME_TOPIC + 1)
+#endif
+static char telemetry_topic[32];
+static publish_topic_t publish_topics[PUBLISH_TOPIC_COUNT] = {
+    [TELEMETRY_LIGHT]       = { MQTT_TOPIC_LIGHT,       { .qos = 0, .change_only = true, .deadband = 50,   .max_interval_ms = 60000 } },
+    [TELEMETRY_MOTION]      = { MQTT_TOPIC_MOTION,      { .qos = 1, .change_only = true, .max_interval_ms = 60000 } },
+    [TELEMETRY_CURRENT]     = { MQTT_TOPIC_CURRENT,     { .qos = 0, .change_only = true, .deadband = 0.05, .max_interval_ms = 60000 } },
+    [TELEMETRY_TEMPERATURE] = { MQTT_TOPIC_TEMPERATURE, { .qos = 0, .change_only = true, .deadband = 0.3,  .min_interval_ms = 10000, .max_interval_ms = 300000 } },
+    [TELEMETRY_HUMIDITY]    = { MQTT_TOPIC_HUMIDITY,    { .qos = 0, .change_only = true, .deadband = 1.0,  .min_interval_ms = 10000, .max_interval_ms = 300000 } },
+    [TELEMETRY_MOISTURE]    = { MQTT_TOPIC_MOISTURE,    { .qos = 0, .change_only = true, .deadband = 20,   .max_interval_ms = 60000 } },
+    [TELEMETRY_PUMP]        = { MQTT_TOPIC_PUMP,        { .qos = 1, .retain = true, .change_only = true, .max_interval_ms = 300000 } },
+    [TELEMETRY_HEART_RATE]  = { MQTT_TOPIC_HEART_RATE,  { .qos = 0 } },
+    [TELEMETRY_SPO2]        = { MQTT_TOPIC_SPO2,        { .qos = 0 } },
+    [TELEMETRY_FRAME_TOPIC] = { telemetry_topic,        { .qos = 1 } },
+#ifdef CONFIG_LOAD_TEST
+    [LOAD_TOPIC]            = { load_topic,             { .qos = 0 } },
+#endif
+};
+static publish_table_t publish_table;
+static SemaphoreHandle_t publish_lock = NULL;
+// Binary frames come from second_loop_task and the motion callback; the
+// lock keeps their seq in publish order
+static SemaphoreHandle_t telemetry_lock = NULL;
+
+// Runtime metrics. Counters are fed where things happen (uploader, MQTT
+// publisher); the "metrics" sensor driver samples tasks, heap, queues, the
+// sensor scheduler and the Uno link. Served at /metrics by wifi_setup.c and
+// published as JSON on iot/<device_id>/metrics.
+#define METRICS_SAMPLE_MS   5000
+#ifndef METRICS_PUBLISH_MS
+#define METRICS_PUBLISH_MS  60000
+#endif
+#define METRICS_TOPIC_FMT   "iot/%d/metrics"
+#define METRICS_MAX_TASKS   24
+metrics_t metrics;
+static char metrics_topic[32];
+static const uint32_t upload_ms_bounds[] = { 50, 100, 250, 500, 1000, 2500, 5000, 10000 };
+static struct {
+    metric_t *http_ok, *http_failed, *upload_ms, *readings_uploaded;
+    metric_t *mqtt_published, *mqtt_refused, *mqtt_acked, *mqtt_expired, *mqtt_disconnects, *spooled;
+} app_metrics;
+
+// DHT results, from the DHT task to the sensing loop. One read is requested
+// per period, so a result only finds the ring full if the loop has stalled;
+// it is dropped then and the loop takes the newest it has.
+static spsc_ring_t dht_results;
+static dht_reading_t dht_results_buf[2];
+
+static void dht_done(const dht_reading_t *reading, void *ctx)
+{
+    spsc_ring_push(&dht_results, reading, 1);
+}
 
 
 // ACS712 current sensor configuration
 float zero_offset = 2.4;
+static ac_meter_t acs712_meter;   // fed by the ADC sampler task
+// Calibrated raw -> mV for ADC1 at 12 dB, the attenuation of every channel
+static adc_lut_t adc1_lut;
 static bool registered = false; // flag to indicate if device is registered
 
-
-static bool is_softap_mode = false;
-
 // Global MQTT client handle
-static esp_mqtt_client_handle_t mqtt_client;
+static hw_mqtt_handle_t mqtt_client;
 
-static adc_oneshot_unit_handle_t adc1_handle;
+static const adc_sampler_channel_t adc_channels[] = {
+    { ACS712_ADC_CHANNEL, ACS712_ADC_ATTEN,        ADC_RING_SAMPLES, 4 },
+    { PHOTORESISTOR_ADC,  PHOTORESISTOR_ADC_ATTEN, ADC_RING_SAMPLES, 6 },
+    { SOIL_SENSOR_ADC,    SOIL_SENSOR_ADC_ATTEN,   ADC_RING_SAMPLES, 6 },
+};
 
-// Improved soil moisture reading with validation using One-shot ADC API
-int read_soil_sensor() {
-    adc_oneshot_chan_cfg_t chan_config = {
-        .bitwidth = SOIL_SENSOR_ADC_WIDTH,
-        .atten = SOIL_SENSOR_ADC_ATTEN
-    };
-    adc_oneshot_config_channel(adc1_handle, SOIL_SENSOR_ADC, &chan_config);
+// ACS712 output in mV for a raw reading
+static int32_t acs712_raw_to_mv(int raw) {
+    return (int32_t)adc_lut_mv(&adc1_lut, raw) * 1000 / ACS712_DIVIDER_PERMILLE;
+}
 
-    int readings[5] = {0};
-    for (int i = 0; i < 5; i++) {
-        adc_oneshot_read(adc1_handle, SOIL_SENSOR_ADC, &readings[i]);
-        vTaskDelay(pdMS_TO_TICKS(5));
-    }
+static float photoresistor_volts(int raw) {
+    return adc_lut_mv(&adc1_lut, raw) / 1000.0f;
+}
 
-    for (int i = 0; i < 4; i++) {
-        for (int j = i + 1; j < 5; j++) {
-            if (readings[i] > readings[j]) {
-                int temp = readings[i];
-                readings[i] = readings[j];
-                readings[j] = temp;
-            }
-        }
-    }
+static void acs712_sink(uint16_t raw, void *ctx) {
+    ac_meter_push(ctx, acs712_raw_to_mv(raw));
+}
 
-    return readings[2];
+// Soil moisture, median of the newest samples so a spike on the long probe
+// lead cannot trip the pump as a mean would; 0 (invalid) until sampled
+int read_soil_sensor() {
+    int raw = 0;
+    adc_sampler_read(SOIL_SENSOR_ADC, ADC_SAMPLER_MEDIAN, &raw);
+    return raw;
 }
 
-bool is_ap_mode_enabled(void) {
-    return is_softap_mode;
+// Evicted and expired handles give their arena space back
+static void http_queue_drop_cb(const void *item, void *ctx) {
+    http_msg_free(&http_msg_store, *(const http_msg_handle_t *)item);
 }
 
-// New function to safely send to queue with priority handling
-bool send_to_http_queue(http_request_t* req, int priority, TickType_t wait_ticks) {
-    // Check if this is a high priority request (like button control)
-    if (priority > 0) {
-        // For high priority requests, try to make space if queue is almost full
-        UBaseType_t spaces = uxQueueSpacesAvailable(http_request_queue);
-        if (spaces < 3) { // Almost full
-            http_request_t dummy;
-            ESP_LOGW("HTTP_QUEUE", "Queue almost full (%u spaces left), removing old items", spaces);
-            // Try to remove up to 5 items to make space for important requests
-            for (int i = 0; i < 5 && spaces < 5; i++) {
-                if (xQueueReceive(http_request_queue, &dummy, 0) == pdTRUE) {
-                    ESP_LOGW("HTTP_QUEUE", "Dropped request to %s to make space", dummy.endpoint);
-                    spaces++;
-                } else {
-                    break; // No more items to remove
-                }
+// Format a body into the arena, evicting lower-priority queued requests if
+// the arena is full. Called with http_queue_lock held.
+static http_msg_handle_t http_msg_vformat(http_class_t cls, const char *endpoint,
+                                          const char *fmt, va_list args) {
+    http_msg_handle_t handle = HTTP_MSG_INVALID;
+    size_t room = HTTP_MSG_MAX_BODY;
+    while (1) {
+        size_t avail = http_msg_max_body(&http_msg_store, endpoint);
+        size_t max_body = avail < room ? avail : room;
+        char *body = (max_body > 0) ? http_msg_reserve(&http_msg_store, endpoint, max_body, &handle) : NULL;
+        if (body) {
+            va_list copy;
+            va_copy(copy, args);
+            int len = vsnprintf(body, max_body + 1, fmt, copy);
+            va_end(copy);
+            if (len >= 0 && (size_t)len <= max_body) {
+                http_msg_commit(&http_msg_store, handle, len);
+                return handle;
             }
+            http_msg_free(&http_msg_store, handle);
+            if (len < 0 || len > HTTP_MSG_MAX_BODY) {
+                ESP_LOGE("HTTP_QUEUE", "Body for %s is %d bytes, limit is %d", endpoint, len, HTTP_MSG_MAX_BODY);
+                return HTTP_MSG_INVALID;
+            }
+            room = len; // exact size is known now
+            if (http_msg_max_body(&http_msg_store, endpoint) >= room) continue;
+        }
+        if (http_pqueue_evict(&http_request_queue, cls) < 0) {
+            return HTTP_MSG_INVALID;
         }
-        // Try to send with higher timeout for important requests
-        return xQueueSend(http_request_queue, req, pdMS_TO_TICKS(300)) == pdTRUE;
     }
-
-    // For regular priority requests
-    return xQueueSend(http_request_queue, req, wait_ticks) == pdTRUE;
 }
 
-// Simple wrapper to publish MQTT sensor data
-static void mqtt_publish_sensor(esp_mqtt_client_handle_t client, const char *topic, const char *payload) {
-    if (client && topic && payload) {
-        esp_mqtt_client_publish(client, topic, payload, 0, 1, 0);
-    }
+// Controls coalesce per endpoint, i.e. per control_id; telemetry and
+// messages are all kept
+static uint32_t http_coalesce_key(http_class_t cls, const char *endpoint) {
+    if (cls != HTTP_CLASS_CONTROL) return 0;
+    uint32_t hash = 2166136261u;   // FNV-1a
+    for (const char *p = endpoint; *p; p++) hash = (hash ^ (uint8_t)*p) * 16777619u;
+    return hash ? hash : 1;
 }
 
-// Improved HTTP request task with better error handling and throughput
-void http_request_task(void *arg) {
+// Queue a request in its priority class; the body is printf-formatted.
+// Never blocks for queue space: a full class drops its oldest entry, a full
+// queue or arena drops the oldest lower-priority entry. A control replaces
+// a queued control for the same endpoint and is otherwise refused rather
+// than push out another control. Returns false only if the request was refused.
+bool send_to_http_queue(http_class_t cls, const char *endpoint, const char *fmt, ...) {
+    if (http_queue_lock == NULL) return false;
+
+    trace_span_t span = trace_begin("queue", "http_push");
+    xSemaphoreTake(http_queue_lock, portMAX_DELAY);
+    va_list args;
+    va_start(args, fmt);
+    http_msg_handle_t handle = http_msg_vformat(cls, endpoint, fmt, args);
+    va_end(args);
+    http_pq_result_t result = HTTP_PQ_REJECTED;
+    if (handle != HTTP_MSG_INVALID) {
+        result = http_pqueue_push_keyed(&http_request_queue, cls, &handle, http_coalesce_key(cls, endpoint),
+                                        pdTICKS_TO_MS(xTaskGetTickCount()));
+        if (result == HTTP_PQ_REJECTED) http_msg_free(&http_msg_store, handle);
+    }
+    xSemaphoreGive(http_queue_lock);
+    trace_end(&span);
 
-    http_request_t req;
-    int consecutive_failures = 0;
-    // esp_task_wdt_add(NULL);
+    if (result == HTTP_PQ_REJECTED) {
+        ESP_LOGW("HTTP_QUEUE", "No room for %s, refused", endpoint);
+        return false;
+    }
+    if (result == HTTP_PQ_REPLACED) {
+        ESP_LOGW("HTTP_QUEUE", "Queue full, evicted an older request to make room for %s", endpoint);
+    } else if (result == HTTP_PQ_COALESCED) {
+        ESP_LOGI("HTTP_QUEUE", "Replaced a queued request to %s with newer state", endpoint);
+    }
+    if (http_task_handle) xTaskNotifyGive(http_task_handle);
+    return true;
+}
 
+// Take the next request in priority order, waiting up to wait_ticks.
+// The record stays valid in the arena until release_http_request().
+static bool receive_from_http_queue(http_msg_handle_t *handle, TickType_t wait_ticks) {
+    TickType_t start = xTaskGetTickCount();
     while (1) {
+        trace_span_t span = trace_begin("queue", "http_pop");
+        xSemaphoreTake(http_queue_lock, portMAX_DELAY);
+        int cls = http_pqueue_pop(&http_request_queue, handle, pdTICKS_TO_MS(xTaskGetTickCount()));
+        xSemaphoreGive(http_queue_lock);
+        trace_end(&span);
+        if (cls >= 0) return true;
+
+        TickType_t waited = xTaskGetTickCount() - start;
+        if (waited >= wait_ticks) return false;
+        ulTaskNotifyTake(pdTRUE, wait_ticks - waited);
+    }
+}
 
-        // Only wait 5 seconds maximum to check queue status periodically
-        if (xQueueReceive(http_request_queue, &req, pdMS_TO_TICKS(5000)) == pdTRUE) {
-
-            // esp_task_wdt_reset();
-            ESP_LOGI("HTTP_REQUEST", "Processing request to %s", req.endpoint);
-
-            // Process control requests first with proper method (PUT for controls)
-            if (strstr(req.endpoint, "/api/controls?control_id=") != NULL) {
-                esp_err_t result = cloudflare_put_json(req.endpoint, req.json_body);
-                if (result != ESP_OK) {
-                    ESP_LOGE("HTTP_REQUEST", "PUT control request failed: %s", esp_err_to_name(result));
-                    // For failed control requests, retry once immediately before continuing
-                    vTaskDelay(pdMS_TO_TICKS(100));
-                    result = cloudflare_put_json(req.endpoint, req.json_body);
-                    if (result != ESP_OK) {
-                        ESP_LOGE("HTTP_REQUEST", "Control request retry failed: %s", esp_err_to_name(result));
-                    }
-                }
-            } else {
-                // For non-control requests, use POST
-                esp_err_t result;
-                if (strstr(req.endpoint, "/api/sensor_data") != NULL) {
-                    result = cloudflare_post_json_nowait(req.endpoint, req.json_body);
-                } else {
-                    result = cloudflare_post_json(req.endpoint, req.json_body);
-                }
-                if (result == ESP_OK) {
-                    consecutive_failures = 0;  // Reset failure counter on success
-                } else {
-                    consecutive_failures++;
-                    ESP_LOGW("HTTP_REQUEST", "Request failed (%d consecutive failures)", consecutive_failures);
-
-                    // Back off on repeated failures
-                    if (consecutive_failures > 5) {
-                        vTaskDelay(pdMS_TO_TICKS(500 * (consecutive_failures - 5)));
-                        // Cap counter to avoid excessive delays
-                        if (consecutive_failures > 10) consecutive_failures = 10;
-                    }
-                }
-            }
-
-            // Report queue status periodically (every 10 requests)
-            static int request_count = 0;
-            if (++request_count % 10 == 0) {
-                UBaseType_t spaces = uxQueueSpacesAvailable(http_request_queue);
-                UBaseType_t msgs = HTTP_QUEUE_LENGTH - spaces;
-                ESP_LOGI("HTTP_QUEUE", "Status: %u messages in queue, %u spaces available",
-                          msgs, spaces);
-            }
+static void release_http_request(http_msg_handle_t handle) {
+    xSemaphoreTake(http_queue_lock, portMAX_DELAY);
+    http_msg_free(&http_msg_store, handle);
+    xSemaphoreGive(http_queue_lock);
+}
 
-            // Small delay between requests to avoid overwhelming server
-            vTaskDelay(pdMS_TO_TICKS(20)); // Reduced from 50ms
-        } else {
-            // No messages for 5 seconds, log queue status
-            UBaseType_t spaces = uxQueueSpacesAvailable(http_request_queue);
-            UBaseType_t msgs = HTTP_QUEUE_LENGTH - spaces;
-            ESP_LOGI("HTTP_QUEUE", "Idle - Status: %u messages in queue, %u spaces available",
-                     msgs, spaces);
-        }
+static void log_http_queue_status(const char *state) {
+    static const char *class_names[HTTP_CLASS_COUNT] = { "control", "message", "telemetry" };
+    xSemaphoreTake(http_queue_lock, portMAX_DELAY);
+    http_msg_store_stats_t arena;
+    http_msg_store_get_stats(&http_msg_store, &arena);
+    ESP_LOGI("HTTP_QUEUE", "%s - %u/%u messages in queue, arena %u/%u bytes (peak %u)", state,
+             http_pqueue_total(&http_request_queue), HTTP_QUEUE_LENGTH,
+             arena.used, HTTP_MSG_ARENA_SIZE, arena.peak_used);
+    for (int c = 0; c < HTTP_CLASS_COUNT; c++) {
+        http_class_stats_t stats;
+        http_pqueue_get_stats(&http_request_queue, c, &stats);
+        ESP_LOGI("HTTP_QUEUE", "  %-9s queued %u, sent %" PRIu32 ", dropped %" PRIu32 " (evicted %" PRIu32 ", rejected %" PRIu32 ", expired %" PRIu32 "), coalesced %" PRIu32,
+                 class_names[c], http_pqueue_count(&http_request_queue, c), stats.dispatched,
+                 http_pqueue_dropped(&http_request_queue, c), stats.evicted, stats.rejected, stats.expired,
+                 stats.coalesced);
     }
+    xSemaphoreGive(http_queue_lock);
 }
 
-// predeclaration of functions
-void on_wifi_connected_notify(void) {
-    // TODO: control LED or other peripherals here
-
+// Publish on a publish_topics[] topic with its QoS and retain flag.
+// False if the client refused it.
+static bool mqtt_publish_topic(int topic, const char *payload, int len) {
+    const publish_topic_t *t = &publish_topics[topic];
+    trace_span_t span = trace_begin("mqtt", t->topic);
+    int msg_id = hw_mqtt_publish(mqtt_client, t->topic, payload, len, t->policy.qos, t->policy.retain);
+    trace_end(&span);
+    if (msg_id < 0) {
+        metrics_add(app_metrics.mqtt_refused, 1);
+        return false;
+    }
+    metrics_add(app_metrics.mqtt_published, 1);
+    xSemaphoreTake(publish_lock, portMAX_DELAY);
+    publish_policy_published(&publish_table, topic, msg_id);
+    xSemaphoreGive(publish_lock);
+    return true;
 }
-void on_post_success() {
-    // ESP_LOGI("Upload", "Data posted successfully.");
+
+static void log_publish_stats(void) {
+    xSemaphoreTake(publish_lock, portMAX_DELAY);
+    ESP_LOGI("MQTT", "Publish stats per topic:");
+    for (int i = 0; i < publish_table.count; i++) {
+        const publish_topic_t *t = &publish_topics[i];
+        if (t->stats.published == 0 && t->stats.suppressed == 0) continue;
+        ESP_LOGI("MQTT", "  %-20s qos %d published %" PRIu32 ", suppressed %" PRIu32 ", acked %" PRIu32 ", failed %" PRIu32,
+                 t->topic, t->policy.qos, t->stats.published, t->stats.suppressed, t->stats.acked, t->stats.failed);
+    }
+    xSemaphoreGive(publish_lock);
 }
 
-static void setup_uart2(void);
-static void uart_event_task(void *pvParameters);
-static void process_arduino_data(const char *data);
+static bool set_pump_from_cloud(const char *state, const char *source);
+static void set_thresholds_from_cloud(int dry, int wet, const char *source);
+
+static void publish_control_ack(hw_mqtt_handle_t client) {
+    char ack[96];
+    xSemaphoreTake(control_lock, portMAX_DELAY);
+    snprintf(ack, sizeof(ack), "{\"pump_state\":\"%s\",\"dry_threshold\":%d,\"wet_threshold\":%d}",
+             pump_on ? "on" : "off", dry_threshold, wet_threshold);
+    xSemaphoreGive(control_lock);
+    // enqueue does not block the caller on the network
+    hw_mqtt_enqueue(client, control_ack_topic, ack, 0, 1, false);
+}
 
-// WiFi event handler
-static void wifi_event_handler(void* arg, esp_event_base_t event_base,
-                              int32_t event_id, void* event_data)
-{
-    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        esp_wifi_connect();
-    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
-        ESP_LOGI(TAG, "WiFi Connected.");
-        is_softap_mode = false; // Clear softAP mode flag
-
-        // Optional: Set bit here if you want, but only set on IP_EVENT_STA_GOT_IP for real connection
-    } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
-        ESP_LOGI(TAG, "Got IP. WiFi connection SUCCESS!");
-        esp_netif_ip_info_t ip_info = ((ip_event_got_ip_t*)event_data)->ip_info;
-        ESP_LOGI(TAG, "Got IP Address: " IPSTR, IP2STR(&ip_info.ip));
-        xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_BIT);
-        on_wifi_connected_notify();
-        is_softap_mode = false; // Clear softAP mode flag
-    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        ESP_LOGI(TAG, "Disconnected. Retry...");
-        esp_wifi_connect();
-    }
-}
-// wifi scan
-esp_err_t wifi_scan_get_handler(httpd_req_t *req) {
-    uint16_t ap_num = 0;
-    esp_err_t err;
-
-    err = esp_wifi_scan_start(NULL, true);
-    if (err != ESP_OK) {
-        httpd_resp_send_500(req);
-        return err;
+// Apply a control message once its last fragment has arrived. Large
+// messages come in several HW_MQTT_DATA events; only the first has the topic.
+static void on_control_message(const hw_mqtt_event_t *event) {
+    if (event->current_data_offset == 0) {
+        mqtt_control_in_progress = event->topic_len == (int)strlen(control_topic) &&
+                                   strncmp(event->topic, control_topic, event->topic_len) == 0;
+        if (!mqtt_control_in_progress) return;
+        control_scan_feed(NULL, 0, &mqtt_control_scan);
     }
-    err = esp_wifi_scan_get_ap_num(&ap_num);
-    if (err != ESP_OK || ap_num == 0) {
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_send(req, "[]", HTTPD_RESP_USE_STRLEN);
-        return ESP_OK;
+    if (!mqtt_control_in_progress) return;
+    control_scan_feed(event->data, event->data_len, &mqtt_control_scan);
+    if (event->current_data_offset + event->data_len < event->total_data_len) return;
+    mqtt_control_in_progress = false;
+
+    if (!control_scan_finish(&mqtt_control_scan)) {
+        ESP_LOGW("ControlSync", "Malformed control message near byte %u",
+                 (unsigned)json_stream_error_offset(&mqtt_control_scan.js));
+        return;
     }
-
-    wifi_ap_record_t *ap_list = malloc(sizeof(wifi_ap_record_t) * ap_num);
-    if (!ap_list) {
-        httpd_resp_send_500(req);
-        return ESP_ERR_NO_MEM;
+    bool applied = false;
+    if (mqtt_control_scan.pump_found && mqtt_control_scan.pump_is_switch) {
+        set_pump_from_cloud(mqtt_control_scan.pump_state, "MQTT");
+        applied = true;
     }
-    err = esp_wifi_scan_get_ap_records(&ap_num, ap_list);
-    if (err != ESP_OK) {
-        free(ap_list);
-        httpd_resp_send_500(req);
-        return err;
+    if (mqtt_control_scan.thresholds_found) {
+        set_thresholds_from_cloud(mqtt_control_scan.dry_threshold, mqtt_control_scan.wet_threshold, "MQTT");
+        applied = true;
     }
-
-    cJSON *root = cJSON_CreateArray();
-    for (int i = 0; i < ap_num; ++i) {
-        cJSON *ap = cJSON_CreateObject();
-        cJSON_AddStringToObject(ap, "ssid", (const char*)ap_list[i].ssid);
-        cJSON_AddNumberToObject(ap, "rssi", ap_list[i].rssi);
-        cJSON_AddItemToArray(root, ap);
+    if (!applied) {
+        ESP_LOGI("ControlSync", "Control message has nothing for this device");
+        return;
     }
-    char *out = cJSON_PrintUnformatted(root);
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, out, HTTPD_RESP_USE_STRLEN);
-
-    free(out);
-    cJSON_Delete(root);
-    free(ap_list);
-    return ESP_OK;
+    publish_control_ack(event->client);
 }
 
-// HTTP POST handler for WiFi config
-esp_err_t wifi_config_post_handler(httpd_req_t *req) {
-    char content[100];
-    int ret = httpd_req_recv(req, content, MIN(req->content_len, sizeof(content) - 1));
-    if (ret <= 0) return ESP_FAIL;
-
-    content[ret] = '\0';
-    ESP_LOGI(TAG, "Received WiFi config: %s", content);
-
-    char ssid[32] = {0}, password[64] = {0};
-    sscanf(content, "ssid=%31[^&]&password=%63s", ssid, password);
+static void mqtt_event_handler(const hw_mqtt_event_t *event, void *ctx) {
+    hw_mqtt_event_id_t event_id = event->id;
+    if (event_id == HW_MQTT_CONNECTED) {
+        ESP_LOGI("MQTT", "Connected");
+        mqtt_connected = true;
+        hw_mqtt_subscribe(event->client, control_topic, 1);
+    } else if (event_id == HW_MQTT_SUBSCRIBED) {
+        ESP_LOGI("MQTT", "Subscribed to %s, control polling slowed to %d s",
+                 control_topic, CONTROL_RECONCILE_MS / 1000);
+        control_subscribed = true;
+        control_resync = true; // catch up on anything sent while we were away
+    } else if (event_id == HW_MQTT_DISCONNECTED) {
+        ESP_LOGW("MQTT", "Disconnected, spooling telemetry");
+        metrics_add(app_metrics.mqtt_disconnects, 1);
+        mqtt_connected = false;
+        control_subscribed = false;
+        mqtt_control_in_progress = false;
+    } else if (event_id == HW_MQTT_DATA) {
+        on_control_message(event);
+    } else if (event_id == HW_MQTT_PUBLISHED || event_id == HW_MQTT_DELETED) {
+        xSemaphoreTake(publish_lock, portMAX_DELAY);
+        if (event_id == HW_MQTT_PUBLISHED) {
+            publish_policy_acked(&publish_table, event->msg_id);
+            metrics_add(app_metrics.mqtt_acked, 1);
+        } else {
+            publish_policy_failed(&publish_table, event->msg_id);
+            metrics_add(app_metrics.mqtt_expired, 1);
+        }
+        xSemaphoreGive(publish_lock);
+    }
+}
 
-    ESP_LOGI(TAG, "Try to connect: ssid=[%s] pwd=[%s]", ssid, password);
+static bool uplink_up(void) {
+    return mqtt_connected && (xEventGroupGetBits(wifi_event_group) & WIFI_CONNECTED_BIT);
+}
 
-    wifi_config_t wifi_config = {0};
-    strncpy((char *)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid));
-    strncpy((char *)wifi_config.sta.password, password, sizeof(wifi_config.sta.password));
+// Store a reading in /api/sensor_data form, stamped with the time it was taken
+static void spool_reading(int sensor_id, const char *data) {
+    if (!spool_ready) return;
+    trace_span_t span = trace_begin("spool", "append");
+    char record[SPOOL_MAX_RECORD];
+    int len = snprintf(record, sizeof(record), "{\"sensor_id\":%d,\"device_id\":%d,\"ts\":%lld,\"data\":%s}",
+                       sensor_id, device_id, (long long)time(NULL), data);
+    if (len <= 0 || len >= (int)sizeof(record)) return;
+
+    xSemaphoreTake(spool_lock, portMAX_DELAY);
+    esp_err_t err = spool_append(&telemetry_spool, record, len);
+    xSemaphoreGive(spool_lock);
+    trace_end(&span);
+    if (err != ESP_OK) {
+        ESP_LOGW("SPOOL", "Append failed: %s", esp_err_to_name(err));
+    } else {
+        metrics_add(app_metrics.spooled, 1);
+    }
+}
 
-    esp_wifi_stop();
-    //ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    // this allows both AP and STA mode
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
-    esp_wifi_start();
-    ESP_ERROR_CHECK(esp_wifi_connect());
+// sensors[] entry of each telemetry field
+static const int telemetry_sensor[TELEMETRY_FIELD_COUNT] = {
+    [TELEMETRY_LIGHT] = 6, [TELEMETRY_MOTION] = 5, [TELEMETRY_CURRENT] = 4, [TELEMETRY_TEMPERATURE] = 0,
+    [TELEMETRY_HUMIDITY] = 1, [TELEMETRY_MOISTURE] = 2, [TELEMETRY_PUMP] = 3, [TELEMETRY_HEART_RATE] = 7,
+    [TELEMETRY_SPO2] = 8,
+};
 
-    httpd_resp_send(req, "Trying to connect...", HTTPD_RESP_USE_STRLEN);
-    return ESP_OK;
+// Publish a sensor reading, or spool it while the uplink is down
+static void publish_reading(telemetry_field_t field, const char *payload) {
+    if (uplink_up()) {
+        mqtt_publish_topic(field, payload, 0);
+    } else {
+        spool_reading(sensors[telemetry_sensor[field]].id, payload);
+    }
 }
 
-// HTTP GET handler for root page (simple WiFi config form)
-esp_err_t root_get_handler(httpd_req_t *req) {
-    const char resp[] =
-    "<html><body>"
-    "<form method='POST' action='/config'>"
-    "SSID: <input name='ssid'><br><br>"
-    "Password: <input name='password' type='password'><br><br>"
-    "<input type='submit' value='Connect'></form>"
-    "<hr><h3>Select WiFi:</h3>"
-    "<div id='wifi-list'></div>"
-    "<script>"
-    "fetch('/scan').then(r=>r.json()).then(list=>{"
-    "list.sort((a,b)=>b.rssi-a.rssi);"
-    "let d=document.getElementById('wifi-list');"
-    "d.innerHTML=list.map(ap=>`<button onclick='askpw(\"${ap.ssid}\")'>${ap.ssid} (${ap.rssi})</button>`).join('<br>');"
-    "});"
-    "function askpw(ssid){"
-    "let pw=prompt('Please enter password:', '');"
-    "if(pw!=null){"
-    "let f=document.createElement('form');"
-    "f.method='POST'; f.action='/config';"
-    "f.innerHTML=`<input name=ssid value='${ssid}'><input name=password value='${pw}'>`;"
-    "document.body.appendChild(f); f.submit();"
-    "}}"
-    "</script></body></html>";
-
-httpd_resp_send(req, resp, HTTPD_RESP_USE_STRLEN);
-    return ESP_OK;
+// Whether the publish policy of topic lets a reading of value through now
+static bool publish_allowed(int topic, float value) {
+    xSemaphoreTake(publish_lock, portMAX_DELAY);
+    bool send = publish_policy_check(&publish_table, topic, value, pdTICKS_TO_MS(xTaskGetTickCount()));
+    xSemaphoreGive(publish_lock);
+    return send;
 }
 
-// Forward declaration for softAP setup
-void setup_softap();
-void  register_device();
+// Record a reading of this cycle if its publish policy lets it through.
+// JSON mode publishes it right away; binary mode holds it in the frame
+// until telemetry_flush().
+static void report_reading(telemetry_frame_t *frame, telemetry_field_t field, float value) {
+    if (!publish_allowed(field, value)) return;
+
+    telemetry_frame_set(frame, field, value);
+#ifndef CONFIG_TELEMETRY_BINARY
+    char payload[64];
+    trace_span_t span = trace_begin("format", "telemetry_json");
+    int len = telemetry_field_json(frame, field, payload, sizeof(payload));
+    trace_end(&span);
+    if (len > 0) {
+        publish_reading(field, payload);
+    }
+#endif
+}
 
-void wifi_setup(void) {
+// End of a sampling cycle: send the frame and start the next one
+static void telemetry_flush(telemetry_frame_t *frame) {
+#ifdef CONFIG_TELEMETRY_BINARY
+    static atomic_uint telemetry_seq;
+    if (frame->present) {
+        if (uplink_up()) {
+            uint8_t buf[TELEMETRY_FRAME_MAX];
+            xSemaphoreTake(telemetry_lock, portMAX_DELAY);
+            frame->timestamp = (uint32_t)time(NULL);
+            frame->seq = (uint16_t)atomic_fetch_add(&telemetry_seq, 1);
+            size_t len = telemetry_encode(frame, buf, sizeof(buf));
+            mqtt_publish_topic(TELEMETRY_FRAME_TOPIC, (const char *)buf, len);
+            xSemaphoreGive(telemetry_lock);
+        } else {
+            // the spool and its replay stay in /api/sensor_data form
+            char payload[64];
+            for (int f = 0; f < TELEMETRY_FIELD_COUNT; f++) {
+                if (telemetry_field_json(frame, f, payload, sizeof(payload)) > 0) {
+                    spool_reading(sensors[telemetry_sensor[f]].id, payload);
+                }
+            }
+        }
+    }
+#endif
+    telemetry_frame_init(frame, device_id, 0, 0);
+}
 
-    ESP_ERROR_CHECK(nvs_flash_init());
-    ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
+// Replay spooled readings once the uplink is back
+static void spool_drain_task(void *arg) {
+    static char batch_buf[SPOOL_DRAIN_BATCH_BYTES];
+    char record[SPOOL_MAX_RECORD + 1];
+    sensor_batch_t batch;
+    sensor_batch_init(&batch, batch_buf, sizeof(batch_buf));
 
-    // Create event group for WiFi connection
-    wifi_event_group = xEventGroupCreate();
+    while (1) {
+        if (!uplink_up() || spool_pending(&telemetry_spool) == 0) {
+            vTaskDelay(pdMS_TO_TICKS(SPOOL_DRAIN_INTERVAL_MS));
+            continue;
+        }
 
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
-            ESP_EVENT_ANY_ID, &wifi_event_handler, NULL, NULL));
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT,
-        ESP_EVENT_ANY_ID, &wifi_event_handler, NULL, NULL));
+        // Take as many of the oldest records as fit in one POST
+        xSemaphoreTake(spool_lock, portMAX_DELAY);
+        spool_pos_t pos = spool_tail(&telemetry_spool);
+        spool_pos_t end = pos;
+        size_t len;
+        while (spool_read(&telemetry_spool, &pos, record, sizeof(record) - 1, &len) == ESP_OK) {
+            record[len] = '\0';
+            if (!sensor_batch_add(&batch, record, 0)) break;
+            end = pos;
+        }
+        xSemaphoreGive(spool_lock);
 
-    esp_netif_create_default_wifi_sta();
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+        int count = batch.count;
+        if (count == 0) {
+            vTaskDelay(pdMS_TO_TICKS(SPOOL_DRAIN_INTERVAL_MS));
+            continue;
+        }
+        esp_err_t result = cloudflare_post_json("/api/sensor_data", sensor_batch_finish(&batch));
+        sensor_batch_reset(&batch);
+        if (result != ESP_OK) {
+            ESP_LOGW("SPOOL", "Replay of %d readings failed: %s", count, esp_err_to_name(result));
+            vTaskDelay(pdMS_TO_TICKS(SPOOL_RETRY_MS));
+            continue;
+        }
 
-    // Enable WiFi config storage in flash (NVS)
-    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_FLASH));
+        xSemaphoreTake(spool_lock, portMAX_DELAY);
+        spool_consume(&telemetry_spool, &end);
+        uint32_t left = spool_pending(&telemetry_spool);
+        xSemaphoreGive(spool_lock);
+        ESP_LOGI("SPOOL", "Replayed %d readings, %" PRIu32 " left", count, left);
+        vTaskDelay(pdMS_TO_TICKS(SPOOL_DRAIN_INTERVAL_MS));
+    }
+}
 
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_start());
+static void spool_setup(void) {
+    spool_storage_t storage;
+    spool_lock = xSemaphoreCreateMutex();
+    esp_err_t err = spool_storage_partition(&storage, SPOOL_PARTITION_LABEL);
+    if (err == ESP_OK) err = spool_open(&telemetry_spool, &storage);
+    if (err != ESP_OK) {
+        ESP_LOGW("SPOOL", "Spool unavailable (%s), telemetry is dropped while offline", esp_err_to_name(err));
+        return;
+    }
+    spool_ready = true;
+    ESP_LOGI("SPOOL", "%u KB spool, %" PRIu32 " readings waiting", (unsigned)(storage.size / 1024),
+             spool_pending(&telemetry_spool));
+    xTaskCreate(spool_drain_task, "spool_drain", 6144, NULL, 4, NULL);
+}
 
-    // Wait for connection with 15s timeout
-    if (xEventGroupWaitBits(wifi_event_group, WIFI_CONNECTED_BIT, pdFALSE, pdFALSE, pdMS_TO_TICKS(15000)) & WIFI_CONNECTED_BIT) {
-        ESP_LOGI(TAG, "WiFi connected within 15s.");
-		is_softap_mode = false;
-        // Device registration now handled in main_loop_task to avoid main‑task stack overflow
+// Two batch buffers: one collects readings while the other is uploading
+typedef struct {
+    sensor_batch_t batch;
+    char buf[SENSOR_BATCH_MAX_BYTES];
+    atomic_bool sending;
+    int64_t submitted_us;
+} upload_batch_t;
+static upload_batch_t sensor_batches[2];
+static int open_batch = 0;
+static atomic_int upload_failures;   // consecutive, updated by completions
+
+// Completion callbacks run in the cloudflare_api engine task
+static void on_batch_uploaded(esp_err_t result, int status, void *arg) {
+    upload_batch_t *b = arg;
+    metrics_observe(app_metrics.upload_ms, (uint32_t)((hw_time_us() - b->submitted_us) / 1000));
+    if (result != ESP_OK) {
+        metrics_add(app_metrics.http_failed, 1);
+        ESP_LOGW("HTTP_REQUEST", "Sensor batch of %d readings failed: %s", b->batch.count, esp_err_to_name(result));
     } else {
-        ESP_LOGW(TAG, "WiFi not connected in 15s, switching to softAP mode.");
-        setup_softap();
+        metrics_add(app_metrics.http_ok, 1);
+        metrics_add(app_metrics.readings_uploaded, b->batch.count);
+        ESP_LOGI("HTTP_REQUEST", "Sensor batch of %d readings uploaded", b->batch.count);
     }
+    sensor_batch_reset(&b->batch);
+    atomic_store(&b->sending, false);
+}
 
+static void on_request_done(esp_err_t result, int status, void *arg) {
+    http_msg_handle_t handle = (http_msg_handle_t)(uintptr_t)arg;
+    metrics_add(result == ESP_OK ? app_metrics.http_ok : app_metrics.http_failed, 1);
+    if (result == ESP_OK) {
+        atomic_store(&upload_failures, 0);  // Reset failure counter on success
+    } else {
+        int failures = atomic_fetch_add(&upload_failures, 1) + 1;
+        ESP_LOGW("HTTP_REQUEST", "Request to %s failed (%d consecutive failures)",
+                 http_msg_endpoint(&http_msg_store, handle), failures);
+    }
+    release_http_request(handle);
+}
 
+// Upload the coalesced /api/sensor_data readings as one JSON array POST and
+// collect into the other buffer. False if that buffer is still uploading or
+// the engine has no room; the batch then stays open for the next try.
+static bool flush_sensor_batch(void) {
+    upload_batch_t *b = &sensor_batches[open_batch];
+    if (b->batch.count == 0) return true;
+    if (atomic_load(&sensor_batches[open_batch ^ 1].sending)) return false;
+    cloudflare_request_t upload = {
+        .method = CLOUDFLARE_POST,
+        .endpoint = "/api/sensor_data",
+        .json_body = sensor_batch_finish(&b->batch),
+        .max_retries = 1,
+        .done_cb = on_batch_uploaded,
+        .arg = b,
+    };
+    atomic_store(&b->sending, true);
+    b->submitted_us = hw_time_us();
+    if (cloudflare_submit(&upload, 0) != ESP_OK) {
+        atomic_store(&b->sending, false);
+        return false;
+    }
+    open_batch ^= 1;
+    return true;
+}
 
+// Pass one queued request on: telemetry into the open batch, anything else
+// to the engine. False if there is no room for it right now; the caller
+// keeps it and tries again.
+static bool dispatch_http_request(http_msg_handle_t req) {
+    const char *endpoint = http_msg_endpoint(&http_msg_store, req);
+    const char *json_body = http_msg_body(&http_msg_store, req);
+
+    if (strstr(endpoint, "/api/sensor_data") != NULL) {
+        uint32_t now_ms = pdTICKS_TO_MS(xTaskGetTickCount());
+        if (!sensor_batch_add(&sensor_batches[open_batch].batch, json_body, now_ms)) {
+            // Batch buffer full: send what we have and start a new one
+            if (!flush_sensor_batch()) return false;
+            if (!sensor_batch_add(&sensor_batches[open_batch].batch, json_body, now_ms)) {
+                ESP_LOGE("HTTP_REQUEST", "Dropped a %u byte reading, too big for a %d byte batch",
+                         (unsigned)strlen(json_body), SENSOR_BATCH_MAX_BYTES);
+                atomic_fetch_add(&sensor_batch_rejected, 1);
+            }
+        }
+        release_http_request(req);
+        return true;
+    }
 
-    // Start HTTP server for configuration
-    httpd_handle_t server = NULL;
-    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    if (httpd_start(&server, &config) == ESP_OK) {
-        httpd_uri_t root = {
-            .uri = "/",
-            .method = HTTP_GET,
-            .handler = root_get_handler
-        };
-        httpd_register_uri_handler(server, &root);
-
-        httpd_uri_t wifi_config = {
-            .uri = "/config",
-            .method = HTTP_POST,
-            .handler = wifi_config_post_handler
-        };
-        httpd_register_uri_handler(server, &wifi_config);
+    // Controls use PUT and get an extra retry, and are started in the order
+    // they were queued. The body stays in the message store until
+    // on_request_done releases it.
+    bool is_control = strstr(endpoint, "/api/controls?control_id=") != NULL;
+    // Back off on repeated failures; the engine waits, not this task
+    int failures = atomic_load(&upload_failures);
+    if (failures > 10) failures = 10;
+    cloudflare_request_t upload = {
+        .method = is_control ? CLOUDFLARE_PUT : CLOUDFLARE_POST,
+        .endpoint = endpoint,
+        .json_body = json_body,
+        .max_retries = is_control ? 2 : 1,
+        .delay_ms = failures > 5 ? 500 * (failures - 5) : 0,
+        .ordered = is_control,
+        .done_cb = on_request_done,
+        .arg = (void *)(uintptr_t)req,
+    };
+    if (cloudflare_submit(&upload, 0) != ESP_OK) return false;
+    ESP_LOGI("HTTP_REQUEST", "Processing request to %s", endpoint);
 
-        httpd_uri_t scan = {
-            .uri = "/scan",
-            .method = HTTP_GET,
-            .handler = wifi_scan_get_handler
-        };
-        httpd_register_uri_handler(server, &scan);
+    // Report queue status periodically (every 10 requests)
+    static int request_count = 0;
+    if (++request_count % 10 == 0) {
+        log_http_queue_status("Status");
     }
+    return true;
 }
 
-void setup_softap() {
-    is_softap_mode = true;
+// Feeds queued requests to the non-blocking cloudflare_api engine. Requests
+// complete in the engine task, so a slow one no longer holds up the queue.
+// Nothing here sleeps on the network: when the engine or the other batch
+// buffer is busy, the request stays put and is retried on the next tick,
+// while producers keep queueing under the priority queue's drop policy.
+void http_request_task(void *arg) {
 
-    // Create the default Wi-Fi AP netif
-    esp_netif_create_default_wifi_ap();
+    http_msg_handle_t held = HTTP_MSG_INVALID;   // taken off the queue, no room for it yet
+    http_msg_handle_t req;
+    // Telemetry is coalesced here; controls and messages go straight through
+    for (int i = 0; i < 2; i++) {
+        sensor_batch_init(&sensor_batches[i].batch, sensor_batches[i].buf, sizeof(sensor_batches[i].buf));
+    }
+    // esp_task_wdt_add(NULL);
 
-    wifi_config_t ap_config = {
-        .ap = {
-            .ssid = "ESP32_Group2",
-            .ssid_len = strlen("ESP32_Group2"),
-            .channel = 1,
-            .password = "",
-            .max_connection = 4,
-            .authmode = WIFI_AUTH_OPEN
-        },
-    };
+    while (1) {
+        sensor_batch_t *batch = &sensor_batches[open_batch].batch;
+        uint32_t now_ms = pdTICKS_TO_MS(xTaskGetTickCount());
+        bool stalled = false;
+        if (sensor_batch_due(batch, SENSOR_BATCH_MAX_COUNT, SENSOR_BATCH_WINDOW_MS, now_ms)) {
+            stalled = !flush_sensor_batch();
+            batch = &sensor_batches[open_batch].batch;
+        }
+        if (held != HTTP_MSG_INVALID) {
+            if (!dispatch_http_request(held)) {
+                ulTaskNotifyTake(pdTRUE, 1);
+                continue;
+            }
+            held = HTTP_MSG_INVALID;
+        }
 
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &ap_config));
-    ESP_ERROR_CHECK(esp_wifi_start());
+        // Wake up when the open batch window closes, otherwise check queue status every 5 seconds
+        uint32_t wait_ms = sensor_batch_ms_until_due(batch, SENSOR_BATCH_WINDOW_MS, now_ms);
+        if (wait_ms > 5000) wait_ms = 5000;
 
-    esp_netif_ip_info_t ip_info;
-    esp_netif_t* netif = esp_netif_get_handle_from_ifkey("WIFI_AP_DEF");
-    if (esp_netif_get_ip_info(netif, &ip_info) == ESP_OK) {
-        ESP_LOGW(TAG, "SoftAP IP: " IPSTR, IP2STR(&ip_info.ip));
-    } else {
-        ESP_LOGW(TAG, "SoftAP IP: unknown");
+        // esp_task_wdt_reset();
+        if (receive_from_http_queue(&req, stalled ? 1 : pdMS_TO_TICKS(wait_ms))) {
+            if (!dispatch_http_request(req)) held = req;
+        } else if (batch->count == 0) {
+            // No messages for 5 seconds, log queue status
+            log_http_queue_status("Idle");
+        }
     }
 }
 
-void print_chip_info(void)
-{
-    ESP_LOGD("Device","Device Info\n");
-
-
-    /* Print chip information */
-    esp_chip_info_t chip_info;
-    uint32_t flash_size;
-    esp_chip_info(&chip_info);
-    ESP_LOGD("Device","This is %s chip with %d CPU core(s), %s%s%s%s, ",
-           CONFIG_IDF_TARGET,
-           chip_info.cores,
-           (chip_info.features & CHIP_FEATURE_WIFI_BGN) ? "WiFi/" : "",
-           (chip_info.features & CHIP_FEATURE_BT) ? "BT" : "",
-           (chip_info.features & CHIP_FEATURE_BLE) ? "BLE" : "",
-           (chip_info.features & CHIP_FEATURE_IEEE802154) ? ", 802.15.4 (Zigbee/Thread)" : "");
-
-    unsigned major_rev = chip_info.revision / 100;
-    unsigned minor_rev = chip_info.revision % 100;
-    ESP_LOGD("Device","silicon revision v%d.%d, ", major_rev, minor_rev);
-    if(esp_flash_get_size(NULL, &flash_size) != ESP_OK) {
-        ESP_LOGE("Device","Get flash size failed");
-        return;
-    }
-
-    ESP_LOGD("Device","%" PRIu32 "MB %s flash\n", flash_size / (uint32_t)(1024 * 1024),
-           (chip_info.features & CHIP_FEATURE_EMB_FLASH) ? "embedded" : "external");
+// predeclaration of functions
+void on_post_success() {
+    // ESP_LOGI("Upload", "Data posted successfully.");
+}
 
-    ESP_LOGD("Device","Minimum free heap size: %" PRIu32 " bytes\n", esp_get_minimum_free_heap_size());
+static void setup_uart2(void);
+static void uart_event_task(void *pvParameters);
+static void process_uno_packet(const uno_packet_t *p);
+static void log_uno_link_stats(void);
+static uart_framer_t uno_framer;
+
+// Link state, owned by the UART task
+static uint32_t uno_baud = UNO_LINK_BAUD_DEFAULT;
+static uint8_t uno_tx_seq;
+static uno_link_seq_t uno_rx_seq;
+static uint32_t uno_bad_frames;
+static ppg_window_t pulse_window;           // IR/red samples, evaluated once a second
+static int64_t uno_last_rx_us, uno_last_ping_us;
 
+void  register_device();
 
-}
 void register_device(void)
 {
     // Register device on startup
@@ -633,49 +991,52 @@ void register_device(void)
 
     // a flag to indicate device registration
     registered = true;
+    free(devices_buf);
     free(sensors_buf);
 }
 void set_soil_relay(bool on) {
-    gpio_set_level(SOIL_RELAY_GPIO, on ? 1 : 0);
+    hw_gpio_set(SOIL_RELAY_GPIO, on ? 1 : 0);
+}
+
+// Drive the relay and record the pump state; called with control_lock held
+static void set_pump_locked(bool on) {
+    set_soil_relay(on);
+    pump_on = on;
+    relay_state = on;
+}
+
+// Button press: flip the pump, returns the new state
+static bool toggle_pump(void) {
+    xSemaphoreTake(control_lock, portMAX_DELAY);
+    bool on = !pump_on;
+    set_pump_locked(on);
+    xSemaphoreGive(control_lock);
+    return on;
 }
 void update_threshold_from_cloud() {
-    char buffer[256];
-    if (cloudflare_get_json(url_control, buffer, sizeof(buffer)) == ESP_OK) {
-        cJSON *root = cJSON_Parse(buffer);
+    // Runs once at boot, before handle_cloud_controls has accepted a
+    // response, so this is always a full GET. The ETag and whether the pump
+    // entry was applied are left to handle_cloud_controls.
+    esp_err_t err = cloudflare_get_stream(url_control, control_scan_feed, &controls_scan);
+    if (err == ESP_OK) {
         bool found = false;
-        if (root) {
-        cJSON *entry = NULL;
-        cJSON_ArrayForEach(entry, root) {
-            cJSON *id_item  = cJSON_GetObjectItem(entry, "device_id");
-            if (!cJSON_IsNumber(id_item)) {
-                ESP_LOGW("Control", "Skip entry without numeric device_id");
-                continue;
-            }
-            if (id_item->valueint != device_id) {
-                continue;   // not for this device
-            }
-
-            cJSON *dry_item = cJSON_GetObjectItem(entry, "dry_threshold");
-            cJSON *wet_item = cJSON_GetObjectItem(entry, "wet_threshold");
-            if (cJSON_IsNumber(dry_item) && cJSON_IsNumber(wet_item)) {
-                dry_threshold = dry_item->valueint;
-                wet_threshold = wet_item->valueint;
-                ESP_LOGI("Control", "Thresholds pulled from cloud: dry=%d, wet=%d",
-                         dry_threshold, wet_threshold);
-                found = true;
-            } else {
-                ESP_LOGW("Control", "Entry for device lacks numeric thresholds");
-            }
-            break;  // processed matching entry, exit loop
-        }
-            cJSON_Delete(root);
+        if (!control_scan_finish(&controls_scan)) {
+            ESP_LOGW("Control", "Malformed controls response near byte %u",
+                     (unsigned)json_stream_error_offset(&controls_scan.js));
+        } else if (controls_scan.thresholds_found) {
+            set_thresholds_from_cloud(controls_scan.dry_threshold, controls_scan.wet_threshold, "HTTP");
+            found = true;
+        } else if (controls_scan.device_found) {
+            ESP_LOGW("Control", "Entry for device lacks numeric thresholds");
         }
         if (!found) {
             // Post default threshold if not found in cloud
             char post_body[128];
+            xSemaphoreTake(control_lock, portMAX_DELAY);
             snprintf(post_body, sizeof(post_body),
                      "{\"device_id\":%d,\"dry_threshold\":%d,\"wet_threshold\":%d}",
                      device_id, dry_threshold, wet_threshold);
+            xSemaphoreGive(control_lock);
             cloudflare_post_json("/api/controls", post_body);
             ESP_LOGI("Control", "Threshold not found. Posted default to cloud.");
         }
@@ -684,20 +1045,10 @@ void update_threshold_from_cloud() {
 
 // RCWL-0516 sensor configuration
 static void setup_rcwl0516_sensor(void) {
-
-	gpio_config_t io_conf = {
-        .pin_bit_mask = 1ULL << RCWL_GPIO,
-        .mode = GPIO_MODE_INPUT,
-        .pull_up_en = GPIO_PULLUP_DISABLE,
-        .pull_down_en = GPIO_PULLDOWN_ENABLE,
-        .intr_type = GPIO_INTR_DISABLE,
-    };
-    gpio_config(&io_conf);
+    hw_gpio_input(RCWL_GPIO, HW_GPIO_PULL_DOWN);
 }
 void init_time() {
-    esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
-    esp_sntp_setservername(0, "pool.ntp.org");
-    esp_sntp_init();
+    hw_time_sync_start("pool.ntp.org");
 }
 
 // Improved test button interrupt handler with debouncing
@@ -705,11 +1056,15 @@ static void IRAM_ATTR test_button_isr_handler(void* arg) {
     static uint32_t last_button_time = 0;
     uint32_t current_time = xTaskGetTickCountFromISR();
 
+    // the ISR is installed in init(), the task only once the device is registered
+    if (button_task_handle == NULL) return;
+
     // Simple debounce - ignore interrupts that come too quickly after each other
     if ((current_time - last_button_time) >= pdMS_TO_TICKS(300)) {
         last_button_time = current_time;
         BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-        xTaskNotifyFromISR(button_task_handle, 0, eNoAction, &xHigherPriorityTaskWoken);
+        // a give, so ulTaskNotifyTake() in button_task returns 1; eNoAction left it at 0
+        vTaskNotifyGiveFromISR(button_task_handle, &xHigherPriorityTaskWoken);
 
         // ESP_LOGI("test_button","Button ISR triggered\n");
         // do not print anything in ISR, it will cause stack overflow
@@ -720,37 +1075,44 @@ static void IRAM_ATTR test_button_isr_handler(void* arg) {
     }
 }
 
+static void metrics_setup(void) {
+    metrics_init(&metrics);
+    app_metrics.http_ok = metrics_counter(&metrics, "http_requests_total", "Cloud API requests completed", "result", "ok");
+    app_metrics.http_failed = metrics_counter(&metrics, "http_requests_total", "Cloud API requests completed", "result", "failed");
+    app_metrics.upload_ms = metrics_histogram(&metrics, "http_batch_upload_ms", "Submit to completion of a /api/sensor_data batch",
+                                              NULL, NULL, upload_ms_bounds, sizeof(upload_ms_bounds) / sizeof(upload_ms_bounds[0]));
+    app_metrics.readings_uploaded = metrics_counter(&metrics, "http_readings_uploaded_total", "Readings in uploaded batches", NULL, NULL);
+    app_metrics.mqtt_published = metrics_counter(&metrics, "mqtt_published_total", "Readings handed to the MQTT client", NULL, NULL);
+    app_metrics.mqtt_refused = metrics_counter(&metrics, "mqtt_refused_total", "Readings the MQTT client would not take", NULL, NULL);
+    app_metrics.mqtt_acked = metrics_counter(&metrics, "mqtt_acked_total", "QoS 1 publishes acknowledged", NULL, NULL);
+    app_metrics.mqtt_expired = metrics_counter(&metrics, "mqtt_expired_total", "QoS 1 publishes dropped unacknowledged", NULL, NULL);
+    app_metrics.mqtt_disconnects = metrics_counter(&metrics, "mqtt_disconnects_total", "Broker connections lost", NULL, NULL);
+    app_metrics.spooled = metrics_counter(&metrics, "telemetry_spooled_total", "Readings spooled while the uplink was down", NULL, NULL);
+}
+
 void init(void)
 {
 
-    gpio_reset_pin(LED_STATUS_GPIO);
-    gpio_reset_pin(RCWL_GPIO);
-
-    gpio_set_direction(LED_STATUS_GPIO, GPIO_MODE_OUTPUT);
+    hw_gpio_output(LED_STATUS_GPIO, false);
     snprintf(url_control, sizeof(url_control), "/api/controls?device_id=%d", device_id);
+    control_scan_init(&controls_scan, sensors[3].id, device_id);
+    control_scan_init(&mqtt_control_scan, sensors[3].id, device_id);
+    snprintf(control_topic, sizeof(control_topic), CONTROL_TOPIC_FMT, device_id);
+    snprintf(control_ack_topic, sizeof(control_ack_topic), CONTROL_ACK_TOPIC_FMT, device_id);
+    snprintf(telemetry_topic, sizeof(telemetry_topic), TELEMETRY_TOPIC_FMT, device_id);
+#ifdef CONFIG_LOAD_TEST
+    snprintf(load_topic, sizeof(load_topic), LOAD_TOPIC_FMT, device_id);
+    snprintf(load_stats_topic, sizeof(load_stats_topic), LOAD_STATS_TOPIC_FMT, device_id);
+#endif
+    snprintf(metrics_topic, sizeof(metrics_topic), METRICS_TOPIC_FMT, device_id);
+    metrics_setup();   // before wifi_setup() starts the /metrics server
 
     ESP_LOGI("Initial","Welcome!");
     print_chip_info();
+    wifi_reset_check();
 
-    // --- WiFi Reset Button (GPIO16) check on boot ---
-    gpio_reset_pin(WIFI_RESET_GPIO);
-    gpio_set_direction(WIFI_RESET_GPIO, GPIO_MODE_INPUT);
-    gpio_pullup_en(WIFI_RESET_GPIO);
-    int held_duration = 0;
-    for (int i = 0; i < 50; ++i) {
-        if (gpio_get_level(WIFI_RESET_GPIO) == 0) {  // pressed (active low)
-            vTaskDelay(pdMS_TO_TICKS(100));
-            held_duration++;
-        } else {
-            break;
-        }
-    }
-    if (held_duration >= 50) {
-        ESP_LOGW("BOOT RESET", "BOOT button held >5s. Clearing WiFi config and restarting...");
-        nvs_flash_erase();  // Clear WiFi credentials and other NVS data
-        vTaskDelay(pdMS_TO_TICKS(500));
-        esp_restart();  // Auto restart
-    }
+    // HTTP connection pool must exist before any task talks to the cloud
+    cloudflare_api_init();
 
     // Set up Wi-Fi connection
     wifi_setup();
@@ -762,48 +1124,32 @@ void init(void)
 
     init_time();
     // soil  moisture sensor config (now uses oneshot ADC, config done in read_soil_sensor)
-    gpio_reset_pin(SOIL_RELAY_GPIO);
-    gpio_set_direction(SOIL_RELAY_GPIO, GPIO_MODE_OUTPUT);
-    gpio_set_drive_capability(SOIL_RELAY_GPIO, GPIO_DRIVE_CAP_3);  // Max drive strength
-    gpio_set_level(SOIL_RELAY_GPIO, 0);  // Set initial state to inactive (assuming active-low relay)
+    hw_gpio_output(SOIL_RELAY_GPIO, true);  // Max drive strength
+    hw_gpio_set(SOIL_RELAY_GPIO, 0);  // Set initial state to inactive (assuming active-low relay)
 
     // Setup test button GPIO and interrupt
-    gpio_reset_pin(TEST_BUTTON_GPIO);
     // Configure test button as input with pull-up and negedge interrupt
-    gpio_config_t test_button_conf = {
-        .intr_type = GPIO_INTR_NEGEDGE,
-        .pin_bit_mask = 1ULL << TEST_BUTTON_GPIO,
-        .mode = GPIO_MODE_INPUT,
-        .pull_up_en = GPIO_PULLUP_ENABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE
-    };
-    gpio_config(&test_button_conf);
-    gpio_install_isr_service(0);
-
-    gpio_isr_handler_add(TEST_BUTTON_GPIO, test_button_isr_handler, NULL);
-
-    // Already configured via gpio_config_t, do not override
+    hw_gpio_input(TEST_BUTTON_GPIO, HW_GPIO_PULL_UP);
+    hw_gpio_isr_add(TEST_BUTTON_GPIO, HW_GPIO_EDGE_FALLING, test_button_isr_handler, NULL);
 
     // microwave radar sensor config.
     setup_rcwl0516_sensor();
     setup_uart2();
 
-    // Initialize global adc1_handle for soil sensor (and possible reuse)
-    adc_oneshot_unit_init_cfg_t init_config = {
-        .unit_id = ADC_UNIT_1
-    };
-    adc_oneshot_new_unit(&init_config, &adc1_handle);
-}
 
-void end(void)
-{
-    for (int i = 10; i >= 0; i--) {
-        ESP_LOGW("End","Restarting in %d seconds...\n", i);
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
+    esp_err_t cali_err = adc_lut_build_cali(&adc1_lut, ADC_UNIT_1, ADC_ATTEN_DB_12);
+    if (cali_err != ESP_OK) {
+        ESP_LOGW("ADC", "No eFuse calibration (%s), assuming %d mV full scale",
+                 esp_err_to_name(cali_err), ADC_FULL_SCALE_MV);
+        adc_lut_build_nominal(&adc1_lut, ADC_FULL_SCALE_MV);
     }
-    ESP_LOGW("End","Restarting now.\n");
-    fflush(stdout);
-    esp_restart();
+    telemetry_set_light_volts(photoresistor_volts);
+    esp_err_t adc_err = adc_sampler_start(adc_channels, sizeof(adc_channels) / sizeof(adc_channels[0]), ADC_SAMPLE_FREQ_HZ);
+    if (adc_err != ESP_OK) {
+        ESP_LOGE("ADC", "Continuous sampling failed to start: %s", esp_err_to_name(adc_err));
+    }
+    ac_meter_init(&acs712_meter, adc_sampler_rate_hz(), MAINS_HZ, ACS712_RMS_CYCLES, zero_offset * 1000);
+    adc_sampler_set_sink(ACS712_ADC_CHANNEL, acs712_sink, &acs712_meter);
 }
 
 // Improved button task with robust HTTP request handling and retry logic
@@ -814,39 +1160,22 @@ void button_task(void* arg) {
     ESP_LOGI("button_task", "Stack high-water mark at start: %u words",
              uxTaskGetStackHighWaterMark(NULL));
     // Use the HTTP request queue instead of direct API calls
-    http_request_t req1, req2;
-
     char control_url[50];
     snprintf(control_url, sizeof(control_url), "/api/controls?control_id=%d", sensors[3].id);
-    snprintf(req1.endpoint, sizeof(req1.endpoint), "%s", control_url);
-    snprintf(req2.endpoint, sizeof(req2.endpoint), "/api/messages");
     while (1) {
         // Use interrupt notification if available
         if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100)) == 1) {
             vTaskDelay(pdMS_TO_TICKS(50)); // Debounce delay
             // Check button state again after debounce to confirm it's still pressed
-            if (gpio_get_level(TEST_BUTTON_GPIO) == 0) {
-                relay_state = !relay_state;
-                pump_on = relay_state;
-                set_soil_relay(relay_state);
+            if (hw_gpio_get(TEST_BUTTON_GPIO) == 0) {
+                bool on = toggle_pump();
 
-                ESP_LOGW("Test Button", "Relay toggled to %s", relay_state ? "ON" : "OFF");
+                ESP_LOGW("Test Button", "Relay toggled to %s", on ? "ON" : "OFF");
 
                 // Try up to 3 times to send control request
                 bool control_queued = false;
                 bool message_queued = false;
-
-                if (pump_on) {
-                    snprintf(req1.json_body, sizeof(req1.json_body), "{\"state\":\"on\"}");
-                    snprintf(req2.json_body, sizeof(req2.json_body),
-                            "{\"device_id\":%d,\"control_id\":%d,\"state\":\"on\",\"from_source\":\"%s\"}",
-                            device_id, sensors[3].id, sensors[3].name);
-                } else {
-                    snprintf(req1.json_body, sizeof(req1.json_body), "{\"state\":\"off\"}");
-                    snprintf(req2.json_body, sizeof(req2.json_body),
-                            "{\"device_id\":%d,\"control_id\":%d,\"state\":\"off\",\"from_source\":\"%s\"}",
-                            device_id, sensors[3].id, sensors[3].name);
-                }
+                const char *state = on ? "on" : "off";
 
                 // Try sending control request with high priority
                 for (int retry = 0; retry < 1 && !control_queued; retry++) {
@@ -854,129 +1183,126 @@ void button_task(void* arg) {
                         ESP_LOGW("Button HTTP", "Retrying control request (attempt %d/3)", retry+1);
                         vTaskDelay(pdMS_TO_TICKS(100 * retry));
                     }
-                    control_queued = send_to_http_queue(&req1, 10, pdMS_TO_TICKS(200));
+                    control_queued = send_to_http_queue(HTTP_CLASS_CONTROL, control_url,
+                                                        "{\"state\":\"%s\"}", state);
                 }
 
                 if (!control_queued) {
                     ESP_LOGE("Button HTTP", "Failed to queue control request after multiple attempts");
                     // As a fallback, try direct API call for critical state change
-                    cloudflare_put_json(req1.endpoint, req1.json_body);
+                    char control_body[24];
+                    snprintf(control_body, sizeof(control_body), "{\"state\":\"%s\"}", state);
+                    cloudflare_put_json(control_url, control_body);
                 }
 
                 // Message is less critical, just try once with priority 5
-                message_queued = send_to_http_queue(&req2, 5, pdMS_TO_TICKS(100));
+                message_queued = send_to_http_queue(HTTP_CLASS_MESSAGE, "/api/messages",
+                        "{\"device_id\":%d,\"control_id\":%d,\"state\":\"%s\",\"from_source\":\"%s\"}",
+                        device_id, sensors[3].id, state, sensors[3].name);
                 if (!message_queued) {
                     ESP_LOGW("Button HTTP", "Failed to queue message request");
                 }
             }
         } else {
             // Fallback: polling method if interrupt/notify fails (button held, or missed ISR)
-            if (gpio_get_level(TEST_BUTTON_GPIO) == 0) {
-                relay_state = !relay_state;
-                pump_on = relay_state;
-                set_soil_relay(relay_state);
-                ESP_LOGW("Test Button", "Relay toggled to %s (by polling fallback)", relay_state ? "ON" : "OFF");
-                bool control_queued = false;
-                bool message_queued = false;
-                if (pump_on) {
-                    snprintf(req1.json_body, sizeof(req1.json_body), "{\"state\":\"on\"}");
-                    snprintf(req2.json_body, sizeof(req2.json_body),
-                            "{\"device_id\":%d,\"control_id\":%d,\"state\":\"on\",\"from_source\":\"%s\"}",
-                            device_id, sensors[3].id, sensors[3].name);
-                } else {
-                    snprintf(req1.json_body, sizeof(req1.json_body), "{\"state\":\"off\"}");
-                    snprintf(req2.json_body, sizeof(req2.json_body),
-                            "{\"device_id\":%d,\"control_id\":%d,\"state\":\"off\",\"from_source\":\"%s\"}",
-                            device_id, sensors[3].id, sensors[3].name);
-                }
-                control_queued = send_to_http_queue(&req1, 10, pdMS_TO_TICKS(200));
-                message_queued = send_to_http_queue(&req2, 5, pdMS_TO_TICKS(100));
+            if (hw_gpio_get(TEST_BUTTON_GPIO) == 0) {
+                bool on = toggle_pump();
+                ESP_LOGW("Test Button", "Relay toggled to %s (by polling fallback)", on ? "ON" : "OFF");
+                const char *state = on ? "on" : "off";
+                send_to_http_queue(HTTP_CLASS_CONTROL, control_url, "{\"state\":\"%s\"}", state);
+                send_to_http_queue(HTTP_CLASS_MESSAGE, "/api/messages",
+                        "{\"device_id\":%d,\"control_id\":%d,\"state\":\"%s\",\"from_source\":\"%s\"}",
+                        device_id, sensors[3].id, state, sensors[3].name);
                 vTaskDelay(pdMS_TO_TICKS(500)); // avoid rapid toggling
             }
         }
     }
 }
 
-// Helper to setup test button interrupt
-// 27/6/2025 disabled this function, as it is not used in the current code
-
+// Shared by MQTT control messages and the HTTP reconciliation poll.
+// Returns true if the pump changed.
+static bool set_pump_from_cloud(const char *state, const char *source) {
+    bool changed = false;
+    xSemaphoreTake(control_lock, portMAX_DELAY);
+    // 檢查狀態是否為 "on"
+    if (strcmp(state, "on") == 0) {
+        if (!pump_on) {
+            set_pump_locked(true);
+            changed = true;
+        }
+    }
+    // 檢查狀態是否為 "off"
+    else if (strcmp(state, "off") == 0) {
+        if (pump_on) {
+            set_pump_locked(false);
+            changed = true;
+        }
+    }
+    xSemaphoreGive(control_lock);
+    if (changed) ESP_LOGI("ControlSync", "Pump turned %s from cloud control (%s)", state[1] == 'n' ? "ON" : "OFF", source);
+    return changed;
+}
 
-static void _setup_test_button_interrupt(void) {
-    gpio_config_t io_conf = {
-        .intr_type = GPIO_INTR_NEGEDGE,
-        .mode = GPIO_MODE_INPUT,
-        .pull_up_en = 1,
-        .pin_bit_mask = 1ULL << TEST_BUTTON_GPIO
-    };
-    gpio_config(&io_conf);
-    gpio_install_isr_service(0);
-    gpio_isr_handler_add(TEST_BUTTON_GPIO, test_button_isr_handler, NULL);
+static void set_thresholds_from_cloud(int dry, int wet, const char *source) {
+    xSemaphoreTake(control_lock, portMAX_DELAY);
+    bool changed = dry != dry_threshold || wet != wet_threshold;
+    dry_threshold = dry;
+    wet_threshold = wet;
+    xSemaphoreGive(control_lock);
+    if (changed) ESP_LOGI("Control", "Thresholds updated from cloud (%s): dry=%d, wet=%d", source, dry, wet);
 }
 
 // 完全重寫的 cloud controls 處理函数
 void handle_cloud_controls(void) {
     ESP_LOGW("ControlSync", "Checking cloud controls...");
 
-    // Clear buffer before use
-    memset(controls_buf, 0, sizeof(controls_buf));
-
-    esp_err_t fetch_result = cloudflare_get_json(url_control, controls_buf, sizeof(controls_buf));
-    if (fetch_result != ESP_OK) {
+    // 僅針對 Pump 控制（sensors[3].id）進行處理
+    // 回應邊下載邊解析，只保留目前這一筆控制項的欄位
+    // 304 (ETag 未變) 時不重新下載和解析，沿用上一次的結果
+    esp_err_t fetch_result = cloudflare_get_stream(url_control, control_scan_feed, &controls_scan);
+    if (fetch_result != ESP_OK && fetch_result != CLOUDFLARE_ERR_NOT_MODIFIED) {
         ESP_LOGW("ControlSync", "Failed to fetch controls: %s", esp_err_to_name(fetch_result));
         return;
     }
+    // 304: the cloud has not changed since this response was applied.
+    // Applying it again would undo a newer MQTT push or button press.
+    if (fetch_result == CLOUDFLARE_ERR_NOT_MODIFIED && controls_scan_applied) {
+        ESP_LOGI("ControlSync", "Controls unchanged");
+        return;
+    }
 
-    if (strlen(controls_buf) == 0) {
-        ESP_LOGW("ControlSync", "Received empty response");
+    if (!control_scan_finish(&controls_scan)) {
+        ESP_LOGW("ControlSync", "Malformed controls response near byte %u",
+                 (unsigned)json_stream_error_offset(&controls_scan.js));
         return;
     }
+    if (fetch_result == ESP_OK) cloudflare_accept_response(url_control);
+    controls_scan_applied = true;
 
-    // 僅針對 Pump 控制（sensors[3].id）進行處理
-    // 這種方法不嘗試解析整個 JSON，只找出我們需要的 Pump 控制
-    char pump_control_id[16];
-    snprintf(pump_control_id, sizeof(pump_control_id), "\"%d\"", sensors[3].id);
-
-    // 在原始 JSON 回應中搜索 pump 控制項
-    char *pump_control = strstr(controls_buf, pump_control_id);
-    if (pump_control == NULL) {
-        ESP_LOGI("ControlSync", "No pump control found in response");
+    if (!controls_scan.pump_found) {
+        ESP_LOGI("ControlSync", "No pump control found in response (%" PRIu32 " entries)",
+                 controls_scan.entries);
         return;
     }
 
-    // 在該控制項中尋找 "control_type":"switch" 以確認這是開關類型
-    char *control_type = strstr(pump_control, "\"control_type\":\"switch\"");
-    if (control_type == NULL) {
+    // 確認這是開關類型
+    if (!controls_scan.pump_is_switch) {
         ESP_LOGI("ControlSync", "Pump control is not of switch type");
         return;
     }
 
-    // 在該控制項中尋找狀態
-    char *state = strstr(pump_control, "\"state\":\"");
-    if (state == NULL) {
+    if (controls_scan.pump_state[0] == '\0') {
         ESP_LOGI("ControlSync", "No state found for pump control");
         return;
     }
 
-    // 移動指針到狀態值
-    state += 9; // 跳過 "state":"
-
-    // 檢查狀態是否為 "on"
-    if (strncmp(state, "on\"", 3) == 0) {
-        if (!pump_on) {
-            set_soil_relay(true);
-            pump_on = true;
-            relay_state = true;
-            ESP_LOGI("ControlSync", "Pump turned ON from cloud control");
-        }
+    // A change found by polling is acknowledged like a pushed one, so the
+    // bench can time both paths
+    if (set_pump_from_cloud(controls_scan.pump_state, "HTTP") && mqtt_connected) {
+        publish_control_ack(mqtt_client);
     }
-    // 檢查狀態是否為 "off"
-    else if (strncmp(state, "off\"", 4) == 0) {
-        if (pump_on) {
-            set_soil_relay(false);
-            pump_on = false;
-            relay_state = false;
-            ESP_LOGI("ControlSync", "Pump turned OFF from cloud control");
-        }
+    if (controls_scan.thresholds_found) {
+        set_thresholds_from_cloud(controls_scan.dry_threshold, controls_scan.wet_threshold, "HTTP");
     }
 }
 
@@ -991,353 +1317,759 @@ static void main_loop_task(void *arg)
     register_device();
 
     // Wait for time to sync
-    time_t now = 0;
-    struct tm timeinfo = { 0 };
-    while (timeinfo.tm_year < (2020 - 1900)) {
-        time(&now);
-        localtime_r(&now, &timeinfo);
+    while (!hw_time_synced()) {
         vTaskDelay(pdMS_TO_TICKS(1000));
     }
+    time_t now = time(NULL);
+    struct tm timeinfo;
+    localtime_r(&now, &timeinfo);
     ESP_LOGI("Time", "Time synced: %s", asctime(&timeinfo));
 
     update_threshold_from_cloud();
 
-    static int soil_read_counter = 0;
     TickType_t last_control_check = xTaskGetTickCount();
-    http_request_t req2, req3;
     while (1) {
         vTaskDelay(pdMS_TO_TICKS(500)); // Delay for 0.5 seconds
 
-        if(soil_read_counter % 2 == 0) {
-            // Check cloud controls every 3 ticks (1.5 seconds)
+        // Controls normally arrive over MQTT; polling only reconciles what
+        // the subscription missed, or takes over while it is down
+        uint32_t interval_ms = control_subscribed ? CONTROL_RECONCILE_MS : CONTROL_POLL_MS;
+        if (control_resync || xTaskGetTickCount() - last_control_check >= pdMS_TO_TICKS(interval_ms)) {
+            control_resync = false;
+            last_control_check = xTaskGetTickCount();
             handle_cloud_controls();
         }
-
-
     }
 }
 
-	void calibrate_zero_offset(adc_oneshot_unit_handle_t adc1_handle) {
-    	int raw = 0, tmp;
-    	for (int i = 0; i < 256; ++i) {
-        	adc_oneshot_read(adc1_handle, ACS712_ADC_CHANNEL, &tmp);
-        	raw += tmp;
+	void calibrate_zero_offset(void) {
+    	// wait (up to 1 s) for a full window of samples
+    	for (int i = 0; i < 100 && adc_sampler_count(ACS712_ADC_CHANNEL) < ADC_RING_SAMPLES; ++i) {
+        	vTaskDelay(pdMS_TO_TICKS(10));
+    	}
+    	int raw = 0;
+    	if (!adc_sampler_read(ACS712_ADC_CHANNEL, ADC_SAMPLER_MEAN, &raw)) {
+        	ESP_LOGW("ACS712", "No samples, keeping zero offset %.2f V", zero_offset);
+        	return;
     	}
-    	zero_offset = (raw / 256.0) / 4095.0 * 5;
-		ESP_LOGI("ACS712", "Zero offset calibrated: %.2f V", zero_offset);
+    	int32_t zero_mv = acs712_raw_to_mv(raw);
+    	zero_offset = zero_mv / 1000.0f;
+    	adc_sampler_lock();
+    	ac_meter_set_zero(&acs712_meter, zero_mv);
+    	adc_sampler_unlock();
+		ESP_LOGI("ACS712", "Zero offset calibrated: %.3f V", zero_offset);
 	}
-static void second_loop_task(void *arg)
-{
+// Sensor drivers run by sensor_sched from second_loop_task. Each sample()
+// only takes what a background reader already has (adc_sampler, the DHT
+// task, the UART task), so no sensor holds up another.
+static sensor_sched_t sensor_sched;
+static telemetry_frame_t sensor_frame;      // readings of the current cycle
+// ppg_result_t from the UART task to the heart_rate driver, about one a second
+static spsc_ring_t pulse_readings;
+static ppg_result_t pulse_readings_buf[4];
+
+static esp_err_t led_sample(void *ctx) {
     static bool led_on = false;
-    float temperature = 0;
-    float humidity = 0;
-    // initialize test button task
-    xTaskCreate(button_task, "button_task", BUTTON_TASK_STACK, NULL, 10, &button_task_handle);
-    // _setup_test_button_interrupt();
-    // Use global adc1_handle for soil sensor, create a local handle for other ADC channels if needed
-    // Config for photoresistor
-    adc_oneshot_chan_cfg_t photo_cfg = {
-        .bitwidth = ADC_BITWIDTH_DEFAULT,
-        .atten = PHOTORESISTOR_ADC_ATTEN
-    };
-    adc_oneshot_config_channel(adc1_handle, PHOTORESISTOR_ADC, &photo_cfg);
-    // Config for ACS712
-    adc_oneshot_chan_cfg_t acs_cfg = {
-        .bitwidth = ADC_BITWIDTH_DEFAULT,
-        .atten = ACS712_ADC_ATTEN
-    };
-    adc_oneshot_config_channel(adc1_handle, ACS712_ADC_CHANNEL, &acs_cfg);
+    led_on = !led_on;
+    hw_gpio_set(LED_STATUS_GPIO, led_on);
+    return ESP_OK;
+}
 
-    calibrate_zero_offset(adc1_handle);
+static struct {
+    int raw;
+    float volts;
+} ldr_state;
 
-    char mqtt_payload[64];
-    // MQTT
-    const esp_mqtt_client_config_t mqtt_cfg = {
-        .broker.address.uri = "mqtts://6bdeb9e091414b898b8a01d7ab63bcd2.s1.eu.hivemq.cloud:8883",
-        //.broker.verification.certificate = NULL,
-        .broker.verification.certificate = (const char *)ca_cert_pem_start,
-        .credentials.username = "eee4464",
-        .credentials.authentication.password = "Eee4464iot",
-        //.broker.verification.use_global_ca_store = false,
-    };
-    mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
-    esp_mqtt_client_start(mqtt_client);
+static esp_err_t ldr_sample(void *ctx) {
+    if (!adc_sampler_read(PHOTORESISTOR_ADC, ADC_SAMPLER_MEAN, &ldr_state.raw)) return ESP_ERR_INVALID_STATE;
+    ldr_state.volts = photoresistor_volts(ldr_state.raw);
+    ESP_LOGI("Photoresistor", "💡Light value: %d, Voltage: %.2f V", ldr_state.raw, ldr_state.volts);
+#ifdef CONFIG_USE_MQTT
+    report_reading(&sensor_frame, TELEMETRY_LIGHT, ldr_state.raw);
+#endif
+    return ESP_OK;
+}
+
+static int ldr_format(void *ctx, char *buf, size_t len) {
+    return snprintf(buf, len, "\"light_value\":%d,\"voltage\":%.2f", ldr_state.raw, ldr_state.volts);
+}
 
-    int current_count = 0;
-    float current = 0.0f;
-    int light_value = 0;
-    float photoresistor_voltage = 0.0f;
-    http_request_t reqs[5];
-    for (int i = 0; i < 5; ++i) {
-        snprintf(reqs[i].endpoint, sizeof(reqs[i].endpoint), "/api/sensor_data");
+// RCWL-0516: edges are timestamped in a GPIO interrupt (motion_rcwl) and
+// every start and end of an episode is published as it happens
+static void rcwl_changed(const motion_event_t *ev, void *ctx) {
+    if (ev->change == MOTION_START) {
+        ESP_LOGI("RCWL", "🚶‍♂️ Motion detected!");
+    } else {
+        ESP_LOGI("RCWL", "🌫️ No motion (after %" PRIu32 " ms).", ev->duration_ms);
     }
+#ifdef CONFIG_USE_MQTT
+    telemetry_frame_t frame;
+    telemetry_frame_init(&frame, device_id, 0, 0);
+    report_reading(&frame, TELEMETRY_MOTION, ev->change == MOTION_START ? 1 : 0);
+    telemetry_flush(&frame);
+#endif
+}
 
-    int motion_count = 0;
-    int soil_read_counter=0;
-    int moisture=0;
+static esp_err_t rcwl_init(void *ctx) {
+    const motion_config_t cfg = { .min_high_ms = RCWL_MIN_HIGH_MS, .hold_ms = RCWL_HOLD_MS };
+    return motion_rcwl_start(RCWL_GPIO, &cfg, rcwl_changed, NULL);
+}
 
-    while (1) {
-        // LED blink
-        led_on = !led_on;
-        gpio_set_level(LED_STATUS_GPIO, led_on);
-
-        vTaskDelay(pdMS_TO_TICKS(500)); // 500ms delay
-
-        if (is_softap_mode) continue;  // Skip network operations in softAP mode
-
-        // caculate Vref and voltage (V), ESP32 ADC theoretical max is 4095 (12bit)
-        // 0 current,  voltage output Vcc/2 ~=> 2.5V  (input 5V)
-        // offset = 2.5V, sensitivity = 0.185V/A (for 5A module)
-        if (++current_count >= 4) { // every 2 seconds
-            current_count = 0;
-
-            // Read photoresistor sensor
-            adc_oneshot_read(adc1_handle, PHOTORESISTOR_ADC, &light_value);
-            photoresistor_voltage = (light_value / 4095.0) * 3.3; // convert to voltage
-            ESP_LOGI("Photoresistor", "💡Light value: %d, Voltage: %.2f V", light_value, photoresistor_voltage);
-            snprintf(reqs[0].json_body, sizeof(reqs[0].json_body),
-                     "{\"sensor_id\":%d,\"device_id\":%d,\"data\":{\"light_value\":%d,\"voltage\":%.2f}}",
-                     sensors[6].id, device_id, light_value, photoresistor_voltage);
+// Periodic state for the publish policy's refresh
+static esp_err_t rcwl_sample(void *ctx) {
 #ifdef CONFIG_USE_MQTT
-            snprintf(mqtt_payload, sizeof(mqtt_payload),
-                     "{\"light_value\":%d,\"voltage\":%.2f}",
-                     light_value, photoresistor_voltage);
-            mqtt_publish_sensor(mqtt_client, MQTT_TOPIC_LIGHT, mqtt_payload);
+    report_reading(&sensor_frame, TELEMETRY_MOTION, motion_rcwl_active() ? 1 : 0);
 #endif
-            // Remove or comment out HTTP queue for light sensor
-            // send_to_http_queue(&reqs[0], 0, 0);
-
-            // Read RCWL-0516 sensor
-            // filter out false positives, if 4 out of 5 readings are high, consider it a motion
-            for (int i = 0; i < 5; ++i) {
-                if (gpio_get_level(RCWL_GPIO) == 1) {
-                    motion_count++;
-                }
-                vTaskDelay(pdMS_TO_TICKS(10)); // read every 10ms
-            }
-            if (motion_count >= 4) {
-                ESP_LOGI("RCWL", "🚶‍♂️ Motion detected!");
-                motion_count = 0; // reset count if no motion detected
+    return ESP_OK;
+}
 
-            } else {
-                ESP_LOGI("RCWL", "🌫️ No motion.");
-                motion_count = 0; // reset count if no motion detected
-            }
-            snprintf(reqs[1].json_body, sizeof(reqs[1].json_body),
-                     "{\"sensor_id\":%d,\"device_id\":%d,\"data\":{\"motion_detected\":%d}}",
-                     sensors[5].id, device_id, motion_count >= 4 ? 1 : 0);
+static int rcwl_format(void *ctx, char *buf, size_t len) {
+    motion_rcwl_stats_t st;
+    motion_rcwl_get_stats(&st);
+    return snprintf(buf, len, "\"motion_detected\":%d,\"episodes\":%" PRIu32 ",\"glitches\":%" PRIu32
+                    ",\"latency_max_us\":%" PRIu32, motion_rcwl_active() ? 1 : 0, st.episodes, st.glitches,
+                    st.latency_max_us);
+}
+
+// ACS712: 0 current, voltage output Vcc/2 ~=> 2.5V (input 5V)
+// offset = 2.5V, sensitivity = 0.185V/A (for 5A module)
+static struct {
+    ac_meter_result_t acs;
+    float current;
+    double energy_wh;
+} acs712_state;
+
+static esp_err_t acs712_sample(void *ctx) {
+    // true RMS over the last ACS712_RMS_CYCLES mains cycles; averaging then
+    // fabs() read ~0 A for an AC load
+    adc_sampler_lock();
+    acs712_state.acs = acs712_meter.result;
+    acs712_state.energy_wh = ac_meter_energy_wh(&acs712_meter, 1.0 / ACS712_MV_PER_A, MAINS_VOLTS);
+    adc_sampler_unlock();
+    if (acs712_state.acs.seq == 0) return ESP_ERR_INVALID_STATE;   // no full window yet
+    acs712_state.current = acs712_state.acs.rms / (float)ACS712_MV_PER_A;
 #ifdef CONFIG_USE_MQTT
-            snprintf(mqtt_payload, sizeof(mqtt_payload),
-                     "{\"motion_detected\":%d}", motion_count >= 4 ? 1 : 0);
-            mqtt_publish_sensor(mqtt_client, MQTT_TOPIC_MOTION, mqtt_payload);
+    report_reading(&sensor_frame, TELEMETRY_CURRENT, acs712_state.current);
 #endif
-            // Remove or comment out HTTP queue for motion sensor
-            // send_to_http_queue(&reqs[1], 0, 0);
-
-            // Read ACS712 current sensor (average 64 samples)
-            int raw = 0, tmp;
-            for (int i = 0; i < 64; ++i) {
-                adc_oneshot_read(adc1_handle, ACS712_ADC_CHANNEL, &tmp);
-                raw += tmp;
-            }
-            float voltage = (raw / 64.0) / 4095.0 * 5;
-            current = (voltage - zero_offset) / 0.185;
-            current = fabs(current);
+    const ac_meter_result_t *acs = &acs712_state.acs;
+    ESP_LOGI("ACS712", "Current: %.2f A rms (AC %.2f, DC %.2f, peak %.2f A), %.3f Wh",
+             acs712_state.current, acs->ac_rms / (float)ACS712_MV_PER_A, acs->dc / (float)ACS712_MV_PER_A,
+             acs->peak / (float)ACS712_MV_PER_A, acs712_state.energy_wh);
+    return ESP_OK;
+}
+
+static int acs712_format(void *ctx, char *buf, size_t len) {
+    return snprintf(buf, len, "\"current\":%.2f,\"energy_wh\":%.3f", acs712_state.current, acs712_state.energy_wh);
+}
+
+static struct {
+    float temperature;
+    float humidity;
+} dht_state;
+
+static esp_err_t dht_init(void *ctx) {
+    spsc_ring_init(&dht_results, dht_results_buf, sizeof(dht_reading_t), 2);
+    return dht_start(DHT_TYPE_DHT11, DHT_GPIO, dht_done, NULL);
+}
+
+// Take the result of the read requested last period and start the next
+// one; the transfer runs in the DHT task
+static esp_err_t dht_sample(void *ctx) {
+    dht_reading_t got[2];
+    size_t n = spsc_ring_pop(&dht_results, got, 2);
+    dht_request();
+    if (n == 0) return ESP_OK;
+    const dht_reading_t dht = got[n - 1];
+    if (dht.err != ESP_OK) {
+        ESP_LOGW("DHT", "Read failed: %s", esp_err_to_name(dht.err));
+        return dht.err;
+    }
+    // this DHT11 sensor has a error in temperature reading, so we need to adjust it
+    dht_state.humidity = dht.humidity * 0.375 + 25.0f;  //old
+    dht_state.temperature = dht.temperature - 30.0f;
+
+    ESP_LOGI("DHT", "🌡️ Temperature: %.1f°C, 💧 Humidity: %.1f%%", dht_state.temperature, dht_state.humidity);
 #ifdef CONFIG_USE_MQTT
-            snprintf(mqtt_payload, sizeof(mqtt_payload), "{\"current\":%.2f}", fabs(current));
-            mqtt_publish_sensor(mqtt_client, MQTT_TOPIC_CURRENT, mqtt_payload);
+    report_reading(&sensor_frame, TELEMETRY_TEMPERATURE, dht_state.temperature);
+    report_reading(&sensor_frame, TELEMETRY_HUMIDITY, dht_state.humidity);
 #endif
-            snprintf(reqs[2].json_body, sizeof(reqs[2].json_body),
-                     "{\"sensor_id\":%d,\"device_id\":%d,\"data\":{\"current\":%.2f}}",
-                     sensors[4].id, device_id, current);
-            // Remove or comment out HTTP queue for current sensor
-            // xQueueSend(http_request_queue, &reqs[2], 0);
-
-            ESP_LOGI("ACS712", "Current: %.2f A", current);
-
-            esp_err_t res = dht_read_float_data(DHT_TYPE_DHT11, DHT_GPIO, &humidity, &temperature);
-            if (res == ESP_OK) {
-                // this DHT11 sensor has a error in temperature reading, so we need to adjust it
-                humidity= humidity*0.375+25.0f;  //old
-                temperature = temperature -30.0f;
-
-                ESP_LOGI("DHT", "🌡️ Temperature: %.1f°C, 💧 Humidity: %.1f%%", temperature, humidity);
-                // Post temperature and humidity data to cloud
-                snprintf(reqs[3].json_body, sizeof(reqs[3].json_body),
-                        "{\"sensor_id\":%d,\"device_id\":%d,\"data\":{\"temperature\":%.1f}}",
-                        sensors[0].id, device_id, temperature);
-                snprintf(reqs[4].json_body, sizeof(reqs[4].json_body),
-                        "{\"sensor_id\":%d,\"device_id\":%d,\"data\":{\"humidity\":%.1f}}",
-                        sensors[1].id, device_id, humidity);
-#ifdef CONFIG_USE_MQTT
-                snprintf(mqtt_payload, sizeof(mqtt_payload), "{\"temperature\":%.1f}", temperature);
-                mqtt_publish_sensor(mqtt_client, MQTT_TOPIC_TEMPERATURE, mqtt_payload);
-                snprintf(mqtt_payload, sizeof(mqtt_payload), "{\"humidity\":%.1f}", humidity);
-                mqtt_publish_sensor(mqtt_client, MQTT_TOPIC_HUMIDITY, mqtt_payload);
+    return ESP_OK;
+}
+
+static int dht_format(void *ctx, char *buf, size_t len) {
+    return snprintf(buf, len, "\"temperature\":%.1f,\"humidity\":%.1f", dht_state.temperature, dht_state.humidity);
+}
+
+static int soil_moisture;
+
+// Soil moisture and the pump hysteresis
+static esp_err_t soil_sample(void *ctx) {
+    int moisture = soil_moisture = read_soil_sensor();
+
+    if (moisture >= 200 && moisture <= 4000) {
+        ESP_LOGI("Soil Moisture Sensor", "🧴Moisture value: %d", moisture);
+
+        // MQTT publish for soil moisture
+        report_reading(&sensor_frame, TELEMETRY_MOISTURE, moisture);
+
+        char control_url[50];
+        snprintf(control_url, sizeof(control_url),
+                 "/api/controls?control_id=%d", sensors[3].id);
+
+        // Check if we need to turn on the pump (moisture too low/dry)
+        xSemaphoreTake(control_lock, portMAX_DELAY);
+        bool was_on = pump_on;
+        if (!pump_on && moisture > dry_threshold) set_pump_locked(true);
+        else if (pump_on && moisture < wet_threshold) set_pump_locked(false);
+        bool on = pump_on;
+        xSemaphoreGive(control_lock);
+
+        if (on && !was_on) {
+            send_to_http_queue(HTTP_CLASS_CONTROL, control_url, "{\"state\":\"on\"}");
+            send_to_http_queue(HTTP_CLASS_MESSAGE, "/api/messages",
+                    "{\"device_id\":%d,\"control_id\":%d,\"state\":\"on\",\"from_source\":\"%s\"}",
+                    device_id, sensors[3].id, sensors[3].name);
+
+            ESP_LOGW("Soil Moisture Sensor","Soil dry, pump ON");
+        }
+        // Check if we need to turn off the pump (moisture high enough/wet)
+        else if (!on && was_on) {
+            send_to_http_queue(HTTP_CLASS_CONTROL, control_url, "{\"state\":\"off\"}");
+            send_to_http_queue(HTTP_CLASS_MESSAGE, "/api/messages",
+                    "{\"device_id\":%d,\"control_id\":%d,\"state\":\"off\",\"from_source\":\"%s\"}",
+                    device_id, sensors[3].id, sensors[3].name);
+
+            ESP_LOGW("Soil Moisture Sensor","Soil wet, pump OFF");
+        }
+
+        // MQTT publish for pump state
+        report_reading(&sensor_frame, TELEMETRY_PUMP, on ? 1 : 0);
+        return ESP_OK;
+    }
+    xSemaphoreTake(control_lock, portMAX_DELAY);
+    set_pump_locked(false);
+    xSemaphoreGive(control_lock);
+    ESP_LOGW("Soil Moisture Sensor", "Invalid moisture value: %d - pump forced OFF", moisture);
+    report_reading(&sensor_frame, TELEMETRY_PUMP, 0);
+    return ESP_ERR_INVALID_RESPONSE;
+}
+
+static int soil_format(void *ctx, char *buf, size_t len) {
+    return snprintf(buf, len, "\"moisture\":%d,\"pump_state\":%d", soil_moisture, pump_on ? 1 : 0);
+}
+
+static ppg_result_t pulse;
+
+// Heart rate and SpO2 are computed by the UART task from the samples the
+// Arduino streams; forward the newest values
+static esp_err_t heart_rate_sample(void *ctx) {
+    ppg_result_t got[4];
+    size_t n = spsc_ring_pop(&pulse_readings, got, 4);
+    if (n == 0) return ESP_OK;
+    const ppg_result_t r = got[n - 1];
+    pulse = r;
+    if (r.hr_valid) report_reading(&sensor_frame, TELEMETRY_HEART_RATE, r.heart_rate);
+    if (r.spo2_valid) report_reading(&sensor_frame, TELEMETRY_SPO2, r.spo2);
+    return ESP_OK;
+}
+
+static int heart_rate_format(void *ctx, char *buf, size_t len) {
+    return snprintf(buf, len, "\"heart_rate\":%d,\"spo2\":%d", (int)pulse.heart_rate, (int)pulse.spo2);
+}
+
+static void log_sensor_stats(void) {
+    char value[128];
+    ESP_LOGI("SCHED", "Sensor timing (us):");
+    for (int i = 0; i < sensor_sched.count; i++) {
+        const sensor_stats_t *st = sensor_sched_stats(&sensor_sched, i);
+        if (st->runs == 0) continue;
+        if (sensor_sched_format(&sensor_sched, i, value, sizeof(value)) == 0) value[0] = '\0';
+        ESP_LOGI("SCHED", "  %-10s runs %" PRIu32 ", late avg %" PRIu32 " max %" PRIu32 ", exec avg %" PRIu32
+                 " max %" PRIu32 ", overruns %" PRIu32 ", errors %" PRIu32 " %s",
+                 sensor_sched.slots[i].driver->name, st->runs, (uint32_t)(st->late_sum_us / st->runs),
+                 st->late_max_us, (uint32_t)(st->exec_sum_us / st->runs), st->exec_max_us,
+                 st->overruns, st->errors, value);
+    }
+}
+
+#ifdef CONFIG_LOAD_TEST
+// Synthetic readings for tests/standin/e2e_bench.py, load_test_rate() per
+// second (the host simulator's "load" input). Each goes out both ways a
+// reading can leave the device: through the publish policy and publisher
+// every sensor reading takes on MQTT, and the HTTP telemetry queue. The
+// payload carries a sequence number and the wall-clock time it was made,
+// so the receiving end can count losses and measure latency. Once a second
+// the counters go out on LOAD_STATS_TOPIC_FMT, so the bench can tell how
+// many were made and where the device itself dropped them.
+float load_test_rate(void);
+
+#define LOAD_STATS_INTERVAL_US 1000000
+
+static struct {
+    int64_t last_us;
+    int64_t stats_us;       // last LOAD_STATS_TOPIC_FMT message
+    double owed;            // readings due but not made yet
+    uint32_t seq;           // readings made, the next one's seq
+    uint32_t mqtt_failed;   // uplink down, suppressed or publish refused
+    uint32_t http_refused;
+} load_state;
+
+// http_dropped counts evictions, expiries and refusals per class, and for
+// telemetry the readings too big to batch; the telemetry refusals are also
+// in http_refused, so they go out on their own
+static void load_publish_stats(int64_t now) {
+    uint32_t dropped[HTTP_CLASS_COUNT];
+    http_class_stats_t telemetry;
+    xSemaphoreTake(http_queue_lock, portMAX_DELAY);
+    for (int c = 0; c < HTTP_CLASS_COUNT; c++) dropped[c] = http_class_dropped(c);
+    http_pqueue_get_stats(&http_request_queue, HTTP_CLASS_TELEMETRY, &telemetry);
+    xSemaphoreGive(http_queue_lock);
+
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    char payload[224];
+    snprintf(payload, sizeof(payload),
+             "{\"t_us\":%lld,\"seq\":%" PRIu32 ",\"mqtt_failed\":%" PRIu32 ",\"http_refused\":%" PRIu32
+             ",\"http_dropped\":{\"control\":%" PRIu32 ",\"message\":%" PRIu32 ",\"telemetry\":%" PRIu32 "}"
+             ",\"telemetry_rejected\":%" PRIu32 "}",
+             tv.tv_sec * 1000000LL + tv.tv_usec, load_state.seq, load_state.mqtt_failed, load_state.http_refused,
+             dropped[HTTP_CLASS_CONTROL], dropped[HTTP_CLASS_MESSAGE], dropped[HTTP_CLASS_TELEMETRY],
+             telemetry.rejected);
+    if (uplink_up()) hw_mqtt_enqueue(mqtt_client, load_stats_topic, payload, 0, 1, false);
+    load_state.stats_us = now;
+}
+
+static esp_err_t load_sample(void *ctx) {
+    int64_t now = hw_time_us();
+    float rate = load_test_rate();
+    if (load_state.last_us == 0 || rate <= 0) load_state.owed = 0;
+    else load_state.owed += rate * (now - load_state.last_us) / 1e6;
+    load_state.last_us = now;
+
+    for (; load_state.owed >= 1; load_state.owed -= 1) {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        xSemaphoreTake(http_queue_lock, portMAX_DELAY);
+        unsigned depth = http_pqueue_total(&http_request_queue);
+        xSemaphoreGive(http_queue_lock);
+        uint32_t seq = load_state.seq++;
+        char payload[96];
+        snprintf(payload, sizeof(payload), "{\"seq\":%" PRIu32 ",\"t_us\":%lld,\"r\":%d,\"q\":%u}",
+                 seq, tv.tv_sec * 1000000LL + tv.tv_usec, (int)rate, depth);
+        if (!publish_allowed(LOAD_TOPIC, seq) || !uplink_up() || !mqtt_publish_topic(LOAD_TOPIC, payload, 0)) {
+            load_state.mqtt_failed++;
+        }
+        // sensor_id 0: not a registered sensor
+        if (!send_to_http_queue(HTTP_CLASS_TELEMETRY, "/api/sensor_data",
+                                "{\"sensor_id\":0,\"device_id\":%d,\"data\":%s}", device_id, payload)) {
+            load_state.http_refused++;
+        }
+    }
+    if (now - load_state.stats_us >= LOAD_STATS_INTERVAL_US) load_publish_stats(now);
+    return ESP_OK;
+}
+
+static int load_format(void *ctx, char *buf, size_t len) {
+    xSemaphoreTake(http_queue_lock, portMAX_DELAY);
+    uint32_t dropped = http_class_dropped(HTTP_CLASS_TELEMETRY);
+    xSemaphoreGive(http_queue_lock);
+    return snprintf(buf, len, "\"made\":%" PRIu32 ",\"mqtt_failed\":%" PRIu32 ",\"http_refused\":%" PRIu32
+                    ",\"http_dropped\":%" PRIu32, load_state.seq, load_state.mqtt_failed, load_state.http_refused,
+                    dropped);
+}
 #endif
-                // Remove or comment out HTTP queue for temp/humidity sensor
-                // xQueueSend(http_request_queue, &reqs[3], 0);
-                // xQueueSend(http_request_queue, &reqs[4], 0);
-            }
+
+#if configUSE_TRACE_FACILITY
+// CPU share since the last sample, as a percentage of one core, and stack
+// headroom of every task
+static void metrics_sample_tasks(void) {
+    static TaskStatus_t tasks[METRICS_MAX_TASKS];
+    static struct {
+        TaskHandle_t handle;
+        uint32_t run_time;
+    } last[METRICS_MAX_TASKS];
+    static int last_count;
+    static uint32_t last_total;
+
+    uint32_t total;
+    int n = uxTaskGetSystemState(tasks, METRICS_MAX_TASKS, &total);
+    if (n == 0) {
+        ESP_LOGW("METRICS", "More than %d tasks, task metrics skipped", METRICS_MAX_TASKS);
+        return;
+    }
+    uint32_t elapsed = total - last_total;
+    for (int i = 0; i < n; i++) {
+        const TaskStatus_t *t = &tasks[i];
+        metrics_set(metrics_gauge(&metrics, "task_stack_free_bytes", "Least stack left since the task started",
+                                  "task", t->pcTaskName), t->usStackHighWaterMark);
+        for (int j = 0; j < last_count; j++) {
+            if (last[j].handle != t->xHandle || elapsed == 0) continue;
+            metrics_set(metrics_gauge(&metrics, "task_cpu_percent", "CPU time since the last sample, % of one core",
+                                      "task", t->pcTaskName), 100.0f * (t->ulRunTimeCounter - last[j].run_time) / elapsed);
+            break;
         }
+    }
+    for (int i = 0; i < n; i++) {
+        last[i].handle = tasks[i].xHandle;
+        last[i].run_time = tasks[i].ulRunTimeCounter;
+    }
+    last_count = n;
+    last_total = total;
+}
+#endif
 
-        // Read soil moisture sensor value every 3 seconds (500 ticks*6)
-        if (++soil_read_counter >= 3) {
-            // Read soil moisture with improved validation
-            moisture = read_soil_sensor();
-
-            if (moisture >= 200 && moisture <= 4000) {
-                ESP_LOGI("Soil Moisture Sensor", "🧴Moisture value: %d", moisture);
-
-                // Format the sensor data JSON properly
-                char soil_data[64];
-                snprintf(soil_data, sizeof(soil_data), "{\"moisture\":%d}", moisture);
-
-                // Remove or comment out HTTP queue for soil moisture sensor
-                // http_request_t req1;
-                // snprintf(req1.endpoint, sizeof(req1.endpoint), "/api/sensor_data");
-                // snprintf(req1.json_body, sizeof(req1.json_body),
-                //         "{\"sensor_id\":%d,\"device_id\":%d,\"data\":%s}",
-                //         sensors[2].id, device_id, soil_data);
-                // send_to_http_queue(&req1, 0, pdMS_TO_TICKS(50));
-
-                // MQTT publish for soil moisture
-                snprintf(mqtt_payload, sizeof(mqtt_payload), "{\"moisture\":%d}", moisture);
-                mqtt_publish_sensor(mqtt_client, MQTT_TOPIC_MOISTURE, mqtt_payload);
-
-                char control_url[50];
-                snprintf(control_url, sizeof(control_url),
-                         "/api/controls?control_id=%d", sensors[3].id);
-
-                // Check if we need to turn on the pump (moisture too low/dry)
-                if (!pump_on && moisture > dry_threshold) {
-                    set_soil_relay(true);
-                    pump_on = true;
-                    relay_state = true;
-
-                    http_request_t req2, req3;
-                    snprintf(req2.endpoint, sizeof(req2.endpoint), "%s", control_url);
-                    snprintf(req2.json_body, sizeof(req2.json_body), "{\"state\":\"on\"}");
-                    send_to_http_queue(&req2, 5, pdMS_TO_TICKS(100));
-
-                    snprintf(req3.endpoint, sizeof(req3.endpoint), "/api/messages");
-                    snprintf(req3.json_body, sizeof(req3.json_body),
-                            "{\"device_id\":%d,\"control_id\":%d,\"state\":\"on\",\"from_source\":\"%s\"}",
-                            device_id, sensors[3].id, sensors[3].name);
-                    send_to_http_queue(&req3, 0, pdMS_TO_TICKS(50));
-
-                    ESP_LOGW("Soil Moisture Sensor","Soil dry, pump ON");
-                }
-                // Check if we need to turn off the pump (moisture high enough/wet)
-                else if (pump_on && moisture < wet_threshold) {
-                    set_soil_relay(false);
-                    pump_on = false;
-                    relay_state = false;
-
-                    http_request_t req2, req3;
-                    snprintf(req2.endpoint, sizeof(req2.endpoint), "%s", control_url);
-                    snprintf(req2.json_body, sizeof(req2.json_body), "{\"state\":\"off\"}");
-                    send_to_http_queue(&req2, 5, pdMS_TO_TICKS(100));
-
-                    snprintf(req3.endpoint, sizeof(req3.endpoint), "/api/messages");
-                    snprintf(req3.json_body, sizeof(req3.json_body),
-                            "{\"device_id\":%d,\"control_id\":%d,\"state\":\"off\",\"from_source\":\"%s\"}",
-                            device_id, sensors[3].id, sensors[3].name);
-                    send_to_http_queue(&req3, 0, pdMS_TO_TICKS(50));
-
-                    ESP_LOGW("Soil Moisture Sensor","Soil wet, pump OFF");
-                }
+static void metrics_sample_queues(void) {
+    static const char *class_names[HTTP_CLASS_COUNT] = { "control", "message", "telemetry" };
+    http_class_stats_t stats[HTTP_CLASS_COUNT];
+    unsigned depth[HTTP_CLASS_COUNT];
+    uint32_t dropped[HTTP_CLASS_COUNT];
+    http_msg_store_stats_t arena;
+    xSemaphoreTake(http_queue_lock, portMAX_DELAY);
+    for (int c = 0; c < HTTP_CLASS_COUNT; c++) {
+        http_pqueue_get_stats(&http_request_queue, c, &stats[c]);
+        dropped[c] = http_class_dropped(c);
+        depth[c] = http_pqueue_count(&http_request_queue, c);
+    }
+    http_msg_store_get_stats(&http_msg_store, &arena);
+    xSemaphoreGive(http_queue_lock);
+
+    for (int c = 0; c < HTTP_CLASS_COUNT; c++) {
+        metrics_set(metrics_gauge(&metrics, "http_queue_depth", "Requests waiting in the HTTP queue",
+                                  "class", class_names[c]), depth[c]);
+        metrics_set_total(metrics_counter(&metrics, "http_queue_sent_total", "Requests taken off the HTTP queue",
+                                    "class", class_names[c]), stats[c].dispatched);
+        metrics_set_total(metrics_counter(&metrics, "http_queue_dropped_total", "Requests evicted, rejected or expired",
+                                    "class", class_names[c]), dropped[c]);
+    }
+    metrics_set(metrics_gauge(&metrics, "http_arena_used_bytes", "Request bodies held in the HTTP arena", NULL, NULL),
+                arena.used);
+}
 
-                // record pump state change
-                // Remove or comment out HTTP queue for pump state sensor
-                // http_request_t req4;
-                // snprintf(req4.endpoint, sizeof(req4.endpoint), "/api/sensor_data");
-                // snprintf(req4.json_body, sizeof(req4.json_body),
-                //         "{\"sensor_id\":%d,\"device_id\":%d,\"data\":{\"pump_state\":%d}}",
-                //         sensors[3].id, device_id, pump_on ? 1 : 0);
-                // send_to_http_queue(&req4, 0, pdMS_TO_TICKS(50));
-                // MQTT publish for pump state
-                snprintf(mqtt_payload, sizeof(mqtt_payload), "{\"pump_state\":%d}", pump_on ? 1 : 0);
-                mqtt_publish_sensor(mqtt_client, MQTT_TOPIC_PUMP, mqtt_payload);
-            } else {
-                set_soil_relay(false);
-                pump_on = false;
-                relay_state = false;
-                ESP_LOGW("Soil Moisture Sensor", "Invalid moisture value: %d - pump forced OFF", moisture);
-                snprintf(mqtt_payload, sizeof(mqtt_payload), "{\"pump_state\":0}");
-                mqtt_publish_sensor(mqtt_client, MQTT_TOPIC_PUMP, mqtt_payload);
-            }
+// The scheduler's own statistics; runs in its task, so they are read whole
+static void metrics_sample_sensors(void) {
+    for (int i = 0; i < sensor_sched.count; i++) {
+        const char *name = sensor_sched.slots[i].driver->name;
+        const sensor_stats_t *st = sensor_sched_stats(&sensor_sched, i);
+        metrics_set_total(metrics_counter(&metrics, "sensor_runs_total", "Sensor driver runs", "sensor", name), st->runs);
+        metrics_set_total(metrics_counter(&metrics, "sensor_errors_total", "Sensor reads that failed", "sensor", name), st->errors);
+        metrics_set(metrics_gauge(&metrics, "sensor_exec_max_us", "Longest sensor read", "sensor", name), st->exec_max_us);
+        metrics_set(metrics_gauge(&metrics, "sensor_late_max_us", "Latest start after the deadline", "sensor", name),
+                    st->late_max_us);
+    }
+}
+
+static esp_err_t metrics_sample(void *ctx) {
+#if configUSE_TRACE_FACILITY
+    metrics_sample_tasks();
+#endif
+    size_t heap_free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    size_t heap_largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    metrics_set(metrics_gauge(&metrics, "heap_free_bytes", "Free heap", NULL, NULL), heap_free);
+    metrics_set(metrics_gauge(&metrics, "heap_min_free_bytes", "Least free heap since boot", NULL, NULL),
+                heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT));
+    metrics_set(metrics_gauge(&metrics, "heap_largest_free_block_bytes", "Largest allocation that would succeed", NULL, NULL),
+                heap_largest);
+    metrics_set(metrics_gauge(&metrics, "heap_fragmentation_percent", "Free heap not in the largest block", NULL, NULL),
+                heap_free ? 100.0f * (heap_free - heap_largest) / heap_free : 0);
+
+    metrics_sample_queues();
+    metrics_sample_sensors();
+
+    // Owned by the UART task; a sample may be one packet behind
+    metrics_set_total(metrics_counter(&metrics, "uart_packets_total", "Packets from the Uno", NULL, NULL), uno_rx_seq.received);
+    metrics_set_total(metrics_counter(&metrics, "uart_packets_lost_total", "Uno packets missing from the sequence", NULL, NULL),
+                uno_rx_seq.lost);
+    metrics_set_total(metrics_counter(&metrics, "uart_bad_frames_total", "Uno frames failing COBS or CRC", NULL, NULL),
+                uno_bad_frames);
+    metrics_set_total(metrics_counter(&metrics, "uart_overruns_total", "Uno frames lost to a full framer", NULL, NULL),
+                uno_framer.stats.overruns + uno_framer.stats.oversize);
+    metrics_set(metrics_gauge(&metrics, "uart_baud", "Uno link rate", NULL, NULL), uno_baud);
+    metrics_set(metrics_gauge(&metrics, "mqtt_connected", "1 while the broker connection is up", NULL, NULL), uplink_up());
+
+    static bool refused_logged;
+    if (!refused_logged && metrics_refused(&metrics) > 0) {
+        ESP_LOGE("METRICS", "%" PRIu32 " series not registered: table of %d full or a name reused with another type",
+                 metrics_refused(&metrics), METRICS_MAX);
+        refused_logged = true;
+    }
+
+    static int64_t last_publish_us;
+    int64_t now = hw_time_us();
+    if (uplink_up() && (last_publish_us == 0 || now - last_publish_us >= (int64_t)METRICS_PUBLISH_MS * 1000)) {
+        int len;
+        char *json = metrics_format_alloc(&metrics, METRICS_JSON, &len);
+        if (json == NULL) return ESP_ERR_NO_MEM;
+        if (hw_mqtt_publish(mqtt_client, metrics_topic, json, len, 0, false) >= 0) last_publish_us = now;
+        free(json);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t stats_sample(void *ctx) {
+    log_publish_stats();
+    log_sensor_stats();
+    log_uno_link_stats();
+    return ESP_OK;
+}
+
+// Periods follow the old 500 ms loop: LED every tick, the 2 s group on
+// every 4th, soil on every 3rd
+static const sensor_driver_t sensor_drivers[] = {
+    { .name = "led",        .period_ms = 500,   .sample = led_sample },
+    { .name = "ldr",        .period_ms = 2000,  .sample = ldr_sample,        .format = ldr_format },
+    { .name = "rcwl",       .period_ms = 2000,  .init = rcwl_init, .sample = rcwl_sample, .format = rcwl_format },
+    { .name = "acs712",     .period_ms = 2000,  .sample = acs712_sample,     .format = acs712_format },
+    { .name = "dht",        .period_ms = 2000,  .init = dht_init, .sample = dht_sample, .format = dht_format },
+    { .name = "soil",       .period_ms = 1500,  .sample = soil_sample,       .format = soil_format },
+    { .name = "heart_rate", .period_ms = 1000,  .sample = heart_rate_sample, .format = heart_rate_format },
+    { .name = "stats",      .period_ms = 60000, .offset_ms = 60000, .sample = stats_sample },
+    { .name = "metrics",    .period_ms = METRICS_SAMPLE_MS, .sample = metrics_sample },
+#ifdef CONFIG_LOAD_TEST
+    { .name = "load",       .period_ms = 20,    .sample = load_sample,       .format = load_format },
+#endif
+};
+
+static bool trace_console_write(const char *data, size_t len, void *ctx) {
+    return fwrite(data, 1, len, stdout) == len;
+}
+
+static void trace_dump_task(void *arg) {
+    printf("\n==== TRACE BEGIN ====\n");
+    int spans = trace_export_chrome(trace_console_write, NULL);
+    printf("==== TRACE END ====\n");
+    fflush(stdout);
+    ESP_LOGI("TRACE", "Dumped %d spans, recording again", spans);
+    trace_set_enabled(true);
+    vTaskDelete(NULL);
+}
+
+// The first overrun of a boot stops the span recorder, so the spans that
+// led up to it are what gets printed to the console (and served at /trace
+// until the dump is done). Save the text between the markers as a .json
+// file and open it in Perfetto.
+static void check_sensor_overruns(void) {
+    static uint32_t seen;
+    static bool dumped;
+    uint32_t total = 0;
+    for (int i = 0; i < sensor_sched.count; i++) total += sensor_sched_stats(&sensor_sched, i)->overruns;
+    if (total == seen) return;
+    seen = total;
+    if (dumped) return;
+    dumped = true;
+    trace_set_enabled(false);
+    ESP_LOGW("TRACE", "Sensor loop overran, dumping the trace to the console");
+    if (xTaskCreate(trace_dump_task, "trace_dump", TRACE_DUMP_TASK_STACK, NULL, 1, NULL) != pdPASS) {
+        trace_set_enabled(true);
+    }
+}
+
+static void second_loop_task(void *arg)
+{
+    // initialize test button task
+    xTaskCreate(button_task, "button_task", BUTTON_TASK_STACK, NULL, 10, &button_task_handle);
+    // Photoresistor, ACS712 and soil channels are sampled by adc_sampler
+    calibrate_zero_offset();
+
+    telemetry_frame_init(&sensor_frame, device_id, 0, 0);
+    // MQTT
+    const hw_mqtt_config_t mqtt_cfg = {
+        .uri = MQTT_BROKER_URI,
+        .cert_pem = MQTT_BROKER_CERT,
+        .username = "eee4464",
+        .password = "Eee4464iot",
+    };
+    mqtt_client = hw_mqtt_start(&mqtt_cfg, mqtt_event_handler, NULL);
+
+    sensor_sched_init(&sensor_sched, hw_time_us);
+    for (size_t i = 0; i < sizeof(sensor_drivers) / sizeof(sensor_drivers[0]); i++) {
+        sensor_sched_add(&sensor_sched, &sensor_drivers[i]);
+    }
+    esp_err_t err = sensor_sched_start(&sensor_sched);
+    if (err != ESP_OK) {
+        ESP_LOGE("SCHED", "Sensor init failed: %s", esp_err_to_name(err));
+    }
 
-            soil_read_counter = 0; // Reset counter after reading
+    while (1) {
+        if (is_ap_mode_enabled()) {   // no sensing or network in softAP mode, just blink
+            led_sample(NULL);
+            vTaskDelay(pdMS_TO_TICKS(500));
+            continue;
         }
+        int64_t wait_us = sensor_sched_run(&sensor_sched);
+        telemetry_flush(&sensor_frame);
+        check_sensor_overruns();
+        TickType_t ticks = pdMS_TO_TICKS((wait_us + 999) / 1000);
+        vTaskDelay(ticks > 0 ? ticks : 1);
     }
-    // Do not call adc_oneshot_del_unit(adc1_handle) here, global handle reused.
-}
-
-static void process_arduino_data(const char *data) {
-    extern esp_mqtt_client_handle_t mqtt_client;
-    static char mqtt_payload[64];
-    // ESP_LOGI("UART", "Received: %s", data);
-    // if data include 'hr' then parse it as heart rate
-    // data:  {"hr":65}
-    if (strstr(data, "hr") == NULL) {
-        return; // no heart rate data
-    }
-    ESP_LOGI("UART", "Received: %s", data);
-
-    cJSON *root = cJSON_Parse(data);
-    if (!root) return;
-    cJSON *hr = cJSON_GetObjectItem(root, "hr");
-    if (cJSON_IsNumber(hr) ) {
-        int heart = hr->valueint;
-        if (heart >= 40 && heart <= 180 ) {
-            // Remove or comment out HTTP queue for heart rate sensor
-            // http_request_t req1;
-            // snprintf(req1.endpoint, sizeof(req1.endpoint), "/api/sensor_data");
-            // snprintf(req1.json_body, sizeof(req1.json_body),
-            //         "{\"sensor_id\":%d,\"device_id\":%d,\"data\":{\"heart_rate\":%d}}",
-            //         sensors[7].id, device_id, heart);
-            // send_to_http_queue(&req1, 0, pdMS_TO_TICKS(50));
-            // MQTT publish for heart rate
-            snprintf(mqtt_payload, sizeof(mqtt_payload), "{\"heart_rate\":%d}", heart);
-            mqtt_publish_sensor(mqtt_client, MQTT_TOPIC_HEART_RATE, mqtt_payload);
+}
+
+// Plausible values only; the Maxim algorithm reports whatever peaks it finds.
+// Published by the heart_rate sensor driver.
+static void forward_pulse(ppg_result_t r) {
+    r.hr_valid = r.hr_valid && r.heart_rate >= 40 && r.heart_rate <= 180;
+    r.spo2_valid = r.spo2_valid && r.spo2 >= 70 && r.spo2 <= 100;
+    if (r.hr_valid || r.spo2_valid) spsc_ring_push(&pulse_readings, &r, 1);
+}
+
+static void uno_send(uno_packet_t *p) {
+    uint8_t buf[UNO_LINK_MAX_FRAME];
+    p->seq = uno_tx_seq++;
+    size_t len = uno_link_encode(p, buf, sizeof(buf));
+    if (len > 0) hw_uart_write(EX_UART_NUM, buf, len);
+}
+
+static void uno_set_baud(uint32_t baud) {
+    hw_uart_set_baud(EX_UART_NUM, baud);
+    uart_framer_reset(&uno_framer);
+    uno_baud = baud;
+    uno_rx_seq.synced = false;      // packets in flight during the switch are not losses
+    ppg_window_reset(&pulse_window);
+    uno_last_rx_us = hw_time_us();
+    ESP_LOGI("UART", "Uno link at %" PRIu32 " baud", baud);
+}
+
+// The Uno says hello at 9600 once a second; answer with the rate to use.
+// It acknowledges at the old rate and switches, and we follow.
+static void process_uno_packet(const uno_packet_t *p) {
+    switch (p->type) {
+    case UNO_PKT_HELLO:
+        if (uno_baud == UNO_LINK_BAUD_DEFAULT && p->hello.version == UNO_LINK_VERSION &&
+            p->hello.max_baud >= UNO_LINK_BAUD) {
+            uno_packet_t set = { .type = UNO_PKT_BAUD_SET, .baud.baud = UNO_LINK_BAUD };
+            uno_send(&set);
+        }
+        break;
+    case UNO_PKT_BAUD_ACK:
+        if (p->baud.baud != uno_baud) uno_set_baud(p->baud.baud);
+        break;
+    case UNO_PKT_SAMPLES:
+        for (int i = 0; i < p->samples.count; i++) {
+            ppg_result_t r;
+            if (ppg_window_push(&pulse_window, p->samples.s[i].ir, p->samples.s[i].red, &r) &&
+                r.ir_mean >= PPG_FINGER_IR) {
+                forward_pulse(r);
+            }
         }
+        break;
+    case UNO_PKT_HR: {
+        // Remove or comment out HTTP queue for heart rate sensor
+        // send_to_http_queue(HTTP_CLASS_TELEMETRY, "/api/sensor_data",
+        //         "{\"sensor_id\":%d,\"device_id\":%d,\"data\":{\"heart_rate\":%d}}",
+        //         sensors[7].id, device_id, heart);
+        ppg_result_t r = { .heart_rate = p->hr.bpm, .hr_valid = true };
+        forward_pulse(r);
+        break;
+    }
+    case UNO_PKT_SPO2: {
+        ppg_result_t r = {
+            .heart_rate = p->spo2.hr, .hr_valid = p->spo2.flags & UNO_HR_VALID,
+            .spo2 = p->spo2.spo2, .spo2_valid = p->spo2.flags & UNO_SPO2_VALID,
+        };
+        forward_pulse(r);
+        break;
+    }
+    case UNO_PKT_IR_EVENT:
+        ESP_LOGI("UART", "IR command 0x%02X: lights 0x%02X, brightness %u, color temp %u",
+                 p->ir.command, p->ir.lights, p->ir.brightness, p->ir.color_temp);
+        break;
+    default:
+        ESP_LOGD("UART", "Unhandled packet type 0x%02X", p->type);
+        break;
+    }
+}
+
+static void process_uno_frame(const uart_frame_t *frame) {
+    uno_packet_t pkt;
+    uno_link_status_t status = uno_link_decode((const uint8_t *)frame->data, frame->len, &pkt);
+    if (status != UNO_LINK_OK) {
+        uno_bad_frames++;
+        ESP_LOGD("UART", "Dropped frame (%s)", uno_link_status_str(status));
+        return;
+    }
+    uno_last_rx_us = hw_time_us();
+    uint32_t lost = uno_link_seq_update(&uno_rx_seq, pkt.seq);
+    if (lost > 0) {
+        ESP_LOGD("UART", "%" PRIu32 " packets lost before seq %u", lost, pkt.seq);
+        ppg_window_reset(&pulse_window);    // samples missing, start over
     }
-    cJSON_Delete(root);
+    process_uno_packet(&pkt);
 }
 
+// At the negotiated rate, ping the Uno so it stays there, and drop back to
+// 9600 when it goes quiet (reset, unplugged); it does the same on its side.
+static void uno_link_tick(void) {
+    if (uno_baud == UNO_LINK_BAUD_DEFAULT) return;
+    int64_t now = hw_time_us();
+    if (now - uno_last_rx_us > UNO_LINK_TIMEOUT_MS * 1000LL) {
+        ESP_LOGW("UART", "No packets from the Uno");
+        uno_set_baud(UNO_LINK_BAUD_DEFAULT);
+        return;
+    }
+    if (now - uno_last_ping_us >= UNO_LINK_PING_MS * 1000LL) {
+        uno_last_ping_us = now;
+        uno_packet_t ping = { .type = UNO_PKT_PING };
+        uno_send(&ping);
+    }
+}
+
+static void log_uno_link_stats(void) {
+    ESP_LOGI("UART", "Uno link: %" PRIu32 " baud, %" PRIu32 " packets, %" PRIu32 " lost, %" PRIu32
+             " bad frames, %" PRIu32 " oversize, %" PRIu32 " overruns",
+             uno_baud, uno_rx_seq.received, uno_rx_seq.lost, uno_bad_frames,
+             uno_framer.stats.oversize, uno_framer.stats.overruns);
+}
+
+// Woken by the UART driver as bytes arrive. Received bytes are read straight
+// into the framer's ring and complete frames are decoded in place.
 static void uart_event_task(void *pvParameters) {
-    uint8_t data[UART_BUF_SIZE];
+    uart_frame_t frame;
     while (1) {
-        int len = uart_read_bytes(EX_UART_NUM, data, UART_BUF_SIZE - 1, 100 / portTICK_PERIOD_MS);
-        if (len > 0) {
-            data[len] = 0;
-            process_arduino_data((char *)data);
+        int ready = hw_uart_wait(EX_UART_NUM, UNO_LINK_PING_MS);
+        if (ready < 0) {
+            ESP_LOGW("UART", "RX overflow, input flushed");
+            uart_framer_reset(&uno_framer);
+        }
+        for (size_t left = ready > 0 ? ready : 0; left > 0; ) {
+            size_t space;
+            uint8_t *dst = uart_framer_write_ptr(&uno_framer, &space);
+            int len = hw_uart_read(EX_UART_NUM, dst, left < space ? left : space);
+            if (len <= 0) break;
+            uart_framer_commit(&uno_framer, len);
+            left -= len;
+            while (uart_framer_next(&uno_framer, &frame)) {
+                process_uno_frame(&frame);
+            }
         }
+        uno_link_tick();
     }
 }
 
 static void setup_uart2(void) {
-    const uart_config_t uart_config = {
-        .baud_rate = 9600,
-        .data_bits = UART_DATA_8_BITS,
-        .parity    = UART_PARITY_DISABLE,
-        .stop_bits = UART_STOP_BITS_1,
-        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE
-    };
-    uart_driver_install(EX_UART_NUM, UART_BUF_SIZE * 2, 0, 0, NULL, 0);
-    uart_param_config(EX_UART_NUM, &uart_config);
-    uart_set_pin(EX_UART_NUM, UART_TX_PIN, UART_RX_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    uart_framer_init_binary(&uno_framer);
+    ppg_window_init(&pulse_window, PPG_RATE_HZ);
+    // 8N1, no flow control
+    hw_uart_open(EX_UART_NUM, UNO_LINK_BAUD_DEFAULT, UART_TX_PIN, UART_RX_PIN, UART_BUF_SIZE * 2);
 }
 void app_main(void)
 {
+    control_lock = xSemaphoreCreateMutex();
+    telemetry_lock = xSemaphoreCreateMutex();
     init();
     while(is_ap_mode_enabled()){
             vTaskDelay(pdMS_TO_TICKS(1000)); // Wait 1 second before checking again
     }
 
-    http_request_queue = xQueueCreate(HTTP_QUEUE_LENGTH, sizeof(http_request_t));
-    xTaskCreate(http_request_task, "http_request_task", 16384, NULL, 7, NULL);
+    http_queue_lock = xSemaphoreCreateMutex();
+    publish_lock = xSemaphoreCreateMutex();
+    publish_table_init(&publish_table, publish_topics, sizeof(publish_topics) / sizeof(publish_topics[0]));
+    http_msg_store_init(&http_msg_store, http_msg_arena, sizeof(http_msg_arena));
+    if (!http_pqueue_init(&http_request_queue, sizeof(http_msg_handle_t), http_class_config, HTTP_QUEUE_LENGTH)) {
+        ESP_LOGE("HTTP_QUEUE", "No mem for HTTP request queue");
+    }
+    http_pqueue_set_drop_cb(&http_request_queue, http_queue_drop_cb, NULL);
+    spool_setup();
+    xTaskCreate(http_request_task, "http_request_task", 16384, NULL, 7, &http_task_handle);
+    spsc_ring_init(&pulse_readings, pulse_readings_buf, sizeof(ppg_result_t), 4);
     xTaskCreate(uart_event_task, "uart_event_task", 4096, NULL, 8, NULL);
 
     /* Run main loop in a separate task with a larger stack to avoid main‑task overflow */
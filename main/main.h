@@ -1,6 +1,23 @@
 #ifndef MAIN_H
 #define MAIN_H
 
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "metrics.h"
+
+// Network bring-up, in wifi_setup.c (host/wifi_host.c in the host build)
+extern EventGroupHandle_t wifi_event_group;
+extern const int WIFI_CONNECTED_BIT;
+
 bool is_ap_mode_enabled(void);
+// Forget the WiFi network and restart if the reset button is held at boot
+void wifi_reset_check(void);
+// Join the stored network, or fall back to the configuration softAP
+void wifi_setup(void);
+void print_chip_info(void);
+
+// Runtime metrics, registered and sampled in main.c; wifi_setup.c serves them at /metrics
+extern metrics_t metrics;
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,376 @@
+// Device-only bring-up: WiFi station with the softAP configuration page as
+// fallback, and the boot-time WiFi reset. The host build replaces this file
+// with host/wifi_host.c.
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "esp_chip_info.h"
+#include "esp_flash.h"
+#include "esp_system.h"
+#include "esp_wifi.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_netif_ip_addr.h"
+#include "esp_http_server.h"
+#include "nvs_flash.h"
+#include "cJSON.h"
+#include "hw_gpio.h"
+#include "trace.h"
+#include "main.h"
+
+#define WIFI_RESET_GPIO GPIO_NUM_16
+
+// Global event group for WiFi connection
+EventGroupHandle_t wifi_event_group;
+const int WIFI_CONNECTED_BIT = BIT0;
+
+static const char *TAG = "wifi_setup";
+static bool is_softap_mode = false;
+
+bool is_ap_mode_enabled(void) {
+    return is_softap_mode;
+}
+
+void on_wifi_connected_notify(void) {
+    // TODO: control LED or other peripherals here
+
+}
+// WiFi event handler
+static void wifi_event_handler(void* arg, esp_event_base_t event_base,
+                              int32_t event_id, void* event_data)
+{
+    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
+        esp_wifi_connect();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        ESP_LOGI(TAG, "WiFi Connected.");
+        is_softap_mode = false; // Clear softAP mode flag
+
+        // Optional: Set bit here if you want, but only set on IP_EVENT_STA_GOT_IP for real connection
+    } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+        ESP_LOGI(TAG, "Got IP. WiFi connection SUCCESS!");
+        esp_netif_ip_info_t ip_info = ((ip_event_got_ip_t*)event_data)->ip_info;
+        ESP_LOGI(TAG, "Got IP Address: " IPSTR, IP2STR(&ip_info.ip));
+        xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_BIT);
+        on_wifi_connected_notify();
+        is_softap_mode = false; // Clear softAP mode flag
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        ESP_LOGI(TAG, "Disconnected. Retry...");
+        xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_BIT);
+        esp_wifi_connect();
+    }
+}
+// wifi scan
+esp_err_t wifi_scan_get_handler(httpd_req_t *req) {
+    uint16_t ap_num = 0;
+    esp_err_t err;
+
+    err = esp_wifi_scan_start(NULL, true);
+    if (err != ESP_OK) {
+        httpd_resp_send_500(req);
+        return err;
+    }
+    err = esp_wifi_scan_get_ap_num(&ap_num);
+    if (err != ESP_OK || ap_num == 0) {
+        httpd_resp_set_type(req, "application/json");
+        httpd_resp_send(req, "[]", HTTPD_RESP_USE_STRLEN);
+        return ESP_OK;
+    }
+
+    wifi_ap_record_t *ap_list = malloc(sizeof(wifi_ap_record_t) * ap_num);
+    if (!ap_list) {
+        httpd_resp_send_500(req);
+        return ESP_ERR_NO_MEM;
+    }
+    err = esp_wifi_scan_get_ap_records(&ap_num, ap_list);
+    if (err != ESP_OK) {
+        free(ap_list);
+        httpd_resp_send_500(req);
+        return err;
+    }
+
+    cJSON *root = cJSON_CreateArray();
+    for (int i = 0; i < ap_num; ++i) {
+        cJSON *ap = cJSON_CreateObject();
+        cJSON_AddStringToObject(ap, "ssid", (const char*)ap_list[i].ssid);
+        cJSON_AddNumberToObject(ap, "rssi", ap_list[i].rssi);
+        cJSON_AddItemToArray(root, ap);
+    }
+    char *out = cJSON_PrintUnformatted(root);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, out, HTTPD_RESP_USE_STRLEN);
+
+    free(out);
+    cJSON_Delete(root);
+    free(ap_list);
+    return ESP_OK;
+}
+
+// HTTP POST handler for WiFi config
+esp_err_t wifi_config_post_handler(httpd_req_t *req) {
+    char content[100];
+    int ret = httpd_req_recv(req, content, MIN(req->content_len, sizeof(content) - 1));
+    if (ret <= 0) return ESP_FAIL;
+
+    content[ret] = '\0';
+    ESP_LOGI(TAG, "Received WiFi config: %s", content);
+
+    char ssid[32] = {0}, password[64] = {0};
+    sscanf(content, "ssid=%31[^&]&password=%63s", ssid, password);
+
+    ESP_LOGI(TAG, "Try to connect: ssid=[%s] pwd=[%s]", ssid, password);
+
+    wifi_config_t wifi_config = {0};
+    strncpy((char *)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid));
+    strncpy((char *)wifi_config.sta.password, password, sizeof(wifi_config.sta.password));
+
+    esp_wifi_stop();
+    //ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+    // this allows both AP and STA mode
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA));
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+    esp_wifi_start();
+    ESP_ERROR_CHECK(esp_wifi_connect());
+
+    httpd_resp_send(req, "Trying to connect...", HTTPD_RESP_USE_STRLEN);
+    return ESP_OK;
+}
+
+// HTTP GET handler for root page (simple WiFi config form)
+esp_err_t root_get_handler(httpd_req_t *req) {
+    const char resp[] =
+    "<html><body>"
+    "<form method='POST' action='/config'>"
+    "SSID: <input name='ssid'><br><br>"
+    "Password: <input name='password' type='password'><br><br>"
+    "<input type='submit' value='Connect'></form>"
+    "<hr><h3>Select WiFi:</h3>"
+    "<div id='wifi-list'></div>"
+    "<script>"
+    "fetch('/scan').then(r=>r.json()).then(list=>{"
+    "list.sort((a,b)=>b.rssi-a.rssi);"
+    "let d=document.getElementById('wifi-list');"
+    "d.innerHTML=list.map(ap=>`<button onclick='askpw(\"${ap.ssid}\")'>${ap.ssid} (${ap.rssi})</button>`).join('<br>');"
+    "});"
+    "function askpw(ssid){"
+    "let pw=prompt('Please enter password:', '');"
+    "if(pw!=null){"
+    "let f=document.createElement('form');"
+    "f.method='POST'; f.action='/config';"
+    "f.innerHTML=`<input name=ssid value='${ssid}'><input name=password value='${pw}'>`;"
+    "document.body.appendChild(f); f.submit();"
+    "}}"
+    "</script></body></html>";
+
+httpd_resp_send(req, resp, HTTPD_RESP_USE_STRLEN);
+    return ESP_OK;
+}
+
+// Prometheus scrape of the runtime metrics
+static esp_err_t metrics_get_handler(httpd_req_t *req)
+{
+    int len;
+    char *buf = metrics_format_alloc(&metrics, METRICS_TEXT, &len);
+    if (buf == NULL) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    esp_err_t err = httpd_resp_send(req, buf, len);
+    free(buf);
+    return err;
+}
+
+static bool trace_send_chunk(const char *data, size_t len, void *ctx)
+{
+    return httpd_resp_send_chunk(ctx, data, len) == ESP_OK;
+}
+
+// Recent spans as Chrome trace JSON, to open in Perfetto
+static esp_err_t trace_get_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"trace.json\"");
+    if (trace_export_chrome(trace_send_chunk, req) < 0) return ESP_FAIL;
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+void setup_softap();
+
+void wifi_setup(void) {
+
+    ESP_ERROR_CHECK(nvs_flash_init());
+    ESP_ERROR_CHECK(esp_netif_init());
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+
+    // Create event group for WiFi connection
+    wifi_event_group = xEventGroupCreate();
+
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
+            ESP_EVENT_ANY_ID, &wifi_event_handler, NULL, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT,
+        ESP_EVENT_ANY_ID, &wifi_event_handler, NULL, NULL));
+
+    esp_netif_create_default_wifi_sta();
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+
+    // Enable WiFi config storage in flash (NVS)
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_FLASH));
+
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+    ESP_ERROR_CHECK(esp_wifi_start());
+
+    // Wait for connection with 15s timeout
+    if (xEventGroupWaitBits(wifi_event_group, WIFI_CONNECTED_BIT, pdFALSE, pdFALSE, pdMS_TO_TICKS(15000)) & WIFI_CONNECTED_BIT) {
+        ESP_LOGI(TAG, "WiFi connected within 15s.");
+		is_softap_mode = false;
+        // Device registration now handled in main_loop_task to avoid main‑task stack overflow
+    } else {
+        ESP_LOGW(TAG, "WiFi not connected in 15s, switching to softAP mode.");
+        setup_softap();
+    }
+
+
+
+
+    // Start HTTP server for configuration
+    httpd_handle_t server = NULL;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    if (httpd_start(&server, &config) == ESP_OK) {
+        httpd_uri_t root = {
+            .uri = "/",
+            .method = HTTP_GET,
+            .handler = root_get_handler
+        };
+        httpd_register_uri_handler(server, &root);
+
+        httpd_uri_t wifi_config = {
+            .uri = "/config",
+            .method = HTTP_POST,
+            .handler = wifi_config_post_handler
+        };
+        httpd_register_uri_handler(server, &wifi_config);
+
+        httpd_uri_t scan = {
+            .uri = "/scan",
+            .method = HTTP_GET,
+            .handler = wifi_scan_get_handler
+        };
+        httpd_register_uri_handler(server, &scan);
+
+        httpd_uri_t metrics_uri = {
+            .uri = "/metrics",
+            .method = HTTP_GET,
+            .handler = metrics_get_handler
+        };
+        httpd_register_uri_handler(server, &metrics_uri);
+
+        httpd_uri_t trace_uri = {
+            .uri = "/trace",
+            .method = HTTP_GET,
+            .handler = trace_get_handler
+        };
+        httpd_register_uri_handler(server, &trace_uri);
+    }
+}
+
+void setup_softap() {
+    is_softap_mode = true;
+
+    // Create the default Wi-Fi AP netif
+    esp_netif_create_default_wifi_ap();
+
+    wifi_config_t ap_config = {
+        .ap = {
+            .ssid = "ESP32_Group2",
+            .ssid_len = strlen("ESP32_Group2"),
+            .channel = 1,
+            .password = "",
+            .max_connection = 4,
+            .authmode = WIFI_AUTH_OPEN
+        },
+    };
+
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &ap_config));
+    ESP_ERROR_CHECK(esp_wifi_start());
+
+    esp_netif_ip_info_t ip_info;
+    esp_netif_t* netif = esp_netif_get_handle_from_ifkey("WIFI_AP_DEF");
+    if (esp_netif_get_ip_info(netif, &ip_info) == ESP_OK) {
+        ESP_LOGW(TAG, "SoftAP IP: " IPSTR, IP2STR(&ip_info.ip));
+    } else {
+        ESP_LOGW(TAG, "SoftAP IP: unknown");
+    }
+}
+
+void print_chip_info(void)
+{
+    ESP_LOGD("Device","Device Info\n");
+
+
+    /* Print chip information */
+    esp_chip_info_t chip_info;
+    uint32_t flash_size;
+    esp_chip_info(&chip_info);
+    ESP_LOGD("Device","This is %s chip with %d CPU core(s), %s%s%s%s, ",
+           CONFIG_IDF_TARGET,
+           chip_info.cores,
+           (chip_info.features & CHIP_FEATURE_WIFI_BGN) ? "WiFi/" : "",
+           (chip_info.features & CHIP_FEATURE_BT) ? "BT" : "",
+           (chip_info.features & CHIP_FEATURE_BLE) ? "BLE" : "",
+           (chip_info.features & CHIP_FEATURE_IEEE802154) ? ", 802.15.4 (Zigbee/Thread)" : "");
+
+    unsigned major_rev = chip_info.revision / 100;
+    unsigned minor_rev = chip_info.revision % 100;
+    ESP_LOGD("Device","silicon revision v%d.%d, ", major_rev, minor_rev);
+    if(esp_flash_get_size(NULL, &flash_size) != ESP_OK) {
+        ESP_LOGE("Device","Get flash size failed");
+        return;
+    }
+
+    ESP_LOGD("Device","%" PRIu32 "MB %s flash\n", flash_size / (uint32_t)(1024 * 1024),
+           (chip_info.features & CHIP_FEATURE_EMB_FLASH) ? "embedded" : "external");
+
+    ESP_LOGD("Device","Minimum free heap size: %" PRIu32 " bytes\n", esp_get_minimum_free_heap_size());
+
+
+}
+
+// Hold the WiFi reset button (GPIO16) through boot for 5 s to forget the network
+void wifi_reset_check(void) {
+    hw_gpio_input(WIFI_RESET_GPIO, HW_GPIO_PULL_UP);
+    int held_duration = 0;
+    for (int i = 0; i < 50; ++i) {
+        if (hw_gpio_get(WIFI_RESET_GPIO) == 0) {  // pressed (active low)
+            vTaskDelay(pdMS_TO_TICKS(100));
+            held_duration++;
+        } else {
+            break;
+        }
+    }
+    if (held_duration >= 50) {
+        ESP_LOGW("BOOT RESET", "BOOT button held >5s. Clearing WiFi config and restarting...");
+        nvs_flash_erase();  // Clear WiFi credentials and other NVS data
+        vTaskDelay(pdMS_TO_TICKS(500));
+        esp_restart();  // Auto restart
+    }
+}
+
+void end(void)
+{
+    for (int i = 10; i >= 0; i--) {
+        ESP_LOGW("End","Restarting in %d seconds...\n", i);
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
+    }
+    ESP_LOGW("End","Restarting now.\n");
+    fflush(stdout);
+    esp_restart();
+}
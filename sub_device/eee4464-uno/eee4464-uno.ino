@@ -1,10 +1,10 @@
 // this code is for the Arduino board
-// this device only has one sensor, so we can use the MAX30102 sensor to measure heart rate
-// and then send the data to the main device via Bluetooth or Wi-Fi or 433MHz or LoRa
+// this device only has one sensor, the MAX30102. Its raw IR/red samples are
+// streamed to the main device, which computes heart rate and SpO2 (the Uno
+// has no room for the 32-bit algorithm).
 
 #include <Wire.h>
 #include "MAX30105.h"
-#include "heartRate.h"
 
 
 // IR 1838
@@ -36,36 +36,186 @@ const int brightnessPWM[3] = {180, 128, 30};
 
 MAX30105 sensor;
 
-unsigned long previousMillis[] =  {0, 0, 0, 0}; //
+// 25 samples/s (100 Hz averaged by 4), the rate the ESP32's Maxim
+// algorithm expects, sent in packets of SAMPLES_PER_PACKET
+const byte SAMPLES_PER_PACKET = 5;
+byte sampleBatch[1 + SAMPLES_PER_PACKET * 6];
+byte batchCount = 0;
+
+
+// Binary link to the ESP32, format in components/uart_frame/include/uno_link.h:
+// each packet is COBS(type, seq, payload, CRC-8) followed by a 0x00 byte.
+// Both ends start at 9600; the ESP32 answers HELLO with BAUD_SET, we ack at
+// the old rate and switch. Without a packet from the ESP32 for
+// LINK_TIMEOUT_MS we fall back to 9600 and start over.
+const byte PKT_HELLO = 0x01;
+const byte PKT_SAMPLES = 0x04;
+const byte PKT_IR_EVENT = 0x05;
+const byte PKT_BAUD_ACK = 0x06;
+const byte PKT_BAUD_SET = 0x81;
+const byte LINK_VERSION = 1;
+const unsigned long LINK_BAUD_DEFAULT = 9600;
+const unsigned long LINK_BAUD_MAX = 250000;   // exact from 16 MHz
+const unsigned long LINK_TIMEOUT_MS = 5000;
+const unsigned long HELLO_MS = 1000;          // also our keepalive
+
+unsigned long linkBaud = LINK_BAUD_DEFAULT;
+unsigned long lastLinkRx = 0;
+unsigned long lastHello = 0;
+byte txSeq = 0;
+byte rxBuf[16];                               // ESP32 packets are short
+byte rxLen = 0;
+bool rxOverflow = false;
+
+// CRC-8, polynomial 0x07, as checked by uno_link on the ESP32
+uint8_t crc8(const byte *data, int len)
+{
+  uint8_t crc = 0;
+  while (len--) {
+    crc ^= *data++;
+    for (byte i = 0; i < 8; i++) crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+  }
+  return crc;
+}
 
-const byte SAMPLE_COUNT = 4;
-byte bpmHistory[SAMPLE_COUNT];
-byte historyIndex = 0;
+void sendPacket(byte type, const byte *payload, byte len)
+{
+  byte raw[2 + sizeof(sampleBatch) + 1];
+  byte n = 2 + len;
+  raw[0] = type;
+  raw[1] = txSeq++;
+  memcpy(raw + 2, payload, len);
+  raw[n] = crc8(raw, n);
+  n++;
+  // COBS: every run of non-zero bytes goes out behind its length + 1,
+  // runs are shorter than 254 bytes here
+  byte start = 0;
+  for (byte i = 0; i <= n; i++) {
+    if (i == n || raw[i] == 0) {
+      Serial.write(i - start + 1);
+      Serial.write(raw + start, i - start);
+      start = i + 1;
+    }
+  }
+  Serial.write((byte)0);
+}
 
-long lastBeatTime = 0;
-float currentBPM = 0;
-int averageBPM = 0;
+void put32(byte *p, unsigned long v)
+{
+  for (byte i = 0; i < 4; i++) p[i] = v >> (8 * i);
+}
 
+void sendHello()
+{
+  byte payload[5];
+  payload[0] = LINK_VERSION;
+  put32(payload + 1, LINK_BAUD_MAX);
+  sendPacket(PKT_HELLO, payload, sizeof(payload));
+}
 
-void sendDataToESP32(int hr)
+void setBaud(unsigned long baud)
 {
-  Serial.print("{\"hr\":");
-  Serial.print(hr);
+  Serial.flush();   // the ack still goes out at the old rate
+  Serial.end();
+  Serial.begin(baud);
+  linkBaud = baud;
+  lastLinkRx = millis();
+  rxLen = 0;
+}
 
-  Serial.println("}");
+void handleFrame(byte *buf, byte len)
+{
+  // COBS decode in place; the output never overtakes the input
+  byte out = 0, i = 0;
+  while (i < len) {
+    byte code = buf[i++];
+    if (i + code - 1 > len) return;
+    for (byte k = 1; k < code; k++) buf[out++] = buf[i++];
+    if (code != 0xFF && i < len) buf[out++] = 0;
+  }
+  if (out < 3 || crc8(buf, out - 1) != buf[out - 1]) return;
+  lastLinkRx = millis();   // PING needs nothing else
+
+  if (buf[0] == PKT_BAUD_SET && out == 7) {
+    unsigned long baud = 0;
+    for (byte k = 0; k < 4; k++) baud |= (unsigned long)buf[2 + k] << (8 * k);
+    if (baud >= LINK_BAUD_DEFAULT && baud <= LINK_BAUD_MAX) {
+      sendPacket(PKT_BAUD_ACK, buf + 2, 4);
+      setBaud(baud);
+    }
+  }
+}
+
+void serviceLink()
+{
+  while (Serial.available()) {
+    byte c = Serial.read();
+    if (c != 0) {
+      if (rxLen < sizeof(rxBuf)) rxBuf[rxLen++] = c;
+      else rxOverflow = true;
+      continue;
+    }
+    if (rxLen > 0 && !rxOverflow) handleFrame(rxBuf, rxLen);
+    rxLen = 0;
+    rxOverflow = false;
+  }
+
+  unsigned long now = millis();
+  if (linkBaud != LINK_BAUD_DEFAULT && now - lastLinkRx > LINK_TIMEOUT_MS) {
+    setBaud(LINK_BAUD_DEFAULT);
+  }
+  if (now - lastHello >= HELLO_MS) {
+    lastHello = now;
+    sendHello();
+  }
+}
+
+void put24(byte *p, uint32_t v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+}
+
+// Drain the sensor FIFO into the batch; never waits for a sample
+void readSamples()
+{
+  sensor.check();
+  while (sensor.available()) {
+    byte *s = sampleBatch + 1 + batchCount * 6;
+    put24(s, sensor.getFIFOIR());
+    put24(s + 3, sensor.getFIFORed());
+    sensor.nextSample();
+    if (++batchCount == SAMPLES_PER_PACKET) {
+      sampleBatch[0] = batchCount;
+      sendPacket(PKT_SAMPLES, sampleBatch, sizeof(sampleBatch));
+      batchCount = 0;
+    }
+  }
+}
+
+// Remote command and the light state it left behind
+void sendIrEvent(uint8_t cmd)
+{
+  byte payload[4];
+  payload[0] = cmd;
+  payload[1] = (fogOn ? 0x01 : 0) | (clearOn ? 0x02 : 0) | (auxMode ? 0x04 : 0);
+  payload[2] = brightnessLevel;
+  payload[3] = colorTempStep;
+  sendPacket(PKT_IR_EVENT, payload, sizeof(payload));
 }
 
 void setup() {
-  Serial.begin(9600);
-  Serial.println("Initializing MAX30102...");
+  Serial.begin(LINK_BAUD_DEFAULT);   // binary packets only from here on, see serviceLink()
 
   if (!sensor.begin(Wire, I2C_SPEED_FAST)) {
-    Serial.println("Sensor not found. Check wiring.");
+    // No text on the link: the ESP32 logs "No packets from the Uno"
     while (1);
   }
 
-  sensor.setup();
-  sensor.setPulseAmplitudeRed(0x2F);   // Stronger LED for clearer signal
+  // LED 0x3C, average 4, red + IR, 100 Hz, 411 us, 4096 nA: 25 samples/s.
+  // Both LEDs at the same current, as the SpO2 table assumes.
+  sensor.setup(0x3C, 4, 2, 100, 411, 4096);
 
   // --- IR & Lighting Setup ---
   IrReceiver.begin(RECV_PIN, ENABLE_LED_FEEDBACK);
@@ -81,54 +231,11 @@ void setup() {
 }
 
 void loop() {
-
-
-  heartbeat(); // cannot add delay for this function
-
-
-}
-
-void heartbeat() {
-  long ir = sensor.getIR();
-
-  if (checkForBeat(ir)) {
-    long currentTime = millis();
-    long interval = currentTime - lastBeatTime;
-    lastBeatTime = currentTime;
-
-    float bpm = 60.0 / (interval / 1000.0);
-    if (bpm >= 40 && bpm <= 180) {
-      bpmHistory[historyIndex] = (byte)bpm;
-      historyIndex = (historyIndex + 1) % SAMPLE_COUNT;
-
-      int total = 0;
-      for (byte i = 0; i < SAMPLE_COUNT; i++) {
-        total += bpmHistory[i];
-      }
-      averageBPM = total / SAMPLE_COUNT;
-      currentBPM = bpm;
-      sendDataToESP32(averageBPM);
-    }
-  }
-
-  unsigned long currentMillis = millis();
-
-  if (currentMillis - previousMillis[1] >= 500) {
-    previousMillis[1] = currentMillis;
-
-//    Serial.print("IR=");
-//    Serial.print(ir);
-//    Serial.print(" | BPM=");
-//    Serial.print(currentBPM);
-//    Serial.print(" | Avg BPM=");
-//    Serial.print(averageBPM);
-//    if (ir < 50000) Serial.print(" (No finger detected)");
-//    Serial.println();
-  }
+  readSamples();
   handleIRandLighting(); // Handle IR remote and lighting control
-
-  heartbeat(); // Do not add delay for this function
+  serviceLink();
 }
+
 void handleIRandLighting() {
   if (IrReceiver.decode()) {
     if (IrReceiver.decodedIRData.protocol == NEC) {
@@ -188,6 +295,7 @@ void handleIRandLighting() {
           break;
       }
       updateLights();
+      sendIrEvent(cmd);
     }
     IrReceiver.resume();
   }
@@ -0,0 +1,85 @@
+#include "ppg_traces.h"
+#include <math.h>
+#include <string.h>
+#include "spo2_algorithm.h"
+
+#define PI 3.14159265358979
+
+const ppg_trace_t ppg_traces[] = {
+    { "rest 62 bpm",      62,  0.55f, 110000, 90000, 0.020f, 20, 0.004f, 0 },
+    { "walk 95 bpm",      95,  0.63f, 105000, 88000, 0.015f, 40, 0.008f, 0 },
+    { "exercise 130 bpm", 130, 0.73f, 100000, 85000, 0.012f, 60, 0.010f, 0 },
+    { "motion 75 bpm",    75,  0.55f, 108000, 90000, 0.018f, 40, 0.006f, 0.03f },
+    { "no finger",        0,   0,     1500,   1200,  0,      30, 0,      0 },
+};
+const size_t ppg_trace_count = sizeof(ppg_traces) / sizeof(ppg_traces[0]);
+
+uint32_t ppg_ir_trace[PPG_TRACE_LEN], ppg_red_trace[PPG_TRACE_LEN];
+static uint32_t seed = 7;
+
+static float noise(void)
+{
+    float s = 0;
+    for (int i = 0; i < 4; i++) {
+        seed = seed * 1103515245u + 12345u;
+        s += ((seed >> 8) & 0xFFFF) / 65535.0f - 0.5f;
+    }
+    return s;   // about unit variance / 3
+}
+
+static float pulse(float phase)
+{
+    float a = (phase - 0.18f) / 0.08f, b = (phase - 0.38f) / 0.12f;
+    return expf(-a * a) + 0.2f * expf(-b * b);
+}
+
+void ppg_make_trace(const ppg_trace_t *t)
+{
+    float phase = 0;
+    for (int i = 0; i < PPG_TRACE_LEN; i++) {
+        float s = (float)i / PPG_RATE_HZ;
+        phase += t->bpm / 60 / PPG_RATE_HZ * (1 + 0.03f * sinf(2 * PI * 0.1f * s));     // some HRV
+        float p = pulse(phase - floorf(phase));
+        float base = 1 + t->wander * sinf(2 * PI * 0.25f * s);
+        if (t->motion > 0 && fmodf(s, 10) < 1) base += t->motion * sinf(2 * PI * 1.3f * s);
+        ppg_ir_trace[i] = (uint32_t)(t->ir_dc * base * (1 - t->perfusion * p) + t->noise * 3 * noise());
+        ppg_red_trace[i] = (uint32_t)(t->red_dc * base * (1 - t->perfusion * t->ratio * p) + t->noise * 3 * noise());
+    }
+}
+
+void ppg_reference(const uint32_t *ir, const uint32_t *red, ppg_result_t *r)
+{
+    static uint32_t ir_buf[BUFFER_SIZE], red_buf[BUFFER_SIZE];
+    memcpy(ir_buf, ir, sizeof(ir_buf));
+    memcpy(red_buf, red, sizeof(red_buf));
+    int32_t spo2, hr;
+    int8_t spo2_valid, hr_valid;
+    maxim_heart_rate_and_oxygen_saturation(ir_buf, BUFFER_SIZE, red_buf, &spo2, &spo2_valid, &hr, &hr_valid);
+    r->spo2 = spo2;
+    r->spo2_valid = spo2_valid;
+    r->heart_rate = hr;
+    r->hr_valid = hr_valid;
+}
+
+int ppg_shift_recompute(int rounds, volatile int32_t *sink)
+{
+    static uint32_t ir_buf[BUFFER_SIZE], red_buf[BUFFER_SIZE];
+    int results = 0;
+    for (int r = 0; r < rounds; r++) {
+        int fill = 0;
+        for (int i = 0; i < PPG_TRACE_LEN; i++) {
+            ir_buf[fill] = ppg_ir_trace[i];
+            red_buf[fill] = ppg_red_trace[i];
+            if (++fill < BUFFER_SIZE) continue;
+            int32_t spo2, hr;
+            int8_t spo2_valid, hr_valid;
+            maxim_heart_rate_and_oxygen_saturation(ir_buf, BUFFER_SIZE, red_buf, &spo2, &spo2_valid, &hr, &hr_valid);
+            *sink += spo2 + hr;
+            results++;
+            memmove(ir_buf, ir_buf + PPG_RATE_HZ, (BUFFER_SIZE - PPG_RATE_HZ) * sizeof(uint32_t));
+            memmove(red_buf, red_buf + PPG_RATE_HZ, (BUFFER_SIZE - PPG_RATE_HZ) * sizeof(uint32_t));
+            fill = BUFFER_SIZE - PPG_RATE_HZ;
+        }
+    }
+    return results;
+}
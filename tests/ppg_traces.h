@@ -0,0 +1,42 @@
+#ifndef PPG_TRACES_H
+#define PPG_TRACES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ppg_window.h"
+
+// Synthetic PPG traces for tests/test_ppg.c and host/ppg_check.c
+#define PPG_TRACE_LEN (PPG_RATE_HZ * 120)
+
+// PPG traces in the shape the Uno streams them: 25 Hz IR/red as the
+// MAX30102 reports them (18 bit) with a finger on the sensor. The pulse
+// has a systolic peak and a dicrotic shoulder; the red AC/DC over the IR AC/DC
+// is ratio, which sets the SpO2 the Maxim table should report.
+typedef struct {
+    const char *name;
+    float bpm;
+    float ratio;
+    float ir_dc, red_dc;
+    float perfusion;            // IR AC as a fraction of DC
+    float noise;                // counts
+    float wander;               // breathing baseline, fraction of DC
+    float motion;               // artifact bursts, fraction of DC
+} ppg_trace_t;
+
+extern const ppg_trace_t ppg_traces[];
+extern const size_t ppg_trace_count;
+
+// The samples of the last trace made
+extern uint32_t ppg_ir_trace[PPG_TRACE_LEN], ppg_red_trace[PPG_TRACE_LEN];
+
+void ppg_make_trace(const ppg_trace_t *t);
+
+// The Maxim algorithm on the PPG_WINDOW samples starting at ir/red
+void ppg_reference(const uint32_t *ir, const uint32_t *red, ppg_result_t *r);
+
+// What the Arduino examples do, rounds times over the last trace: keep 100
+// samples, shift out the oldest 25 and recompute everything once per second.
+// Returns the number of results; their values are added to sink.
+int ppg_shift_recompute(int rounds, volatile int32_t *sink);
+
+#endif
@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+# Local stand-in for the eee4464 Cloudflare worker, used by the [bench] tests.
+#
+#   openssl req -x509 -newkey rsa:2048 -nodes -days 365 -subj "/CN=standin" \
+#       -keyout standin_key.pem -out standin_cert.pem
+#   python3 cloudflare_standin.py --cert standin_cert.pem --key standin_key.pem
+#
+# Point the device at it with cloudflare_api_configure() (base_url
+# "https://<host-ip>:8443", cert_pem = contents of standin_cert.pem).
+# Without --cert the server speaks plain HTTP.
+#
+# GET /__stats returns the connection/request counters, GET /__reset clears them.
+# POST /__controls replaces the list served by GET /api/controls, which
+# carries an ETag and Last-Modified and answers conditional requests with 304.
+#
+# Importable: make_server(port, on_request=fn) calls fn(method, path, body,
+# arrival_time) for every /api request before answering it.
+import argparse
+import email.utils
+import json
+import random
+import ssl
+import threading
+import time
+import zlib
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import urlparse
+
+lock = threading.Lock()
+stats = {"connections": 0, "requests": 0}
+controls = {"body": b"[]", "etag": '"0"', "modified": email.utils.formatdate(usegmt=True)}
+
+
+def set_controls(body):
+    with lock:
+        controls["body"] = body
+        controls["etag"] = '"%08x"' % zlib.crc32(body)
+        controls["modified"] = email.utils.formatdate(usegmt=True)
+
+
+def bump(key, n=1):
+    with lock:
+        stats[key] = stats.get(key, 0) + n
+
+
+class WorkerHandler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"  # keep-alive unless the client asks to close
+
+    def setup(self):
+        super().setup()
+        bump("connections")  # one per TCP (and TLS) handshake
+
+    def log_message(self, fmt, *args):
+        if self.server.verbose:
+            super().log_message(fmt, *args)
+
+    def send_json(self, code, obj):
+        body = json.dumps(obj).encode()
+        self.send_response(code)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def send_controls(self):
+        with lock:
+            body, etag, modified = controls["body"], controls["etag"], controls["modified"]
+        inm = self.headers.get("If-None-Match")
+        ims = self.headers.get("If-Modified-Since")
+        if (inm is not None and etag in [t.strip() for t in inm.split(",")]) or (inm is None and ims == modified):
+            bump("not_modified")
+            self.send_response(304)
+            self.send_header("ETag", etag)
+            self.end_headers()
+            return
+        bump("bytes_out", len(body))
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        self.send_header("ETag", etag)
+        self.send_header("Last-Modified", modified)
+        self.end_headers()
+        self.wfile.write(body)
+
+    def read_body(self):
+        length = int(self.headers.get("Content-Length", 0))
+        return self.rfile.read(length) if length else b""
+
+    def handle_api(self):
+        path = urlparse(self.path).path
+        if path == "/__stats":
+            with lock:
+                self.send_json(200, dict(stats))
+            return
+        if path == "/__reset":
+            with lock:
+                for key in stats:
+                    stats[key] = 0
+            self.send_json(200, {"success": True})
+            return
+        if path == "/__controls":
+            set_controls(self.read_body())
+            self.send_json(200, {"success": True})
+            return
+
+        bump("requests")
+        arrival = time.time()
+        delay_ms = self.server.delay_ms
+        if self.server.jitter_ms:
+            delay_ms += random.uniform(0, self.server.jitter_ms)
+        with lock:
+            n = stats["requests"]
+        if self.server.slow_every and n % self.server.slow_every == 0:
+            delay_ms += self.server.slow_ms  # injected tail latency
+        if delay_ms:
+            time.sleep(delay_ms / 1000.0)
+        body = self.read_body()
+        if self.server.on_request:
+            self.server.on_request(self.command, path, body, arrival)
+        if self.command == "GET" and path == "/api/controls":
+            self.send_controls()
+        elif self.command == "GET":
+            self.send_json(200, [])
+        else:
+            bump("bytes_in", len(body))
+            try:
+                payload = json.loads(body or b"null")
+            except ValueError:
+                self.send_json(400, {"error": "invalid JSON"})
+                return
+            # /api/sensor_data accepts a single reading or a batched array
+            bump("readings", len(payload) if isinstance(payload, list) else 1)
+            self.send_json(200, {"success": True})
+
+    do_GET = handle_api
+    do_POST = handle_api
+    do_PUT = handle_api
+
+
+def make_server(port, delay_ms=0, jitter_ms=0, slow_every=0, slow_ms=2000, verbose=False, on_request=None):
+    server = ThreadingHTTPServer(("0.0.0.0", port), WorkerHandler)
+    server.daemon_threads = True
+    server.delay_ms = delay_ms
+    server.jitter_ms = jitter_ms
+    server.slow_every = slow_every
+    server.slow_ms = slow_ms
+    server.verbose = verbose
+    server.on_request = on_request
+    return server
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--port", type=int, default=8443)
+    parser.add_argument("--cert")
+    parser.add_argument("--key")
+    parser.add_argument("--delay-ms", type=int, default=0, help="fixed delay added to every API request")
+    parser.add_argument("--jitter-ms", type=int, default=0, help="extra random delay, uniform in [0, jitter]")
+    parser.add_argument("--slow-every", type=int, default=0, help="make every Nth API request slow")
+    parser.add_argument("--slow-ms", type=int, default=2000, help="extra delay of a slow request")
+    parser.add_argument("--verbose", action="store_true")
+    args = parser.parse_args()
+
+    server = make_server(args.port, args.delay_ms, args.jitter_ms, args.slow_every, args.slow_ms, args.verbose)
+    scheme = "http"
+    if args.cert:
+        ctx = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        ctx.load_cert_chain(args.cert, args.key)
+        server.socket = ctx.wrap_socket(server.socket, server_side=True)
+        scheme = "https"
+    print(f"stand-in worker listening on {scheme}://0.0.0.0:{args.port}")
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
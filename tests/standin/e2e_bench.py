@@ -0,0 +1,241 @@
+#!/usr/bin/env python3
+# End-to-end throughput and latency of the host build against local stand-ins.
+#
+#   cmake -S host -B _host_build && cmake --build _host_build
+#   python3 tests/standin/e2e_bench.py --rates 5,10,20,50,100,200,500 --out e2e_results.json
+#
+# Starts cloudflare_standin.py and mqtt_broker.py in this process on free
+# ports, then runs eee4464_host against them with a script that raises the
+# synthetic "load" input (CONFIG_LOAD_TEST in main.c) one step at a time and
+# presses the test button once per step. Every load reading leaves the device
+# twice, on iot/<device_id>/load and in a /api/sensor_data batch, carrying its
+# sequence number, creation time and the HTTP queue depth at that moment.
+#
+# Once a second the device also publishes iot/<device_id>/load_stats: the
+# next sequence number and what it dropped itself (MQTT publishes that
+# failed, HTTP requests refused or dropped from the queue). A step covers
+# the sequence numbers made between two of those reports, so loss is
+# counted against what the device says it made.
+#
+# Per step and channel it reports msgs/s received, p50/p99 latency from
+# creation to arrival, queue depth, readings lost and how many of those the
+# device dropped before sending, plus the latency from each button press to
+# the PUT /api/controls it causes.
+# Device and stand-ins share the host clock, so latencies need no sync.
+import argparse
+import json
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+from pathlib import Path
+
+sys.path.insert(0, str(Path(__file__).resolve().parent))
+import cloudflare_standin  # noqa: E402
+import mqtt_broker  # noqa: E402
+
+REPO = Path(__file__).resolve().parents[2]
+LOSS_LIMIT = 0.01  # a step counts as sustained below 1% loss
+
+lock = threading.Lock()
+received = {"mqtt": [], "http": []}  # (seq, t_us, arrival, depth)
+load_stats = []  # the device's load_stats reports, in arrival order
+controls = []  # arrival of each PUT /api/controls
+
+
+def on_publish(client_id, topic, payload, arrival):
+    if topic.endswith("/load_stats"):
+        with lock:
+            load_stats.append(json.loads(payload))
+        return
+    if not topic.endswith("/load"):
+        return
+    r = json.loads(payload)
+    with lock:
+        received["mqtt"].append((r["seq"], r["t_us"], arrival, r["q"]))
+
+
+def on_request(method, path, body, arrival):
+    if method == "PUT" and path == "/api/controls":
+        with lock:
+            controls.append(arrival)
+        return
+    if method != "POST" or path != "/api/sensor_data":
+        return
+    try:
+        payload = json.loads(body)
+    except ValueError:
+        return
+    with lock:
+        for reading in payload if isinstance(payload, list) else [payload]:
+            if reading.get("sensor_id") == 0:  # the load driver's readings
+                r = reading["data"]
+                received["http"].append((r["seq"], r["t_us"], arrival, r["q"]))
+
+
+def percentile(values, p):
+    if not values:
+        return None
+    values = sorted(values)
+    return values[min(len(values) - 1, int(p / 100 * len(values)))]
+
+
+def write_script(path, rates, warmup_s, step_s):
+    lines = ["# generated by e2e_bench.py"]
+    for i, rate in enumerate(rates):
+        start = warmup_s + i * step_s
+        lines.append(f"{start} load {rate}")
+        lines.append(f"{start + step_s / 2:.1f} button 1")
+        lines.append(f"{start + step_s / 2 + 0.2:.1f} button 0")
+    lines.append(f"{warmup_s + len(rates) * step_s} load 0")
+    Path(path).write_text("\n".join(lines) + "\n")
+    return [warmup_s + i * step_s + step_s / 2 for i in range(len(rates))]
+
+
+def device_drops(a, b):
+    """Readings the device dropped itself between two load_stats reports, per channel."""
+    def delta(key):
+        return b[key] - a[key]
+    queue = delta("http_refused") + \
+        (b["http_dropped"]["telemetry"] - a["http_dropped"]["telemetry"]) - delta("telemetry_rejected")
+    return {"mqtt": delta("mqtt_failed"), "http": queue}
+
+
+def step_reports(t0, t1):
+    """The load_stats reports bracketing [t0, t1): the last one at or before each end."""
+    def last_before(t):
+        before = [s for s in load_stats if s["t_us"] / 1e6 <= t]
+        return max(before, key=lambda s: s["t_us"]) if before else None
+    a, b = last_before(t0), last_before(t1)
+    return (a, b) if a and b and b["seq"] >= a["seq"] else (None, None)
+
+
+def summarize_step(rate, t0, t1, made, rows, dropped):
+    latencies = [(arrival - t_us / 1e6) * 1000 for _, t_us, arrival, _ in rows]
+    depths = [q for *_, q in rows]
+    lost = max(0, made - len({seq for seq, *_ in rows}))
+    return {
+        "received": len(rows),
+        "msgs_per_s": round(len(rows) / (t1 - t0), 1),
+        "p50_ms": round(percentile(latencies, 50), 1) if rows else None,
+        "p99_ms": round(percentile(latencies, 99), 1) if rows else None,
+        "max_ms": round(max(latencies), 1) if rows else None,
+        "queue_depth_mean": round(statistics.mean(depths), 1) if rows else None,
+        "queue_depth_max": max(depths) if rows else None,
+        "lost": lost,
+        "dropped_on_device": dropped,
+        "loss": round(lost / made, 4) if made else 0.0,
+    }
+
+
+def analyze(rates, boot, warmup_s, step_s, presses):
+    steps = []
+    for i, rate in enumerate(rates):
+        t0 = boot + warmup_s + i * step_s
+        t1 = t0 + step_s
+        a, b = step_reports(t0, t1)
+        if a:
+            # what the device says it made between the reports around the step
+            made = b["seq"] - a["seq"]
+            in_step = {ch: [r for r in rows if a["seq"] <= r[0] < b["seq"]] for ch, rows in received.items()}
+            dropped = device_drops(a, b)
+        else:
+            # no reports (MQTT down): the span of sequence numbers seen on either channel
+            in_step = {ch: [r for r in rows if t0 <= r[1] / 1e6 < t1] for ch, rows in received.items()}
+            seqs = [r[0] for rows in in_step.values() for r in rows]
+            made = max(seqs) - min(seqs) + 1 if seqs else 0
+            dropped = {ch: None for ch in received}
+        steps.append({
+            "offered_per_s": rate,
+            "made": made,
+            "made_from": "device" if a else "sequence span",
+            **{ch: summarize_step(rate, t0, t1, made, rows, dropped[ch]) for ch, rows in in_step.items()},
+        })
+
+    button = []
+    for t in presses:
+        press = boot + t
+        after = [a for a in controls if a >= press]
+        button.append(round((min(after) - press) * 1000, 1) if after else None)
+
+    sustained = {}
+    for ch in received:
+        ok = [s[ch]["msgs_per_s"] for s in steps if s["made"] and s[ch]["loss"] < LOSS_LIMIT]
+        sustained[ch] = max(ok) if ok else 0.0
+    return steps, button, sustained
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host-bin", default=str(REPO / "_host_build" / "eee4464_host"))
+    parser.add_argument("--rates", default="5,10,20,50,100,200,500", help="readings per second, one step each")
+    parser.add_argument("--step-s", type=float, default=10)
+    parser.add_argument("--warmup-s", type=float, default=15, help="registration and MQTT connect")
+    parser.add_argument("--delay-ms", type=int, default=0, help="stand-in delay per API request")
+    parser.add_argument("--jitter-ms", type=int, default=0, help="stand-in random extra delay")
+    parser.add_argument("--out", default="e2e_results.json")
+    parser.add_argument("--log", help="keep the device log here")
+    args = parser.parse_args()
+    rates = [float(r) for r in args.rates.split(",")]
+
+    http = cloudflare_standin.make_server(0, args.delay_ms, args.jitter_ms, on_request=on_request)
+    threading.Thread(target=http.serve_forever, daemon=True).start()
+    broker = mqtt_broker.Broker(0, on_publish=on_publish).start()
+    http_origin = f"http://127.0.0.1:{http.server_address[1]}"
+    mqtt_uri = f"mqtt://127.0.0.1:{broker.port}"
+
+    with tempfile.TemporaryDirectory() as state:
+        script = os.path.join(state, "load.txt")
+        presses = write_script(script, rates, args.warmup_s, args.step_s)
+        seconds = int(args.warmup_s + len(rates) * args.step_s + 5)  # 5 s to drain
+        print(f"{len(rates)} steps of {args.step_s:g} s against {http_origin} and {mqtt_uri}, {seconds} s")
+        run = subprocess.run(
+            [args.host_bin, "--http", http_origin, "--mqtt", mqtt_uri, "--state", state, "--script", script,
+             str(seconds)],
+            stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True, errors="replace")
+    log = run.stdout
+    if args.log:
+        Path(args.log).write_text(log)
+    if run.returncode != 0:
+        print(log[-2000:])
+        sys.exit(f"host exited with {run.returncode}")
+    boot = next((float(line.rsplit(" ", 1)[1]) for line in log.splitlines() if "Boot at unix time" in line), None)
+    if boot is None:
+        sys.exit("no \"Boot at unix time\" in the host log")
+
+    with lock:
+        steps, button, sustained = analyze(rates, boot, args.warmup_s, args.step_s, presses)
+    results = {
+        "config": {"rates": rates, "step_s": args.step_s, "warmup_s": args.warmup_s,
+                   "delay_ms": args.delay_ms, "jitter_ms": args.jitter_ms},
+        "steps": steps,
+        "sustained_msgs_per_s": sustained,
+        "button_to_control_ms": button,
+        "http_queue_full_logs": sum("HTTP_QUEUE" in line and "Queue full" in line for line in log.splitlines()),
+        "broker": broker.stats,
+    }
+    Path(args.out).write_text(json.dumps(results, indent=2) + "\n")
+
+    print(f"{'rate/s':>7} {'made':>6} | {'mqtt/s':>7} {'p50':>7} {'p99':>7} {'lost':>5} {'dev':>5} | "
+          f"{'http/s':>7} {'p50':>7} {'p99':>7} {'lost':>5} {'dev':>5} | {'q mean':>6} {'q max':>5}")
+    for s in steps:
+        m, h = s["mqtt"], s["http"]
+        fmt = lambda v: "-" if v is None else f"{v:g}"  # noqa: E731
+        print(f"{s['offered_per_s']:>7g} {s['made']:>6} | {m['msgs_per_s']:>7g} {fmt(m['p50_ms']):>7} "
+              f"{fmt(m['p99_ms']):>7} {m['lost']:>5} {fmt(m['dropped_on_device']):>5} | "
+              f"{h['msgs_per_s']:>7g} {fmt(h['p50_ms']):>7} {fmt(h['p99_ms']):>7} {h['lost']:>5} "
+              f"{fmt(h['dropped_on_device']):>5} | {fmt(h['queue_depth_mean'] or m['queue_depth_mean']):>6} "
+              f"{fmt(h['queue_depth_max'] or m['queue_depth_max']):>5}")
+    print("lost: made by the device but never received; dev: of those, dropped by the device itself")
+    print(f"sustained below {LOSS_LIMIT:.0%} loss: mqtt {sustained['mqtt']:g}/s, http {sustained['http']:g}/s")
+    print(f"button -> PUT /api/controls (ms): {button}")
+    print(f"results in {args.out}")
+    if not received["mqtt"] or not received["http"]:
+        sys.exit("no load readings arrived on one of the channels")
+
+
+if __name__ == "__main__":
+    main()
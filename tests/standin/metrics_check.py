@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+# Checks that a full metrics sample of the host build exports every family.
+#
+#   cmake -S host -B _host_build && cmake --build _host_build
+#   python3 tests/standin/metrics_check.py
+#
+# Runs eee4464_host against cloudflare_standin.py and mqtt_broker.py and
+# takes the last JSON snapshot it publishes on iot/<device_id>/metrics. The
+# host build publishes every METRICS_PUBLISH_MS (10 s there), so a run of
+# 25 s gives a snapshot from a sample that had a previous one to compare
+# against, with task CPU shares in it. Every family main.c registers must be
+# there, the per-task and per-driver families for every task and driver,
+# and the device must not have logged a refused registration.
+import argparse
+import json
+import re
+import subprocess
+import sys
+import tempfile
+import threading
+from pathlib import Path
+
+sys.path.insert(0, str(Path(__file__).resolve().parent))
+import cloudflare_standin  # noqa: E402
+import mqtt_broker  # noqa: E402
+
+REPO = Path(__file__).resolve().parents[2]
+
+FIXED = [
+    "http_requests_total", "http_batch_upload_ms", "http_readings_uploaded_total", "mqtt_published_total",
+    "mqtt_refused_total", "mqtt_acked_total", "mqtt_expired_total", "mqtt_disconnects_total",
+    "telemetry_spooled_total", "http_arena_used_bytes", "heap_free_bytes", "heap_min_free_bytes",
+    "heap_largest_free_block_bytes", "heap_fragmentation_percent", "uart_packets_total",
+    "uart_packets_lost_total", "uart_bad_frames_total", "uart_overruns_total", "uart_baud", "mqtt_connected",
+]
+QUEUE = ["http_queue_depth", "http_queue_sent_total", "http_queue_dropped_total"]
+QUEUE_CLASSES = {"control", "message", "telemetry"}
+TASK = ["task_stack_free_bytes", "task_cpu_percent"]
+SENSOR = ["sensor_runs_total", "sensor_errors_total", "sensor_exec_max_us", "sensor_late_max_us"]
+
+lock = threading.Lock()
+snapshots = []
+
+
+def on_publish(client_id, topic, payload, arrival):
+    if topic.endswith("/metrics"):
+        with lock:
+            snapshots.append(json.loads(payload))
+
+
+def sensor_drivers():
+    """Driver names in main.c's sensor_drivers[] table, as the host build has them."""
+    src = (REPO / "main" / "main.c").read_text()
+    table = src[src.index("sensor_drivers[] = {"):]
+    table = table[:table.index("\n};")]
+    return set(re.findall(r'\.name = "([^"]+)"', table))
+
+
+def check(snapshot, drivers):
+    problems = []
+    for name in FIXED + QUEUE + TASK + SENSOR:
+        if name not in snapshot:
+            problems.append(f"{name} missing")
+    for name in QUEUE:
+        if name in snapshot and set(snapshot[name]) != QUEUE_CLASSES:
+            problems.append(f"{name} has classes {sorted(snapshot[name])}")
+    tasks = set(snapshot.get("task_stack_free_bytes", {}))
+    if tasks and set(snapshot.get("task_cpu_percent", {})) != tasks:
+        problems.append(f"task_cpu_percent lacks {sorted(tasks - set(snapshot.get('task_cpu_percent', {})))}")
+    for name in SENSOR:
+        if name in snapshot and set(snapshot[name]) != drivers:
+            problems.append(f"{name} lacks {sorted(drivers - set(snapshot[name]))}")
+    return problems, len(tasks)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host-bin", default=str(REPO / "_host_build" / "eee4464_host"))
+    parser.add_argument("--seconds", type=int, default=25)
+    args = parser.parse_args()
+
+    http = cloudflare_standin.make_server(0, 0, 0)
+    threading.Thread(target=http.serve_forever, daemon=True).start()
+    broker = mqtt_broker.Broker(0, on_publish=on_publish).start()
+    with tempfile.TemporaryDirectory() as state:
+        run = subprocess.run(
+            [args.host_bin, "--http", f"http://127.0.0.1:{http.server_address[1]}",
+             "--mqtt", f"mqtt://127.0.0.1:{broker.port}", "--state", state, str(args.seconds)],
+            stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True, errors="replace")
+    if run.returncode != 0:
+        print(run.stdout[-2000:])
+        sys.exit(f"host exited with {run.returncode}")
+
+    with lock:
+        if len(snapshots) < 2:
+            sys.exit(f"{len(snapshots)} metrics snapshots published, need 2")
+        snapshot = snapshots[-1]
+    drivers = sensor_drivers()
+    problems, tasks = check(snapshot, drivers)
+    if "series not registered" in run.stdout:
+        problems.append("the device logged refused registrations")
+    series = sum(len(v) if isinstance(v, dict) else 1 for v in snapshot.values())
+    print(f"{series} series, {tasks} tasks, {len(drivers)} sensor drivers")
+    for p in problems:
+        print(p)
+    print("Metrics check FAILED" if problems else "Metrics check passed")
+    sys.exit(1 if problems else 0)
+
+
+if __name__ == "__main__":
+    main()
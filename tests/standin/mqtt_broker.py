@@ -0,0 +1,211 @@
+#!/usr/bin/env python3
+# Minimal MQTT 3.1.1 broker for benches without Mosquitto.
+#
+#   python3 mqtt_broker.py --port 1883 [--verbose]
+#
+# Plain TCP, any username/password. QoS 0 and 1 (QoS 2 is downgraded to 1),
+# retained messages, + and # wildcards, keepalive is not enforced.
+# Importable: Broker(port, on_publish=fn) calls fn(client_id, topic, payload,
+# arrival_time) for every PUBLISH it receives, before routing it.
+import argparse
+import socket
+import struct
+import threading
+import time
+
+
+def topic_matches(pattern, topic):
+    p, t = pattern.split("/"), topic.split("/")
+    for i, level in enumerate(p):
+        if level == "#":
+            return True
+        if i >= len(t) or (level != "+" and level != t[i]):
+            return False
+    return len(p) == len(t)
+
+
+def encode_length(n):
+    out = bytearray()
+    while True:
+        b = n % 128
+        n //= 128
+        out.append(b | 0x80 if n else b)
+        if not n:
+            return bytes(out)
+
+
+def read_exact(sock, n):
+    buf = bytearray()
+    while len(buf) < n:
+        chunk = sock.recv(n - len(buf))
+        if not chunk:
+            raise ConnectionError("closed")
+        buf += chunk
+    return bytes(buf)
+
+
+def read_packet(sock):
+    header = read_exact(sock, 1)[0]
+    length, shift = 0, 0
+    while True:
+        b = read_exact(sock, 1)[0]
+        length |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            break
+    return header, read_exact(sock, length) if length else b""
+
+
+def utf8(s):
+    b = s.encode()
+    return struct.pack(">H", len(b)) + b
+
+
+class Session:
+    def __init__(self, broker, sock):
+        self.broker = broker
+        self.sock = sock
+        self.client_id = "?"
+        self.subs = {}  # pattern -> qos
+        self.lock = threading.Lock()
+        self.next_id = 0
+
+    def send(self, data):
+        with self.lock:
+            self.sock.sendall(data)
+
+    def deliver(self, topic, payload, qos, retain=False):
+        body = utf8(topic)
+        if qos:
+            self.next_id = self.next_id % 65535 + 1
+            body += struct.pack(">H", self.next_id)
+        body += payload
+        header = 0x30 | (qos << 1) | (1 if retain else 0)
+        self.send(bytes([header]) + encode_length(len(body)) + body)
+
+    def run(self):
+        try:
+            while True:
+                header, body = read_packet(self.sock)
+                kind = header >> 4
+                if kind == 1:  # CONNECT
+                    pos = 2 + struct.unpack(">H", body[:2])[0] + 4  # protocol name, level, flags, keepalive
+                    n = struct.unpack(">H", body[pos:pos + 2])[0]
+                    self.client_id = body[pos + 2:pos + 2 + n].decode(errors="replace")
+                    self.send(b"\x20\x02\x00\x00")
+                    self.broker.log(f"connect {self.client_id}")
+                elif kind == 3:  # PUBLISH
+                    qos = (header >> 1) & 3
+                    n = struct.unpack(">H", body[:2])[0]
+                    topic = body[2:2 + n].decode(errors="replace")
+                    pos = 2 + n
+                    if qos:
+                        msg_id = body[pos:pos + 2]
+                        pos += 2
+                        self.send(b"\x40\x02" + msg_id)
+                    self.broker.publish(self, topic, body[pos:], qos, bool(header & 1))
+                elif kind == 8:  # SUBSCRIBE
+                    msg_id, pos, granted = body[:2], 2, bytearray()
+                    while pos < len(body):
+                        n = struct.unpack(">H", body[pos:pos + 2])[0]
+                        pattern = body[pos + 2:pos + 2 + n].decode(errors="replace")
+                        qos = min(body[pos + 2 + n], 1)
+                        pos += 3 + n
+                        self.subs[pattern] = qos
+                        granted.append(qos)
+                        self.broker.log(f"{self.client_id} subscribed to {pattern}")
+                    self.send(bytes([0x90]) + encode_length(2 + len(granted)) + msg_id + bytes(granted))
+                    self.broker.send_retained(self, list(self.subs.items())[-len(granted):])
+                elif kind == 10:  # UNSUBSCRIBE
+                    self.send(b"\xb0\x02" + body[:2])
+                elif kind == 12:  # PINGREQ
+                    self.send(b"\xd0\x00")
+                elif kind == 14:  # DISCONNECT
+                    break
+                # PUBACK from subscribers needs nothing
+        except (ConnectionError, OSError, struct.error, IndexError):
+            pass
+        finally:
+            self.broker.drop(self)
+            self.sock.close()
+
+
+class Broker:
+    def __init__(self, port=1883, host="0.0.0.0", on_publish=None, verbose=False):
+        self.on_publish = on_publish
+        self.verbose = verbose
+        self.sessions = []
+        self.retained = {}
+        self.lock = threading.Lock()
+        self.stats = {"connections": 0, "published": 0, "delivered": 0}
+        self.server = socket.create_server((host, port))
+        self.port = self.server.getsockname()[1]
+
+    def log(self, msg):
+        if self.verbose:
+            print(f"mqtt_broker: {msg}", flush=True)
+
+    def serve_forever(self):
+        while True:
+            sock, _ = self.server.accept()
+            sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            session = Session(self, sock)
+            with self.lock:
+                self.sessions.append(session)
+                self.stats["connections"] += 1
+            threading.Thread(target=session.run, daemon=True).start()
+
+    def start(self):
+        threading.Thread(target=self.serve_forever, daemon=True).start()
+        return self
+
+    def drop(self, session):
+        with self.lock:
+            if session in self.sessions:
+                self.sessions.remove(session)
+        self.log(f"disconnect {session.client_id}")
+
+    def publish(self, sender, topic, payload, qos, retain):
+        now = time.time()
+        if self.on_publish:
+            self.on_publish(sender.client_id, topic, payload, now)
+        with self.lock:
+            self.stats["published"] += 1
+            if retain:
+                if payload:
+                    self.retained[topic] = (payload, qos)
+                else:
+                    self.retained.pop(topic, None)
+            targets = []
+            for s in self.sessions:
+                granted = [q for p, q in s.subs.items() if topic_matches(p, topic)]
+                if granted:
+                    targets.append((s, min(max(granted), qos)))
+        for s, q in targets:
+            try:
+                s.deliver(topic, payload, q)
+                self.stats["delivered"] += 1
+            except OSError:
+                pass
+
+    def send_retained(self, session, subs):
+        with self.lock:
+            retained = list(self.retained.items())
+        for topic, (payload, qos) in retained:
+            granted = [q for p, q in subs if topic_matches(p, topic)]
+            if granted:
+                session.deliver(topic, payload, min(max(granted), qos), retain=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--verbose", action="store_true")
+    args = parser.parse_args()
+    broker = Broker(args.port, verbose=args.verbose)
+    print(f"mqtt broker listening on mqtt://0.0.0.0:{broker.port}")
+    broker.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
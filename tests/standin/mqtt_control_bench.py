@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+# Control latency and HTTP request volume, pushed over MQTT vs polled.
+#
+#   mosquitto -p 1883 -v        (allow_anonymous true)
+#   python3 cloudflare_standin.py --cert ... --key ...
+#   python3 mqtt_control_bench.py --broker 192.168.1.10 --standin https://127.0.0.1:8443
+#
+# Build the device with -DMQTT_BROKER_URI="mqtt://<host>:1883" and point
+# cloudflare_api at the stand-in. Each round flips the pump and waits for the
+# device's acknowledgement on iot/<device_id>/control/ack.
+#
+#   --via mqtt  publishes the control row on iot/<device_id>/control
+#   --via http  only changes the stand-in's /api/controls list, so the change
+#               is seen on the next poll. Build with
+#               -DCONTROL_RECONCILE_MS=CONTROL_POLL_MS for the polling baseline.
+#
+# The stand-in's request counter gives the HTTP request volume of the run.
+# Needs paho-mqtt (pip install paho-mqtt).
+import argparse
+import json
+import queue
+import ssl
+import statistics
+import time
+import urllib.request
+
+import paho.mqtt.client as mqtt
+
+PUMP_ID = 446400104
+
+
+def standin(base, path, body=None):
+    ctx = ssl.create_default_context()
+    ctx.check_hostname = False
+    ctx.verify_mode = ssl.CERT_NONE
+    req = urllib.request.Request(base + path, data=body, method="POST" if body is not None else "GET")
+    with urllib.request.urlopen(req, context=ctx, timeout=5) as resp:
+        return json.loads(resp.read() or b"null")
+
+
+def control_row(device_id, state):
+    return {"control_id": PUMP_ID, "device_id": device_id, "control_type": "switch", "state": state}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--broker", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--device-id", type=int, default=4464001)
+    parser.add_argument("--via", choices=["mqtt", "http"], default="mqtt")
+    parser.add_argument("--standin", help="base URL of cloudflare_standin.py, for request counts")
+    parser.add_argument("--rounds", type=int, default=30)
+    parser.add_argument("--gap", type=float, default=2.0, help="seconds between rounds")
+    parser.add_argument("--timeout", type=float, default=10.0)
+    args = parser.parse_args()
+
+    control_topic = "iot/%d/control" % args.device_id
+    ack_topic = control_topic + "/ack"
+    acks = queue.Queue()
+
+    client = mqtt.Client()
+    client.on_connect = lambda c, u, f, rc: c.subscribe(ack_topic, qos=1)
+    client.on_message = lambda c, u, msg: acks.put((time.monotonic(), json.loads(msg.payload)))
+    client.connect(args.broker, args.port)
+    client.loop_start()
+    time.sleep(1.0)
+
+    if args.standin:
+        standin(args.standin, "/__reset")
+    start = time.monotonic()
+    latencies = []
+    lost = 0
+    for i in range(args.rounds):
+        state = "on" if i % 2 == 0 else "off"
+        row = control_row(args.device_id, state)
+        # The stand-in always holds the current state, as the worker's table would
+        if args.standin:
+            standin(args.standin, "/__controls", json.dumps([row]).encode())
+        sent = time.monotonic()
+        if args.via == "mqtt":
+            client.publish(control_topic, json.dumps(row), qos=1)
+        deadline = sent + args.timeout
+        while True:
+            try:
+                at, ack = acks.get(timeout=max(0.0, deadline - time.monotonic()))
+            except queue.Empty:
+                lost += 1
+                break
+            if ack.get("pump_state") == state:
+                latencies.append((at - sent) * 1000.0)
+                break
+        time.sleep(args.gap)
+    elapsed = time.monotonic() - start
+    client.loop_stop()
+
+    print("%s: %d/%d acknowledged" % (args.via, len(latencies), args.rounds))
+    if latencies:
+        latencies.sort()
+        p95 = latencies[min(len(latencies) - 1, int(len(latencies) * 0.95))]
+        print("latency ms: p50 %.0f  p95 %.0f  max %.0f" % (statistics.median(latencies), p95, latencies[-1]))
+    if args.standin:
+        stats = standin(args.standin, "/__stats")
+        print("HTTP: %d requests in %.0f s (%.1f/min), %d answered 304" % (
+            stats.get("requests", 0), elapsed, stats.get("requests", 0) * 60.0 / elapsed,
+            stats.get("not_modified", 0)))
+    if lost:
+        print("%d rounds timed out" % lost)
+
+
+if __name__ == "__main__":
+    main()
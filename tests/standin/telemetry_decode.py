@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+# Decoder for the packed frames a CONFIG_TELEMETRY_BINARY build publishes on
+# iot/<device_id>/telemetry (layout in components/telemetry_codec).
+#
+#   python3 telemetry_decode.py --broker 192.168.1.10
+#
+# Prints each frame as the per-sensor JSON messages the default build sends.
+# Needs paho-mqtt (pip install paho-mqtt).
+import argparse
+import json
+import struct
+
+VERSION = 2
+HEADER = struct.Struct("<BHIIH")
+
+# name, struct code, scale, decimals, in telemetry_field_t order
+FIELDS = [
+    ("light_value", "H", 1, 0),
+    ("motion_detected", "B", 1, 0),
+    ("current", "H", 100, 2),
+    ("temperature", "h", 10, 1),
+    ("humidity", "H", 10, 1),
+    ("moisture", "H", 1, 0),
+    ("pump_state", "B", 1, 0),
+    ("heart_rate", "B", 1, 0),
+    ("spo2", "B", 1, 0),
+]
+
+
+def decode(payload):
+    """Returns (device_id, timestamp, seq, {name: value}), raises ValueError."""
+    if len(payload) < HEADER.size:
+        raise ValueError("short frame")
+    version, present, device_id, timestamp, seq = HEADER.unpack_from(payload)
+    if version != VERSION:
+        raise ValueError("unknown version %d" % version)
+    offset = HEADER.size
+    values = {}
+    for bit, (name, code, scale, decimals) in enumerate(FIELDS):
+        if not present & (1 << bit):
+            continue
+        size = struct.calcsize("<" + code)
+        if offset + size > len(payload):
+            raise ValueError("truncated frame")
+        (raw,) = struct.unpack_from("<" + code, payload, offset)
+        offset += size
+        values[name] = round(raw / scale, decimals) if decimals else raw
+    if offset != len(payload):
+        raise ValueError("trailing bytes")
+    return device_id, timestamp, seq, values
+
+
+def as_json(values):
+    out = []
+    for name, value in values.items():
+        if name == "light_value":
+            out.append({"light_value": value, "voltage": round(value / 4095.0 * 3.3, 2)})
+        else:
+            out.append({name: value})
+    return out
+
+
+def main():
+    import paho.mqtt.client as mqtt
+
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--broker", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--topic", default="iot/+/telemetry")
+    args = parser.parse_args()
+
+    last_seq = {}
+
+    def on_message(client, userdata, msg):
+        try:
+            device_id, timestamp, seq, values = decode(msg.payload)
+        except ValueError as e:
+            print("%s: %s" % (msg.topic, e))
+            return
+        prev = last_seq.get(device_id)
+        if prev is not None and (prev + 1) & 0xFFFF != seq:
+            print("device %d: %d frames lost" % (device_id, (seq - prev - 1) & 0xFFFF))
+        last_seq[device_id] = seq
+        print("device %d ts %d seq %d %d B: %s" % (
+            device_id, timestamp, seq, len(msg.payload), " ".join(json.dumps(v) for v in as_json(values))))
+
+    client = mqtt.Client()
+    client.on_connect = lambda c, u, f, rc: c.subscribe(args.topic, qos=1)
+    client.on_message = on_message
+    client.connect(args.broker, args.port)
+    client.loop_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,136 @@
+#include "unity.h"
+#include <math.h>
+#include <stdio.h>
+#include "esp_timer.h"
+#include "ac_meter.h"
+#ifdef ESP_PLATFORM
+#include "esp_cpu.h"
+#endif
+
+#define RATE_HZ 8000
+#define MAINS   50
+#define ZERO_MV 2500
+#define PI      3.14159265358979
+
+static ac_meter_result_t run(ac_meter_t *m, int32_t (*wave)(uint32_t i, void *arg), void *arg, uint32_t samples)
+{
+    for (uint32_t i = 0; i < samples; i++) ac_meter_push(m, wave(i, arg));
+    return m->result;
+}
+
+typedef struct {
+    double amplitude;
+    double dc;
+    double phase;
+} sine_t;
+
+static int32_t sine(uint32_t i, void *arg)
+{
+    const sine_t *s = arg;
+    return (int32_t)lround(ZERO_MV + s->dc + s->amplitude * sin(2 * PI * MAINS * i / RATE_HZ + s->phase));
+}
+
+typedef struct {
+    int32_t amplitude;
+    uint32_t period;
+    uint32_t on;
+} pulse_t;
+
+static int32_t pulse(uint32_t i, void *arg)
+{
+    const pulse_t *p = arg;
+    return ZERO_MV + ((i % p->period) < p->on ? p->amplitude : 0);
+}
+
+TEST_CASE("AC meter integer square root", "[ac_meter]")
+{
+    TEST_ASSERT_EQUAL(0, ac_meter_isqrt64(0));
+    TEST_ASSERT_EQUAL(1, ac_meter_isqrt64(3));
+    TEST_ASSERT_EQUAL(2, ac_meter_isqrt64(4));
+    TEST_ASSERT_EQUAL(65535, ac_meter_isqrt64(65536ull * 65536 - 1));
+    TEST_ASSERT_EQUAL(3000000000u, ac_meter_isqrt64(9000000000000000000ull));
+}
+
+TEST_CASE("AC meter true RMS of sine waves", "[ac_meter]")
+{
+    ac_meter_t m;
+    ac_meter_init(&m, RATE_HZ, MAINS, 10, ZERO_MV);
+    TEST_ASSERT_EQUAL(1600, m.window);
+
+    // 0.45 A pump at 185 mV/A; the old mean-then-fabs read ~0 here
+    sine_t s = { .amplitude = 0.45 * 185 * sqrt(2), .phase = 0.3 };
+    ac_meter_result_t r = run(&m, sine, &s, m.window);
+    TEST_ASSERT_EQUAL(1, r.seq);
+    TEST_ASSERT_INT_WITHIN(1, lround(0.45 * 185), r.rms);
+    TEST_ASSERT_INT_WITHIN(1, lround(0.45 * 185), r.ac_rms);
+    TEST_ASSERT_INT_WITHIN(1, 0, r.dc);
+    TEST_ASSERT_INT_WITHIN(1, lround(s.amplitude), r.peak);
+
+    // DC offset on top: rms^2 = ac^2 + dc^2
+    ac_meter_init(&m, RATE_HZ, MAINS, 10, ZERO_MV);
+    s = (sine_t){ .amplitude = 300, .dc = -120, .phase = 1.0 };
+    r = run(&m, sine, &s, m.window * 3);
+    TEST_ASSERT_EQUAL(3, r.seq);
+    TEST_ASSERT_INT_WITHIN(1, lround(300 / sqrt(2)), r.ac_rms);
+    TEST_ASSERT_INT_WITHIN(1, -120, r.dc);
+    TEST_ASSERT_INT_WITHIN(1, lround(sqrt(300 * 300 / 2.0 + 120 * 120)), r.rms);
+    TEST_ASSERT_INT_WITHIN(1, 420, r.peak);
+
+    // 60 Hz: 133.3 samples per cycle, so the window is not exactly whole cycles
+    ac_meter_init(&m, RATE_HZ, 60, 12, ZERO_MV);
+    s = (sine_t){ .amplitude = 500 };
+    r = run(&m, sine, &s, m.window);
+    TEST_ASSERT_INT_WITHIN(4, lround(500 / sqrt(2)), r.rms);
+}
+
+TEST_CASE("AC meter pulse waveforms and energy", "[ac_meter]")
+{
+    ac_meter_t m;
+    ac_meter_init(&m, RATE_HZ, MAINS, 10, ZERO_MV);
+
+    // 25 % duty pulse of 400 mV: rms = 400 * sqrt(0.25), dc = 100
+    pulse_t p = { .amplitude = 400, .period = 160, .on = 40 };
+    ac_meter_result_t r = run(&m, pulse, &p, m.window);
+    TEST_ASSERT_EQUAL(200, r.rms);
+    TEST_ASSERT_EQUAL(100, r.dc);
+    TEST_ASSERT_EQUAL(400, r.peak);
+    TEST_ASSERT_INT_WITHIN(1, lround(sqrt(200.0 * 200 - 100 * 100)), r.ac_rms);
+
+    // a zero change restarts the window
+    ac_meter_set_zero(&m, ZERO_MV + 400);
+    r = run(&m, pulse, &p, m.window);
+    TEST_ASSERT_EQUAL(2, r.seq);
+    TEST_ASSERT_EQUAL(-300, r.dc);
+
+    // one hour at a steady 1 A (185 mV) on 220 V is 220 Wh
+    ac_meter_init(&m, RATE_HZ, MAINS, 10, ZERO_MV);
+    for (uint32_t i = 0; i < RATE_HZ * 3600u; i++) ac_meter_push(&m, ZERO_MV + 185);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 220.0, ac_meter_energy_wh(&m, 1.0 / 185, 220));
+}
+
+TEST_CASE("AC meter cost per sample", "[ac_meter][bench]")
+{
+    static int32_t wave[1600];
+    sine_t s = { .amplitude = 400, .dc = 10 };
+    for (int i = 0; i < 1600; i++) wave[i] = sine(i, &s);
+
+    ac_meter_t m;
+    ac_meter_init(&m, RATE_HZ, MAINS, 10, ZERO_MV);
+    const int rounds = 200;
+#ifdef ESP_PLATFORM
+    uint32_t c0 = esp_cpu_get_cycle_count();
+#endif
+    int64_t start = esp_timer_get_time();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < 1600; i++) ac_meter_push(&m, wave[i]);
+    }
+    int64_t us = esp_timer_get_time() - start;
+    double samples = rounds * 1600.0;
+#ifdef ESP_PLATFORM
+    uint32_t cycles = esp_cpu_get_cycle_count() - c0;
+    printf("%.1f cycles/sample\n", cycles / samples);
+#endif
+    printf("%.1f ns/sample, %.3f%% of a core at %d Hz, %u windows\n",
+           us * 1000.0 / samples, us * 1000.0 / samples * RATE_HZ / 1e7, RATE_HZ, (unsigned)m.result.seq);
+    TEST_ASSERT_INT_WITHIN(1, lround(sqrt(400 * 400 / 2.0 + 100)), m.result.rms);
+}
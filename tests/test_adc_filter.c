@@ -0,0 +1,119 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "adc_filter.h"
+
+#define RING 64
+
+static int cmp_u16(const void *a, const void *b)
+{
+    return *(const uint16_t *)a - *(const uint16_t *)b;
+}
+
+TEST_CASE("ADC filter window mean, median and copy", "[adc_filter]")
+{
+    static uint16_t buf[RING];
+    adc_filter_t f;
+    TEST_ASSERT_FALSE(adc_filter_init(&f, buf, 48, 4));    // not a power of two
+    TEST_ASSERT_TRUE(adc_filter_init(&f, buf, RING, 4));
+    TEST_ASSERT_EQUAL(0, adc_filter_mean(&f));
+    TEST_ASSERT_EQUAL(0, adc_filter_median(&f, 5));
+
+    // Reference: plain arithmetic over everything pushed so far
+    uint16_t history[1000];
+    uint32_t seed = 1;
+    for (int n = 0; n < 1000; n++) {
+        seed = seed * 1103515245u + 12345u;
+        uint16_t x = 2000 + (seed >> 16) % 500;
+        history[n] = x;
+        adc_filter_push(&f, x);
+
+        int count = n + 1 < RING ? n + 1 : RING;
+        uint32_t sum = 0;
+        for (int i = n + 1 - count; i <= n; i++) sum += history[i];
+        TEST_ASSERT_EQUAL((sum + count / 2) / count, adc_filter_mean(&f));
+
+        int m = count < 7 ? count : 7;
+        uint16_t last[7];
+        memcpy(last, &history[n + 1 - m], m * sizeof(uint16_t));
+        qsort(last, m, sizeof(uint16_t), cmp_u16);
+        TEST_ASSERT_EQUAL(last[m / 2], adc_filter_median(&f, 7));
+    }
+
+    uint16_t out[RING + 8];
+    TEST_ASSERT_EQUAL(RING, adc_filter_copy(&f, out, RING + 8));
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(&history[1000 - RING], out, RING);
+    TEST_ASSERT_EQUAL(3, adc_filter_copy(&f, out, 3));
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(&history[997], out, 3);
+    TEST_ASSERT_EQUAL(1000, f.total);
+
+    adc_filter_reset(&f);
+    TEST_ASSERT_EQUAL(0, adc_filter_copy(&f, out, 4));
+}
+
+TEST_CASE("ADC filter EMA settles on a step", "[adc_filter]")
+{
+    static uint16_t buf[RING];
+    adc_filter_t f;
+    adc_filter_init(&f, buf, RING, 3);
+
+    adc_filter_push(&f, 1000);
+    TEST_ASSERT_EQUAL(1000, adc_filter_ema(&f));     // starts at the first sample
+    for (int i = 0; i < 200; i++) adc_filter_push(&f, 3000);
+    TEST_ASSERT_UINT32_WITHIN(1, 3000, adc_filter_ema(&f));
+    for (int i = 0; i < 8; i++) adc_filter_push(&f, 0);
+    // 1 - (7/8)^8 of the way down
+    TEST_ASSERT_UINT32_WITHIN(30, 3000 * 0.344, adc_filter_ema(&f));
+
+    // spikes move the median of 5 not at all, the mean only a little
+    adc_filter_init(&f, buf, RING, 3);
+    for (int i = 0; i < RING; i++) adc_filter_push(&f, (i % 16 == 0) ? 4095 : 1500);
+    TEST_ASSERT_EQUAL(1500, adc_filter_median(&f, 5));
+    TEST_ASSERT_UINT32_WITHIN(200, 1500, adc_filter_mean(&f));
+}
+
+TEST_CASE("ADC filter CPU time per sample and per reading", "[adc_filter][bench]")
+{
+    static uint16_t buf[512];
+    adc_filter_t f;
+    adc_filter_init(&f, buf, 512, 4);
+    const int samples = 240000;     // 10 s of all three channels at 24 kHz
+    volatile uint32_t sink = 0;
+
+    uint32_t seed = 7;
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < samples; i++) {
+        seed = seed * 1103515245u + 12345u;
+        adc_filter_push(&f, (seed >> 20) & 0xFFF);
+    }
+    int64_t push_us = esp_timer_get_time() - start;
+
+    const int reads = 20000;
+    start = esp_timer_get_time();
+    for (int i = 0; i < reads; i++) sink += adc_filter_mean(&f) + adc_filter_ema(&f);
+    int64_t mean_us = esp_timer_get_time() - start;
+
+    start = esp_timer_get_time();
+    for (int i = 0; i < reads; i++) sink += adc_filter_median(&f, ADC_FILTER_MEDIAN_MAX);
+    int64_t median_us = esp_timer_get_time() - start;
+
+    // what the old loop did per current reading: average 64 fresh samples
+    start = esp_timer_get_time();
+    for (int i = 0; i < reads; i++) {
+        uint16_t last[64];
+        adc_filter_copy(&f, last, 64);
+        uint32_t sum = 0;
+        for (int j = 0; j < 64; j++) sum += last[j];
+        sink += sum / 64;
+    }
+    int64_t avg64_us = esp_timer_get_time() - start;
+    (void)sink;
+
+    double push_ns = push_us * 1000.0 / samples;
+    printf("push:        %7.1f ns/sample, %.2f%% of a core at 24 kHz\n", push_ns, push_ns * 24000 / 1e7);
+    printf("mean + EMA:  %7.1f ns/reading (running sum, any window)\n", mean_us * 1000.0 / reads);
+    printf("median(%d):  %7.1f ns/reading\n", ADC_FILTER_MEDIAN_MAX, median_us * 1000.0 / reads);
+    printf("avg of 64:   %7.1f ns/reading (copy + sum)\n", avg64_us * 1000.0 / reads);
+}
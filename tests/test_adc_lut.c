@@ -0,0 +1,124 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "esp_timer.h"
+#include "adc_lut.h"
+
+static adc_lut_t lut;
+
+typedef struct {
+    int vref;
+    adc_atten_t atten;
+} line_ctx_t;
+
+static bool line_mv(int raw, int *mv, void *ctx)
+{
+    const line_ctx_t *c = ctx;
+    *mv = adc_lut_esp32_line_mv(raw, c->vref, c->atten);
+    return *mv >= 0;
+}
+
+static bool failing_mv(int raw, int *mv, void *ctx)
+{
+    *mv = raw;
+    return raw < 100;
+}
+
+TEST_CASE("ADC LUT matches the conversion it was built from", "[adc_lut]")
+{
+    adc_lut_build_nominal(&lut, 3300);
+    for (int raw = 0; raw < ADC_LUT_SIZE; raw++) {
+        TEST_ASSERT_INT_WITHIN(1, (int)(raw / 4095.0 * 3300 + 0.5), adc_lut_mv(&lut, raw));
+    }
+    TEST_ASSERT_EQUAL(3300, adc_lut_mv(&lut, 4095));
+
+    line_ctx_t ctx = { 1100, ADC_ATTEN_DB_12 };
+    TEST_ASSERT_TRUE(adc_lut_build(&lut, line_mv, &ctx));
+    for (int raw = 0; raw < ADC_LUT_SIZE; raw++) {
+        TEST_ASSERT_EQUAL(adc_lut_esp32_line_mv(raw, 1100, ADC_ATTEN_DB_12), adc_lut_mv(&lut, raw));
+    }
+    TEST_ASSERT_EQUAL(adc_lut_mv(&lut, 5), adc_lut_mv(&lut, ADC_LUT_SIZE + 5));   // masked, never out of range
+
+    TEST_ASSERT_FALSE(adc_lut_build(&lut, failing_mv, NULL));
+    TEST_ASSERT_EQUAL(-1, adc_lut_esp32_line_mv(100, 1100, (adc_atten_t)7));
+}
+
+TEST_CASE("ADC nominal scaling error against line fitting", "[adc_lut]")
+{
+    // eFuse Vref of ESP32 parts spreads around 1100 mV
+    static const int vrefs[] = { 1000, 1100, 1200 };
+    for (int v = 0; v < 3; v++) {
+        int max_err = 0, at_raw = 0;
+        for (int raw = 0; raw < ADC_LUT_SIZE; raw += 7) {
+            int nominal = (int)(raw / 4095.0 * 3300 + 0.5);
+            int err = abs(nominal - adc_lut_esp32_line_mv(raw, vrefs[v], ADC_ATTEN_DB_12));
+            if (err > max_err) {
+                max_err = err;
+                at_raw = raw;
+            }
+        }
+        printf("Vref %d mV: raw / 4095 * 3.3 is off by up to %d mV (raw %d)\n", vrefs[v], max_err, at_raw);
+        TEST_ASSERT_GREATER_THAN(20, max_err);
+    }
+}
+
+#ifdef ESP_PLATFORM
+TEST_CASE("ADC LUT from eFuse calibration", "[adc_lut]")
+{
+    esp_err_t err = adc_lut_build_cali(&lut, ADC_UNIT_1, ADC_ATTEN_DB_12);
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+        TEST_IGNORE_MESSAGE("no calibration scheme on this chip");
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, err);
+    for (int raw = 1; raw < ADC_LUT_SIZE; raw++) {
+        TEST_ASSERT_GREATER_OR_EQUAL(adc_lut_mv(&lut, raw - 1), adc_lut_mv(&lut, raw));
+    }
+    printf("calibrated: raw 0 -> %u mV, 2048 -> %u mV, 4095 -> %u mV\n",
+           adc_lut_mv(&lut, 0), adc_lut_mv(&lut, 2048), adc_lut_mv(&lut, 4095));
+}
+#endif
+
+TEST_CASE("ADC conversion throughput: LUT vs float vs line fitting", "[adc_lut][bench]")
+{
+    static uint16_t raw[4096];
+    uint32_t seed = 3;
+    for (int i = 0; i < 4096; i++) {
+        seed = seed * 1103515245u + 12345u;
+        raw[i] = (seed >> 20) & 0xFFF;
+    }
+    line_ctx_t ctx = { 1100, ADC_ATTEN_DB_12 };
+    adc_lut_build(&lut, line_mv, &ctx);
+    const int rounds = 100;
+    const double n = rounds * 4096.0;
+    volatile uint32_t sink = 0;
+
+    int64_t start = esp_timer_get_time();
+    for (int r = 0; r < rounds; r++) {
+        uint32_t acc = 0;
+        for (int i = 0; i < 4096; i++) acc += adc_lut_mv(&lut, raw[i]);
+        sink += acc;
+    }
+    int64_t lut_us = esp_timer_get_time() - start;
+
+    start = esp_timer_get_time();
+    for (int r = 0; r < rounds; r++) {
+        float acc = 0;
+        for (int i = 0; i < 4096; i++) acc += raw[i] / 4095.0f * 3.3f;
+        sink += (uint32_t)acc;
+    }
+    int64_t float_us = esp_timer_get_time() - start;
+
+    start = esp_timer_get_time();
+    for (int r = 0; r < rounds; r++) {
+        uint32_t acc = 0;
+        for (int i = 0; i < 4096; i++) acc += adc_lut_esp32_line_mv(raw[i], 1100, ADC_ATTEN_DB_12);
+        sink += acc;
+    }
+    int64_t line_us = esp_timer_get_time() - start;
+    (void)sink;
+
+    printf("LUT lookup:      %6.2f ns/sample\n", lut_us * 1000.0 / n);
+    printf("float raw*3.3:   %6.2f ns/sample (uncalibrated)\n", float_us * 1000.0 / n);
+    printf("line fitting:    %6.2f ns/sample\n", line_us * 1000.0 / n);
+    printf("table: %u bytes\n", (unsigned)sizeof(lut));
+}
@@ -0,0 +1,107 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "cloudflare_api.h"
+
+// Benchmark against tests/standin/cloudflare_standin.py with injected delays:
+//   python3 cloudflare_standin.py --cert ... --key ... --delay-ms 50 --slow-every 10 --slow-ms 2000
+// WiFi must already be connected. The engine needs TLS (esp_http_client
+// only supports non-blocking mode over HTTPS).
+#ifndef STANDIN_BASE_URL
+#define STANDIN_BASE_URL "https://192.168.1.10:8443"
+#endif
+#ifndef STANDIN_CERT_PEM
+#define STANDIN_CERT_PEM NULL
+#endif
+#define BENCH_REQUESTS 40
+
+static const char *bench_body = "{\"sensor_id\":446400101,\"device_id\":4464001,\"data\":{\"temperature\":25.0}}";
+
+static int64_t submitted_us[BENCH_REQUESTS];
+static int64_t latency_us[BENCH_REQUESTS];
+static volatile int completed;
+static volatile int succeeded;
+
+static int cmp_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void report(const char *label, int64_t *lat, int n, int ok, int64_t elapsed_us)
+{
+    qsort(lat, n, sizeof(lat[0]), cmp_i64);
+    printf("%-10s %2d/%d ok  %5.1f req/s  p50 %4lld ms  p95 %4lld ms  p99 %4lld ms  max %4lld ms\n",
+           label, ok, n, elapsed_us > 0 ? ok * 1e6 / elapsed_us : 0.0,
+           (long long)lat[n / 2] / 1000, (long long)lat[n * 95 / 100] / 1000,
+           (long long)lat[n * 99 / 100] / 1000, (long long)lat[n - 1] / 1000);
+}
+
+static void on_done(esp_err_t result, int status, void *arg)
+{
+    int i = (int)(intptr_t)arg;
+    latency_us[i] = esp_timer_get_time() - submitted_us[i];
+    if (result == ESP_OK) succeeded++;
+    completed++;
+}
+
+TEST_CASE("Async engine vs blocking requests under injected delays", "[cloudflare_api][bench]")
+{
+    TEST_ASSERT_EQUAL(ESP_OK, cloudflare_api_init());
+    cloudflare_api_config_t cfg = {
+        .base_url = STANDIN_BASE_URL,
+        .cert_pem = STANDIN_CERT_PEM,
+        .reuse_connections = true,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, cloudflare_api_configure(&cfg));
+
+    // Blocking: one request at a time, as http_request_task used to do
+    int ok = 0;
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < BENCH_REQUESTS; i++) {
+        int64_t t0 = esp_timer_get_time();
+        if (cloudflare_post_json("/api/sensor_data", bench_body) == ESP_OK) ok++;
+        latency_us[i] = esp_timer_get_time() - t0;
+    }
+    report("blocking", latency_us, BENCH_REQUESTS, ok, esp_timer_get_time() - start);
+    int64_t blocking_us = esp_timer_get_time() - start;
+
+    // Engine: submit everything, completions arrive through the callback
+    cloudflare_api_reset_pool_stats();
+    completed = 0;
+    succeeded = 0;
+    start = esp_timer_get_time();
+    for (int i = 0; i < BENCH_REQUESTS; i++) {
+        cloudflare_request_t req = {
+            .method = CLOUDFLARE_POST,
+            .endpoint = "/api/sensor_data",
+            .json_body = bench_body,
+            .max_retries = 1,
+            .done_cb = on_done,
+            .arg = (void *)(intptr_t)i,
+        };
+        submitted_us[i] = esp_timer_get_time();
+        TEST_ASSERT_EQUAL(ESP_OK, cloudflare_submit(&req, 30000));
+    }
+    while (completed < BENCH_REQUESTS) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    int64_t async_us = esp_timer_get_time() - start;
+    report("engine", latency_us, BENCH_REQUESTS, succeeded, async_us);
+
+    cloudflare_pool_stats_t stats;
+    cloudflare_api_get_pool_stats(&stats);
+    printf("engine: %u connections in flight at peak, %u handshakes\n",
+           (unsigned)stats.peak_in_flight, (unsigned)stats.handshakes);
+
+    TEST_ASSERT_EQUAL_INT(BENCH_REQUESTS, ok);
+    TEST_ASSERT_EQUAL_INT(BENCH_REQUESTS, succeeded);
+    TEST_ASSERT_TRUE(stats.peak_in_flight > 1);
+    TEST_ASSERT_TRUE(async_us < blocking_us);
+
+    cloudflare_api_config_t defaults = { .reuse_connections = true };
+    cloudflare_api_configure(&defaults);
+}
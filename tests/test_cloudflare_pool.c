@@ -0,0 +1,144 @@
+#include "unity.h"
+#include <stdio.h>
+#include "esp_timer.h"
+#include "cloudflare_api.h"
+#include "control_scan.h"
+
+// Benchmark against tests/standin/cloudflare_standin.py running on the bench
+// host. WiFi must already be connected.
+#ifndef STANDIN_BASE_URL
+#define STANDIN_BASE_URL "https://192.168.1.10:8443"
+#endif
+// Contents of the stand-in's standin_cert.pem; NULL only works with a
+// certificate the CA bundle can verify.
+#ifndef STANDIN_CERT_PEM
+#define STANDIN_CERT_PEM NULL
+#endif
+#define BENCH_REQUESTS 20
+#define POLL_ROUNDS    20
+
+static cloudflare_pool_stats_t run_round(bool reuse, const char *label)
+{
+    cloudflare_api_config_t cfg = {
+        .base_url = STANDIN_BASE_URL,
+        .cert_pem = STANDIN_CERT_PEM,
+        .reuse_connections = reuse,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, cloudflare_api_configure(&cfg));
+    cloudflare_api_reset_pool_stats();
+
+    int ok = 0;
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < BENCH_REQUESTS; i++) {
+        if (cloudflare_post_json("/api/sensor_data",
+                "{\"sensor_id\":446400101,\"device_id\":4464001,\"data\":{\"temperature\":25.0}}") == ESP_OK) {
+            ok++;
+        }
+    }
+    int64_t elapsed_us = esp_timer_get_time() - start;
+
+    cloudflare_pool_stats_t stats;
+    cloudflare_api_get_pool_stats(&stats);
+    printf("%-24s %2d/%d ok  %.2f handshakes/request  %.1f requests/s\n",
+           label, ok, BENCH_REQUESTS,
+           stats.requests ? (double)stats.handshakes / stats.requests : 0.0,
+           elapsed_us > 0 ? ok * 1e6 / elapsed_us : 0.0);
+    TEST_ASSERT_EQUAL_INT(BENCH_REQUESTS, ok);
+    return stats;
+}
+
+TEST_CASE("Pooled keep-alive connections avoid per-request handshakes", "[cloudflare_api][bench]")
+{
+    TEST_ASSERT_EQUAL(ESP_OK, cloudflare_api_init());
+
+    cloudflare_pool_stats_t before = run_round(false, "new connection each time");
+    cloudflare_pool_stats_t after = run_round(true, "pooled keep-alive");
+
+    TEST_ASSERT_EQUAL_UINT32(BENCH_REQUESTS, before.handshakes);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(2, after.handshakes);
+
+    cloudflare_api_config_t defaults = { .reuse_connections = true };
+    cloudflare_api_configure(&defaults);
+}
+
+// Controls list for the stand-in's /api/controls, the pump entry last
+static int controls_body(char *buf, size_t size, int entries, const char *pump_state)
+{
+    int len = snprintf(buf, size, "[");
+    for (int i = 0; i < entries; i++) {
+        len += snprintf(buf + len, size - len,
+                        "{\"control_id\":\"%d\",\"device_id\":4464001,\"control_type\":\"switch\",\"state\":\"%s\"},",
+                        446400200 + i, i % 2 ? "on" : "off");
+    }
+    len += snprintf(buf + len, size - len,
+                    "{\"control_id\":\"446400104\",\"device_id\":4464001,\"control_type\":\"switch\",\"state\":\"%s\"}]",
+                    pump_state);
+    return len;
+}
+
+TEST_CASE("Conditional GET skips unchanged control lists", "[cloudflare_api][bench]")
+{
+    TEST_ASSERT_EQUAL(ESP_OK, cloudflare_api_init());
+    cloudflare_api_config_t cfg = {
+        .base_url = STANDIN_BASE_URL,
+        .cert_pem = STANDIN_CERT_PEM,
+        .reuse_connections = true,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, cloudflare_api_configure(&cfg));
+
+    static char body[8192];
+    int body_len = controls_body(body, sizeof(body), 60, "on");
+    TEST_ASSERT_EQUAL(ESP_OK, cloudflare_post_json("/__controls", body));
+    cloudflare_api_reset_pool_stats();
+
+    static control_scan_t scan;
+    control_scan_init(&scan, 446400104, 4464001);
+    int64_t full_us = 0, cached_us = 0;
+    for (int i = 0; i < POLL_ROUNDS; i++) {
+        int64_t t0 = esp_timer_get_time();
+        esp_err_t err = cloudflare_get_stream("/api/controls?device_id=4464001", control_scan_feed, &scan);
+        int64_t t = esp_timer_get_time() - t0;
+        if (i == 0) {
+            TEST_ASSERT_EQUAL(ESP_OK, err);
+            full_us = t;
+        } else {
+            TEST_ASSERT_EQUAL(CLOUDFLARE_ERR_NOT_MODIFIED, err);
+            cached_us += t;
+        }
+        // a 304 leaves the last parse in place
+        TEST_ASSERT_TRUE(control_scan_finish(&scan));
+        TEST_ASSERT_EQUAL_STRING("on", scan.pump_state);
+        if (i == 0) cloudflare_accept_response("/api/controls?device_id=4464001");
+    }
+
+    // buffer GETs of the same endpoint are never conditional
+    static char full[8192];
+    TEST_ASSERT_EQUAL(ESP_OK, cloudflare_get_json("/api/controls?device_id=4464001", full, sizeof(full)));
+    TEST_ASSERT_EQUAL_STRING(body, full);
+
+    cloudflare_pool_stats_t stats;
+    cloudflare_api_get_pool_stats(&stats);
+    printf("%d polls of a %d byte list: %u/%u conditional GETs answered 304, %u bytes saved\n",
+           POLL_ROUNDS, body_len, (unsigned)stats.not_modified, (unsigned)stats.conditional,
+           (unsigned)stats.bytes_saved);
+    printf("full GET + parse %lld us, 304 %lld us\n",
+           (long long)full_us, (long long)(cached_us / (POLL_ROUNDS - 1)));
+    TEST_ASSERT_EQUAL_UINT32(POLL_ROUNDS - 1, stats.conditional);
+    TEST_ASSERT_EQUAL_UINT32(POLL_ROUNDS - 1, stats.not_modified);
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)body_len * (POLL_ROUNDS - 1), stats.bytes_saved);
+
+    // A changed list is downloaded again; until it is accepted, e.g. because
+    // it did not parse, every poll fetches it in full
+    controls_body(body, sizeof(body), 60, "off");
+    TEST_ASSERT_EQUAL(ESP_OK, cloudflare_post_json("/__controls", body));
+    TEST_ASSERT_EQUAL(ESP_OK, cloudflare_get_stream("/api/controls?device_id=4464001", control_scan_feed, &scan));
+    TEST_ASSERT_TRUE(control_scan_finish(&scan));
+    TEST_ASSERT_EQUAL_STRING("off", scan.pump_state);
+    TEST_ASSERT_EQUAL(ESP_OK, cloudflare_get_stream("/api/controls?device_id=4464001", control_scan_feed, &scan));
+    cloudflare_accept_response("/api/controls?device_id=4464001");
+    TEST_ASSERT_EQUAL(CLOUDFLARE_ERR_NOT_MODIFIED,
+                      cloudflare_get_stream("/api/controls?device_id=4464001", control_scan_feed, &scan));
+
+    cloudflare_api_config_t defaults = { .reuse_connections = true };
+    cloudflare_api_configure(&defaults);
+}
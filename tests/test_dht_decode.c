@@ -0,0 +1,140 @@
+#include "unity.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "dht_decode.h"
+
+// DHT11 transfer in the form the RMT delivers it: the tail of the 20 ms start
+// pulse, the release, the 80/80 us acknowledge, 40 bits and the final low.
+// 62 %RH, 25.3 C.
+static const dht_pulse_t dht11_trace[] = {
+    { 0, 2100 }, { 1, 31 }, { 0, 83 }, { 1, 87 }, { 0, 54 }, { 1, 24 }, { 0, 55 }, { 1, 28 },
+    { 0, 49 }, { 1, 70 }, { 0, 50 }, { 1, 72 }, { 0, 49 }, { 1, 74 }, { 0, 52 }, { 1, 70 },
+    { 0, 50 }, { 1, 73 }, { 0, 55 }, { 1, 23 }, { 0, 52 }, { 1, 23 }, { 0, 55 }, { 1, 23 },
+    { 0, 50 }, { 1, 24 }, { 0, 49 }, { 1, 27 }, { 0, 55 }, { 1, 23 }, { 0, 52 }, { 1, 23 },
+    { 0, 51 }, { 1, 25 }, { 0, 55 }, { 1, 24 }, { 0, 50 }, { 1, 27 }, { 0, 53 }, { 1, 27 },
+    { 0, 51 }, { 1, 23 }, { 0, 52 }, { 1, 72 }, { 0, 50 }, { 1, 74 }, { 0, 50 }, { 1, 27 },
+    { 0, 49 }, { 1, 27 }, { 0, 52 }, { 1, 73 }, { 0, 55 }, { 1, 25 }, { 0, 56 }, { 1, 27 },
+    { 0, 56 }, { 1, 25 }, { 0, 53 }, { 1, 24 }, { 0, 51 }, { 1, 28 }, { 0, 52 }, { 1, 23 },
+    { 0, 53 }, { 1, 74 }, { 0, 56 }, { 1, 72 }, { 0, 56 }, { 1, 25 }, { 0, 50 }, { 1, 70 },
+    { 0, 55 }, { 1, 24 }, { 0, 54 }, { 1, 71 }, { 0, 56 }, { 1, 73 }, { 0, 49 }, { 1, 28 },
+    { 0, 50 }, { 1, 74 }, { 0, 54 }, { 1, 25 }, { 0, 54 },
+};
+
+static uint32_t seed = 1;
+
+static int jitter(int us, int spread)
+{
+    seed = seed * 1103515245u + 12345u;
+    return us + (int)((seed >> 16) % (2 * spread + 1)) - spread;
+}
+
+// Synthetic transfer of the 5 bytes with +-spread us of jitter on every pulse
+static size_t make_trace(const uint8_t data[5], int spread, dht_pulse_t *out)
+{
+    size_t n = 0;
+    out[n++] = (dht_pulse_t){ 0, 1500 };
+    out[n++] = (dht_pulse_t){ 1, jitter(30, 10) };
+    out[n++] = (dht_pulse_t){ 0, jitter(80, spread) };
+    out[n++] = (dht_pulse_t){ 1, jitter(80, spread) };
+    for (int bit = 0; bit < 40; bit++) {
+        bool one = data[bit / 8] & (0x80 >> (bit % 8));
+        out[n++] = (dht_pulse_t){ 0, jitter(50, spread) };
+        out[n++] = (dht_pulse_t){ 1, jitter(one ? 70 : 27, spread) };
+    }
+    out[n++] = (dht_pulse_t){ 0, 50 };
+    return n;
+}
+
+TEST_CASE("DHT decode of a captured transfer", "[dht]")
+{
+    uint8_t data[5];
+    size_t n = sizeof(dht11_trace) / sizeof(dht11_trace[0]);
+    TEST_ASSERT_EQUAL(DHT_DECODE_OK, dht_decode(dht11_trace, n, data));
+    const uint8_t expected[5] = { 62, 0, 25, 3, 90 };
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, data, 5);
+
+    float h, t;
+    dht11_convert(data, &h, &t);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 62.0, h);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 25.3, t);
+
+    // without the trailing low, as when the idle threshold cuts the capture
+    TEST_ASSERT_EQUAL(DHT_DECODE_OK, dht_decode(dht11_trace, n - 1, data));
+}
+
+TEST_CASE("DHT decode rejects bad transfers", "[dht]")
+{
+    static dht_pulse_t p[100];
+    uint8_t data[5];
+    size_t n = sizeof(dht11_trace) / sizeof(dht11_trace[0]);
+    memcpy(p, dht11_trace, sizeof(dht11_trace));
+
+    // one bit flipped in the temperature byte: the old reader returned it as valid
+    p[4 + 2 * 22 + 1].us = 72;
+    TEST_ASSERT_EQUAL(DHT_DECODE_CHECKSUM, dht_decode(p, n, data));
+    TEST_ASSERT_EQUAL(25 | 2, data[2]);
+
+    TEST_ASSERT_EQUAL(DHT_DECODE_SHORT, dht_decode(dht11_trace, n - 10, data));
+    TEST_ASSERT_EQUAL(DHT_DECODE_NO_RESPONSE, dht_decode(dht11_trace, 3, data));
+    TEST_ASSERT_EQUAL(DHT_DECODE_NO_RESPONSE, dht_decode(NULL, 0, data));
+
+    // a stretched bit (sensor stalled or a missed edge)
+    memcpy(p, dht11_trace, sizeof(dht11_trace));
+    p[4 + 2 * 10].us = 200;
+    TEST_ASSERT_EQUAL(DHT_DECODE_TIMING, dht_decode(p, n, data));
+}
+
+TEST_CASE("DHT decode with jitter and split pulses", "[dht]")
+{
+    static dht_pulse_t p[100], split[120];
+    uint8_t data[5], out[5];
+    for (int i = 0; i < 500; i++) {
+        for (int b = 0; b < 4; b++) data[b] = (uint8_t)jitter(128, 127);
+        data[4] = (uint8_t)(data[0] + data[1] + data[2] + data[3]);
+        size_t n = make_trace(data, 12, p);
+        TEST_ASSERT_EQUAL(DHT_DECODE_OK, dht_decode(p, n, out));
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(data, out, 5);
+
+        // a high cut in two by a filtered glitch still counts as one pulse
+        size_t k = 0;
+        for (size_t j = 0; j < n; j++) {
+            if (j == 30 && p[j].level == 1) {
+                split[k++] = (dht_pulse_t){ 1, p[j].us / 2 };
+                split[k++] = (dht_pulse_t){ 1, p[j].us - p[j].us / 2 };
+            } else {
+                split[k++] = p[j];
+            }
+        }
+        TEST_ASSERT_EQUAL(DHT_DECODE_OK, dht_decode(split, k, out));
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(data, out, 5);
+    }
+}
+
+TEST_CASE("DHT22 conversion", "[dht]")
+{
+    float h, t;
+    const uint8_t warm[5] = { 0x02, 0x8C, 0x01, 0x5F, 0xEE };   // 65.2 %, 35.1 C
+    dht22_convert(warm, &h, &t);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 65.2, h);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 35.1, t);
+
+    const uint8_t cold[5] = { 0x01, 0xF4, 0x80, 0x65, 0xDA };   // 50.0 %, -10.1 C
+    dht22_convert(cold, &h, &t);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 50.0, h);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, -10.1, t);
+}
+
+TEST_CASE("DHT decode cost per transfer", "[dht][bench]")
+{
+    uint8_t data[5];
+    size_t n = sizeof(dht11_trace) / sizeof(dht11_trace[0]);
+    const int rounds = 10000;
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < rounds; i++) dht_decode(dht11_trace, n, data);
+    int64_t us = esp_timer_get_time() - start;
+    // the busy-wait reader spun in esp_rom_delay_us for the whole transfer,
+    // about 4-5 ms, after blocking the caller 20 ms for the start pulse
+    printf("decode: %.2f us per transfer (%u pulses)\n", (double)us / rounds, (unsigned)n);
+    TEST_ASSERT_EQUAL(DHT_DECODE_OK, dht_decode(dht11_trace, n, data));
+}
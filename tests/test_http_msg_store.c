@@ -0,0 +1,170 @@
+#include "unity.h"
+#include <stdio.h>
+#include <string.h>
+#include "http_msg_store.h"
+#include "http_pqueue.h"
+
+#define RECORD_SIZE(endpoint, body) ((HTTP_MSG_HEADER_SIZE + strlen(endpoint) + strlen(body) + 2 + 3) & ~3u)
+
+static uint32_t arena[1024 / sizeof(uint32_t)];
+static http_msg_store_t store;
+
+// Reserve generously, format, commit exact length (as main.c does)
+static http_msg_handle_t put(const char *endpoint, const char *body)
+{
+    http_msg_handle_t h;
+    size_t max_body = http_msg_max_body(&store, endpoint);
+    char *dst = http_msg_reserve(&store, endpoint, max_body, &h);
+    if (dst == NULL) return HTTP_MSG_INVALID;
+    int len = snprintf(dst, max_body + 1, "%s", body);
+    if ((size_t)len > max_body) {
+        http_msg_free(&store, h);
+        return HTTP_MSG_INVALID;
+    }
+    http_msg_commit(&store, h, len);
+    return h;
+}
+
+static uint16_t used(void)
+{
+    http_msg_store_stats_t stats;
+    http_msg_store_get_stats(&store, &stats);
+    return stats.used;
+}
+
+TEST_CASE("Records take only the space their body needs", "[http_msg_store]")
+{
+    http_msg_store_init(&store, arena, sizeof(arena));
+    const char *endpoint = "/api/controls?control_id=4";
+    http_msg_handle_t h = put(endpoint, "{\"state\":\"on\"}");
+    TEST_ASSERT_NOT_EQUAL(HTTP_MSG_INVALID, h);
+    TEST_ASSERT_EQUAL_STRING(endpoint, http_msg_endpoint(&store, h));
+    TEST_ASSERT_EQUAL_STRING("{\"state\":\"on\"}", http_msg_body(&store, h));
+    TEST_ASSERT_EQUAL_UINT16(RECORD_SIZE(endpoint, "{\"state\":\"on\"}"), used());
+
+    http_msg_free(&store, h);
+    TEST_ASSERT_EQUAL_UINT16(0, used());
+}
+
+TEST_CASE("Long bodies are stored intact or refused, never truncated", "[http_msg_store]")
+{
+    http_msg_store_init(&store, arena, sizeof(arena));
+    char body[700];
+    memset(body, 'x', sizeof(body) - 1);
+    body[sizeof(body) - 1] = '\0';
+
+    http_msg_handle_t h = put("/api/messages", body);
+    TEST_ASSERT_NOT_EQUAL(HTTP_MSG_INVALID, h);
+    TEST_ASSERT_EQUAL_UINT32(sizeof(body) - 1, http_msg_body_len(&store, h));
+
+    // a second one does not fit in the remaining space
+    http_msg_handle_t h2;
+    TEST_ASSERT_NULL(http_msg_reserve(&store, "/api/messages", sizeof(body) - 1, &h2));
+    TEST_ASSERT_EQUAL_UINT16(HTTP_MSG_INVALID, h2);
+    http_msg_free(&store, h);
+}
+
+TEST_CASE("Ring wraps and reclaims records freed out of order", "[http_msg_store]")
+{
+    http_msg_store_init(&store, arena, sizeof(arena));
+    char body[200];
+    memset(body, 'a', sizeof(body) - 1);
+    body[sizeof(body) - 1] = '\0';
+
+    http_msg_handle_t h[4];
+    for (int i = 0; i < 4; i++) {
+        h[i] = put("/api/sensor_data", body);
+        TEST_ASSERT_NOT_EQUAL(HTTP_MSG_INVALID, h[i]);
+    }
+    TEST_ASSERT_EQUAL_UINT16(HTTP_MSG_INVALID, put("/api/sensor_data", body));
+
+    // freeing a newer record does not make room while the oldest is live
+    http_msg_free(&store, h[1]);
+    TEST_ASSERT_EQUAL_UINT16(HTTP_MSG_INVALID, put("/api/sensor_data", body));
+
+    // freeing the oldest reclaims both, and the next record wraps to the start
+    http_msg_free(&store, h[0]);
+    http_msg_handle_t wrapped = put("/api/sensor_data", body);
+    TEST_ASSERT_EQUAL_UINT16(0, wrapped);
+    TEST_ASSERT_EQUAL_STRING(body, http_msg_body(&store, h[2]));
+    TEST_ASSERT_EQUAL_STRING(body, http_msg_body(&store, wrapped));
+
+    http_msg_free(&store, h[2]);
+    http_msg_free(&store, h[3]);
+    http_msg_free(&store, wrapped);
+    TEST_ASSERT_EQUAL_UINT16(0, used());
+}
+
+static void free_dropped(const void *item, void *ctx)
+{
+    http_msg_free(ctx, *(const http_msg_handle_t *)item);
+}
+
+TEST_CASE("Evicted and expired queue entries release their records", "[http_msg_store]")
+{
+    http_msg_store_init(&store, arena, sizeof(arena));
+    http_pqueue_t queue;
+    const http_class_config_t config[HTTP_CLASS_COUNT] = {
+        [HTTP_CLASS_CONTROL]   = { .capacity = 2 },
+        [HTTP_CLASS_MESSAGE]   = { .capacity = 2 },
+        [HTTP_CLASS_TELEMETRY] = { .capacity = 2, .max_age_ms = 100 },
+    };
+    TEST_ASSERT_TRUE(http_pqueue_init(&queue, sizeof(http_msg_handle_t), config, 6));
+    http_pqueue_set_drop_cb(&queue, free_dropped, &store);
+
+    for (int i = 0; i < 5; i++) {
+        http_msg_handle_t h = put("/api/sensor_data", "{\"sensor_id\":1}");
+        http_pqueue_push(&queue, HTTP_CLASS_TELEMETRY, &h, 0);
+    }
+    TEST_ASSERT_EQUAL_UINT16(2 * RECORD_SIZE("/api/sensor_data", "{\"sensor_id\":1}"), used());
+
+    http_msg_handle_t control = put("/api/controls?control_id=4", "{\"state\":\"on\"}");
+    http_pqueue_push(&queue, HTTP_CLASS_CONTROL, &control, 0);
+    TEST_ASSERT_EQUAL_INT(HTTP_CLASS_TELEMETRY, http_pqueue_evict(&queue, HTTP_CLASS_CONTROL));
+
+    http_msg_handle_t h;
+    TEST_ASSERT_EQUAL_INT(HTTP_CLASS_CONTROL, http_pqueue_pop(&queue, &h, 500));
+    TEST_ASSERT_EQUAL_STRING("{\"state\":\"on\"}", http_msg_body(&store, h));
+    http_msg_free(&store, h);
+    TEST_ASSERT_EQUAL_INT(-1, http_pqueue_pop(&queue, &h, 500)); // last telemetry expired
+    TEST_ASSERT_EQUAL_UINT16(0, used());
+    http_pqueue_deinit(&queue);
+}
+
+TEST_CASE("Message store RAM compared with fixed-size queue items", "[http_msg_store][bench]")
+{
+    // Previous layout: 40 copies of { char endpoint[64]; char json_body[256]; }
+    const size_t queue_length = 40;
+    const size_t fixed_bytes = queue_length * (64 + 256);
+
+    // Bodies main.c produces, in the mix they are produced
+    static const struct { const char *endpoint, *body; } mix[] = {
+        { "/api/controls?control_id=4", "{\"state\":\"on\"}" },
+        { "/api/messages", "{\"device_id\":1001,\"control_id\":4,\"state\":\"on\",\"from_source\":\"soil_pump\"}" },
+        { "/api/sensor_data", "{\"sensor_id\":7,\"device_id\":1001,\"data\":{\"light_value\":2048,\"voltage\":1.65}}" },
+        { "/api/sensor_data", "{\"sensor_id\":6,\"device_id\":1001,\"data\":{\"motion_detected\":0}}" },
+        { "/api/sensor_data", "{\"sensor_id\":5,\"device_id\":1001,\"data\":{\"current\":0.12}}" },
+        { "/api/sensor_data", "{\"sensor_id\":1,\"device_id\":1001,\"data\":{\"temperature\":24.5}}" },
+        { "/api/sensor_data", "{\"sensor_id\":2,\"device_id\":1001,\"data\":{\"humidity\":55.0}}" },
+    };
+    static uint32_t big_arena[6144 / sizeof(uint32_t)];
+    http_msg_store_init(&store, big_arena, sizeof(big_arena));
+
+    size_t payload = 0;
+    size_t stored = 0;
+    for (size_t i = 0; i < queue_length; i++) {
+        const char *endpoint = mix[i % 7].endpoint, *body = mix[i % 7].body;
+        if (put(endpoint, body) == HTTP_MSG_INVALID) break;
+        payload += strlen(endpoint) + strlen(body) + 2;
+        stored++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(queue_length, stored);
+
+    // Queue side: a 2-byte handle and a 4-byte timestamp per slot
+    size_t store_bytes = sizeof(big_arena) + queue_length * (sizeof(http_msg_handle_t) + sizeof(uint32_t));
+    printf("fixed items: %u bytes static, %u bytes per request\n",
+           (unsigned)fixed_bytes, (unsigned)(fixed_bytes / queue_length));
+    printf("msg store:   %u bytes static, %u bytes used for %u requests (%u payload), %u per request\n",
+           (unsigned)store_bytes, used(), (unsigned)stored, (unsigned)payload, used() / (unsigned)stored);
+    TEST_ASSERT_TRUE(store_bytes * 2 < fixed_bytes);
+}
@@ -1,100 +1,222 @@
 #include "unity.h"
 #include <string.h>
 #include <stdbool.h>
+#include "http_pqueue.h"
 
-// Definition copied from application
+// The queue copies items without looking inside them. main.c queues
+// http_msg_handle_t; a local item that carries a sequence number is easier to check.
 typedef struct {
     char endpoint[64];
-    char json_body[256];
-} http_request_t;
+    char json_body[32];
+} test_item_t;
 
-// ---- Mock FreeRTOS queue API ----
-typedef struct {
-    int capacity;
-    int count;
-} MockQueue;
+static http_pqueue_t queue;
 
-typedef MockQueue* QueueHandle_t;
-typedef int BaseType_t;
-typedef unsigned int UBaseType_t;
-typedef int TickType_t;
+static void setup_queue(uint16_t control_cap, uint16_t message_cap, uint16_t telemetry_cap,
+                        uint16_t total_cap, uint32_t telemetry_max_age_ms)
+{
+    const http_class_config_t config[HTTP_CLASS_COUNT] = {
+        [HTTP_CLASS_CONTROL]   = { .capacity = control_cap },
+        [HTTP_CLASS_MESSAGE]   = { .capacity = message_cap },
+        [HTTP_CLASS_TELEMETRY] = { .capacity = telemetry_cap, .max_age_ms = telemetry_max_age_ms },
+    };
+    TEST_ASSERT_TRUE(http_pqueue_init(&queue, sizeof(test_item_t), config, total_cap));
+}
 
-#define pdTRUE 1
-#define pdFALSE 0
-#define pdMS_TO_TICKS(x) (x)
+static http_pq_result_t push(http_class_t cls, const char *endpoint, int seq, uint32_t now_ms)
+{
+    test_item_t req = {0};
+    snprintf(req.endpoint, sizeof(req.endpoint), "%s", endpoint);
+    snprintf(req.json_body, sizeof(req.json_body), "{\"seq\":%d}", seq);
+    return http_pqueue_push(&queue, cls, &req, now_ms);
+}
 
-static QueueHandle_t http_request_queue = NULL;
+static int pop_seq(int *cls, uint32_t now_ms)
+{
+    test_item_t req;
+    *cls = http_pqueue_pop(&queue, &req, now_ms);
+    if (*cls < 0) return -1;
+    int seq = -1;
+    sscanf(req.json_body, "{\"seq\":%d}", &seq);
+    return seq;
+}
 
-static BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t wait)
+// ---------------------- Tests -------------------------
+TEST_CASE("High priority request enqueued when queue space is low", "[http_queue]")
 {
-    if (q->count < q->capacity) {
-        q->count++;
-        return pdTRUE;
+    setup_queue(2, 2, 5, 5, 0);
+    for (int i = 0; i < 5; i++) {
+        push(HTTP_CLASS_TELEMETRY, "/api/sensor_data", i, i);
     }
-    return pdFALSE;
+
+    TEST_ASSERT_EQUAL_INT(HTTP_PQ_REPLACED, push(HTTP_CLASS_CONTROL, "/api/controls?control_id=1", 100, 10));
+    TEST_ASSERT_EQUAL_INT(5, http_pqueue_total(&queue));
+    TEST_ASSERT_EQUAL_INT(1, http_pqueue_count(&queue, HTTP_CLASS_CONTROL));
+    TEST_ASSERT_EQUAL_UINT32(1, http_pqueue_dropped(&queue, HTTP_CLASS_TELEMETRY));
+
+    // the oldest telemetry (seq 0) made room, the rest is untouched
+    int cls;
+    TEST_ASSERT_EQUAL_INT(100, pop_seq(&cls, 20));
+    TEST_ASSERT_EQUAL_INT(HTTP_CLASS_CONTROL, cls);
+    TEST_ASSERT_EQUAL_INT(1, pop_seq(&cls, 20));
+    http_pqueue_deinit(&queue);
 }
 
-static BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t wait)
+TEST_CASE("Low priority request fails when queue is full", "[http_queue]")
 {
-    if (q->count > 0) {
-        q->count--;
-        return pdTRUE;
+    setup_queue(3, 3, 3, 3, 0);
+    for (int i = 0; i < 3; i++) {
+        push(HTTP_CLASS_CONTROL, "/api/controls?control_id=1", i, i);
     }
-    return pdFALSE;
+
+    TEST_ASSERT_EQUAL_INT(HTTP_PQ_REJECTED, push(HTTP_CLASS_TELEMETRY, "/api/sensor_data", 9, 5));
+    TEST_ASSERT_EQUAL_INT(3, http_pqueue_total(&queue)); // queue unchanged
+    TEST_ASSERT_EQUAL_UINT32(0, http_pqueue_dropped(&queue, HTTP_CLASS_CONTROL));
+    TEST_ASSERT_EQUAL_UINT32(1, http_pqueue_dropped(&queue, HTTP_CLASS_TELEMETRY));
+    http_pqueue_deinit(&queue);
 }
 
-static UBaseType_t uxQueueSpacesAvailable(QueueHandle_t q)
+TEST_CASE("Controls are dispatched before messages and telemetry", "[http_queue]")
 {
-    return q->capacity - q->count;
+    setup_queue(4, 4, 4, 12, 0);
+    push(HTTP_CLASS_TELEMETRY, "/api/sensor_data", 1, 0);
+    push(HTTP_CLASS_MESSAGE, "/api/messages", 2, 1);
+    push(HTTP_CLASS_CONTROL, "/api/controls?control_id=1", 3, 2);
+    push(HTTP_CLASS_TELEMETRY, "/api/sensor_data", 4, 3);
+    push(HTTP_CLASS_CONTROL, "/api/controls?control_id=1", 5, 4);
+
+    const int expected_seq[] = { 3, 5, 2, 1, 4 };
+    const int expected_cls[] = { HTTP_CLASS_CONTROL, HTTP_CLASS_CONTROL, HTTP_CLASS_MESSAGE,
+                                 HTTP_CLASS_TELEMETRY, HTTP_CLASS_TELEMETRY };
+    for (int i = 0; i < 5; i++) {
+        int cls;
+        TEST_ASSERT_EQUAL_INT(expected_seq[i], pop_seq(&cls, 10));
+        TEST_ASSERT_EQUAL_INT(expected_cls[i], cls);
+    }
+    int cls;
+    TEST_ASSERT_EQUAL_INT(-1, pop_seq(&cls, 10));
+    http_pqueue_deinit(&queue);
 }
 
-// Silence logging macros used in original implementation
-#define ESP_LOGW(tag, fmt, ...)
+TEST_CASE("Full class evicts its own oldest item", "[http_queue]")
+{
+    setup_queue(2, 2, 2, 6, 0);
+    push(HTTP_CLASS_CONTROL, "/api/controls?control_id=1", 1, 0);
+    push(HTTP_CLASS_CONTROL, "/api/controls?control_id=1", 2, 1);
+    TEST_ASSERT_EQUAL_INT(HTTP_PQ_REPLACED, push(HTTP_CLASS_CONTROL, "/api/controls?control_id=1", 3, 2));
+
+    http_class_stats_t stats;
+    http_pqueue_get_stats(&queue, HTTP_CLASS_CONTROL, &stats);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.evicted);
+
+    int cls;
+    TEST_ASSERT_EQUAL_INT(2, pop_seq(&cls, 3));
+    TEST_ASSERT_EQUAL_INT(3, pop_seq(&cls, 3));
+    http_pqueue_deinit(&queue);
+}
 
-// Function under test (copied from main.c)
-bool send_to_http_queue(http_request_t* req, int priority, TickType_t wait_ticks)
+TEST_CASE("Stale telemetry expires at dispatch", "[http_queue]")
 {
-    if (priority > 0) {
-        UBaseType_t spaces = uxQueueSpacesAvailable(http_request_queue);
-        if (spaces < 3) {
-            http_request_t dummy;
-            for (int i = 0; i < 5 && spaces < 5; i++) {
-                if (xQueueReceive(http_request_queue, &dummy, 0) == pdTRUE) {
-                    spaces++;
-                } else {
-                    break;
-                }
-            }
-        }
-        return xQueueSend(http_request_queue, req, 300) == pdTRUE;
-    }
-    return xQueueSend(http_request_queue, req, wait_ticks) == pdTRUE;
+    setup_queue(2, 2, 4, 8, 1000);
+    push(HTTP_CLASS_TELEMETRY, "/api/sensor_data", 1, 0);
+    push(HTTP_CLASS_TELEMETRY, "/api/sensor_data", 2, 500);
+    push(HTTP_CLASS_TELEMETRY, "/api/sensor_data", 3, 1400);
+
+    int cls;
+    TEST_ASSERT_EQUAL_INT(3, pop_seq(&cls, 2000)); // seq 1 and 2 are older than 1000 ms
+    http_class_stats_t stats;
+    http_pqueue_get_stats(&queue, HTTP_CLASS_TELEMETRY, &stats);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.expired);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.dispatched);
+    http_pqueue_deinit(&queue);
 }
 
-// ---------------------- Tests -------------------------
-TEST_CASE("High priority request enqueued when queue space is low", "[http_queue]")
+TEST_CASE("Eviction policy under load keeps every control request", "[http_queue]")
 {
-    MockQueue q = { .capacity = 5, .count = 4 };
-    http_request_queue = &q;
+    // 40 slots shared, as in main.c, with a burst 10x larger than the queue
+    setup_queue(8, 16, 32, 40, 0);
+    int pushed[HTTP_CLASS_COUNT] = {0};
+    for (int i = 0; i < 400; i++) {
+        http_class_t cls = (i % 50 == 0) ? HTTP_CLASS_CONTROL
+                         : (i % 10 == 0) ? HTTP_CLASS_MESSAGE
+                         : HTTP_CLASS_TELEMETRY;
+        push(cls, "/api/any", i, i);
+        pushed[cls]++;
+    }
 
-    http_request_t req = {0};
-    strcpy(req.endpoint, "/api/test");
+    TEST_ASSERT_EQUAL_INT(40, http_pqueue_total(&queue));
+    TEST_ASSERT_EQUAL_INT(8, http_pqueue_count(&queue, HTTP_CLASS_CONTROL));
+    TEST_ASSERT_EQUAL_UINT32(0, http_pqueue_dropped(&queue, HTTP_CLASS_CONTROL));
 
-    bool ok = send_to_http_queue(&req, 10, 0);
-    TEST_ASSERT_TRUE(ok);
-    TEST_ASSERT_EQUAL_INT(1, q.count); // old items dropped and request enqueued
-}
+    // every push is either still queued or counted as a drop in its class
+    for (int c = 0; c < HTTP_CLASS_COUNT; c++) {
+        TEST_ASSERT_EQUAL_INT(pushed[c], http_pqueue_count(&queue, c) + http_pqueue_dropped(&queue, c));
+    }
 
-TEST_CASE("Low priority request fails when queue is full", "[http_queue]")
-{
-    MockQueue q = { .capacity = 3, .count = 3 };
-    http_request_queue = &q;
+    // dispatch order: all controls, then messages, then telemetry, FIFO and
+    // newest-wins within each class
+    int last_cls = HTTP_CLASS_CONTROL, last_seq = -1, cls, seq;
+    while ((seq = pop_seq(&cls, 1000)) >= 0) {
+        TEST_ASSERT_TRUE(cls >= last_cls);
+        if (cls == last_cls) TEST_ASSERT_TRUE(seq > last_seq);
+        last_cls = cls;
+        last_seq = seq;
+    }
+    TEST_ASSERT_EQUAL_INT(HTTP_CLASS_TELEMETRY, last_cls);
+    TEST_ASSERT_EQUAL_INT(399, last_seq);
+    http_pqueue_deinit(&queue);
+}
 
-    http_request_t req = {0};
-    strcpy(req.endpoint, "/api/test");
+static int drops_seen;
 
-    bool ok = send_to_http_queue(&req, 0, 0);
-    TEST_ASSERT_FALSE(ok);
-    TEST_ASSERT_EQUAL_INT(3, q.count); // queue unchanged
+static void count_drop(const void *item, void *ctx)
+{
+    drops_seen++;
 }
 
+TEST_CASE("Full never_evict control class refuses instead of dropping a control", "[http_queue]")
+{
+    const http_class_config_t config[HTTP_CLASS_COUNT] = {
+        [HTTP_CLASS_CONTROL]   = { .capacity = 2, .never_evict = true },
+        [HTTP_CLASS_MESSAGE]   = { .capacity = 2 },
+        [HTTP_CLASS_TELEMETRY] = { .capacity = 2 },
+    };
+    TEST_ASSERT_TRUE(http_pqueue_init(&queue, sizeof(test_item_t), config, 3));
+    drops_seen = 0;
+    http_pqueue_set_drop_cb(&queue, count_drop, NULL);
+    test_item_t req = {0};
+
+    // same control twice: the newer state replaces the queued one in place
+    snprintf(req.json_body, sizeof(req.json_body), "{\"seq\":%d}", 1);
+    TEST_ASSERT_EQUAL_INT(HTTP_PQ_ADDED, http_pqueue_push_keyed(&queue, HTTP_CLASS_CONTROL, &req, 11, 0));
+    snprintf(req.json_body, sizeof(req.json_body), "{\"seq\":%d}", 2);
+    TEST_ASSERT_EQUAL_INT(HTTP_PQ_ADDED, http_pqueue_push_keyed(&queue, HTTP_CLASS_CONTROL, &req, 22, 1));
+    snprintf(req.json_body, sizeof(req.json_body), "{\"seq\":%d}", 3);
+    TEST_ASSERT_EQUAL_INT(HTTP_PQ_COALESCED, http_pqueue_push_keyed(&queue, HTTP_CLASS_CONTROL, &req, 11, 2));
+    TEST_ASSERT_EQUAL_INT(2, http_pqueue_count(&queue, HTTP_CLASS_CONTROL));
+    TEST_ASSERT_EQUAL_INT(1, drops_seen);
+
+    // a third control finds the class full: it is refused, both queued stay
+    snprintf(req.json_body, sizeof(req.json_body), "{\"seq\":%d}", 4);
+    TEST_ASSERT_EQUAL_INT(HTTP_PQ_REJECTED, http_pqueue_push_keyed(&queue, HTTP_CLASS_CONTROL, &req, 33, 3));
+    TEST_ASSERT_EQUAL_INT(HTTP_PQ_REJECTED, http_pqueue_push(&queue, HTTP_CLASS_CONTROL, &req, 3));
+    TEST_ASSERT_EQUAL_INT(1, drops_seen);
+
+    // nor does a control free arena space at another control's expense
+    TEST_ASSERT_EQUAL_INT(-1, http_pqueue_evict(&queue, HTTP_CLASS_CONTROL));
+    push(HTTP_CLASS_TELEMETRY, "/api/sensor_data", 5, 4);
+    TEST_ASSERT_EQUAL_INT(HTTP_CLASS_TELEMETRY, http_pqueue_evict(&queue, HTTP_CLASS_CONTROL));
+
+    http_class_stats_t stats;
+    http_pqueue_get_stats(&queue, HTTP_CLASS_CONTROL, &stats);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.coalesced);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.rejected);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.evicted);
+
+    // the replacement kept the first one's place in line
+    int cls;
+    TEST_ASSERT_EQUAL_INT(3, pop_seq(&cls, 5));
+    TEST_ASSERT_EQUAL_INT(2, pop_seq(&cls, 5));
+    TEST_ASSERT_EQUAL_INT(-1, pop_seq(&cls, 5));
+    http_pqueue_deinit(&queue);
+}
@@ -0,0 +1,309 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "cJSON.h"
+#include "json_stream.h"
+#include "control_scan.h"
+
+#define PUMP_ID   446400104
+#define DEVICE_ID 4464001
+
+// Flattens the token stream so two parses can be compared
+typedef struct {
+    char text[1024];
+    size_t len;
+} token_log_t;
+
+static void log_token(const json_stream_token_t *tok, void *ctx)
+{
+    static const char *names[] = { "{", "}", "[", "]", "s", "n", "t", "f", "z" };
+    token_log_t *log = ctx;
+    log->len += snprintf(log->text + log->len, sizeof(log->text) - log->len, "%s%d:%s=%s%s;",
+                         names[tok->event], tok->depth, tok->key, tok->value, tok->truncated ? "~" : "");
+}
+
+static bool parse_chunked(const char *doc, size_t split, size_t chunk, token_log_t *log)
+{
+    json_stream_t js;
+    memset(log, 0, sizeof(*log));
+    json_stream_init(&js, log_token, log);
+    size_t len = strlen(doc);
+    bool ok = json_stream_feed(&js, doc, split);
+    for (size_t i = split; ok && i < len; i += chunk) {
+        ok = json_stream_feed(&js, doc + i, (len - i < chunk) ? len - i : chunk);
+    }
+    return json_stream_finish(&js) && ok;
+}
+
+// What handle_cloud_controls() used to do with the first 1 KB of the response
+static const char *legacy_strstr_state(const char *buf)
+{
+    char id[16];
+    snprintf(id, sizeof(id), "\"%d\"", PUMP_ID);
+    const char *p = strstr(buf, id);
+    if (p == NULL || strstr(p, "\"control_type\":\"switch\"") == NULL) return NULL;
+    const char *state = strstr(p, "\"state\":\"");
+    if (state == NULL) return NULL;
+    state += 9;
+    if (strncmp(state, "on\"", 3) == 0) return "on";
+    if (strncmp(state, "off\"", 4) == 0) return "off";
+    return NULL;
+}
+
+static void scan_chunked(control_scan_t *scan, const char *doc, size_t len, size_t chunk)
+{
+    control_scan_init(scan, PUMP_ID, DEVICE_ID);
+    for (size_t i = 0; i < len; i += chunk) {
+        control_scan_feed(doc + i, (int)((len - i < chunk) ? len - i : chunk), scan);
+    }
+}
+
+// entries controls, the pump last; every entry is about 150 bytes
+static char *make_controls(int entries, size_t *out_len)
+{
+    size_t size = (size_t)entries * 200 + 256;
+    char *buf = malloc(size);
+    TEST_ASSERT_NOT_NULL(buf);
+    size_t len = 0;
+    buf[len++] = '[';
+    for (int i = 0; i < entries; i++) {
+        bool pump = (i == entries - 1);
+        len += snprintf(buf + len, size - len,
+                        "%s{\"control_id\":\"%d\",\"device_id\":%d,\"control_type\":\"%s\","
+                        "\"state\":\"%s\",\"name\":\"Control \\\"%d\\\"\",\"meta\":{\"rev\":%d,\"tags\":[1,2.5,null]}}",
+                        i ? "," : "", pump ? PUMP_ID : 500000000 + i, 4470000 + i % 50,
+                        (pump || i % 3 == 0) ? "switch" : "slider", pump ? "off" : "on", i, i);
+    }
+    buf[len++] = ']';
+    buf[len] = '\0';
+    *out_len = len;
+    return buf;
+}
+
+TEST_CASE("Token stream does not depend on chunk boundaries", "[json_stream]")
+{
+    const char *doc = " {\"a\":[1,-2.5e3,true,false,null],\"b\\\"q\":\"x\\u00e9\\n\\/y\","
+                      "\"c\":{\"d\":{}},\"e\":[],\"f\":[{\"g\":0}]} ";
+    token_log_t whole, parts;
+    TEST_ASSERT_TRUE(parse_chunked(doc, strlen(doc), 1, &whole));
+    TEST_ASSERT_EQUAL_STRING("{1:=;[2:a=;n2:=1;n2:=-2.5e3;t2:=true;f2:=false;z2:=null;]2:=;"
+                             "s1:b\"q=x\xc3\xa9\n/y;{2:c=;{3:d=;}3:=;}2:=;[2:e=;]2:=;"
+                             "[2:f=;{3:=;n3:g=0;}3:=;]2:=;}1:=;", whole.text);
+
+    for (size_t split = 0; split <= strlen(doc); split++) {
+        TEST_ASSERT_TRUE(parse_chunked(doc, split, 1, &parts));
+        TEST_ASSERT_EQUAL_STRING(whole.text, parts.text);
+    }
+    TEST_ASSERT_TRUE(parse_chunked("42", 1, 1, &parts));
+    TEST_ASSERT_EQUAL_STRING("n0:=42;", parts.text);
+}
+
+TEST_CASE("Malformed JSON is rejected", "[json_stream]")
+{
+    const char *bad[] = {
+        "[1,]", "{\"a\" 1}", "[01]", "{\"a\":tru}", "[1]]", "[1}", "{\"a\":1,}",
+        "\"a\x01\"", "[\"\\x\"]", "[1 2]", "[-]", "[1.]", "{1:2}", "[", "", "[1] [2]",
+    };
+    token_log_t log;
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        TEST_ASSERT_FALSE(parse_chunked(bad[i], 0, 3, &log));
+    }
+}
+
+TEST_CASE("Long keys and values are truncated, not overrun", "[json_stream]")
+{
+    char doc[320];
+    char big[128];
+    memset(big, 'v', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+    snprintf(doc, sizeof(doc), "{\"%s\":\"%s\",\"k\":1}", big, big);
+    token_log_t log;
+    TEST_ASSERT_TRUE(parse_chunked(doc, 0, 7, &log));
+    TEST_ASSERT_NOT_NULL(strstr(log.text, "~;n1:k=1;"));
+}
+
+TEST_CASE("Control fields are matched within one entry", "[json_stream]")
+{
+    // Another switch mentions the pump id before the pump's own entry
+    const char *doc = "[{\"control_id\":\"446400110\",\"control_type\":\"switch\",\"linked\":\"446400104\",\"state\":\"on\"},"
+                      "{\"device_id\":4464001,\"dry_threshold\":2900,\"wet_threshold\":1400.0},"
+                      "{\"control_id\":446400104,\"control_type\":\"switch\",\"state\":\"off\",\"extra\":{\"state\":\"on\"}}]";
+    TEST_ASSERT_EQUAL_STRING("on", legacy_strstr_state(doc));
+
+    control_scan_t scan;
+    scan_chunked(&scan, doc, strlen(doc), 5);
+    TEST_ASSERT_TRUE(control_scan_finish(&scan));
+    TEST_ASSERT_EQUAL_UINT32(3, scan.entries);
+    TEST_ASSERT_TRUE(scan.pump_found);
+    TEST_ASSERT_TRUE(scan.pump_is_switch);
+    TEST_ASSERT_EQUAL_STRING("off", scan.pump_state);
+    TEST_ASSERT_TRUE(scan.thresholds_found);
+    TEST_ASSERT_EQUAL_INT(2900, scan.dry_threshold);
+    TEST_ASSERT_EQUAL_INT(1400, scan.wet_threshold);
+
+    // a retried request starts the scan over
+    control_scan_feed(NULL, 0, &scan);
+    control_scan_feed("[]", 2, &scan);
+    TEST_ASSERT_TRUE(control_scan_finish(&scan));
+    TEST_ASSERT_FALSE(scan.pump_found);
+    TEST_ASSERT_EQUAL_UINT32(0, scan.entries);
+}
+
+TEST_CASE("Thresholds outside the ADC range are rejected", "[json_stream]")
+{
+    const char *bad[] = {
+        "{\"device_id\":4464001,\"dry_threshold\":1e20,\"wet_threshold\":1400}",
+        "{\"device_id\":4464001,\"dry_threshold\":2900,\"wet_threshold\":-1}",
+        "{\"device_id\":4464001,\"dry_threshold\":4096,\"wet_threshold\":1400}",
+        "{\"device_id\":4464001,\"dry_threshold\":\"2900\",\"wet_threshold\":1400}",
+    };
+    control_scan_t scan;
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        scan_chunked(&scan, bad[i], strlen(bad[i]), 7);
+        TEST_ASSERT_TRUE(control_scan_finish(&scan));
+        TEST_ASSERT_TRUE(scan.device_found);
+        TEST_ASSERT_FALSE_MESSAGE(scan.thresholds_found, bad[i]);
+    }
+
+    const char *edge = "{\"device_id\":4464001,\"dry_threshold\":4095,\"wet_threshold\":0}";
+    scan_chunked(&scan, edge, strlen(edge), 7);
+    TEST_ASSERT_TRUE(control_scan_finish(&scan));
+    TEST_ASSERT_TRUE(scan.thresholds_found);
+    TEST_ASSERT_EQUAL_INT(4095, scan.dry_threshold);
+    TEST_ASSERT_EQUAL_INT(0, scan.wet_threshold);
+}
+
+TEST_CASE("Large controls response is scanned in constant memory", "[json_stream]")
+{
+    size_t len;
+    char *doc = make_controls(1000, &len);
+    TEST_ASSERT_TRUE(len > 100 * 1024);
+
+    control_scan_t scan;
+    scan_chunked(&scan, doc, len, 512);
+    TEST_ASSERT_TRUE(control_scan_finish(&scan));
+    TEST_ASSERT_EQUAL_UINT32(1000, scan.entries);
+    TEST_ASSERT_TRUE(scan.pump_found);
+    TEST_ASSERT_EQUAL_STRING("off", scan.pump_state);
+    TEST_ASSERT_FALSE(scan.device_found);
+    TEST_ASSERT_TRUE(sizeof(scan) < 512);
+
+    // the old 1 KB buffer never got as far as the pump
+    doc[1023] = '\0';
+    TEST_ASSERT_NULL(legacy_strstr_state(doc));
+    free(doc);
+}
+
+TEST_CASE("Pushed control message is applied once all fragments arrive", "[json_stream]")
+{
+    // MQTT_EVENT_DATA hands over long payloads in pieces; the scan is reused
+    // for every message without re-init
+    control_scan_t scan;
+    control_scan_init(&scan, PUMP_ID, DEVICE_ID);
+    const char *messages[] = {
+        "{\"control_id\":446400104,\"control_type\":\"switch\",\"state\":\"on\"}",
+        "{\"device_id\":4464001,\"dry_threshold\":3100,\"wet_threshold\":1900}",
+    };
+    for (int m = 0; m < 2; m++) {
+        size_t len = strlen(messages[m]);
+        control_scan_feed(NULL, 0, &scan);
+        for (size_t off = 0; off < len; off += 16) {
+            control_scan_feed(messages[m] + off, (int)((len - off < 16) ? len - off : 16), &scan);
+        }
+        TEST_ASSERT_TRUE(control_scan_finish(&scan));
+        TEST_ASSERT_EQUAL_UINT32(1, scan.entries);
+    }
+    // the second message replaced the first
+    TEST_ASSERT_FALSE(scan.pump_found);
+    TEST_ASSERT_TRUE(scan.thresholds_found);
+    TEST_ASSERT_EQUAL_INT(3100, scan.dry_threshold);
+}
+
+// cJSON allocations, for the peak heap of the tree
+static size_t cjson_live, cjson_peak;
+
+static void *counting_malloc(size_t size)
+{
+    size_t *p = malloc(size + sizeof(size_t));
+    if (p == NULL) return NULL;
+    *p = size;
+    cjson_live += size;
+    if (cjson_live > cjson_peak) cjson_peak = cjson_live;
+    return p + 1;
+}
+
+static void counting_free(void *ptr)
+{
+    if (ptr == NULL) return;
+    size_t *p = (size_t *)ptr - 1;
+    cjson_live -= *p;
+    free(p);
+}
+
+static const char *cjson_state(const char *doc)
+{
+    static char state[CONTROL_STATE_MAX];
+    const char *result = NULL;
+    cJSON *root = cJSON_Parse(doc);
+    cJSON *entry = NULL;
+    cJSON_ArrayForEach(entry, root) {
+        cJSON *id = cJSON_GetObjectItem(entry, "control_id");
+        if (!cJSON_IsString(id) || atol(id->valuestring) != PUMP_ID) continue;
+        cJSON *st = cJSON_GetObjectItem(entry, "state");
+        if (cJSON_IsString(st)) {
+            snprintf(state, sizeof(state), "%s", st->valuestring);
+            result = state;
+        }
+        break;
+    }
+    cJSON_Delete(root);
+    return result;
+}
+
+TEST_CASE("Controls parsing: streaming vs strstr vs cJSON", "[json_stream][bench]")
+{
+#ifdef ESP_PLATFORM
+    const int entries = 120;   // the cJSON tree has to fit in internal RAM
+#else
+    const int entries = 5000;
+#endif
+    const int rounds = 5;
+    size_t len;
+    char *doc = make_controls(entries, &len);
+
+    int64_t start = esp_timer_get_time();
+    for (int r = 0; r < rounds; r++) {
+        TEST_ASSERT_EQUAL_STRING("off", legacy_strstr_state(doc));
+    }
+    int64_t strstr_us = (esp_timer_get_time() - start) / rounds;
+
+    cJSON_Hooks hooks = { .malloc_fn = counting_malloc, .free_fn = counting_free };
+    cJSON_InitHooks(&hooks);
+    cjson_peak = 0;
+    start = esp_timer_get_time();
+    for (int r = 0; r < rounds; r++) {
+        TEST_ASSERT_EQUAL_STRING("off", cjson_state(doc));
+    }
+    int64_t cjson_us = (esp_timer_get_time() - start) / rounds;
+    cJSON_InitHooks(NULL);
+
+    control_scan_t scan;
+    start = esp_timer_get_time();
+    for (int r = 0; r < rounds; r++) {
+        scan_chunked(&scan, doc, len, 1460); // one TCP segment per HTTP_EVENT_ON_DATA
+        TEST_ASSERT_TRUE(control_scan_finish(&scan));
+        TEST_ASSERT_EQUAL_STRING("off", scan.pump_state);
+    }
+    int64_t stream_us = (esp_timer_get_time() - start) / rounds;
+
+    printf("%d entries, %u bytes\n", entries, (unsigned)len);
+    printf("strstr:    %7lld us  %6.1f MB/s  needs %u byte buffer, matches across entries\n",
+           (long long)strstr_us, len / (strstr_us ? (double)strstr_us : 1.0), (unsigned)len + 1);
+    printf("cJSON:     %7lld us  %6.1f MB/s  needs %u byte buffer + %u bytes of tree\n",
+           (long long)cjson_us, len / (cjson_us ? (double)cjson_us : 1.0), (unsigned)len + 1, (unsigned)cjson_peak);
+    printf("streaming: %7lld us  %6.1f MB/s  needs %u bytes\n",
+           (long long)stream_us, len / (stream_us ? (double)stream_us : 1.0), (unsigned)sizeof(scan));
+    free(doc);
+}
@@ -0,0 +1,167 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cJSON.h"
+#include "esp_timer.h"
+#include "metrics.h"
+
+static metrics_t reg;
+static const uint32_t ms_bounds[] = { 10, 100, 1000 };
+
+TEST_CASE("Metrics registry finds and adds series", "[metrics]")
+{
+    metrics_init(&reg);
+    metric_t *sent = metrics_counter(&reg, "http_requests_total", "Requests", "result", "ok");
+    metric_t *failed = metrics_counter(&reg, "http_requests_total", "Requests", "result", "failed");
+    TEST_ASSERT_NOT_NULL(sent);
+    TEST_ASSERT_NOT_NULL(failed);
+    TEST_ASSERT_NOT_EQUAL(sent, failed);
+    TEST_ASSERT_EQUAL_PTR(sent, metrics_counter(&reg, "http_requests_total", "Requests", "result", "ok"));
+
+    // one type and one label per name
+    TEST_ASSERT_NULL(metrics_gauge(&reg, "http_requests_total", NULL, "result", "ok"));
+    TEST_ASSERT_NULL(metrics_counter(&reg, "http_requests_total", NULL, NULL, NULL));
+    TEST_ASSERT_NULL(metrics_histogram(&reg, "too_many_buckets", NULL, NULL, NULL, ms_bounds, METRICS_HIST_BUCKETS + 1));
+    TEST_ASSERT_EQUAL(2, metrics_refused(&reg));
+
+    metrics_add(sent, 3);
+    metrics_add(sent, 2);
+    metrics_add(NULL, 1);       // a full table hands out NULL; updates ignore it
+    TEST_ASSERT_EQUAL_FLOAT(5, metrics_value(sent));
+    metrics_set_total(failed, 7);     // total kept elsewhere
+    TEST_ASSERT_EQUAL_FLOAT(7, metrics_value(failed));
+    char text[512];
+    metrics_set_total(failed, 16777217);    // 2^24 + 1, not a float
+    metrics_format(&reg, METRICS_TEXT, text, sizeof(text));
+    TEST_ASSERT_NOT_NULL(strstr(text, "http_requests_total{result=\"failed\"} 16777217\n"));
+
+    metric_t *g = metrics_gauge(&reg, "heap_fragmentation_percent", NULL, NULL, NULL);
+    metrics_set(g, 12.5f);
+    TEST_ASSERT_EQUAL_FLOAT(12.5f, metrics_value(g));
+
+    metrics_init(&reg);
+    char name[METRICS_MAX + 1][8];
+    for (int i = 0; i < METRICS_MAX; i++) {
+        snprintf(name[i], sizeof(name[i]), "m%d", i);
+        TEST_ASSERT_NOT_NULL(metrics_gauge(&reg, name[i], NULL, NULL, NULL));
+    }
+    TEST_ASSERT_EQUAL(0, metrics_refused(&reg));
+    TEST_ASSERT_NULL(metrics_gauge(&reg, "one_more", NULL, NULL, NULL));
+    TEST_ASSERT_EQUAL(1, metrics_refused(&reg));
+    TEST_ASSERT_NOT_NULL(metrics_gauge(&reg, "m0", NULL, NULL, NULL));
+}
+
+TEST_CASE("Metrics histogram buckets", "[metrics]")
+{
+    metrics_init(&reg);
+    metric_t *h = metrics_histogram(&reg, "upload_ms", NULL, NULL, NULL, ms_bounds, 3);
+    const uint32_t values[] = { 0, 10, 11, 100, 999, 1000, 1001, 60000 };
+    for (int i = 0; i < 8; i++) metrics_observe(h, values[i]);
+    TEST_ASSERT_EQUAL_UINT32(2, atomic_load(&h->buckets[0]));   // <= 10
+    TEST_ASSERT_EQUAL_UINT32(2, atomic_load(&h->buckets[1]));   // <= 100
+    TEST_ASSERT_EQUAL_UINT32(2, atomic_load(&h->buckets[2]));   // <= 1000
+    TEST_ASSERT_EQUAL_UINT32(2, atomic_load(&h->buckets[3]));   // +Inf
+    TEST_ASSERT_EQUAL_UINT32(8, atomic_load(&h->count));
+    TEST_ASSERT_EQUAL_UINT32(0 + 10 + 11 + 100 + 999 + 1000 + 1001 + 60000, atomic_load(&h->sum));
+}
+
+static void fill(void)
+{
+    metrics_init(&reg);
+    metrics_add(metrics_counter(&reg, "uart_packets_total", "Uno packets", NULL, NULL), 42);
+    metrics_set(metrics_gauge(&reg, "task_cpu_percent", "CPU", "task", "main"), 1.5f);
+    metrics_histogram(&reg, "upload_ms", NULL, NULL, NULL, ms_bounds, 3);
+    metrics_set(metrics_gauge(&reg, "task_cpu_percent", "CPU", "task", "IDLE0"), 97);
+    metrics_observe(metrics_histogram(&reg, "upload_ms", NULL, NULL, NULL, ms_bounds, 3), 50);
+}
+
+TEST_CASE("Metrics text exposition", "[metrics]")
+{
+    fill();
+    char buf[1024];
+    int len = metrics_format(&reg, METRICS_TEXT, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL(strlen(buf), len);
+    // series of one name together, even when registered apart
+    TEST_ASSERT_EQUAL_STRING(
+        "# HELP uart_packets_total Uno packets\n"
+        "# TYPE uart_packets_total counter\n"
+        "uart_packets_total 42\n"
+        "# HELP task_cpu_percent CPU\n"
+        "# TYPE task_cpu_percent gauge\n"
+        "task_cpu_percent{task=\"main\"} 1.5\n"
+        "task_cpu_percent{task=\"IDLE0\"} 97\n"
+        "# TYPE upload_ms histogram\n"
+        "upload_ms_bucket{le=\"10\"} 0\n"
+        "upload_ms_bucket{le=\"100\"} 1\n"
+        "upload_ms_bucket{le=\"1000\"} 1\n"
+        "upload_ms_bucket{le=\"+Inf\"} 1\n"
+        "upload_ms_sum 50\n"
+        "upload_ms_count 1\n", buf);
+
+    // truncated output still reports the full length
+    char small[40];
+    TEST_ASSERT_EQUAL(len, metrics_format(&reg, METRICS_TEXT, small, sizeof(small)));
+    TEST_ASSERT_EQUAL(sizeof(small) - 1, strlen(small));
+    TEST_ASSERT_EQUAL(len, metrics_format(&reg, METRICS_TEXT, NULL, 0));
+}
+
+TEST_CASE("Metrics JSON snapshot", "[metrics]")
+{
+    fill();
+    char buf[512];
+    metrics_format(&reg, METRICS_JSON, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("{\"uart_packets_total\":42,\"task_cpu_percent\":{\"main\":1.5,\"IDLE0\":97},"
+                             "\"upload_ms\":{\"le\":[10,100,1000],\"buckets\":[0,1,0,0],\"count\":1,\"sum\":50}}", buf);
+    cJSON *root = cJSON_Parse(buf);
+    TEST_ASSERT_NOT_NULL(root);
+    cJSON *cpu = cJSON_GetObjectItem(root, "task_cpu_percent");
+    TEST_ASSERT_EQUAL_FLOAT(97, cJSON_GetObjectItem(cpu, "IDLE0")->valuedouble);
+    cJSON_Delete(root);
+
+    int len;
+    char *full = metrics_format_alloc(&reg, METRICS_JSON, &len);
+    TEST_ASSERT_NOT_NULL(full);
+    TEST_ASSERT_EQUAL(strlen(buf), len);
+    TEST_ASSERT_EQUAL_STRING(buf, full);
+    free(full);
+
+    metrics_init(&reg);
+    TEST_ASSERT_EQUAL(2, metrics_format(&reg, METRICS_JSON, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_STRING("{}", buf);
+}
+
+TEST_CASE("Metrics update and snapshot cost", "[metrics][bench]")
+{
+    static const uint32_t us_bounds[] = { 100, 500, 1000, 5000, 10000, 50000, 100000, 500000 };
+    metrics_init(&reg);
+    metric_t *c = metrics_counter(&reg, "mqtt_published_total", NULL, "topic", "iot/temperature");
+    metric_t *h = metrics_histogram(&reg, "sensor_exec_us", NULL, NULL, NULL, us_bounds, 8);
+    const int n = 100000;
+
+    int64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < n; i++) metrics_add(c, 1);
+    int64_t t1 = esp_timer_get_time();
+    for (int i = 0; i < n; i++) metrics_observe(h, (uint32_t)i * 7);
+    int64_t t2 = esp_timer_get_time();
+    printf("counter add %.0f ns, histogram observe %.0f ns\n", (t1 - t0) * 1000.0 / n, (t2 - t1) * 1000.0 / n);
+
+    // about what main.c registers: 12 tasks x 2, 12 sensors x 2, a dozen more
+    char label[8];
+    for (int i = 0; i < 48; i++) {
+        snprintf(label, sizeof(label), "t%d", i / 2);
+        metrics_set(metrics_gauge(&reg, i % 2 ? "task_cpu_percent" : "task_stack_free_bytes", NULL, "task", label), i);
+    }
+    char *buf = malloc(8192);
+    TEST_ASSERT_NOT_NULL(buf);
+    const metrics_format_t formats[] = { METRICS_TEXT, METRICS_JSON };
+    for (int f = 0; f < 2; f++) {
+        int64_t s = esp_timer_get_time();
+        int len = 0;
+        for (int i = 0; i < 100; i++) len = metrics_format(&reg, formats[f], buf, 8192);
+        printf("%s snapshot of %d series: %d bytes, %lld us\n", f ? "JSON" : "text", atomic_load(&reg.count), len,
+               (long long)(esp_timer_get_time() - s) / 100);
+        TEST_ASSERT_LESS_THAN(8192, len);
+    }
+    free(buf);
+}
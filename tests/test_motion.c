@@ -0,0 +1,218 @@
+#include "unity.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "motion_detector.h"
+
+#define MS 1000LL
+
+static motion_event_t events[64];
+static int event_count;
+
+static void feed(motion_detector_t *d, int64_t t_us, uint8_t level)
+{
+    motion_edge_t e = { t_us, level };
+    motion_event_t ev;
+    if (motion_detector_poll(d, t_us, &ev)) events[event_count++] = ev;
+    if (motion_detector_edge(d, &e, &ev)) events[event_count++] = ev;
+}
+
+static void advance(motion_detector_t *d, int64_t now_us)
+{
+    motion_event_t ev;
+    if (motion_detector_poll(d, now_us, &ev)) events[event_count++] = ev;
+}
+
+TEST_CASE("Motion edge ring order, overflow and wrap", "[motion]")
+{
+    static motion_edge_ring_t r;
+    motion_edge_t e;
+    motion_edge_ring_init(&r);
+    TEST_ASSERT_FALSE(motion_edge_pop(&r, &e));
+
+    for (int i = 0; i < MOTION_EDGE_RING; i++) TEST_ASSERT_TRUE(motion_edge_push(&r, i, i & 1));
+    TEST_ASSERT_FALSE(motion_edge_push(&r, 999, 1));
+    TEST_ASSERT_EQUAL(1, atomic_load(&r.dropped));
+    for (int i = 0; i < MOTION_EDGE_RING; i++) {
+        TEST_ASSERT_TRUE(motion_edge_pop(&r, &e));
+        TEST_ASSERT_EQUAL(i, e.t_us);
+        TEST_ASSERT_EQUAL(i & 1, e.level);
+    }
+    TEST_ASSERT_FALSE(motion_edge_pop(&r, &e));
+
+    // indices run on past the ring size many times
+    for (int i = 0; i < 10000; i++) {
+        TEST_ASSERT_TRUE(motion_edge_push(&r, i, 1));
+        if (i % 3 == 0) TEST_ASSERT_TRUE(motion_edge_push(&r, -i, 0));
+        TEST_ASSERT_TRUE(motion_edge_pop(&r, &e));
+        TEST_ASSERT_EQUAL(i, e.t_us);
+        if (i % 3 == 0) {
+            TEST_ASSERT_TRUE(motion_edge_pop(&r, &e));
+            TEST_ASSERT_EQUAL(-i, e.t_us);
+        }
+    }
+    TEST_ASSERT_EQUAL(1, atomic_load(&r.dropped));
+}
+
+TEST_CASE("Motion episodes with hold and glitch filter", "[motion]")
+{
+    motion_detector_t d;
+    const motion_config_t cfg = { .min_high_ms = 10, .hold_ms = 3000 };
+    event_count = 0;
+    motion_detector_init(&d, &cfg, 0, 0);
+    TEST_ASSERT_EQUAL(-1, motion_detector_deadline(&d));
+
+    // 4 ms spike: not motion
+    feed(&d, 100 * MS, 1);
+    TEST_ASSERT_EQUAL(110 * MS, motion_detector_deadline(&d));
+    feed(&d, 104 * MS, 0);
+    TEST_ASSERT_EQUAL(0, event_count);
+    TEST_ASSERT_EQUAL(1, d.glitches);
+
+    // real trigger: starts at the rise, decided 10 ms later
+    feed(&d, 1000 * MS, 1);
+    advance(&d, 1009 * MS);
+    TEST_ASSERT_EQUAL(0, event_count);
+    advance(&d, 1010 * MS);
+    TEST_ASSERT_EQUAL(1, event_count);
+    TEST_ASSERT_EQUAL(MOTION_START, events[0].change);
+    TEST_ASSERT_EQUAL(1000 * MS, events[0].t_us);
+    TEST_ASSERT_EQUAL(1010 * MS, events[0].decided_us);
+
+    // output falls after 2.5 s, retriggers 1 s later: still one episode
+    feed(&d, 3500 * MS, 0);
+    TEST_ASSERT_EQUAL(6500 * MS, motion_detector_deadline(&d));
+    feed(&d, 4500 * MS, 1);
+    TEST_ASSERT_EQUAL(-1, motion_detector_deadline(&d));
+    feed(&d, 7000 * MS, 0);
+    advance(&d, 9999 * MS);
+    TEST_ASSERT_EQUAL(1, event_count);
+    advance(&d, 10000 * MS);
+    TEST_ASSERT_EQUAL(2, event_count);
+    TEST_ASSERT_EQUAL(MOTION_END, events[1].change);
+    TEST_ASSERT_EQUAL(10000 * MS, events[1].t_us);
+    TEST_ASSERT_EQUAL(9000, events[1].duration_ms);
+    TEST_ASSERT_EQUAL(1, d.episodes);
+    TEST_ASSERT_EQUAL(1, d.glitches);
+
+    // edges read late from the ring: the poll with each edge's time decides
+    // in the right order, and a repeated level (lost edge) changes nothing
+    feed(&d, 20000 * MS, 1);
+    feed(&d, 20500 * MS, 0);
+    feed(&d, 20600 * MS, 0);
+    feed(&d, 30000 * MS, 1);
+    TEST_ASSERT_EQUAL(4, event_count);
+    TEST_ASSERT_EQUAL(MOTION_START, events[2].change);
+    TEST_ASSERT_EQUAL(20000 * MS, events[2].t_us);
+    TEST_ASSERT_EQUAL(20500 * MS, events[2].decided_us);
+    TEST_ASSERT_EQUAL(MOTION_END, events[3].change);
+    TEST_ASSERT_EQUAL(23500 * MS, events[3].t_us);
+    TEST_ASSERT_EQUAL(3500, events[3].duration_ms);
+    advance(&d, 30010 * MS);
+    TEST_ASSERT_EQUAL(5, event_count);
+    TEST_ASSERT_EQUAL(MOTION_START, events[4].change);
+    TEST_ASSERT_EQUAL(30000 * MS, events[4].t_us);
+}
+
+TEST_CASE("Motion without glitch filter starts on the edge", "[motion]")
+{
+    motion_detector_t d;
+    const motion_config_t cfg = { .min_high_ms = 0, .hold_ms = 0 };
+    event_count = 0;
+    motion_detector_init(&d, &cfg, 0, 0);
+    feed(&d, 5 * MS, 1);
+    TEST_ASSERT_EQUAL(1, event_count);
+    TEST_ASSERT_EQUAL(5 * MS, events[0].decided_us);
+    feed(&d, 6 * MS, 0);
+    advance(&d, 6 * MS);
+    TEST_ASSERT_EQUAL(2, event_count);
+    TEST_ASSERT_EQUAL(MOTION_END, events[1].change);
+    TEST_ASSERT_EQUAL(1, events[1].duration_ms);
+}
+
+static uint32_t seed = 11;
+
+static uint32_t rnd(uint32_t n)
+{
+    seed = seed * 1103515245u + 12345u;
+    return (seed >> 8) % n;
+}
+
+TEST_CASE("Motion latency: edge interrupts vs 2 s polling", "[motion][bench]")
+{
+    // An hour of radar output. Most triggers hold the output high 2-3 s
+    // like the RCWL-0516; one in four is a short 20-150 ms blip.
+    enum { EPISODES = 600 };
+    static int64_t rise[EPISODES], fall[EPISODES];
+    int64_t t = 0;
+    for (int i = 0; i < EPISODES; i++) {
+        t += (1000 + rnd(8000)) * MS;
+        rise[i] = t;
+        t += (rnd(4) == 0 ? 20 + rnd(130) : 2000 + rnd(1000)) * MS;
+        fall[i] = t;
+    }
+
+    // Old loop: every 2 s, five reads 10 ms apart, motion if 4 are high
+    int detected = 0;
+    int64_t poll_latency_sum = 0, poll_latency_max = 0;
+    int e = 0;
+    for (int64_t poll = 0; poll < t && e < EPISODES; poll += 2000 * MS + 50 * MS) {
+        while (e < EPISODES && fall[e] < poll) e++;   // over before this poll
+        if (e >= EPISODES) break;
+        int high = 0;
+        for (int k = 0; k < 5; k++) {
+            int64_t at = poll + k * 10 * MS;
+            high += at >= rise[e] && at < fall[e];
+        }
+        if (high >= 4) {
+            int64_t lat = poll + 40 * MS - rise[e];
+            poll_latency_sum += lat;
+            if (lat > poll_latency_max) poll_latency_max = lat;
+            detected++;
+            e++;
+        }
+    }
+
+    // Interrupts: every edge goes through the ring and the detector
+    static motion_edge_ring_t ring;
+    motion_edge_ring_init(&ring);
+    motion_detector_t d;
+    const motion_config_t cfg = { .min_high_ms = 10, .hold_ms = 0 };
+    motion_detector_init(&d, &cfg, 0, 0);
+    int starts = 0;
+    int64_t lat_sum = 0, lat_max = 0;
+    motion_edge_t edge;
+    motion_event_t ev[3];
+    int64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < EPISODES; i++) {
+        for (int k = 0; k < 2; k++) {
+            int64_t at = k ? fall[i] : rise[i];
+            // the task wakes on the detector deadline if it comes first
+            int64_t deadline = motion_detector_deadline(&d);
+            int n = 0;
+            if (deadline >= 0 && deadline <= at) n += motion_detector_poll(&d, deadline, &ev[n]);
+            motion_edge_push(&ring, at, !k);
+            while (motion_edge_pop(&ring, &edge)) {
+                n += motion_detector_poll(&d, edge.t_us, &ev[n]);
+                n += motion_detector_edge(&d, &edge, &ev[n]);
+            }
+            for (int j = 0; j < n; j++) {
+                if (ev[j].change != MOTION_START) continue;
+                int64_t lat = ev[j].decided_us - ev[j].t_us;
+                lat_sum += lat;
+                if (lat > lat_max) lat_max = lat;
+                starts++;
+            }
+        }
+    }
+    int64_t us = esp_timer_get_time() - t0;
+
+    printf("%d episodes in %.0f min\n", EPISODES, t / 60e6);
+    printf("polling:    %3d detected, latency avg %4lld ms max %4lld ms, loop blocked 50 ms every 2 s\n",
+           detected, (long long)(poll_latency_sum / (detected ? detected : 1) / 1000),
+           (long long)(poll_latency_max / 1000));
+    printf("interrupts: %3d detected, latency avg %4lld ms max %4lld ms (+ task wakeup), %.0f ns per edge\n",
+           starts, (long long)(lat_sum / starts / 1000), (long long)(lat_max / 1000), us * 1000.0 / (2 * EPISODES));
+    TEST_ASSERT_EQUAL(EPISODES, starts);
+    TEST_ASSERT_LESS_THAN(EPISODES, detected);
+}
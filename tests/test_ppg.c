@@ -0,0 +1,136 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "esp_timer.h"
+#include "ppg_traces.h"
+#include "spo2_algorithm.h"
+
+TEST_CASE("PPG window gives the reference result for every window", "[ppg]")
+{
+    static ppg_window_t w;
+    for (size_t t = 0; t < ppg_trace_count; t++) {
+        ppg_make_trace(&ppg_traces[t]);
+        ppg_window_init(&w, 1);
+        int compared = 0;
+        for (int i = 0; i < PPG_TRACE_LEN; i++) {
+            ppg_result_t got, want;
+            bool due = ppg_window_push(&w, ppg_ir_trace[i], ppg_red_trace[i], &got);
+            TEST_ASSERT_EQUAL(i >= PPG_WINDOW - 1, due);
+            if (!due) continue;
+            ppg_reference(&ppg_ir_trace[i + 1 - PPG_WINDOW], &ppg_red_trace[i + 1 - PPG_WINDOW], &want);
+            TEST_ASSERT_EQUAL_MESSAGE(want.hr_valid, got.hr_valid, ppg_traces[t].name);
+            TEST_ASSERT_EQUAL_MESSAGE(want.heart_rate, got.heart_rate, ppg_traces[t].name);
+            TEST_ASSERT_EQUAL_MESSAGE(want.spo2_valid, got.spo2_valid, ppg_traces[t].name);
+            TEST_ASSERT_EQUAL_MESSAGE(want.spo2, got.spo2, ppg_traces[t].name);
+            compared++;
+        }
+        TEST_ASSERT_EQUAL(PPG_TRACE_LEN - PPG_WINDOW + 1, compared);
+    }
+}
+
+TEST_CASE("PPG window hop and reset", "[ppg]")
+{
+    static ppg_window_t w;
+    ppg_result_t r;
+    ppg_make_trace(&ppg_traces[0]);
+    ppg_window_init(&w, PPG_RATE_HZ);
+    TEST_ASSERT_FALSE(ppg_window_evaluate(&w, &r));
+
+    int results = 0;
+    for (int i = 0; i < 500; i++) {
+        if (ppg_window_push(&w, ppg_ir_trace[i], ppg_red_trace[i], &r)) {
+            results++;
+            TEST_ASSERT_EQUAL(0, (i + 1) % PPG_RATE_HZ);
+        }
+    }
+    TEST_ASSERT_EQUAL((500 - PPG_WINDOW) / PPG_RATE_HZ + 1, results);
+    TEST_ASSERT_INT_WITHIN(3000, 108000, r.ir_mean);
+
+    // after a gap the window refills before the next result
+    ppg_window_reset(&w);
+    for (int i = 0; i < PPG_WINDOW - 1; i++) TEST_ASSERT_FALSE(ppg_window_push(&w, ppg_ir_trace[i], ppg_red_trace[i], &r));
+    TEST_ASSERT_FALSE(ppg_window_evaluate(&w, &r));
+    ppg_window_push(&w, ppg_ir_trace[PPG_WINDOW - 1], ppg_red_trace[PPG_WINDOW - 1], &r);
+    TEST_ASSERT_TRUE(ppg_window_evaluate(&w, &r));
+}
+
+static int cmp_int(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+TEST_CASE("PPG accuracy on synthetic traces", "[ppg]")
+{
+    static ppg_window_t w;
+    static int hr[PPG_TRACE_LEN], spo2[PPG_TRACE_LEN];
+    printf("%-18s %7s %7s %6s %4s %7s %8s %4s\n", "trace", "results", "HR ok", "HR med", "want",
+           "SpO2 ok", "SpO2 med", "want");
+    for (size_t t = 0; t < ppg_trace_count; t++) {
+        const ppg_trace_t *tr = &ppg_traces[t];
+        ppg_make_trace(tr);
+        ppg_window_init(&w, PPG_RATE_HZ);
+        int results = 0, nhr = 0, nspo2 = 0;
+        for (int i = 0; i < PPG_TRACE_LEN; i++) {
+            ppg_result_t r;
+            if (!ppg_window_push(&w, ppg_ir_trace[i], ppg_red_trace[i], &r)) continue;
+            results++;
+            TEST_ASSERT_EQUAL_MESSAGE(tr->bpm > 0, r.ir_mean >= PPG_FINGER_IR, tr->name);
+            if (r.hr_valid) hr[nhr++] = r.heart_rate;
+            if (r.spo2_valid) spo2[nspo2++] = r.spo2;
+        }
+        qsort(hr, nhr, sizeof(int), cmp_int);
+        qsort(spo2, nspo2, sizeof(int), cmp_int);
+        int hr_med = nhr ? hr[nhr / 2] : -1, spo2_med = nspo2 ? spo2[nspo2 / 2] : -1;
+        int want_spo2 = tr->bpm > 0 ? uch_spo2_table[(int)(tr->ratio * 100)] : 0;
+        printf("%-18s %7d %6d%% %6d %4d %6d%% %8d %4d\n", tr->name, results, 100 * nhr / results, hr_med,
+               (int)tr->bpm, 100 * nspo2 / results, spo2_med, want_spo2);
+        if (tr->bpm > 0 && tr->motion == 0) {
+            TEST_ASSERT_INT_WITHIN_MESSAGE(tr->bpm / 10, (int)tr->bpm, hr_med, tr->name);
+            // the Maxim ratio is rough (it reads the IR AC at the red peak and
+            // has few samples per beat at high rates), so only check it reads
+            TEST_ASSERT_GREATER_OR_EQUAL(results * 9 / 10, nspo2);
+            TEST_ASSERT_INT_WITHIN_MESSAGE(20, 90, spo2_med, tr->name);
+        }
+    }
+}
+
+TEST_CASE("PPG cost: incremental window vs shifting buffer", "[ppg][bench]")
+{
+    static ppg_window_t w;
+    ppg_make_trace(&ppg_traces[1]);
+    const int rounds = 10;
+    volatile int32_t sink = 0;
+
+    int64_t start = esp_timer_get_time();
+    int ref_results = ppg_shift_recompute(rounds, &sink);
+    int64_t ref_us = esp_timer_get_time() - start;
+
+    const uint32_t hops[] = { PPG_RATE_HZ, 5, 1 };
+    int64_t win_us[3];
+    int win_results[3];
+    for (int h = 0; h < 3; h++) {
+        win_results[h] = 0;
+        start = esp_timer_get_time();
+        for (int r = 0; r < rounds; r++) {
+            ppg_window_init(&w, hops[h]);
+            for (int i = 0; i < PPG_TRACE_LEN; i++) {
+                ppg_result_t res;
+                if (ppg_window_push(&w, ppg_ir_trace[i], ppg_red_trace[i], &res)) {
+                    sink += res.spo2 + res.heart_rate;
+                    win_results[h]++;
+                }
+            }
+        }
+        win_us[h] = esp_timer_get_time() - start;
+    }
+    (void)sink;
+
+    double seconds = rounds * (double)PPG_TRACE_LEN / PPG_RATE_HZ;
+    printf("shift + recompute, 1 result/s:  %6.2f us per result, %7.1f us per second of signal\n",
+           (double)ref_us / ref_results, ref_us / seconds);
+    for (int h = 0; h < 3; h++) {
+        printf("window, %2d results/s:          %6.2f us per result, %7.1f us per second of signal\n",
+               (int)(PPG_RATE_HZ / hops[h]), (double)win_us[h] / win_results[h], win_us[h] / seconds);
+    }
+    TEST_ASSERT_EQUAL(ref_results, win_results[0]);
+}
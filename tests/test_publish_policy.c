@@ -0,0 +1,140 @@
+#include "unity.h"
+#include <math.h>
+#include <stdio.h>
+#include "publish_policy.h"
+
+static publish_topic_t topics[] = {
+    { "iot/temperature", { .qos = 0, .change_only = true, .deadband = 0.3f, .min_interval_ms = 10000, .max_interval_ms = 300000 } },
+    { "iot/pump",        { .qos = 1, .retain = true, .change_only = true, .max_interval_ms = 300000 } },
+    { "iot/heart_rate",  { .qos = 0 } },
+};
+enum { TEMP, PUMP, HEART };
+
+TEST_CASE("Publish policy applies deadband and intervals", "[publish_policy]")
+{
+    publish_table_t table;
+    publish_table_init(&table, topics, 3);
+
+    TEST_ASSERT_TRUE(publish_policy_check(&table, TEMP, 25.0f, 0));        // first reading always goes
+    TEST_ASSERT_FALSE(publish_policy_check(&table, TEMP, 30.0f, 2000));    // inside min interval
+    TEST_ASSERT_FALSE(publish_policy_check(&table, TEMP, 25.2f, 12000));   // inside deadband
+    TEST_ASSERT_TRUE(publish_policy_check(&table, TEMP, 25.4f, 14000));
+    TEST_ASSERT_FALSE(publish_policy_check(&table, TEMP, 25.5f, 20000));   // measured from 25.4
+    TEST_ASSERT_TRUE(publish_policy_check(&table, TEMP, 25.4f, 314000));   // refresh after max interval
+    TEST_ASSERT_EQUAL(3, topics[TEMP].stats.suppressed);
+
+    // change only, no deadband: any change, no repeats
+    TEST_ASSERT_TRUE(publish_policy_check(&table, PUMP, 0, 0));
+    TEST_ASSERT_FALSE(publish_policy_check(&table, PUMP, 0, 2000));
+    TEST_ASSERT_TRUE(publish_policy_check(&table, PUMP, 1, 4000));
+    TEST_ASSERT_FALSE(publish_policy_check(&table, PUMP, 1, 6000));
+
+    // default policy sends everything
+    for (uint32_t t = 0; t < 10; t++) {
+        TEST_ASSERT_TRUE(publish_policy_check(&table, HEART, 72, t));
+    }
+    TEST_ASSERT_FALSE(publish_policy_check(&table, 3, 0, 0));              // unknown topic
+
+    // tick counter wrap does not stall a topic
+    publish_table_init(&table, topics, 3);
+    TEST_ASSERT_TRUE(publish_policy_check(&table, TEMP, 25.0f, UINT32_MAX - 1000));
+    TEST_ASSERT_TRUE(publish_policy_check(&table, TEMP, 26.0f, 10000));
+}
+
+TEST_CASE("Publish policy counts acks per topic", "[publish_policy]")
+{
+    publish_table_t table;
+    publish_table_init(&table, topics, 3);
+
+    publish_policy_published(&table, PUMP, 11);
+    publish_policy_published(&table, PUMP, 12);
+    publish_policy_published(&table, HEART, 0);   // QoS 0, nothing to wait for
+    TEST_ASSERT_EQUAL(PUMP, publish_policy_acked(&table, 12));
+    TEST_ASSERT_EQUAL(-1, publish_policy_acked(&table, 12));   // duplicate
+    TEST_ASSERT_EQUAL(-1, publish_policy_acked(&table, 99));
+    TEST_ASSERT_EQUAL(PUMP, publish_policy_failed(&table, 11));
+    TEST_ASSERT_EQUAL(2, topics[PUMP].stats.published);
+    TEST_ASSERT_EQUAL(1, topics[PUMP].stats.acked);
+    TEST_ASSERT_EQUAL(1, topics[PUMP].stats.failed);
+    TEST_ASSERT_EQUAL(1, topics[HEART].stats.published);
+    TEST_ASSERT_EQUAL(0, topics[HEART].stats.acked);
+
+    // only the newest PUBLISH_PENDING_MAX ids are remembered
+    for (int id = 100; id < 100 + PUBLISH_PENDING_MAX + 4; id++) {
+        publish_policy_published(&table, TEMP, id);
+    }
+    TEST_ASSERT_EQUAL(-1, publish_policy_acked(&table, 100));
+    TEST_ASSERT_EQUAL(TEMP, publish_policy_acked(&table, 100 + PUBLISH_PENDING_MAX + 3));
+}
+
+// Same policies as publish_topics[] in main.c
+static publish_topic_t device_topics[] = {
+    { "iot/light",       { .qos = 0, .change_only = true, .deadband = 50,    .max_interval_ms = 60000 } },
+    { "iot/motion",      { .qos = 1, .change_only = true, .max_interval_ms = 60000 } },
+    { "iot/current",     { .qos = 0, .change_only = true, .deadband = 0.05f, .max_interval_ms = 60000 } },
+    { "iot/temperature", { .qos = 0, .change_only = true, .deadband = 0.3f,  .min_interval_ms = 10000, .max_interval_ms = 300000 } },
+    { "iot/humidity",    { .qos = 0, .change_only = true, .deadband = 1.0f,  .min_interval_ms = 10000, .max_interval_ms = 300000 } },
+    { "iot/moisture",    { .qos = 0, .change_only = true, .deadband = 20,    .max_interval_ms = 60000 } },
+    { "iot/pump",        { .qos = 1, .retain = true, .change_only = true, .max_interval_ms = 300000 } },
+};
+#define DEVICE_TOPICS (int)(sizeof(device_topics) / sizeof(device_topics[0]))
+
+static uint32_t rng = 4464001;
+static float noise(float amplitude)
+{
+    rng = rng * 1664525u + 1013904223u;
+    return amplitude * ((rng >> 8) / 8388608.0f - 1.0f);
+}
+
+TEST_CASE("Publish volume over a simulated hour", "[publish_policy][bench]")
+{
+    publish_table_t table;
+    publish_table_init(&table, device_topics, DEVICE_TOPICS);
+
+    // second_loop_task timing: light/motion/current/DHT every 2 s, soil every 1.5 s
+    const uint32_t hour_ms = 3600 * 1000;
+    int baseline = 0, baseline_acks = 0;
+    float moisture = 2200;
+    bool pump = false;
+    for (uint32_t now = 0; now < hour_ms; now += 500) {
+        float values[DEVICE_TOPICS];
+        bool due[DEVICE_TOPICS] = { false };
+        if (now % 2000 == 0) {
+            float minute = now / 60000.0f;
+            values[0] = roundf(2500 + 300 * sinf(minute / 20) + noise(15));   // light
+            values[1] = (now / 1000) % 600 < 20;                                // a visitor every 10 min
+            values[2] = fabsf((pump ? 0.45f : 0.0f) + noise(0.03f));            // ACS712 noise
+            values[3] = roundf(28 + 2 * sinf(minute / 30) + noise(0.6f));       // DHT11 whole degrees
+            values[4] = roundf((60 + 5 * sinf(minute / 25) + noise(1)) / 0.375f) * 0.375f;
+            for (int i = 0; i < 5; i++) due[i] = true;
+        }
+        if (now % 1500 == 0) {
+            moisture += pump ? -12 : 2;
+            if (!pump && moisture > 2900) pump = true;
+            if (pump && moisture < 1400) pump = false;
+            values[5] = roundf(moisture + noise(8));
+            values[6] = pump;
+            due[5] = due[6] = true;
+        }
+        for (int i = 0; i < DEVICE_TOPICS; i++) {
+            if (!due[i]) continue;
+            baseline++;      // today: every reading at QoS 1
+            baseline_acks++;
+            if (publish_policy_check(&table, i, values[i], now)) {
+                publish_policy_published(&table, i, device_topics[i].policy.qos ? 1 : 0);
+            }
+        }
+    }
+
+    int published = 0, acks = 0;
+    printf("%-16s %9s %10s\n", "topic", "published", "suppressed");
+    for (int i = 0; i < DEVICE_TOPICS; i++) {
+        const publish_stats_t *s = &device_topics[i].stats;
+        printf("%-16s %9u %10u\n", device_topics[i].topic, (unsigned)s->published, (unsigned)s->suppressed);
+        published += s->published;
+        if (device_topics[i].policy.qos) acks += s->published;
+    }
+    printf("one hour: %d publishes / %d PUBACKs with policies, %d / %d at QoS 1 for everything\n",
+           published, acks, baseline, baseline_acks);
+    TEST_ASSERT_LESS_THAN(baseline / 2, published);
+}
@@ -0,0 +1,53 @@
+#include "unity.h"
+#include <string.h>
+#include "sensor_batch.h"
+
+#define READING_A "{\"sensor_id\":446400101,\"device_id\":4464001,\"data\":{\"temperature\":25.0}}"
+#define READING_B "{\"sensor_id\":446400102,\"device_id\":4464001,\"data\":{\"humidity\":61.0}}"
+
+TEST_CASE("Sensor batch builds a JSON array", "[sensor_batch]")
+{
+    char buf[256];
+    sensor_batch_t batch;
+    sensor_batch_init(&batch, buf, sizeof(buf));
+
+    TEST_ASSERT_TRUE(sensor_batch_add(&batch, READING_A, 100));
+    TEST_ASSERT_TRUE(sensor_batch_add(&batch, READING_B, 150));
+    TEST_ASSERT_EQUAL_INT(2, batch.count);
+    TEST_ASSERT_EQUAL_STRING("[" READING_A "," READING_B "]", sensor_batch_finish(&batch));
+
+    sensor_batch_reset(&batch);
+    TEST_ASSERT_EQUAL_INT(0, batch.count);
+    TEST_ASSERT_EQUAL_STRING("[]", sensor_batch_finish(&batch));
+}
+
+TEST_CASE("Sensor batch is due on count or window", "[sensor_batch]")
+{
+    char buf[512];
+    sensor_batch_t batch;
+    sensor_batch_init(&batch, buf, sizeof(buf));
+
+    TEST_ASSERT_FALSE(sensor_batch_due(&batch, 3, 2000, 0));
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, sensor_batch_ms_until_due(&batch, 2000, 0));
+
+    sensor_batch_add(&batch, READING_A, 1000);
+    TEST_ASSERT_FALSE(sensor_batch_due(&batch, 3, 2000, 2500));
+    TEST_ASSERT_EQUAL_UINT32(500, sensor_batch_ms_until_due(&batch, 2000, 2500));
+    TEST_ASSERT_TRUE(sensor_batch_due(&batch, 3, 2000, 3000));
+
+    sensor_batch_add(&batch, READING_B, 1100);
+    sensor_batch_add(&batch, READING_A, 1200);
+    TEST_ASSERT_TRUE(sensor_batch_due(&batch, 3, 2000, 1200));
+}
+
+TEST_CASE("Sensor batch rejects a reading that does not fit", "[sensor_batch]")
+{
+    char buf[sizeof(READING_A) + 2];
+    sensor_batch_t batch;
+    sensor_batch_init(&batch, buf, sizeof(buf));
+
+    TEST_ASSERT_TRUE(sensor_batch_add(&batch, READING_A, 0));
+    TEST_ASSERT_FALSE(sensor_batch_add(&batch, READING_B, 0));
+    TEST_ASSERT_EQUAL_INT(1, batch.count);
+    TEST_ASSERT_EQUAL_STRING("[" READING_A "]", sensor_batch_finish(&batch));
+}
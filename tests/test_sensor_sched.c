@@ -0,0 +1,215 @@
+#include "unity.h"
+#include <stdio.h>
+#include <string.h>
+#include "sensor_sched.h"
+
+// Simulated time: drivers advance the clock by what they cost
+static int64_t fake_now;
+
+static int64_t fake_clock(void)
+{
+    return fake_now;
+}
+
+typedef struct {
+    uint32_t cost_us;
+    int runs;
+    int64_t first_us;
+    int64_t last_us;
+    char tag;
+    esp_err_t result;
+} fake_t;
+
+static char order[64];
+static int order_len;
+
+static esp_err_t fake_sample(void *ctx)
+{
+    fake_t *f = ctx;
+    if (f->runs++ == 0) f->first_us = fake_now;
+    f->last_us = fake_now;
+    if (order_len < (int)sizeof(order) - 1) order[order_len++] = f->tag;
+    fake_now += f->cost_us;
+    return f->result;
+}
+
+static int fake_format(void *ctx, char *buf, size_t len)
+{
+    const fake_t *f = ctx;
+    return snprintf(buf, len, "\"runs\":%d", f->runs);
+}
+
+static esp_err_t failing_init(void *ctx)
+{
+    return ESP_ERR_NOT_FOUND;
+}
+
+// Drive the scheduler the way second_loop_task does until `until_us`;
+// sleeps end on 10 ms tick boundaries like vTaskDelay at 100 Hz
+static void run_until(sensor_sched_t *s, int64_t until_us, int64_t tick_us)
+{
+    while (fake_now < until_us) {
+        int64_t wait = sensor_sched_run(s);
+        int64_t wake = fake_now + wait;
+        if (tick_us > 1) wake = (wake + tick_us - 1) / tick_us * tick_us;
+        fake_now = wake > fake_now ? wake : fake_now + tick_us;
+    }
+}
+
+static void reset(void)
+{
+    fake_now = 0;
+    order_len = 0;
+    memset(order, 0, sizeof(order));
+}
+
+TEST_CASE("Sensor scheduler runs each driver at its period", "[sensor_sched]")
+{
+    reset();
+    fake_t a = { .tag = 'a', .cost_us = 100 }, b = { .tag = 'b', .cost_us = 100 }, c = { .tag = 'c' };
+    const sensor_driver_t da = { "a", 500, 0, NULL, fake_sample, NULL, &a };
+    const sensor_driver_t db = { "b", 2000, 0, NULL, fake_sample, NULL, &b };
+    const sensor_driver_t dc = { "c", 1500, 250, NULL, fake_sample, NULL, &c };
+    const sensor_driver_t zero = { "z", 0, 0, NULL, fake_sample, NULL, &c };
+
+    sensor_sched_t s;
+    sensor_sched_init(&s, fake_clock);
+    TEST_ASSERT_EQUAL(0, sensor_sched_add(&s, &da));
+    TEST_ASSERT_EQUAL(1, sensor_sched_add(&s, &db));
+    TEST_ASSERT_EQUAL(2, sensor_sched_add(&s, &dc));
+    TEST_ASSERT_EQUAL(-1, sensor_sched_add(&s, &zero));
+    TEST_ASSERT_EQUAL(ESP_OK, sensor_sched_start(&s));
+
+    run_until(&s, 6000 * 1000 - 1, 1);
+    TEST_ASSERT_EQUAL(12, a.runs);
+    TEST_ASSERT_EQUAL(3, b.runs);
+    TEST_ASSERT_EQUAL(4, c.runs);
+    TEST_ASSERT_EQUAL(250000, c.first_us);
+    TEST_ASSERT_EQUAL(250000 + 3 * 1500000, c.last_us);
+    TEST_ASSERT_EQUAL(0, strncmp(order, "abcaa", 5));   // a and b at 0, c at 250 ms, a at 500 and 1000 ms
+
+    // a ran first at t=0, b 100 us later behind it; nothing overran
+    const sensor_stats_t *sb = sensor_sched_stats(&s, 1);
+    TEST_ASSERT_EQUAL(100, sb->late_max_us);
+    TEST_ASSERT_EQUAL(100, sb->exec_max_us);
+    TEST_ASSERT_EQUAL(0, sb->overruns);
+    TEST_ASSERT_NULL(sensor_sched_stats(&s, 3));
+}
+
+TEST_CASE("Sensor scheduler counts overruns and keeps the grid", "[sensor_sched]")
+{
+    reset();
+    fake_t slow = { .tag = 's', .cost_us = 1200 * 1000 }, fast = { .tag = 'f', .cost_us = 50 };
+    const sensor_driver_t ds = { "slow", 1000, 0, NULL, fake_sample, NULL, &slow };
+    const sensor_driver_t df = { "fast", 500, 0, NULL, fake_sample, NULL, &fast };
+
+    sensor_sched_t s;
+    sensor_sched_init(&s, fake_clock);
+    sensor_sched_add(&s, &ds);
+    sensor_sched_add(&s, &df);
+    sensor_sched_start(&s);
+
+    // slow runs at 0 and ends at 1.2 s. fast, due at 0, starts 1.2 s late,
+    // skips the 0.5 s and 1.0 s slots and moves to 1.5 s. slow's 1 s slot
+    // has passed too, but it waits for the next call.
+    TEST_ASSERT_EQUAL(0, sensor_sched_run(&s));
+    const sensor_stats_t *sf = sensor_sched_stats(&s, 1);
+    TEST_ASSERT_EQUAL(1, slow.runs);
+    TEST_ASSERT_EQUAL(1, fast.runs);
+    TEST_ASSERT_EQUAL(1200000, sf->late_max_us);
+    TEST_ASSERT_EQUAL(2, sf->overruns);
+    TEST_ASSERT_EQUAL(1500000, s.slots[1].deadline_us);
+
+    // slow runs its 1 s slot 200 us late and keeps the grid: next at 2 s
+    TEST_ASSERT_EQUAL(0, sensor_sched_run(&s));
+    TEST_ASSERT_EQUAL(2, slow.runs);
+    TEST_ASSERT_EQUAL(1, fast.runs);
+    TEST_ASSERT_EQUAL(0, sensor_sched_stats(&s, 0)->overruns);
+    TEST_ASSERT_EQUAL(2000000, s.slots[0].deadline_us);
+
+    // permanently overloaded, both still get their turns
+    run_until(&s, 60 * 1000000, 10000);
+    printf("overloaded for 60 s: slow %d runs, fast %d runs\n", slow.runs, fast.runs);
+    TEST_ASSERT_GREATER_THAN(20, slow.runs);
+    TEST_ASSERT_GREATER_THAN(20, fast.runs);
+}
+
+TEST_CASE("Sensor scheduler errors and format", "[sensor_sched]")
+{
+    reset();
+    fake_t a = { .tag = 'a', .result = ESP_ERR_TIMEOUT };
+    const sensor_driver_t da = { "dht", 2000, 0, failing_init, fake_sample, fake_format, &a };
+    const sensor_driver_t db = { "led", 500, 0, NULL, fake_sample, NULL, &a };
+
+    sensor_sched_t s;
+    sensor_sched_init(&s, fake_clock);
+    sensor_sched_add(&s, &da);
+    sensor_sched_add(&s, &db);
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, sensor_sched_start(&s));
+    sensor_sched_run(&s);
+
+    // init failure, then one failed sample
+    const sensor_stats_t *st = sensor_sched_stats(&s, 0);
+    TEST_ASSERT_EQUAL(1, st->runs);
+    TEST_ASSERT_EQUAL(2, st->errors);
+    TEST_ASSERT_EQUAL(ESP_ERR_TIMEOUT, st->last_err);
+
+    char buf[32];
+    TEST_ASSERT_EQUAL(strlen("\"dht\":{\"runs\":2}"), sensor_sched_format(&s, 0, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_STRING("\"dht\":{\"runs\":2}", buf);
+    TEST_ASSERT_EQUAL(0, sensor_sched_format(&s, 0, buf, 10));
+    TEST_ASSERT_EQUAL(0, sensor_sched_format(&s, 1, buf, sizeof(buf)));
+
+    sensor_sched_reset_stats(&s);
+    TEST_ASSERT_EQUAL(0, sensor_sched_stats(&s, 0)->runs);
+}
+
+TEST_CASE("Sensor scheduler vs the serial 500 ms loop", "[sensor_sched][bench]")
+{
+    // Cost of one sample() in us. The serial loop blocked 50 ms in the RCWL
+    // poll and ~25 ms in the DHT read every 2 s; with the scheduler both only
+    // take what the ISR/RMT task already has.
+    static fake_t f[] = {
+        { .tag = 'l', .cost_us = 30 },     // led
+        { .tag = 'p', .cost_us = 400 },    // ldr, mostly logging
+        { .tag = 'r', .cost_us = 20 },     // rcwl
+        { .tag = 'a', .cost_us = 500 },    // acs712
+        { .tag = 'd', .cost_us = 300 },    // dht
+        { .tag = 's', .cost_us = 600 },    // soil
+    };
+    const sensor_driver_t d[] = {
+        { "led", 500, 0, NULL, fake_sample, NULL, &f[0] },
+        { "ldr", 2000, 0, NULL, fake_sample, NULL, &f[1] },
+        { "rcwl", 400, 0, NULL, fake_sample, NULL, &f[2] },
+        { "acs712", 2000, 0, NULL, fake_sample, NULL, &f[3] },
+        { "dht", 2000, 0, NULL, fake_sample, NULL, &f[4] },
+        { "soil", 1500, 0, NULL, fake_sample, NULL, &f[5] },
+    };
+    reset();
+    sensor_sched_t s;
+    sensor_sched_init(&s, fake_clock);
+    for (int i = 0; i < 6; i++) sensor_sched_add(&s, &d[i]);
+    sensor_sched_start(&s);
+    const int64_t hour = 3600LL * 1000000;
+    run_until(&s, hour, 10000);
+
+    // serial loop: 500 ms delay + everything due on that tick, back to back
+    const int64_t group_us = 50000 + 25000 + 400 + 500 + 20;
+    int64_t t = 0;
+    int ticks = 0, groups = 0, soils = 0;
+    while (t < hour) {
+        t += 500000 + 30;
+        if (++ticks % 4 == 0) { t += group_us; groups++; }
+        if (ticks % 3 == 0) { t += 600; soils++; }
+    }
+    printf("serial loop: %d 2 s groups (period %.1f ms), %d soil reads, in an hour\n",
+           groups, hour / 1000.0 / groups, soils);
+    for (int i = 0; i < 6; i++) {
+        const sensor_stats_t *st = sensor_sched_stats(&s, i);
+        printf("%-7s %5d runs (expected %5d), late avg %5u us max %5u us, overruns %u\n",
+               d[i].name, f[i].runs, (int)(hour / 1000 / d[i].period_ms),
+               (unsigned)(st->late_sum_us / st->runs), (unsigned)st->late_max_us, (unsigned)st->overruns);
+        TEST_ASSERT_EQUAL(0, st->overruns);
+        TEST_ASSERT_INT_WITHIN(1, hour / 1000 / d[i].period_ms, f[i].runs);
+    }
+}
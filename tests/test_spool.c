@@ -0,0 +1,213 @@
+#include "unity.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "spool.h"
+#include "sensor_batch.h"
+
+// Host builds spool to a file, target builds to the "spool" data partition
+#define SPOOL_TEST_PATH   "spool_test.bin"
+#define SECTOR_SIZE       4096
+#define MAX_SECTORS       16
+
+static spool_storage_t backing;
+static spool_storage_t storage;       // backing plus erase counting
+static uint32_t erase_count[MAX_SECTORS];
+static spool_t sp;
+
+static esp_err_t counting_read(void *ctx, size_t offset, void *buf, size_t len)
+{
+    return backing.read(backing.ctx, offset, buf, len);
+}
+
+static esp_err_t counting_write(void *ctx, size_t offset, const void *buf, size_t len)
+{
+    return backing.write(backing.ctx, offset, buf, len);
+}
+
+static esp_err_t counting_erase(void *ctx, size_t offset, size_t len)
+{
+    erase_count[offset / SECTOR_SIZE]++;
+    return backing.erase(backing.ctx, offset, len);
+}
+
+static void open_storage(uint16_t sectors)
+{
+#ifdef ESP_PLATFORM
+    TEST_ASSERT_EQUAL(ESP_OK, spool_storage_partition(&backing, "spool"));
+#else
+    remove(SPOOL_TEST_PATH);
+    TEST_ASSERT_EQUAL(ESP_OK, spool_storage_file(&backing, SPOOL_TEST_PATH, MAX_SECTORS * SECTOR_SIZE, SECTOR_SIZE));
+#endif
+    TEST_ASSERT_EQUAL(SECTOR_SIZE, backing.sector_size);
+    TEST_ASSERT_TRUE(backing.size >= (size_t)sectors * SECTOR_SIZE);
+    backing.erase(backing.ctx, 0, (size_t)sectors * SECTOR_SIZE);
+    memset(erase_count, 0, sizeof(erase_count));
+    storage = (spool_storage_t) {
+        .size = (size_t)sectors * SECTOR_SIZE,
+        .sector_size = SECTOR_SIZE,
+        .read = counting_read,
+        .write = counting_write,
+        .erase = counting_erase,
+    };
+}
+
+static void close_storage(void)
+{
+#ifndef ESP_PLATFORM
+    spool_storage_file_close(&backing);
+    remove(SPOOL_TEST_PATH);
+#endif
+}
+
+static int reading(char *buf, size_t size, int seq)
+{
+    return snprintf(buf, size, "{\"sensor_id\":1,\"device_id\":1001,\"ts\":%d,\"data\":{\"temperature\":24.5}}", seq);
+}
+
+TEST_CASE("Spooled records survive a reopen and are consumed once", "[spool]")
+{
+    open_storage(4);
+    TEST_ASSERT_EQUAL(ESP_OK, spool_open(&sp, &storage));
+    char buf[SPOOL_MAX_RECORD];
+    for (int i = 0; i < 10; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, spool_append(&sp, buf, reading(buf, sizeof(buf), i)));
+    }
+
+    // replay 4, then "reboot"
+    spool_pos_t pos = spool_tail(&sp);
+    size_t len;
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, spool_read(&sp, &pos, buf, sizeof(buf), &len));
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, spool_consume(&sp, &pos));
+    TEST_ASSERT_EQUAL(ESP_OK, spool_open(&sp, &storage));
+    TEST_ASSERT_EQUAL_UINT32(6, spool_pending(&sp));
+
+    pos = spool_tail(&sp);
+    char expected[SPOOL_MAX_RECORD];
+    for (int i = 4; i < 10; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, spool_read(&sp, &pos, buf, sizeof(buf), &len));
+        buf[len] = '\0';
+        reading(expected, sizeof(expected), i);
+        TEST_ASSERT_EQUAL_STRING(expected, buf);
+    }
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, spool_read(&sp, &pos, buf, sizeof(buf), &len));
+    TEST_ASSERT_EQUAL(ESP_OK, spool_consume(&sp, &pos));
+    TEST_ASSERT_EQUAL_UINT32(0, spool_pending(&sp));
+    close_storage();
+}
+
+TEST_CASE("Full spool recycles the oldest sector and spreads erases", "[spool]")
+{
+    open_storage(4);
+    TEST_ASSERT_EQUAL(ESP_OK, spool_open(&sp, &storage));
+    char buf[SPOOL_MAX_RECORD];
+    const int total = 2000; // about 12 passes over 4 sectors
+    for (int i = 0; i < total; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, spool_append(&sp, buf, reading(buf, sizeof(buf), i)));
+    }
+
+    spool_stats_t stats;
+    spool_get_stats(&sp, &stats);
+    TEST_ASSERT_EQUAL_UINT32(total, spool_pending(&sp) + stats.dropped);
+    TEST_ASSERT_TRUE(spool_pending(&sp) < 4 * SECTOR_SIZE / 80);
+
+    // the oldest record left is the first one after the dropped ones
+    spool_pos_t pos = spool_tail(&sp);
+    size_t len;
+    TEST_ASSERT_EQUAL(ESP_OK, spool_read(&sp, &pos, buf, sizeof(buf), &len));
+    char expected[SPOOL_MAX_RECORD];
+    buf[len] = '\0';
+    reading(expected, sizeof(expected), stats.dropped);
+    TEST_ASSERT_EQUAL_STRING(expected, buf);
+
+    for (int s = 1; s < 4; s++) {
+        TEST_ASSERT_TRUE(erase_count[s] + 1 >= erase_count[0] && erase_count[s] <= erase_count[0] + 1);
+    }
+    close_storage();
+}
+
+TEST_CASE("Corrupted and torn records are skipped", "[spool]")
+{
+    open_storage(2);
+    TEST_ASSERT_EQUAL(ESP_OK, spool_open(&sp, &storage));
+    char buf[SPOOL_MAX_RECORD];
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, spool_append(&sp, buf, reading(buf, sizeof(buf), i)));
+    }
+    // flip a payload byte of the second record (first record at 16, 8-byte header)
+    int first_len = reading(buf, sizeof(buf), 0);
+    size_t second_payload = 16 + 8 + ((first_len + 3) & ~3) + 8;
+    uint8_t zero = 0;
+    storage.write(NULL, second_payload + 5, &zero, 1);
+
+    // a header written without its payload, as after a reset mid-append
+    uint8_t torn[8] = { 40, 0, 0xFF, 0xA5, 0x12, 0x34, 0x56, 0x78 };
+    storage.write(NULL, sp.head.offset, torn, sizeof(torn));
+
+    TEST_ASSERT_EQUAL(ESP_OK, spool_open(&sp, &storage));
+    TEST_ASSERT_EQUAL(ESP_OK, spool_append(&sp, buf, reading(buf, sizeof(buf), 3)));
+
+    spool_pos_t pos = spool_tail(&sp);
+    size_t len;
+    const int expected_seq[] = { 0, 2, 3 };
+    for (int i = 0; i < 3; i++) {
+        char expected[SPOOL_MAX_RECORD];
+        TEST_ASSERT_EQUAL(ESP_OK, spool_read(&sp, &pos, buf, sizeof(buf), &len));
+        buf[len] = '\0';
+        reading(expected, sizeof(expected), expected_seq[i]);
+        TEST_ASSERT_EQUAL_STRING(expected, buf);
+    }
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, spool_read(&sp, &pos, buf, sizeof(buf), &len));
+
+    spool_stats_t stats;
+    spool_get_stats(&sp, &stats);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.corrupt); // bad CRC, and the torn one
+    close_storage();
+}
+
+TEST_CASE("Spool replay throughput", "[spool][bench]")
+{
+    open_storage(MAX_SECTORS);
+    TEST_ASSERT_EQUAL(ESP_OK, spool_open(&sp, &storage));
+    char buf[SPOOL_MAX_RECORD];
+    const int records = 600;
+
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < records; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, spool_append(&sp, buf, reading(buf, sizeof(buf), i)));
+    }
+    int64_t append_us = esp_timer_get_time() - start;
+
+    // Drain the way main.c does: one JSON array per batch, then consume
+    static char batch_buf[4096];
+    sensor_batch_t batch;
+    sensor_batch_init(&batch, batch_buf, sizeof(batch_buf));
+    int replayed = 0, batches = 0;
+    size_t bytes = 0;
+    start = esp_timer_get_time();
+    while (spool_pending(&sp) > 0) {
+        spool_pos_t pos = spool_tail(&sp), end = pos;
+        size_t len;
+        while (spool_read(&sp, &pos, buf, sizeof(buf) - 1, &len) == ESP_OK) {
+            buf[len] = '\0';
+            if (!sensor_batch_add(&batch, buf, 0)) break;
+            end = pos;
+            replayed++;
+        }
+        bytes += strlen(sensor_batch_finish(&batch));
+        sensor_batch_reset(&batch);
+        TEST_ASSERT_EQUAL(ESP_OK, spool_consume(&sp, &end));
+        batches++;
+    }
+    int64_t replay_us = esp_timer_get_time() - start;
+
+    TEST_ASSERT_EQUAL_INT(records, replayed);
+    printf("append: %d records in %lld us (%.0f records/s)\n",
+           records, (long long)append_us, records * 1e6 / (append_us ? append_us : 1));
+    printf("replay: %d records, %d batches, %u bytes in %lld us (%.0f records/s, %.1f KB/s)\n",
+           replayed, batches, (unsigned)bytes, (long long)replay_us,
+           replayed * 1e6 / (replay_us ? replay_us : 1), bytes * 1e6 / 1024 / (replay_us ? replay_us : 1));
+    close_storage();
+}
@@ -0,0 +1,169 @@
+#include "unity.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "spsc_ring.h"
+
+TEST_CASE("SPSC ring pushes and pops in order across the wrap", "[spsc_ring]")
+{
+    spsc_ring_t r;
+    uint32_t buf[8];
+    TEST_ASSERT_FALSE(spsc_ring_init(&r, buf, sizeof(uint32_t), 6));
+    TEST_ASSERT_FALSE(spsc_ring_init(&r, NULL, sizeof(uint32_t), 8));
+    TEST_ASSERT_TRUE(spsc_ring_init(&r, buf, sizeof(uint32_t), 8));
+    TEST_ASSERT_EQUAL(8, spsc_ring_capacity(&r));
+
+    uint32_t in[12], out[12];
+    for (int i = 0; i < 12; i++) in[i] = 100 + i;
+    TEST_ASSERT_EQUAL(0, spsc_ring_pop(&r, out, 12));
+    TEST_ASSERT_FALSE(spsc_ring_wait(&r, 0));
+
+    // a batch that does not fit goes in as far as it fits
+    TEST_ASSERT_EQUAL(5, spsc_ring_push(&r, in, 5));
+    TEST_ASSERT_EQUAL(3, spsc_ring_push(&r, in + 5, 7));
+    TEST_ASSERT_EQUAL(0, spsc_ring_push(&r, in + 8, 1));
+    TEST_ASSERT_EQUAL(8, spsc_ring_count(&r));
+    TEST_ASSERT_TRUE(spsc_ring_wait(&r, 0));
+
+    TEST_ASSERT_EQUAL(6, spsc_ring_pop(&r, out, 6));
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(in, out, 6);
+    // wraps: 2 left at the end, 4 more start over at the front
+    TEST_ASSERT_EQUAL(4, spsc_ring_push(&r, in + 8, 4));
+    TEST_ASSERT_EQUAL(6, spsc_ring_pop(&r, out, 12));
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(in + 6, out, 6);
+    TEST_ASSERT_EQUAL(0, spsc_ring_count(&r));
+}
+
+#define STRESS_ITEMS 200000
+
+typedef struct {
+    uint32_t seq;
+    uint32_t check;     // ~seq, catches torn copies
+    uint8_t pad[24];
+} item_t;
+
+typedef struct {
+    spsc_ring_t ring;
+    item_t buf[64];
+    SemaphoreHandle_t done;
+} stress_t;
+
+static void stress_producer(void *arg)
+{
+    stress_t *s = arg;
+    item_t batch[16];
+    uint32_t seq = 0, rnd = 1;
+    while (seq < STRESS_ITEMS) {
+        rnd = rnd * 1103515245 + 12345;
+        size_t n = 1 + (rnd >> 16) % 16;
+        if (n > STRESS_ITEMS - seq) n = STRESS_ITEMS - seq;
+        for (size_t i = 0; i < n; i++) batch[i] = (item_t){ .seq = seq + i, .check = ~(seq + i) };
+        size_t pushed = spsc_ring_push(&s->ring, batch, n);
+        seq += pushed;
+        if (pushed < n) taskYIELD();
+    }
+    xSemaphoreGive(s->done);
+    vTaskDelete(NULL);
+}
+
+TEST_CASE("SPSC ring loses and reorders nothing between cores", "[spsc_ring]")
+{
+    static stress_t s;
+    TEST_ASSERT_TRUE(spsc_ring_init(&s.ring, s.buf, sizeof(item_t), 64));
+    s.done = xSemaphoreCreateBinary();
+    TEST_ASSERT_NOT_NULL(s.done);
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreatePinnedToCore(stress_producer, "spsc_prod", 3072, &s, 5, NULL,
+                                                      portNUM_PROCESSORS - 1));
+
+    item_t got[24];
+    uint32_t expect = 0, rnd = 7;
+    int64_t deadline = esp_timer_get_time() + 30 * 1000000LL;
+    while (expect < STRESS_ITEMS && esp_timer_get_time() < deadline) {
+        spsc_ring_wait(&s.ring, pdMS_TO_TICKS(100));
+        rnd = rnd * 1103515245 + 12345;
+        size_t n = spsc_ring_pop(&s.ring, got, 1 + (rnd >> 16) % 24);
+        for (size_t i = 0; i < n; i++, expect++) {
+            TEST_ASSERT_EQUAL_UINT32(expect, got[i].seq);
+            TEST_ASSERT_EQUAL_UINT32(~expect, got[i].check);
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(STRESS_ITEMS, expect);
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(s.done, pdMS_TO_TICKS(1000)));
+    TEST_ASSERT_EQUAL(0, spsc_ring_count(&s.ring));
+    vSemaphoreDelete(s.done);
+}
+
+#define BENCH_ITEMS 100000
+
+typedef struct {
+    QueueHandle_t queue;        // NULL: the ring
+    spsc_ring_t ring;
+    item_t buf[64];
+    int batch;
+    SemaphoreHandle_t done;
+} bench_t;
+
+static void bench_producer(void *arg)
+{
+    bench_t *b = arg;
+    item_t batch[16] = { 0 };
+    for (uint32_t sent = 0; sent < BENCH_ITEMS;) {
+        if (b->queue) {
+            batch[0].seq = sent;
+            xQueueSend(b->queue, &batch[0], portMAX_DELAY);
+            sent++;
+        } else {
+            size_t n = spsc_ring_push(&b->ring, batch, b->batch);
+            sent += n;
+            if (n == 0) taskYIELD();
+        }
+    }
+    xSemaphoreGive(b->done);
+    vTaskDelete(NULL);
+}
+
+// Items per second from a task on one core to a task on the other
+static double bench_run(bench_t *b)
+{
+    item_t got[16];
+    b->done = xSemaphoreCreateBinary();
+    int64_t start = esp_timer_get_time();
+    xTaskCreatePinnedToCore(bench_producer, "spsc_bench", 3072, b, 5, NULL, portNUM_PROCESSORS - 1);
+    for (uint32_t received = 0; received < BENCH_ITEMS;) {
+        if (b->queue) {
+            xQueueReceive(b->queue, &got[0], portMAX_DELAY);
+            received++;
+        } else if (spsc_ring_wait(&b->ring, portMAX_DELAY)) {
+            received += spsc_ring_pop(&b->ring, got, b->batch);
+        }
+    }
+    double rate = BENCH_ITEMS * 1e6 / (esp_timer_get_time() - start);
+    xSemaphoreTake(b->done, portMAX_DELAY);
+    vSemaphoreDelete(b->done);
+    return rate;
+}
+
+TEST_CASE("SPSC ring throughput against a FreeRTOS queue", "[spsc_ring][bench]")
+{
+    static bench_t b;
+    memset(&b, 0, sizeof(b));
+    b.queue = xQueueCreate(64, sizeof(item_t));
+    TEST_ASSERT_NOT_NULL(b.queue);
+    double queue_rate = bench_run(&b);
+    vQueueDelete(b.queue);
+    b.queue = NULL;
+    printf("xQueueSend/xQueueReceive, %u-byte items: %.0f items/s\n", (unsigned)sizeof(item_t), queue_rate);
+
+    const int batches[] = { 1, 4, 16 };
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_TRUE(spsc_ring_init(&b.ring, b.buf, sizeof(item_t), 64));
+        b.batch = batches[i];
+        double rate = bench_run(&b);
+        printf("spsc_ring, batches of %2d: %.0f items/s (%.1fx)\n", b.batch, rate, rate / queue_rate);
+        if (b.batch == 16) TEST_ASSERT_TRUE(rate > queue_rate);
+    }
+}
@@ -0,0 +1,165 @@
+#include "unity.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "telemetry_codec.h"
+
+#define DEVICE_ID 4464001
+
+// One second_loop_task cycle with every sensor read
+static void full_cycle(telemetry_frame_t *frame, uint16_t seq)
+{
+    telemetry_frame_init(frame, DEVICE_ID, 1760000000u + seq * 2, seq);
+    telemetry_frame_set(frame, TELEMETRY_LIGHT, 2545);
+    telemetry_frame_set(frame, TELEMETRY_MOTION, 0);
+    telemetry_frame_set(frame, TELEMETRY_CURRENT, 0.29f);
+    telemetry_frame_set(frame, TELEMETRY_TEMPERATURE, 28.0f);
+    telemetry_frame_set(frame, TELEMETRY_HUMIDITY, 61.0f);
+    telemetry_frame_set(frame, TELEMETRY_MOISTURE, 2310);
+    telemetry_frame_set(frame, TELEMETRY_PUMP, 1);
+}
+
+// Bytes of an MQTT 3.1.1 QoS 1 PUBLISH plus its PUBACK
+static size_t mqtt_qos1_bytes(const char *topic, size_t payload)
+{
+    size_t remaining = 2 + strlen(topic) + 2 + payload;   // topic length, topic, packet id, payload
+    size_t varint = remaining < 128 ? 1 : remaining < 16384 ? 2 : 3;
+    return 1 + varint + remaining + 4;
+}
+
+static const char *json_topics[TELEMETRY_FIELD_COUNT] = {
+    "iot/light", "iot/motion", "iot/current", "iot/temperature",
+    "iot/humidity", "iot/moisture", "iot/pump", "iot/heart_rate", "iot/spo2",
+};
+
+TEST_CASE("Telemetry frame round trip", "[telemetry_codec]")
+{
+    telemetry_frame_t in, out;
+    uint8_t buf[TELEMETRY_FRAME_MAX];
+    full_cycle(&in, 7);
+    telemetry_frame_set(&in, TELEMETRY_TEMPERATURE, -3.25f);
+    telemetry_frame_set(&in, TELEMETRY_HEART_RATE, 72);
+    telemetry_frame_set(&in, TELEMETRY_SPO2, 97);
+
+    size_t len = telemetry_encode(&in, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL(TELEMETRY_FRAME_MAX, len);
+    TEST_ASSERT_EQUAL_HEX8(TELEMETRY_CODEC_VERSION, buf[0]);
+    TEST_ASSERT_TRUE(telemetry_decode(buf, len, &out));
+    TEST_ASSERT_EQUAL(DEVICE_ID, out.device_id);
+    TEST_ASSERT_EQUAL(in.timestamp, out.timestamp);
+    TEST_ASSERT_EQUAL(7, out.seq);
+    TEST_ASSERT_EQUAL_HEX16(in.present, out.present);
+    TEST_ASSERT_EQUAL_FLOAT(2545, out.value[TELEMETRY_LIGHT]);
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, 0.29f, out.value[TELEMETRY_CURRENT]);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, -3.25f, out.value[TELEMETRY_TEMPERATURE]);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 61.0f, out.value[TELEMETRY_HUMIDITY]);
+    TEST_ASSERT_EQUAL_FLOAT(72, out.value[TELEMETRY_HEART_RATE]);
+    TEST_ASSERT_EQUAL_FLOAT(97, out.value[TELEMETRY_SPO2]);
+
+    // Decoded frames give back the per-sensor JSON the topics carry today
+    char json[64];
+    telemetry_field_json(&out, TELEMETRY_LIGHT, json, sizeof(json));
+    TEST_ASSERT_EQUAL_STRING("{\"light_value\":2545,\"voltage\":2.05}", json);
+    telemetry_field_json(&out, TELEMETRY_CURRENT, json, sizeof(json));
+    TEST_ASSERT_EQUAL_STRING("{\"current\":0.29}", json);
+    telemetry_field_json(&out, TELEMETRY_HUMIDITY, json, sizeof(json));
+    TEST_ASSERT_EQUAL_STRING("{\"humidity\":61.0}", json);
+    telemetry_field_json(&out, TELEMETRY_PUMP, json, sizeof(json));
+    TEST_ASSERT_EQUAL_STRING("{\"pump_state\":1}", json);
+
+    // Only the fields read this cycle are sent
+    telemetry_frame_init(&in, DEVICE_ID, 0, 8);
+    telemetry_frame_set(&in, TELEMETRY_HEART_RATE, 65);
+    len = telemetry_encode(&in, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL(TELEMETRY_HEADER_SIZE + 1, len);
+    TEST_ASSERT_TRUE(telemetry_decode(buf, len, &out));
+    TEST_ASSERT_FALSE(telemetry_frame_has(&out, TELEMETRY_TEMPERATURE));
+    TEST_ASSERT_EQUAL(-1, telemetry_field_json(&out, TELEMETRY_TEMPERATURE, json, sizeof(json)));
+}
+
+TEST_CASE("Telemetry values are clamped to the field range", "[telemetry_codec]")
+{
+    telemetry_frame_t in, out;
+    uint8_t buf[TELEMETRY_FRAME_MAX];
+    telemetry_frame_init(&in, DEVICE_ID, 0, 0);
+    telemetry_frame_set(&in, TELEMETRY_TEMPERATURE, -5000.0f);
+    telemetry_frame_set(&in, TELEMETRY_MOISTURE, 70000);
+    telemetry_frame_set(&in, TELEMETRY_HEART_RATE, -1);
+    TEST_ASSERT_TRUE(telemetry_decode(buf, telemetry_encode(&in, buf, sizeof(buf)), &out));
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, -3276.8f, out.value[TELEMETRY_TEMPERATURE]);
+    TEST_ASSERT_EQUAL_FLOAT(65535, out.value[TELEMETRY_MOISTURE]);
+    TEST_ASSERT_EQUAL_FLOAT(0, out.value[TELEMETRY_HEART_RATE]);
+}
+
+TEST_CASE("Telemetry decoder rejects bad frames", "[telemetry_codec]")
+{
+    telemetry_frame_t in, out;
+    uint8_t buf[TELEMETRY_FRAME_MAX + 1];
+    full_cycle(&in, 1);
+    size_t len = telemetry_encode(&in, buf, sizeof(buf));
+
+    TEST_ASSERT_EQUAL(0, telemetry_encode(&in, buf, len - 1));
+    len = telemetry_encode(&in, buf, sizeof(buf));
+    TEST_ASSERT_FALSE(telemetry_decode(buf, len - 1, &out));     // truncated
+    TEST_ASSERT_FALSE(telemetry_decode(buf, len + 1, &out));     // trailing byte
+    TEST_ASSERT_FALSE(telemetry_decode(buf, 4, &out));           // no header
+    buf[1] |= 1u << TELEMETRY_HEART_RATE;                         // field claimed, not sent
+    TEST_ASSERT_FALSE(telemetry_decode(buf, len, &out));
+    buf[1] &= ~(1u << TELEMETRY_HEART_RATE);
+    buf[2] |= 1u << (TELEMETRY_SPO2 - 8);
+    TEST_ASSERT_FALSE(telemetry_decode(buf, len, &out));
+    buf[2] &= ~(1u << (TELEMETRY_SPO2 - 8));
+    buf[0] = TELEMETRY_CODEC_VERSION + 1;
+    TEST_ASSERT_FALSE(telemetry_decode(buf, len, &out));
+    buf[0] = TELEMETRY_CODEC_VERSION;
+    TEST_ASSERT_TRUE(telemetry_decode(buf, len, &out));
+}
+
+TEST_CASE("Telemetry bytes on wire: binary frame vs JSON per sensor", "[telemetry_codec][bench]")
+{
+    const int rounds = 10000;
+    telemetry_frame_t frame;
+    uint8_t buf[TELEMETRY_FRAME_MAX];
+    char json[64];
+    char topic[32];
+    snprintf(topic, sizeof(topic), "iot/%d/telemetry", DEVICE_ID);
+    full_cycle(&frame, 0);
+
+    size_t json_payload = 0, json_wire = 0;
+    int messages = 0;
+    for (int f = 0; f < TELEMETRY_FIELD_COUNT; f++) {
+        int n = telemetry_field_json(&frame, f, json, sizeof(json));
+        if (n < 0) continue;
+        json_payload += n;
+        json_wire += mqtt_qos1_bytes(json_topics[f], n);
+        messages++;
+    }
+    size_t bin_payload = telemetry_encode(&frame, buf, sizeof(buf));
+    size_t bin_wire = mqtt_qos1_bytes(topic, bin_payload);
+
+    volatile size_t sink = 0;
+    int64_t start = esp_timer_get_time();
+    for (int r = 0; r < rounds; r++) {
+        frame.seq = r;
+        for (int f = 0; f < TELEMETRY_FIELD_COUNT; f++) {
+            int n = telemetry_field_json(&frame, f, json, sizeof(json));
+            if (n > 0) sink += n;
+        }
+    }
+    int64_t json_us = esp_timer_get_time() - start;
+
+    start = esp_timer_get_time();
+    for (int r = 0; r < rounds; r++) {
+        frame.seq = r;
+        sink += telemetry_encode(&frame, buf, sizeof(buf));
+    }
+    int64_t bin_us = esp_timer_get_time() - start;
+    (void)sink;
+
+    printf("one sampling cycle, %d readings, MQTT QoS 1 incl. PUBACK\n", messages);
+    printf("JSON:   %d messages  payload %3u B  on wire %4u B  encode %6.2f us\n",
+           messages, (unsigned)json_payload, (unsigned)json_wire, json_us / (double)rounds);
+    printf("binary: 1 message   payload %3u B  on wire %4u B  encode %6.2f us\n",
+           (unsigned)bin_payload, (unsigned)bin_wire, bin_us / (double)rounds);
+    TEST_ASSERT_LESS_THAN(json_wire / 4, bin_wire);
+}
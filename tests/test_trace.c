@@ -0,0 +1,204 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cJSON.h"
+#include "esp_timer.h"
+#include "trace.h"
+
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t cap;
+    int calls;
+    int fail_after;     // writer gives up on this call, 0 never
+} sink_t;
+
+static bool sink_write(const char *data, size_t len, void *ctx)
+{
+    sink_t *s = ctx;
+    if (++s->calls == s->fail_after) return false;
+    if (s->len + len >= s->cap) return false;
+    memcpy(s->buf + s->len, data, len);
+    s->len += len;
+    s->buf[s->len] = '\0';
+    return true;
+}
+
+static cJSON *export(sink_t *s, int *spans)
+{
+    s->len = 0;
+    s->buf[0] = '\0';
+    s->calls = 0;
+    *spans = trace_export_chrome(sink_write, s);
+    return cJSON_Parse(s->buf);
+}
+
+// Complete events of the export in ring order
+static int spans_of(cJSON *root, cJSON **out, int max)
+{
+    int n = 0;
+    cJSON *e;
+    cJSON_ArrayForEach(e, cJSON_GetObjectItem(root, "traceEvents")) {
+        if (strcmp(cJSON_GetObjectItem(e, "ph")->valuestring, "X") == 0 && n < max) out[n++] = e;
+    }
+    return n;
+}
+
+static double num(cJSON *e, const char *key)
+{
+    return cJSON_GetObjectItem(e, key)->valuedouble;
+}
+
+static void spin_us(int64_t us)
+{
+    int64_t end = esp_timer_get_time() + us;
+    while (esp_timer_get_time() < end) {
+    }
+}
+
+TEST_CASE("Trace spans export as Chrome trace JSON", "[trace]")
+{
+    sink_t s = { .buf = malloc(8192), .cap = 8192 };
+    TEST_ASSERT_NOT_NULL(s.buf);
+    trace_reset();
+    trace_set_enabled(true);
+
+    trace_span_t outer = trace_begin("sensor", "dht");
+    spin_us(200);
+    trace_span_t inner = trace_begin("mqtt", "iot/temperature");
+    spin_us(300);
+    trace_end(&inner);
+    trace_end(&outer);
+    trace_span_t request = trace_begin("http", "POST");
+    trace_end_on(&request, "http engine 0");
+
+    int spans;
+    cJSON *root = export(&s, &spans);
+    TEST_ASSERT_NOT_NULL(root);
+    TEST_ASSERT_EQUAL(3, spans);
+    cJSON *x[3];
+    TEST_ASSERT_EQUAL(3, spans_of(root, x, 3));
+
+    // ring order is end order: the inner span closed first
+    TEST_ASSERT_EQUAL_STRING("iot/temperature", cJSON_GetObjectItem(x[0], "name")->valuestring);
+    TEST_ASSERT_EQUAL_STRING("mqtt", cJSON_GetObjectItem(x[0], "cat")->valuestring);
+    TEST_ASSERT_EQUAL_STRING("dht", cJSON_GetObjectItem(x[1], "name")->valuestring);
+    // esp_timer_get_time() is whole microseconds
+    TEST_ASSERT_TRUE(num(x[0], "dur") >= 299);
+    TEST_ASSERT_TRUE(num(x[1], "dur") >= 498);
+    TEST_ASSERT_TRUE(num(x[0], "ts") >= num(x[1], "ts") + 199);
+    TEST_ASSERT_TRUE(num(x[0], "ts") + num(x[0], "dur") <= num(x[1], "ts") + num(x[1], "dur"));
+    TEST_ASSERT_EQUAL(num(x[0], "tid"), num(x[1], "tid"));
+
+    // the track gets a row of its own, named after it
+    TEST_ASSERT_NOT_EQUAL(num(x[1], "tid"), num(x[2], "tid"));
+    bool track_named = false;
+    cJSON *e;
+    cJSON_ArrayForEach(e, cJSON_GetObjectItem(root, "traceEvents")) {
+        cJSON *args = cJSON_GetObjectItem(e, "args");
+        if (args && cJSON_GetObjectItem(e, "tid") && num(e, "tid") == num(x[2], "tid") &&
+            strcmp(cJSON_GetObjectItem(args, "name")->valuestring, "http engine 0") == 0) {
+            track_named = true;
+        }
+    }
+    TEST_ASSERT_TRUE(track_named);
+    cJSON_Delete(root);
+
+    // off: open spans and new ones are not recorded
+    trace_span_t open = trace_begin("sensor", "ldr");
+    trace_set_enabled(false);
+    trace_span_t off = trace_begin("sensor", "soil");
+    TEST_ASSERT_NULL(off.name);
+    trace_end(&off);
+    trace_end(&open);
+    trace_set_enabled(true);
+    root = export(&s, &spans);
+    TEST_ASSERT_EQUAL(3, spans);
+    cJSON_Delete(root);
+
+    // a writer that gives up fails the export; recording carries on
+    s.fail_after = 1;
+    s.len = 0;
+    s.calls = 0;
+    TEST_ASSERT_EQUAL(-1, trace_export_chrome(sink_write, &s));
+    TEST_ASSERT_EQUAL(1, s.calls);
+    TEST_ASSERT_EQUAL(0, s.len);
+    TEST_ASSERT_TRUE(trace_enabled());
+
+    trace_reset();
+    s.fail_after = 0;
+    root = export(&s, &spans);
+    TEST_ASSERT_EQUAL(0, spans);
+    TEST_ASSERT_EQUAL(0, cJSON_GetArraySize(cJSON_GetObjectItem(root, "traceEvents")));
+    cJSON_Delete(root);
+    free(s.buf);
+}
+
+TEST_CASE("Trace ring keeps the newest spans and unwraps the clock", "[trace]")
+{
+    sink_t s = { .buf = malloc(TRACE_RING_SIZE * 160), .cap = TRACE_RING_SIZE * 160 };
+    cJSON **x = malloc(TRACE_RING_SIZE * sizeof(cJSON *));
+    TEST_ASSERT_NOT_NULL(s.buf);
+    TEST_ASSERT_NOT_NULL(x);
+    trace_reset();
+    trace_set_enabled(true);
+
+    // a span every 250 ms for longer than the 32-bit clock lasts, starting
+    // 1.5 ms into a tick, 1.234 us long
+    const uint64_t per_us = trace_clock_per_us();
+    const int n = TRACE_RING_SIZE + 40;
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for (int i = 0; i < n; i++) {
+        uint64_t at_us = 1000000 + (uint64_t)i * 250000 + 1500;
+        trace_record("sensor", i % 2 ? "odd" : "even", (uint32_t)(at_us * per_us), (uint32_t)(1234 * per_us / 1000),
+                     (TickType_t)(at_us / 1000 / portTICK_PERIOD_MS), self, NULL);
+    }
+
+    int spans;
+    cJSON *root = export(&s, &spans);
+    TEST_ASSERT_NOT_NULL(root);
+    TEST_ASSERT_EQUAL(TRACE_RING_SIZE, spans);
+    TEST_ASSERT_EQUAL(TRACE_RING_SIZE, spans_of(root, x, TRACE_RING_SIZE));
+    TEST_ASSERT_EQUAL_STRING("even", cJSON_GetObjectItem(x[0], "name")->valuestring);     // 40 overwritten
+    double first_us = 1000000 + 40 * 250000.0 + 1500;
+    TEST_ASSERT_DOUBLE_WITHIN(portTICK_PERIOD_MS * 1000, first_us, num(x[0], "ts"));
+    for (int i = 1; i < TRACE_RING_SIZE; i++) {
+        TEST_ASSERT_DOUBLE_WITHIN(0.002, 250000, num(x[i], "ts") - num(x[i - 1], "ts"));
+    }
+    TEST_ASSERT_DOUBLE_WITHIN(0.002, 1.234, num(x[0], "dur"));
+    cJSON_Delete(root);
+    trace_reset();
+    free(x);
+    free(s.buf);
+}
+
+TEST_CASE("Trace span and export cost", "[trace][bench]")
+{
+    const int n = 100000;
+    trace_reset();
+    trace_set_enabled(true);
+    int64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < n; i++) {
+        trace_span_t span = trace_begin("bench", "span");
+        trace_end(&span);
+    }
+    int64_t t1 = esp_timer_get_time();
+    trace_set_enabled(false);
+    for (int i = 0; i < n; i++) {
+        trace_span_t span = trace_begin("bench", "span");
+        trace_end(&span);
+    }
+    int64_t t2 = esp_timer_get_time();
+    trace_set_enabled(true);
+    printf("span %.0f ns recording, %.0f ns off\n", (t1 - t0) * 1000.0 / n, (t2 - t1) * 1000.0 / n);
+
+    sink_t s = { .buf = malloc(TRACE_RING_SIZE * 160), .cap = TRACE_RING_SIZE * 160 };
+    TEST_ASSERT_NOT_NULL(s.buf);
+    int64_t s0 = esp_timer_get_time();
+    int spans = trace_export_chrome(sink_write, &s);
+    printf("export of %d spans: %u bytes, %lld us\n", spans, (unsigned)s.len, (long long)(esp_timer_get_time() - s0));
+    TEST_ASSERT_EQUAL(TRACE_RING_SIZE, spans);
+    free(s.buf);
+    trace_reset();
+}
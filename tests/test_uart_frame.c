@@ -0,0 +1,161 @@
+#include "unity.h"
+#include <stdio.h>
+#include <string.h>
+#include "uart_frame.h"
+
+static uart_framer_t framer;
+
+static uint32_t seed = 5;
+
+static uint32_t rnd(uint32_t n)
+{
+    seed = seed * 1103515245u + 12345u;
+    return (seed >> 8) % n;
+}
+
+// "text*XX\n" as the Uno sends it
+static size_t with_crc(char *out, size_t size, const char *text)
+{
+    return snprintf(out, size, "%s*%02X\r\n", text, uart_frame_crc8(text, strlen(text)));
+}
+
+static bool next_is(const char *text, bool checked)
+{
+    uart_frame_t fr;
+    if (!uart_framer_next(&framer, &fr)) return false;
+    return fr.len == strlen(text) && memcmp(fr.data, text, fr.len) == 0 && fr.checked == checked;
+}
+
+TEST_CASE("UART framer lines, CRC and partial input", "[uart_frame]")
+{
+    char line[64];
+    uart_framer_init(&framer, false);
+    TEST_ASSERT_EQUAL_HEX8(0xDA, uart_frame_crc8("{\"hr\":72}", 9));
+
+    size_t n = with_crc(line, sizeof(line), "{\"hr\":72}");
+    uart_framer_feed(&framer, line, n);
+    uart_framer_feed(&framer, "Initializing MAX30102...\r\n\n", 27);
+    TEST_ASSERT_TRUE(next_is("{\"hr\":72}", true));
+    TEST_ASSERT_TRUE(next_is("Initializing MAX30102...", false));
+    TEST_ASSERT_FALSE(next_is("", false));
+
+    // one byte at a time, the old code saw each byte as a message
+    n = with_crc(line, sizeof(line), "{\"hr\":65,\"spo2\":97}");
+    for (size_t i = 0; i < n; i++) {
+        TEST_ASSERT_FALSE(i + 1 < n && next_is("", false));
+        uart_framer_feed(&framer, &line[i], 1);
+    }
+    TEST_ASSERT_TRUE(next_is("{\"hr\":65,\"spo2\":97}", true));
+
+    // corrupted byte: the CRC catches it
+    line[3] = '9';
+    uart_framer_feed(&framer, line, n);
+    TEST_ASSERT_FALSE(next_is("", false));
+    TEST_ASSERT_EQUAL(1, framer.stats.crc_errors);
+    TEST_ASSERT_EQUAL(2, framer.stats.frames);
+    TEST_ASSERT_EQUAL(1, framer.stats.unchecked);
+
+    // CRC required: lines without one are dropped
+    uart_framer_init(&framer, true);
+    uart_framer_feed(&framer, "{\"hr\":72}\n", 10);
+    TEST_ASSERT_FALSE(next_is("", false));
+    TEST_ASSERT_EQUAL(1, framer.stats.rejected);
+}
+
+TEST_CASE("UART framer wraps the ring and skips overlong lines", "[uart_frame]")
+{
+    char line[64], big[UART_FRAME_MAX * 3];
+    uart_framer_init(&framer, false);
+    size_t n = with_crc(line, sizeof(line), "{\"hr\":101}");
+
+    // many lines through the ring: some wrap its end and go through scratch
+    int scratch = 0;
+    for (int i = 0; i < 200; i++) {
+        uart_framer_feed(&framer, line, n);
+        uart_frame_t fr;
+        TEST_ASSERT_TRUE(uart_framer_next(&framer, &fr));
+        TEST_ASSERT_EQUAL(10, fr.len);
+        TEST_ASSERT_EQUAL_MEMORY("{\"hr\":101}", fr.data, 10);
+        scratch += fr.data == framer.scratch;
+    }
+    TEST_ASSERT_GREATER_THAN(0, scratch);
+
+    // a line that never fits is dropped up to its newline, in pieces
+    memset(big, 'x', sizeof(big));
+    for (size_t i = 0; i < sizeof(big); i += 50) {
+        uart_framer_feed(&framer, big + i, sizeof(big) - i < 50 ? sizeof(big) - i : 50);
+        TEST_ASSERT_FALSE(next_is("", false));
+    }
+    uart_framer_feed(&framer, "\n", 1);
+    uart_framer_feed(&framer, line, n);
+    TEST_ASSERT_TRUE(next_is("{\"hr\":101}", true));
+    TEST_ASSERT_EQUAL(1, framer.stats.oversize);
+
+    // after a reset the fragment up to the next newline is not a line
+    uart_framer_feed(&framer, line, 5);
+    uart_framer_reset(&framer);
+    uart_framer_feed(&framer, "\":99}*00\n", 9);
+    uart_framer_feed(&framer, line, n);
+    TEST_ASSERT_TRUE(next_is("{\"hr\":101}", true));
+    TEST_ASSERT_FALSE(next_is("", false));
+    TEST_ASSERT_EQUAL(0, framer.stats.crc_errors);
+
+    // direct writes into the ring
+    size_t space;
+    uint8_t *dst = uart_framer_write_ptr(&framer, &space);
+    TEST_ASSERT_GREATER_OR_EQUAL(1, space);
+    dst[0] = '\n';
+    uart_framer_commit(&framer, 1);
+    TEST_ASSERT_FALSE(next_is("", false));
+}
+
+TEST_CASE("UART framer fuzz: records among garbage in random chunks", "[uart_frame]")
+{
+    static uint8_t stream[16384];
+    static int32_t sent[1024];
+    for (int round = 0; round < 50; round++) {
+        uart_framer_init(&framer, round % 2);
+        size_t len = 0;
+        int count = 0;
+        while (len < sizeof(stream) - 200 && count < 1024) {
+            if (rnd(4) == 0) {
+                // newline-terminated noise: random bytes, maybe overlong
+                size_t g = rnd(5) == 0 ? UART_FRAME_MAX + rnd(300) : rnd(40);
+                if (len + g + 1 >= sizeof(stream) - 200) break;
+                for (size_t i = 0; i < g; i++) {
+                    uint8_t b = (uint8_t)rnd(256);
+                    stream[len++] = b == '\n' ? '?' : b;
+                }
+                stream[len++] = '\n';
+            } else {
+                char text[32], line[40];
+                sent[count] = (int32_t)rnd(200);
+                snprintf(text, sizeof(text), "{\"hr\":%d}", (int)sent[count++]);
+                size_t n = with_crc(line, sizeof(line), text);
+                memcpy(stream + len, line, n);
+                len += n;
+            }
+        }
+
+        int got = 0;
+        for (size_t pos = 0; pos < len; ) {
+            size_t chunk = 1 + rnd(rnd(2) ? 8 : 300);
+            if (chunk > len - pos) chunk = len - pos;
+            TEST_ASSERT_EQUAL(chunk, uart_framer_feed(&framer, stream + pos, chunk));
+            pos += chunk;
+            uart_frame_t fr;
+            while (uart_framer_next(&framer, &fr)) {
+                TEST_ASSERT_LESS_OR_EQUAL(UART_FRAME_MAX, fr.len);
+                if (!fr.checked) continue;    // noise
+                char text[32];
+                snprintf(text, sizeof(text), "{\"hr\":%d}", (int)sent[got]);
+                TEST_ASSERT_EQUAL(strlen(text), fr.len);
+                TEST_ASSERT_EQUAL_MEMORY(text, fr.data, fr.len);
+                got++;
+            }
+        }
+        // noise can pass an 8-bit CRC by chance (1 in 256 of its "*XX" lines)
+        TEST_ASSERT_EQUAL(count, got);
+        TEST_ASSERT_EQUAL(0, framer.stats.overruns);
+    }
+}
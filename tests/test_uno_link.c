@@ -0,0 +1,262 @@
+#include "unity.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "uart_frame.h"
+#include "uno_link.h"
+
+static uart_framer_t framer;
+
+static uint32_t seed = 11;
+
+static uint32_t rnd(uint32_t n)
+{
+    seed = seed * 1103515245u + 12345u;
+    return (seed >> 8) % n;
+}
+
+static void check_cobs(const uint8_t *in, size_t len, const uint8_t *expect, size_t expect_len)
+{
+    uint8_t enc[300], dec[300];
+    TEST_ASSERT_EQUAL(expect_len, cobs_encode(in, len, enc));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expect, enc, expect_len);
+    TEST_ASSERT_EQUAL(len, cobs_decode(enc, expect_len, dec, sizeof(dec)));
+    if (len > 0) TEST_ASSERT_EQUAL_HEX8_ARRAY(in, dec, len);
+}
+
+TEST_CASE("Uno link COBS encoding", "[uno_link]")
+{
+    // examples from the COBS paper / Wikipedia
+    check_cobs((const uint8_t[]){ 0x00 }, 1, (const uint8_t[]){ 0x01, 0x01 }, 2);
+    check_cobs((const uint8_t[]){ 0x00, 0x00 }, 2, (const uint8_t[]){ 0x01, 0x01, 0x01 }, 3);
+    check_cobs((const uint8_t[]){ 0x11, 0x22, 0x00, 0x33 }, 4, (const uint8_t[]){ 0x03, 0x11, 0x22, 0x02, 0x33 }, 5);
+    check_cobs((const uint8_t[]){ 0x11, 0x00, 0x00, 0x00 }, 4, (const uint8_t[]){ 0x02, 0x11, 0x01, 0x01, 0x01 }, 5);
+
+    // 254 and 255 non-zero bytes: exactly one block, then a block plus one
+    uint8_t in[255], expect[258];
+    for (int i = 0; i < 255; i++) in[i] = i + 1;
+    expect[0] = 0xFF;
+    memcpy(expect + 1, in, 254);
+    check_cobs(in, 254, expect, 255);
+    expect[255] = 0x02;
+    expect[256] = 0xFF;
+    check_cobs(in, 255, expect, 257);
+
+    // random round trips never put a zero on the wire
+    uint8_t enc[300], dec[300];
+    for (int round = 0; round < 500; round++) {
+        size_t len = rnd(256);
+        for (size_t i = 0; i < len; i++) in[i] = rnd(4) == 0 ? 0 : rnd(256);
+        size_t n = cobs_encode(in, len, enc);
+        TEST_ASSERT_NULL(memchr(enc, 0, n));
+        TEST_ASSERT_EQUAL(len, cobs_decode(enc, n, dec, sizeof(dec)));
+        if (len > 0) TEST_ASSERT_EQUAL_HEX8_ARRAY(in, dec, len);
+    }
+
+    // a block longer than the input and an embedded zero are malformed
+    TEST_ASSERT_EQUAL(0, cobs_decode((const uint8_t[]){ 0x05, 0x11, 0x22 }, 3, dec, sizeof(dec)));
+    TEST_ASSERT_EQUAL(0, cobs_decode((const uint8_t[]){ 0x03, 0x11, 0x00 }, 3, dec, sizeof(dec)));
+    TEST_ASSERT_EQUAL(0, cobs_decode((const uint8_t[]){ 0x03, 0x11, 0x22 }, 3, dec, 1));
+}
+
+static bool same_packet(const uno_packet_t *a, const uno_packet_t *b)
+{
+    uint8_t fa[UNO_LINK_MAX_FRAME], fb[UNO_LINK_MAX_FRAME];
+    size_t na = uno_link_encode(a, fa, sizeof(fa));
+    return na > 0 && na == uno_link_encode(b, fb, sizeof(fb)) && memcmp(fa, fb, na) == 0;
+}
+
+static uno_packet_t make_packet(int i)
+{
+    uno_packet_t p = { .type = UNO_PKT_HR };
+    switch (i % 6) {
+    case 0:
+        p.type = UNO_PKT_HR;
+        p.hr.bpm = 60 + i % 60;
+        break;
+    case 1:
+        p.type = UNO_PKT_SPO2;
+        p.spo2.spo2 = 90 + i % 10;
+        p.spo2.hr = 70;
+        p.spo2.flags = UNO_SPO2_VALID | UNO_HR_VALID;
+        break;
+    case 2:
+        p.type = UNO_PKT_SAMPLES;
+        p.samples.count = 1 + i % UNO_LINK_MAX_SAMPLES;
+        for (int k = 0; k < p.samples.count; k++) {
+            p.samples.s[k].ir = (100000 + i * 37 + k) & 0x3FFFF;    // 18-bit MAX30102 samples
+            p.samples.s[k].red = (i * 101 + k * 3) & 0x3FFFF;       // zero bytes included
+        }
+        break;
+    case 3:
+        p.type = UNO_PKT_IR_EVENT;
+        p.ir.command = 0x1A;
+        p.ir.lights = UNO_LIGHT_FOG | UNO_LIGHT_AUX;
+        p.ir.brightness = 1;
+        p.ir.color_temp = i % 5;
+        break;
+    case 4:
+        p.type = UNO_PKT_HELLO;
+        p.hello.version = UNO_LINK_VERSION;
+        p.hello.max_baud = 250000;
+        break;
+    case 5:
+        p.type = UNO_PKT_PING;
+        break;
+    }
+    p.seq = i;
+    return p;
+}
+
+TEST_CASE("Uno link packets through the framer with noise and loss", "[uno_link]")
+{
+    static uint8_t stream[64 * 1024];
+    uint8_t buf[UNO_LINK_MAX_FRAME];
+    size_t len = 0;
+    const int count = 600;
+    int dropped = 0, corrupted = 0;
+
+    // a zero-terminated burst of garbage first, as after a baud change
+    for (int i = 0; i < 40; i++) stream[len++] = rnd(256);
+    stream[len++] = 0;
+    for (int i = 0; i < count; i++) {
+        uno_packet_t p = make_packet(i);
+        size_t n = uno_link_encode(&p, buf, sizeof(buf));
+        TEST_ASSERT_GREATER_THAN(0, n);
+        TEST_ASSERT_EQUAL(0, buf[n - 1]);
+        if (i % 50 == 7) {              // lost on the wire
+            dropped++;
+            continue;
+        }
+        if (i % 50 == 23) {             // one flipped bit
+            buf[rnd(n - 1)] ^= 1 << rnd(8);
+            corrupted++;
+        }
+        memcpy(stream + len, buf, n);
+        len += n;
+    }
+
+    uart_framer_init_binary(&framer);
+    uno_link_seq_t seq = { 0 };
+    int good = 0, bad = 0;
+    uint32_t index = 0;                 // seq unwrapped
+    for (size_t pos = 0; pos < len; ) {
+        size_t chunk = 1 + rnd(64);
+        if (chunk > len - pos) chunk = len - pos;
+        uart_framer_feed(&framer, stream + pos, chunk);
+        pos += chunk;
+        uart_frame_t fr;
+        while (uart_framer_next(&framer, &fr)) {
+            uno_packet_t p;
+            if (uno_link_decode((const uint8_t *)fr.data, fr.len, &p) != UNO_LINK_OK) {
+                bad++;
+                continue;
+            }
+            uint32_t missing = uno_link_seq_update(&seq, p.seq);
+            index = good == 0 ? p.seq : index + 1 + missing;
+            uno_packet_t want = make_packet(index);
+            TEST_ASSERT_TRUE(same_packet(&want, &p));
+            good++;
+        }
+    }
+    // a flipped bit fails the CRC or COBS, or turns into a zero and splits
+    // the frame in two; either way nothing wrong gets through
+    TEST_ASSERT_EQUAL(count - dropped - corrupted, good);
+    TEST_ASSERT_GREATER_OR_EQUAL(corrupted + 1, bad);
+    TEST_ASSERT_EQUAL(dropped + corrupted, seq.lost);
+    TEST_ASSERT_EQUAL(good, seq.received);
+}
+
+TEST_CASE("Uno link rejects malformed packets", "[uno_link]")
+{
+    uint8_t raw[8], frame[16];
+    uno_packet_t p;
+
+    // HR with a byte too many, under a valid CRC
+    raw[0] = UNO_PKT_HR;
+    raw[1] = 1;
+    raw[2] = 72;
+    raw[3] = 0;
+    raw[4] = uart_frame_crc8(raw, 4);
+    size_t n = cobs_encode(raw, 5, frame);
+    TEST_ASSERT_EQUAL(UNO_LINK_LENGTH, uno_link_decode(frame, n, &p));
+
+    raw[0] = 0x42;
+    raw[3] = uart_frame_crc8(raw, 3);
+    n = cobs_encode(raw, 4, frame);
+    TEST_ASSERT_EQUAL(UNO_LINK_TYPE, uno_link_decode(frame, n, &p));
+
+    raw[0] = UNO_PKT_HR;
+    raw[3] = uart_frame_crc8(raw, 3) ^ 0x80;
+    n = cobs_encode(raw, 4, frame);
+    TEST_ASSERT_EQUAL(UNO_LINK_CRC, uno_link_decode(frame, n, &p));
+
+    // sample count above the limit
+    uno_packet_t big = { .type = UNO_PKT_SAMPLES, .samples.count = UNO_LINK_MAX_SAMPLES + 1 };
+    TEST_ASSERT_EQUAL(0, uno_link_encode(&big, frame, sizeof(frame)));
+    TEST_ASSERT_EQUAL(UNO_LINK_COBS, uno_link_decode((const uint8_t[]){ 0x09, 0x01 }, 2, &p));
+
+    // sequence numbers wrap
+    uno_link_seq_t seq = { 0 };
+    TEST_ASSERT_EQUAL(0, uno_link_seq_update(&seq, 250));
+    TEST_ASSERT_EQUAL(0, uno_link_seq_update(&seq, 251));
+    TEST_ASSERT_EQUAL(5, uno_link_seq_update(&seq, 1));
+    TEST_ASSERT_EQUAL(5, seq.lost);
+}
+
+TEST_CASE("Uno link size and throughput against JSON lines", "[uno_link][bench]")
+{
+    uint8_t buf[UNO_LINK_MAX_FRAME];
+    char line[32];
+    uno_packet_t hr = { .type = UNO_PKT_HR, .hr.bpm = 72 };
+    size_t bin_hr = uno_link_encode(&hr, buf, sizeof(buf));
+    size_t text_hr = snprintf(line, sizeof(line), "{\"hr\":72}*DA\r\n");
+    uno_packet_t s = make_packet(2);
+    s.samples.count = 10;               // 100 ms at 100 Hz per packet
+    size_t bin_samples = uno_link_encode(&s, buf, sizeof(buf));
+    // {"ir":123456,"red":123456}\r\n per sample as JSON
+    const size_t text_sample = 29;
+
+    // 10 bits per byte on the wire
+    const double bauds[] = { 9600, 115200, 250000 };
+    printf("HR message: %u bytes as a JSON line, %u as a packet\n", (unsigned)text_hr, (unsigned)bin_hr);
+    for (int i = 0; i < 3; i++) {
+        double bytes_s = bauds[i] / 10;
+        printf("%6.0f baud: %5.0f HR msg/s as JSON, %5.0f as packets; 100 Hz IR/red uses %5.1f%% as packets"
+               " (%5.1f%% as JSON)\n", bauds[i], bytes_s / text_hr, bytes_s / bin_hr,
+               100.0 * bin_samples * 10 / bytes_s, 100.0 * text_sample * 100 / bytes_s);
+    }
+    TEST_ASSERT_LESS_THAN(text_hr, bin_hr);
+    TEST_ASSERT_LESS_THAN(9600 / 10, bin_samples * 10);     // fits even at 9600
+
+    // encode + frame + decode cost per sample packet
+    static uint8_t stream[UNO_LINK_MAX_FRAME * 64];
+    size_t len = 0;
+    for (int i = 0; i < 64; i++) {
+        s.seq = i;
+        len += uno_link_encode(&s, stream + len, sizeof(stream) - len);
+    }
+    const int rounds = 2000;
+    uint32_t decoded = 0;
+    uart_framer_init_binary(&framer);
+    int64_t start = esp_timer_get_time();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t pos = 0; pos < len; ) {
+            size_t space;
+            uint8_t *dst = uart_framer_write_ptr(&framer, &space);
+            size_t n = len - pos < space ? len - pos : space;
+            memcpy(dst, stream + pos, n);
+            uart_framer_commit(&framer, n);
+            pos += n;
+            uart_frame_t fr;
+            uno_packet_t p;
+            while (uart_framer_next(&framer, &fr)) {
+                decoded += uno_link_decode((const uint8_t *)fr.data, fr.len, &p) == UNO_LINK_OK;
+            }
+        }
+    }
+    int64_t us = esp_timer_get_time() - start;
+    TEST_ASSERT_EQUAL(rounds * 64, decoded);
+    printf("framing + decoding: %.2f us per 10-sample packet, %u bytes\n",
+           (double)us / decoded, (unsigned)bin_samples);
+}